@@ -0,0 +1,367 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include <benchmark/benchmark.h>
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "BitVector.h"
+#include "Chromosome.h"
+#include "GeneticAlgorithm.h"
+#include "Genome.h"
+#include "Individual.h"
+#include "Population.h"
+#include "RandomWrapper.h"
+
+using panga::BitVector;
+using panga::Chromosome;
+using panga::GeneticAlgorithm;
+using panga::Genome;
+using panga::Individual;
+using panga::Population;
+using panga::RandomWrapper;
+
+namespace {
+
+constexpr uint64_t BenchmarkSeed = 20081014U;
+constexpr size_t GeneBitWidth = 16;
+constexpr double MutationRate = 0.001;
+constexpr size_t TournamentSize = 4;
+
+// Benchmarks over one chromosome are parameterized by the bit count.
+constexpr int64_t MinBitCount = 64;
+constexpr int64_t MaxBitCount = 1 << 16;
+
+// Benchmarks over a population are parameterized by the population size and
+// the bit count of each chromosome.
+const std::vector<int64_t> PopulationSizes = {64, 512, 4096};
+const std::vector<int64_t> PopulationBitCounts = {256, 4096};
+
+// Exposes the raw copy used by every bit-offset read and write.
+class BenchmarkBitVector : public BitVector {
+ public:
+  using BitVector::GetBytesWritable;
+  using BitVector::WriteBytes;
+};
+
+// Exposes the full pairwise diversity computation which is normally cached.
+class BenchmarkPopulation : public Population {
+ public:
+  using Population::CalculateDiversity;
+  using Population::Population;
+};
+
+// Scores an individual by its distance from the target BitVector passed as
+// |user_data|.
+double MatchingObjective(Individual* individual, void* user_data) {
+  const auto* target = static_cast<const BitVector*>(user_data);
+  return static_cast<double>(individual->HammingDistance(*target));
+}
+
+// A genome of |bit_count| bits split into genes of GeneBitWidth bits so
+// crossover has gene boundaries to respect.
+void BuildGenome(Genome* genome, size_t bit_count) {
+  for (size_t i = 0; i + GeneBitWidth <= bit_count; i += GeneBitWidth) {
+    genome->AddGene(GeneBitWidth);
+  }
+  genome->AddBooleanGenes(bit_count % GeneBitWidth);
+  genome->Freeze();
+}
+
+// An evaluated population of random individuals shared by the population
+// benchmarks.
+struct BenchmarkFixture {
+  BenchmarkFixture(size_t population_size, size_t bit_count)
+      : population(genome), target(bit_count), random(BenchmarkSeed) {
+    BuildGenome(&genome, bit_count);
+    population.Resize(population_size, &random);
+    population.Evaluate(MatchingObjective, &target);
+  }
+
+  Genome genome;
+  BenchmarkPopulation population;
+  BitVector target;
+  RandomWrapper random;
+};
+
+void SetBitsProcessed(benchmark::State& state, size_t bit_count) {
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) *
+                          static_cast<int64_t>(bit_count / CHAR_BIT));
+}
+
+void BM_WriteBytes(benchmark::State& state, size_t source_offset,
+                   size_t destination_offset) {
+  const auto bit_count = static_cast<size_t>(state.range(0));
+  RandomWrapper random(BenchmarkSeed);
+  // Leave room for the offsets on both sides.
+  BitVector source(bit_count + CHAR_BIT);
+  std::vector<std::byte> destination(
+      BitVector::BytesRequired(bit_count + CHAR_BIT));
+  random.FillBytes(destination.data(), destination.size());
+  for (size_t i = 0; i < bit_count; i += 3U) {
+    source.Set(i);
+  }
+
+  for (auto _ : state) {
+    BenchmarkBitVector::WriteBytes(source.GetBytes(), source_offset,
+                                   destination.data(), destination_offset,
+                                   bit_count);
+    benchmark::DoNotOptimize(destination.data());
+    benchmark::ClobberMemory();
+  }
+  SetBitsProcessed(state, bit_count);
+}
+BENCHMARK_CAPTURE(BM_WriteBytes, aligned, 0, 0)
+    ->RangeMultiplier(4)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_WriteBytes, unaligned, 3, 5)
+    ->RangeMultiplier(4)
+    ->Range(MinBitCount, MaxBitCount);
+
+void BM_HammingDistance(benchmark::State& state) {
+  const auto bit_count = static_cast<size_t>(state.range(0));
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  RandomWrapper random(BenchmarkSeed);
+  Chromosome left(genome);
+  Chromosome right(genome);
+  left.Randomize(&random);
+  right.Randomize(&random);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(left.HammingDistance(right));
+  }
+  SetBitsProcessed(state, bit_count);
+}
+BENCHMARK(BM_HammingDistance)
+    ->RangeMultiplier(4)
+    ->Range(MinBitCount, MaxBitCount);
+
+// Point counts for one-point, two-point, and k-point crossover. A count of 0
+// selects uniform crossover.
+constexpr size_t UniformCrossoverPoints = 0;
+constexpr size_t KPointCrossoverPoints = 5;
+
+void BM_Crossover(benchmark::State& state, size_t point_count,
+                  bool ignore_gene_boundaries) {
+  const auto bit_count = static_cast<size_t>(state.range(0));
+  Genome genome;
+  BuildGenome(&genome, bit_count);
+  RandomWrapper random(BenchmarkSeed);
+  Chromosome parent1(genome);
+  Chromosome parent2(genome);
+  Chromosome offspring(genome);
+  parent1.Randomize(&random);
+  parent2.Randomize(&random);
+
+  for (auto _ : state) {
+    if (point_count == UniformCrossoverPoints) {
+      Chromosome::UniformCrossover(parent1, parent2, &offspring, &random,
+                                   ignore_gene_boundaries);
+    } else {
+      Chromosome::KPointCrossover(point_count, parent1, parent2, &offspring,
+                                  &random, ignore_gene_boundaries);
+    }
+    benchmark::DoNotOptimize(offspring.GetBytes());
+  }
+  SetBitsProcessed(state, bit_count);
+}
+BENCHMARK_CAPTURE(BM_Crossover, one_point, 1, true)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, one_point_genes, 1, false)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, two_point, 2, true)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, two_point_genes, 2, false)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, k_point, KPointCrossoverPoints, true)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, k_point_genes, KPointCrossoverPoints, false)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, uniform, UniformCrossoverPoints, true)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Crossover, uniform_genes, UniformCrossoverPoints, false)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+
+using MutatorFunction = size_t (*)(Chromosome*, double, RandomWrapper*);
+
+void BM_Mutator(benchmark::State& state, MutatorFunction mutator) {
+  const auto bit_count = static_cast<size_t>(state.range(0));
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  RandomWrapper random(BenchmarkSeed);
+  Chromosome chromosome(genome);
+  chromosome.Randomize(&random);
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(mutator(&chromosome, MutationRate, &random));
+  }
+  SetBitsProcessed(state, bit_count);
+}
+BENCHMARK_CAPTURE(BM_Mutator, flip, Chromosome::FlipMutator)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Mutator, geometric_flip, Chromosome::GeometricFlipMutator)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+BENCHMARK_CAPTURE(BM_Mutator, mask_flip, Chromosome::MaskFlipMutator)
+    ->RangeMultiplier(8)
+    ->Range(MinBitCount, MaxBitCount);
+
+enum class Selector : uint8_t {
+  Uniform = 1,
+  RouletteWheel,
+  Alias,
+  StochasticUniversalSampling,
+  Tournament,
+  Rank
+};
+
+void BM_Select(benchmark::State& state, Selector selector) {
+  BenchmarkFixture fixture(static_cast<size_t>(state.range(0)),
+                           static_cast<size_t>(state.range(1)));
+  auto& population = fixture.population;
+  auto* random = &fixture.random;
+  population.InitializePartialSums();
+  population.InitializeAliasTable();
+  std::vector<const Individual*> sampled;
+
+  for (auto _ : state) {
+    switch (selector) {
+      case Selector::Uniform:
+        benchmark::DoNotOptimize(&population.UniformSelect(random));
+        break;
+      case Selector::RouletteWheel:
+        benchmark::DoNotOptimize(&population.RouletteWheelSelect(random));
+        break;
+      case Selector::Alias:
+        benchmark::DoNotOptimize(&population.AliasSelect(random));
+        break;
+      case Selector::StochasticUniversalSampling:
+        // One sweep picks a parent for every member of the next generation.
+        population.StochasticUniversalSelect(population.Size(), random,
+                                             &sampled);
+        benchmark::DoNotOptimize(sampled.data());
+        break;
+      case Selector::Tournament:
+        benchmark::DoNotOptimize(
+            &population.TournamentSelect(TournamentSize, random));
+        break;
+      case Selector::Rank:
+        benchmark::DoNotOptimize(&population.RankSelect());
+        break;
+    }
+  }
+  state.SetItemsProcessed(
+      static_cast<int64_t>(state.iterations()) *
+      (selector == Selector::StochasticUniversalSampling ? state.range(0)
+                                                         : 1));
+}
+BENCHMARK_CAPTURE(BM_Select, uniform, Selector::Uniform)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+BENCHMARK_CAPTURE(BM_Select, roulette_wheel, Selector::RouletteWheel)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+BENCHMARK_CAPTURE(BM_Select, alias, Selector::Alias)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+BENCHMARK_CAPTURE(BM_Select, stochastic_universal_sampling,
+                  Selector::StochasticUniversalSampling)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+BENCHMARK_CAPTURE(BM_Select, tournament, Selector::Tournament)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+BENCHMARK_CAPTURE(BM_Select, rank, Selector::Rank)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+
+void BM_PopulationSort(benchmark::State& state) {
+  BenchmarkFixture fixture(static_cast<size_t>(state.range(0)),
+                           static_cast<size_t>(state.range(1)));
+  auto& population = fixture.population;
+  const auto score_range = static_cast<uint64_t>(state.range(1)) + 1U;
+
+  for (auto _ : state) {
+    // Sort starts from the last order so give every individual a new score,
+    // like a new generation would, or only the first sort does any work.
+    state.PauseTiming();
+    for (size_t i = 0; i < population.Size(); i++) {
+      population.GetIndividualWritable(i).SetScore(
+          static_cast<double>(fixture.random.RandomBounded(score_range)));
+    }
+    state.ResumeTiming();
+
+    population.Sort();
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+BENCHMARK(BM_PopulationSort)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+
+void BM_PopulationEvaluate(benchmark::State& state) {
+  BenchmarkFixture fixture(static_cast<size_t>(state.range(0)),
+                           static_cast<size_t>(state.range(1)));
+  auto& population = fixture.population;
+
+  for (auto _ : state) {
+    population.Evaluate(MatchingObjective, &fixture.target);
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+BENCHMARK(BM_PopulationEvaluate)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+
+void BM_PopulationDiversity(benchmark::State& state) {
+  BenchmarkFixture fixture(static_cast<size_t>(state.range(0)),
+                           static_cast<size_t>(state.range(1)));
+  auto& population = fixture.population;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        population.CalculateDiversity(nullptr, population.Size()));
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+BENCHMARK(BM_PopulationDiversity)
+    ->ArgsProduct({PopulationSizes, PopulationBitCounts});
+
+void BM_Step(benchmark::State& state) {
+  const auto population_size = static_cast<size_t>(state.range(0));
+  const auto bit_count = static_cast<size_t>(state.range(1));
+  BitVector target(bit_count);
+  GeneticAlgorithm ga;
+  BuildGenome(&ga.GetGenome(), bit_count);
+  ga.SetPopulationSize(population_size);
+  ga.SetEliteCount(2);
+  ga.SetMutationRate(MutationRate);
+  ga.SetFitnessFunction(MatchingObjective);
+  ga.SetUserData(&target);
+  ga.SetRandomSeed(BenchmarkSeed);
+  ga.Initialize();
+  ga.Step();
+
+  for (auto _ : state) {
+    ga.Step();
+  }
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations()) *
+                          state.range(0));
+}
+BENCHMARK(BM_Step)->ArgsProduct({PopulationSizes, PopulationBitCounts});
+
+}  // namespace
+
+BENCHMARK_MAIN();
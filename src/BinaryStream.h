@@ -0,0 +1,159 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef BINARYSTREAM_H__
+#define BINARYSTREAM_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <type_traits>
+
+namespace panga {
+
+/**
+ * Large arrays in a checkpoint start at a multiple of this many bytes from
+ * the start of the file so a memory-mapped checkpoint can be used in place.
+ */
+constexpr size_t CheckpointAlignment = 64;
+
+/**
+ * Write the raw bytes of |value| to |stream| in host byte order.
+ */
+template <typename ValueType>
+void WriteBinary(std::ostream* stream, const ValueType& value) {
+  static_assert(std::is_trivially_copyable_v<ValueType>,
+                "Only trivially copyable values can be written as bytes");
+  stream->write(reinterpret_cast<const char*>(&value), sizeof(ValueType));
+}
+
+/**
+ * Read the raw bytes of |value| from |stream|.
+ * @return false if |stream| ran out of bytes.
+ */
+template <typename ValueType>
+bool ReadBinary(std::istream* stream, ValueType* value) {
+  static_assert(std::is_trivially_copyable_v<ValueType>,
+                "Only trivially copyable values can be read as bytes");
+  stream->read(reinterpret_cast<char*>(value), sizeof(ValueType));
+  return stream->good();
+}
+
+/**
+ * Sizes are always stored as 64-bit values so checkpoints don't depend on
+ * the width of size_t.
+ */
+inline void WriteSize(std::ostream* stream, size_t value) {
+  WriteBinary(stream, static_cast<uint64_t>(value));
+}
+
+inline bool ReadSize(std::istream* stream, size_t* value) {
+  uint64_t stored = 0;
+  if (!ReadBinary(stream, &stored)) {
+    return false;
+  }
+  *value = static_cast<size_t>(stored);
+  return true;
+}
+
+/**
+ * Flags and enumerations are stored as single bytes.
+ */
+inline void WriteFlag(std::ostream* stream, bool value) {
+  WriteBinary(stream, static_cast<uint8_t>(value));
+}
+
+inline bool ReadFlag(std::istream* stream, bool* value) {
+  uint8_t stored = 0;
+  if (!ReadBinary(stream, &stored)) {
+    return false;
+  }
+  *value = stored != 0;
+  return true;
+}
+
+template <typename EnumType>
+void WriteEnum(std::ostream* stream, EnumType value) {
+  static_assert(sizeof(EnumType) == sizeof(uint8_t),
+                "Only enumerations with a byte-wide type can be written");
+  WriteBinary(stream, static_cast<uint8_t>(value));
+}
+
+/**
+ * Read an enumeration written by WriteEnum.
+ * @return false if |stream| ran out of bytes or the stored value is outside
+ * [|first|, |last|].
+ */
+template <typename EnumType>
+bool ReadEnum(std::istream* stream, EnumType first, EnumType last,
+              EnumType* value) {
+  uint8_t stored = 0;
+  if (!ReadBinary(stream, &stored) || stored < static_cast<uint8_t>(first) ||
+      stored > static_cast<uint8_t>(last)) {
+    return false;
+  }
+  *value = static_cast<EnumType>(stored);
+  return true;
+}
+
+/**
+ * Return true if |stream| may still hold |count| values of |value_size|
+ * bytes each.<br/>
+ * Counts read from a checkpoint are checked with this before anything is
+ * allocated for them. Streams which can't seek are only checked for counts
+ * too large to fit in memory at all.
+ */
+inline bool HasBytesLeft(std::istream* stream, size_t count,
+                         size_t value_size) {
+  if (value_size != 0 &&
+      count > std::numeric_limits<size_t>::max() / value_size) {
+    return false;
+  }
+  const auto position = stream->tellg();
+  if (position < 0) {
+    return stream->good();
+  }
+  stream->seekg(0, std::ios::end);
+  const auto end = stream->tellg();
+  stream->seekg(position);
+  if (end < 0) {
+    stream->clear();
+    stream->seekg(position);
+    return stream->good();
+  }
+  return static_cast<size_t>(end - position) >= count * value_size;
+}
+
+/**
+ * Write zero bytes to |stream| until its position is a multiple of
+ * CheckpointAlignment.
+ */
+inline void WriteAlignment(std::ostream* stream) {
+  const auto position = static_cast<size_t>(stream->tellp());
+  for (size_t i = position % CheckpointAlignment;
+       i != 0 && i < CheckpointAlignment; i++) {
+    stream->put(0);
+  }
+}
+
+/**
+ * Skip the bytes written by WriteAlignment.
+ */
+inline bool ReadAlignment(std::istream* stream) {
+  const auto position = static_cast<size_t>(stream->tellg());
+  const size_t remainder = position % CheckpointAlignment;
+  if (remainder != 0) {
+    stream->ignore(static_cast<std::streamsize>(CheckpointAlignment -
+                                                remainder));
+  }
+  return stream->good();
+}
+
+}  // namespace panga
+
+#endif  // BINARYSTREAM_H__
@@ -13,32 +13,234 @@
 #include <cstring>
 #include <iomanip>
 #include <limits>
+#include <utility>
+#include <vector>
 
 namespace {
 
 constexpr size_t BitsPerByte = CHAR_BIT;
+constexpr size_t BitsPerWord = sizeof(uint64_t) * BitsPerByte;
 
 // We would like to use std::numeric_limits<std::byte>::max() but that isn't
 // defined for std::byte.
 constexpr std::byte MaxByteValue = std::byte{UCHAR_MAX};
 
+// The word-wise kernels below are compiled for several instruction sets when
+// the toolchain supports function multi-versioning. The best version for the
+// running CPU is picked by the loader the first time the kernel is called.
+// ThreadSanitizer crashes resolving those before main so it gets the default
+// version only.
+#if defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define PANGA_DISABLE_MULTIVERSIONING
+#endif
+#endif
+#if defined(__SANITIZE_THREAD__) && !defined(PANGA_DISABLE_MULTIVERSIONING)
+#define PANGA_DISABLE_MULTIVERSIONING
+#endif
+#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute) && \
+    !defined(PANGA_DISABLE_MULTIVERSIONING)
+#if __has_attribute(target_clones)
+#define PANGA_MULTIVERSION \
+  __attribute__((target_clones("arch=x86-64-v4", "arch=x86-64-v3", \
+                                "popcnt", "default")))
+#endif
+#endif
+#if !defined(PANGA_MULTIVERSION)
+#define PANGA_MULTIVERSION
+#endif
+
+/**
+ * Get a word with the low |bit_count| bits set.<br/>
+ * Note: |bit_count| must be less than the number of bits in a word.
+ */
+constexpr uint64_t LowBitsMask(size_t bit_count) {
+  return (uint64_t{1} << bit_count) - 1U;
+}
+
+/**
+ * Count the number of bits set in a word.
+ */
+inline size_t CountSetBits(uint64_t val) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_popcountll(val));
+#else
+  // Count bits in parallel within 2-, 4-, and then 8-bit fields and sum the
+  // bytes using a multiply.
+  constexpr uint64_t m1 = 0x5555555555555555ULL;
+  constexpr uint64_t m2 = 0x3333333333333333ULL;
+  constexpr uint64_t m4 = 0x0f0f0f0f0f0f0f0fULL;
+  constexpr uint64_t h01 = 0x0101010101010101ULL;
+  constexpr unsigned sum_shift = 56U;
+  val -= (val >> 1U) & m1;
+  val = (val & m2) + ((val >> 2U) & m2);
+  val = (val + (val >> 4U)) & m4;
+  return static_cast<size_t>((val * h01) >> sum_shift);
+#endif
+}
+
+/**
+ * Get the index of the lowest set bit of |val|.<br/>
+ * Note: |val| must not be 0.
+ */
+inline size_t LowestSetBit(uint64_t val) {
+#if defined(__GNUC__) || defined(__clang__)
+  return static_cast<size_t>(__builtin_ctzll(val));
+#else
+  // Isolate the lowest set bit and count the bits below it.
+  return CountSetBits((val & (0U - val)) - 1U);
+#endif
+}
+
+/**
+ * Load a word from |bytes| such that bit i of the word is bit (i % 8) of
+ * byte (i / 8) - the same bit order the BitVector uses.
+ */
+inline uint64_t LoadWord(const std::byte* bytes) {
+  return panga::BitVector::LoadUnalignedWord(bytes);
+}
+
 /**
- * Count the number of bits set in a byte.
+ * Store |value| into |bytes| using the bit order of LoadWord.
  */
-uint32_t CountSetBits(std::byte val) {
-  static constexpr int bits_set_table[256] = {
-      0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4,
-      2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-      2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4,
-      2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6,
-      2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6,
-      4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5,
-      2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5,
-      3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-      2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6,
-      4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7,
-      4, 5, 5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8};
-  return bits_set_table[std::to_integer<uint8_t>(val)];
+inline void StoreWord(std::byte* bytes, uint64_t value) {
+  panga::BitVector::StoreUnalignedWord(bytes, value);
+}
+
+/**
+ * Scramble the bits of |value| such that every input bit affects every
+ * output bit. This is the finalizer from MurmurHash3.
+ */
+inline uint64_t HashMix(uint64_t value) {
+  constexpr uint64_t first_multiplier = 0xff51afd7ed558ccdULL;
+  constexpr uint64_t second_multiplier = 0xc4ceb9fe1a85ec53ULL;
+  constexpr unsigned shift = 33;
+  value ^= value >> shift;
+  value *= first_multiplier;
+  value ^= value >> shift;
+  value *= second_multiplier;
+  value ^= value >> shift;
+  return value;
+}
+
+/**
+ * Load |byte_count| (at most 8) bytes from |bytes| into the low bytes of a
+ * word using the bit order of LoadWord. Doesn't touch memory past the last
+ * byte.
+ */
+inline uint64_t LoadPartialWord(const std::byte* bytes, size_t byte_count) {
+  if (byte_count == sizeof(uint64_t)) {
+    return LoadWord(bytes);
+  }
+  uint64_t value = 0;
+  for (size_t i = 0; i < byte_count; i++) {
+    value |= static_cast<uint64_t>(std::to_integer<uint8_t>(bytes[i]))
+             << (i * BitsPerByte);
+  }
+  return value;
+}
+
+/**
+ * Store the low |byte_count| (at most 8) bytes of |value| into |bytes|.
+ */
+inline void StorePartialWord(std::byte* bytes, size_t byte_count,
+                             uint64_t value) {
+  if (byte_count == sizeof(uint64_t)) {
+    StoreWord(bytes, value);
+    return;
+  }
+  for (size_t i = 0; i < byte_count; i++) {
+    bytes[i] = static_cast<std::byte>(value >> (i * BitsPerByte));
+  }
+}
+
+/**
+ * Count the bits which differ between the first |word_count| words of |left|
+ * and |right|.
+ */
+PANGA_MULTIVERSION
+size_t CountDifferentBits(const std::byte* left, const std::byte* right,
+                          size_t word_count) {
+  size_t distance = 0;
+  for (size_t i = 0; i < word_count; i++) {
+    uint64_t left_word = 0;
+    uint64_t right_word = 0;
+    std::memcpy(&left_word, left + i * sizeof(uint64_t), sizeof(uint64_t));
+    std::memcpy(&right_word, right + i * sizeof(uint64_t), sizeof(uint64_t));
+    distance += CountSetBits(left_word ^ right_word);
+  }
+  return distance;
+}
+
+/**
+ * Write (mask & left) | (~mask & right) into the first |word_count| words of
+ * |destination|.
+ */
+PANGA_MULTIVERSION
+void BlendWords(const std::byte* mask, const std::byte* left,
+                const std::byte* right, std::byte* destination,
+                size_t word_count) {
+  for (size_t i = 0; i < word_count; i++) {
+    const size_t offset = i * sizeof(uint64_t);
+    uint64_t mask_word = 0;
+    uint64_t left_word = 0;
+    uint64_t right_word = 0;
+    std::memcpy(&mask_word, mask + offset, sizeof(uint64_t));
+    std::memcpy(&left_word, left + offset, sizeof(uint64_t));
+    std::memcpy(&right_word, right + offset, sizeof(uint64_t));
+    const uint64_t blended = (mask_word & left_word) | (~mask_word & right_word);
+    std::memcpy(destination + offset, &blended, sizeof(uint64_t));
+  }
+}
+
+/**
+ * Write (mask & left) | (~mask & right) into the first |word_count| words of
+ * |destination| where bit b of |mask|[i] selects bit 64 * i + b.
+ */
+PANGA_MULTIVERSION
+void BlendMaskWords(const uint64_t* mask, const std::byte* left,
+                    const std::byte* right, std::byte* destination,
+                    size_t word_count) {
+  for (size_t i = 0; i < word_count; i++) {
+    const size_t offset = i * sizeof(uint64_t);
+    const uint64_t blended = (mask[i] & LoadWord(left + offset)) |
+                             (~mask[i] & LoadWord(right + offset));
+    StoreWord(destination + offset, blended);
+  }
+}
+
+/**
+ * Flip bit b of word i of |bytes| wherever bit b of |mask|[i] is set for the
+ * first |word_count| words.
+ * @return The number of bits flipped.
+ */
+PANGA_MULTIVERSION
+size_t XorMaskWords(const uint64_t* mask, std::byte* bytes,
+                    size_t word_count) {
+  size_t flipped = 0;
+  for (size_t i = 0; i < word_count; i++) {
+    std::byte* word_bytes = bytes + i * sizeof(uint64_t);
+    StoreWord(word_bytes, LoadWord(word_bytes) ^ mask[i]);
+    flipped += CountSetBits(mask[i]);
+  }
+  return flipped;
+}
+
+/**
+ * Add bit b of each of the first |word_count| words of |bytes| into
+ * |counts|[64 * word + b].<br/>
+ * Written without branches so the inner loop can be vectorized.
+ */
+PANGA_MULTIVERSION
+void AccumulateWordBits(const std::byte* bytes, size_t word_count,
+                        uint32_t* counts) {
+  for (size_t i = 0; i < word_count; i++) {
+    const uint64_t word = LoadWord(bytes + i * sizeof(uint64_t));
+    uint32_t* word_counts = counts + i * BitsPerWord;
+    for (size_t bit = 0; bit < BitsPerWord; bit++) {
+      word_counts[bit] += static_cast<uint32_t>((word >> bit) & 1U);
+    }
+  }
 }
 
 }  // namespace
@@ -51,17 +253,66 @@ BitVector::BitVector(size_t bit_count) { SetBitCount(bit_count); }
 
 BitVector::BitVector(const BitVector& source) { *this = source; }
 
+BitVector::BitVector(BitVector&& source) noexcept
+    : owned_bytes_(std::move(source.owned_bytes_)),
+      bytes_(source.bytes_),
+      byte_capacity_(source.byte_capacity_),
+      bit_count_(source.bit_count_) {
+  // Moving the vector keeps its buffer so |bytes_| stays valid whether it
+  // points into owned_bytes_ or into external storage.
+  source.bytes_ = nullptr;
+  source.byte_capacity_ = 0;
+  source.bit_count_ = 0;
+}
+
+BitVector::BitVector(size_t bit_count, std::byte* storage,
+                     size_t byte_capacity)
+    : bytes_(storage), byte_capacity_(byte_capacity) {
+  assert(storage != nullptr || byte_capacity == 0);
+  SetBitCount(bit_count);
+}
+
 BitVector& BitVector::operator=(const BitVector& rhs) {
   if (this != &rhs) {
     Resize(rhs.bit_count_);
-    std::copy_n(rhs.bytes_.cbegin(), rhs.bytes_.size(), bytes_.begin());
+    // Either buffer may be larger than we need if it was previously used for
+    // more bits. Only copy the bytes backing rhs.bit_count_ bits.
+    std::copy_n(rhs.bytes_, BytesRequired(rhs.bit_count_), bytes_);
   }
   return *this;
 }
 
-const std::vector<std::byte>& BitVector::GetBytes() const { return bytes_; }
+const std::byte* BitVector::GetBytes() const { return bytes_; }
 
-std::vector<std::byte>& BitVector::GetBytesWritable() { return bytes_; }
+std::byte* BitVector::GetBytesWritable() { return bytes_; }
+
+void BitVector::AttachStorage(std::byte* storage, size_t byte_capacity) {
+  const size_t byte_count = BytesRequired(bit_count_);
+  assert(storage != nullptr || byte_capacity == 0);
+  assert(byte_capacity >= byte_count);
+
+  if (storage != bytes_) {
+    std::copy_n(bytes_, byte_count, storage);
+  }
+  bytes_ = storage;
+  byte_capacity_ = byte_capacity;
+
+  // Release any storage we owned before.
+  std::vector<std::byte>().swap(owned_bytes_);
+}
+
+bool BitVector::HasExternalStorage() const {
+  return byte_capacity_ != 0 && owned_bytes_.empty();
+}
+
+void BitVector::SwapStorage(BitVector* other) {
+  assert(other != nullptr);
+  assert(HasExternalStorage() && other->HasExternalStorage());
+  assert(bit_count_ == other->bit_count_);
+
+  std::swap(bytes_, other->bytes_);
+  std::swap(byte_capacity_, other->byte_capacity_);
+}
 
 // static
 void BitVector::WriteBytes(const std::byte* source,
@@ -69,72 +320,94 @@ void BitVector::WriteBytes(const std::byte* source,
                            std::byte* destination,
                            size_t destination_start_bit_offset,
                            size_t bits_to_copy) {
-  const size_t destination_first_byte_index =
-      destination_start_bit_offset / BitsPerByte;
-  const size_t destination_last_byte_index =
-      (destination_start_bit_offset + bits_to_copy) / BitsPerByte;
-  const std::byte last_byte = destination[destination_last_byte_index];
+  if (bits_to_copy == 0) {
+    return;
+  }
+
+  // Move the pointers up to the bytes containing the first bits so the
+  // offsets we need to track are always smaller than a byte.
+  source += source_start_bit_offset / BitsPerByte;
+  destination += destination_start_bit_offset / BitsPerByte;
+  size_t source_bit_offset = source_start_bit_offset % BitsPerByte;
+  size_t destination_bit_offset = destination_start_bit_offset % BitsPerByte;
 
-  // Copy all the bytes except for the last one.
   // If we're reading from and writing to byte-aligned memory, we can take a
   // fast path using memcpy.
-  if (source_start_bit_offset % BitsPerByte == 0 &&
-      destination_start_bit_offset % BitsPerByte == 0) {
-    std::memcpy(destination + destination_first_byte_index,
-                source + (source_start_bit_offset / BitsPerByte),
-                sizeof(std::byte) * (destination_last_byte_index -
-                                     destination_first_byte_index + 1));
-  } else {
-    // Keep track of the first byte in destination so we can put back the bits
-    // in that byte which are not supposed to be overwritten.
-    const std::byte first_byte = destination[destination_first_byte_index];
-    // Zero-out all the bytes which we're going to overwrite in destination.
-    // TODO(boingoing): Can we avoid this?
-    std::memset(destination + destination_first_byte_index, 0,
-                sizeof(std::byte) * (destination_last_byte_index -
-                                     destination_first_byte_index + 1));
-
-    // Now copy bits from source until we've written at least bits_to_copy.
-    size_t bits_written = 0;
-    while (bits_written < bits_to_copy) {
-      const size_t source_byte_index =
-          (source_start_bit_offset + bits_written) / BitsPerByte;
-      const size_t source_bit_offset =
-          (source_start_bit_offset + bits_written) % BitsPerByte;
-      const size_t destination_byte_index =
-          (destination_start_bit_offset + bits_written) / BitsPerByte;
-      const size_t destination_bit_offset =
-          (destination_start_bit_offset + bits_written) % BitsPerByte;
-
-      // Shift the source byte such that it begins with the relevant bits and
-      // shift those so they slot into the destination byte at the correct bit
-      // offset.
-      destination[destination_byte_index] |=
-          source[source_byte_index] >> source_bit_offset
-                                           << destination_bit_offset;
-
-      // Due to the bit-shifting above, we can only ever copy the smaller of
-      // source_bit_offset and destination_bit_offset number of bits while
-      // writing a single byte.
-      bits_written += std::min(BitsPerByte - source_bit_offset,
-                               BitsPerByte - destination_bit_offset);
+  if (source_bit_offset == 0 && destination_bit_offset == 0) {
+    const size_t byte_count = bits_to_copy / BitsPerByte;
+    std::memcpy(destination, source, byte_count);
+
+    // Now mask off the last byte so we don't lose existing bits there.
+    const size_t remaining_bits = bits_to_copy % BitsPerByte;
+    if (remaining_bits != 0) {
+      const std::byte mask = MaxByteValue >> (BitsPerByte - remaining_bits);
+      destination[byte_count] =
+          (destination[byte_count] & ~mask) | (source[byte_count] & mask);
     }
+    return;
+  }
 
-    // Mask off the bits in the destination first byte which we do not want to
-    // overwrite and put them back into the destination first byte.
-    const size_t destination_first_byte_bit_index =
-        destination_start_bit_offset % BitsPerByte;
-    destination[destination_first_byte_index] |=
-        first_byte &
-        MaxByteValue >> (BitsPerByte - destination_first_byte_bit_index);
+  // Otherwise copy a word-sized chunk of bits at a time. We copy at most 56
+  // bits per chunk so a chunk plus its (less than one byte) bit offset always
+  // fits in a single 64-bit load or store. We never touch bytes outside of
+  // the ranges being read and written.
+  constexpr size_t max_chunk_bits = BitsPerWord - BitsPerByte;
+  while (bits_to_copy > 0) {
+    const size_t chunk_bits = std::min(bits_to_copy, max_chunk_bits);
+    const uint64_t chunk_mask = LowBitsMask(chunk_bits);
+
+    const size_t source_byte_count =
+        (source_bit_offset + chunk_bits + BitsPerByte - 1U) / BitsPerByte;
+    const uint64_t value =
+        (LoadPartialWord(source, source_byte_count) >> source_bit_offset) &
+        chunk_mask;
+
+    // Keep the destination bits outside of the chunk as they were.
+    const size_t destination_byte_count =
+        (destination_bit_offset + chunk_bits + BitsPerByte - 1U) / BitsPerByte;
+    const uint64_t destination_mask = chunk_mask << destination_bit_offset;
+    const uint64_t existing =
+        LoadPartialWord(destination, destination_byte_count);
+    StorePartialWord(destination, destination_byte_count,
+                     (existing & ~destination_mask) |
+                         (value << destination_bit_offset));
+
+    bits_to_copy -= chunk_bits;
+    source += (source_bit_offset + chunk_bits) / BitsPerByte;
+    source_bit_offset = (source_bit_offset + chunk_bits) % BitsPerByte;
+    destination += (destination_bit_offset + chunk_bits) / BitsPerByte;
+    destination_bit_offset =
+        (destination_bit_offset + chunk_bits) % BitsPerByte;
   }
+}
+
+// static
+void BitVector::BlendBytes(const std::byte* mask, const std::byte* left,
+                           const std::byte* right, std::byte* destination,
+                           size_t byte_count) {
+  assert(byte_count % sizeof(uint64_t) == 0);
+  ::BlendWords(mask, left, right, destination, byte_count / sizeof(uint64_t));
+}
+
+// static
+void BitVector::BlendWords(const uint64_t* mask, const std::byte* left,
+                           const std::byte* right, std::byte* destination,
+                           size_t word_count) {
+  BlendMaskWords(mask, left, right, destination, word_count);
+}
 
-  // Now mask off the last byte so we don't lose existing bits there.
-  const size_t destination_last_byte_bit_index =
-      (destination_start_bit_offset + bits_to_copy) % BitsPerByte;
-  const std::byte mask = MaxByteValue << destination_last_byte_bit_index;
-  destination[destination_last_byte_index] =
-      destination[destination_last_byte_index] & ~mask | last_byte & mask;
+// static
+size_t BitVector::XorWords(const uint64_t* mask, std::byte* destination,
+                           size_t word_count) {
+  return XorMaskWords(mask, destination, word_count);
+}
+
+// static
+size_t BitVector::BytesRequired(size_t bit_count) {
+  // Round up to a whole number of words so the word-wise kernels never need
+  // to handle a partial word at the end of the buffer.
+  const size_t word_count = (bit_count + BitsPerWord - 1U) / BitsPerWord;
+  return word_count * sizeof(uint64_t);
 }
 
 // static
@@ -158,21 +431,19 @@ bool BitVector::Compare(const std::byte* left, const std::byte* right,
 }
 
 void BitVector::Clear() {
-  this->bytes_.assign(this->bytes_.size(), std::byte{0x0});
+  std::fill_n(this->bytes_, this->byte_capacity_, std::byte{0x0});
 }
 
 void BitVector::Resize(size_t bit_count) {
-  // Number of full bytes needed.
-  size_t new_bytes_count = bit_count / BitsPerByte;
-
-  // Partial byte at the end.
-  if (bit_count % BitsPerByte != 0) {
-    new_bytes_count++;
-  }
-
-  // Allocate new memory only if we need to grow the vector.
-  if (this->bytes_.size() < new_bytes_count) {
-    this->bytes_.resize(new_bytes_count);
+  const size_t new_bytes_count = BytesRequired(bit_count);
+
+  // Allocate new memory only if we need to grow the vector. External storage
+  // can never grow.
+  if (this->byte_capacity_ < new_bytes_count) {
+    assert(!HasExternalStorage());
+    this->owned_bytes_.resize(new_bytes_count);
+    this->bytes_ = this->owned_bytes_.data();
+    this->byte_capacity_ = new_bytes_count;
   }
 
   // Possibly truncate if the new size is smaller.
@@ -203,6 +474,27 @@ void BitVector::Flip(size_t index) {
   this->bytes_[byte_offset] ^= mask;
 }
 
+void BitVector::FlipBits(const BitVector& mask) {
+  assert(this->bit_count_ == mask.bit_count_);
+
+  const auto flip_word = [this, &mask](size_t word_index, uint64_t keep) {
+    const size_t offset = word_index * sizeof(uint64_t);
+    StoreWord(this->bytes_ + offset,
+              LoadWord(this->bytes_ + offset) ^
+                  (LoadWord(mask.bytes_ + offset) & keep));
+  };
+
+  const size_t full_words = this->bit_count_ / BitsPerWord;
+  for (size_t i = 0; i < full_words; i++) {
+    flip_word(i, ~uint64_t{0});
+  }
+  // Leave the bits past the end of the last word alone.
+  const size_t tail_bits = this->bit_count_ % BitsPerWord;
+  if (tail_bits != 0) {
+    flip_word(full_words, LowBitsMask(tail_bits));
+  }
+}
+
 void BitVector::Set(size_t index) {
   assert(index < this->bit_count_);
 
@@ -236,16 +528,56 @@ void BitVector::SubVector(BitVector* destination,
                           size_t source_start_bit_offset,
                           size_t bits_to_copy) const {
   // Resize destination if it's not big enough
-  destination->Resize(destination_start_bit_offset + bits_to_copy);
+  const size_t destination_end_bit_offset =
+      destination_start_bit_offset + bits_to_copy;
+  if (destination->bit_count_ < destination_end_bit_offset) {
+    destination->Resize(destination_end_bit_offset);
+  }
 
-  WriteBytes(this->bytes_.data(), source_start_bit_offset,
-             destination->bytes_.data(), destination_start_bit_offset,
+  WriteBytes(this->bytes_, source_start_bit_offset,
+             destination->bytes_, destination_start_bit_offset,
              bits_to_copy);
 }
 
-size_t BitVector::HammingDistance(const BitVector& rhs) const {
-  size_t distance = 0;
+// static
+size_t BitVector::FindNextBit(const std::byte* left, const std::byte* right,
+                              size_t bit_count, size_t start) {
+  if (start >= bit_count) {
+    return bit_count;
+  }
 
+  const size_t word_count = (bit_count + BitsPerWord - 1U) / BitsPerWord;
+  size_t word_index = start / BitsPerWord;
+  const auto load = [left, right](size_t index) {
+    const size_t offset = index * sizeof(uint64_t);
+    const uint64_t word = LoadWord(left + offset);
+    return right != nullptr ? word ^ LoadWord(right + offset) : word;
+  };
+
+  // Drop the bits of the first word which come before |start|.
+  uint64_t word =
+      load(word_index) & (~uint64_t{0} << (start % BitsPerWord));
+  while (word == 0) {
+    if (++word_index == word_count) {
+      return bit_count;
+    }
+    word = load(word_index);
+  }
+  // Bits past the end of the last word may be set so clamp to the end.
+  return std::min(word_index * BitsPerWord + LowestSetBit(word), bit_count);
+}
+
+size_t BitVector::FindNextSetBit(size_t start) const {
+  return FindNextBit(this->bytes_, nullptr, this->bit_count_, start);
+}
+
+size_t BitVector::FindNextDifference(const BitVector& rhs,
+                                     size_t start) const {
+  assert(this->bit_count_ == rhs.bit_count_);
+  return FindNextBit(this->bytes_, rhs.bytes_, this->bit_count_, start);
+}
+
+size_t BitVector::HammingDistance(const BitVector& rhs) const {
   // If the two BitVectors differ in the number of bits they contain, it's not
   // clear what we should return. For now, treat this as an error condition and
   // return infinity-ish.
@@ -253,30 +585,124 @@ size_t BitVector::HammingDistance(const BitVector& rhs) const {
     return std::numeric_limits<size_t>::max();
   }
 
-  const size_t last_byte = this->bit_count_ / BitsPerByte;
+  // All but the last word.
+  const size_t full_words = this->bit_count_ / BitsPerWord;
+  size_t distance = CountDifferentBits(this->bytes_, rhs.bytes_, full_words);
 
-  // All but the last byte.
-  for (size_t i = 0; i < last_byte; i++) {
-    distance += CountSetBits(this->bytes_[i] ^ rhs.bytes_[i]);
+  // Mask the last word so it only includes bits which are in the vector.
+  const size_t relevant_bits = this->bit_count_ % BitsPerWord;
+  if (relevant_bits > 0) {
+    const size_t offset = full_words * sizeof(uint64_t);
+    const uint64_t difference = LoadWord(this->bytes_ + offset) ^
+                                LoadWord(rhs.bytes_ + offset);
+    distance += CountSetBits(difference & LowBitsMask(relevant_bits));
   }
 
-  // Mask the last byte so it only includes bits which are in the vector.
-  const size_t relevant_bits = this->bit_count_ % BitsPerByte;
+  return distance;
+}
 
+size_t BitVector::GetSetBitCount() const {
+  const size_t full_words = this->bit_count_ / BitsPerWord;
+  size_t count = 0;
+  for (size_t i = 0; i < full_words; i++) {
+    count += CountSetBits(LoadWord(this->bytes_ + i * sizeof(uint64_t)));
+  }
+
+  // Padding bits past the bit count are unspecified so mask them out.
+  const size_t relevant_bits = this->bit_count_ % BitsPerWord;
   if (relevant_bits > 0) {
-    const std::byte mask = MaxByteValue >> (BitsPerByte - relevant_bits);
-    distance += CountSetBits((this->bytes_[last_byte] & mask) ^
-                             (rhs.bytes_[last_byte] & mask));
+    const uint64_t word =
+        LoadWord(this->bytes_ + full_words * sizeof(uint64_t));
+    count += CountSetBits(word & LowBitsMask(relevant_bits));
   }
 
-  return distance;
+  return count;
+}
+
+uint64_t BitVector::Hash() const {
+  // Start from the bit count so vectors which only differ in length don't
+  // collide.
+  uint64_t hash = HashMix(this->bit_count_);
+
+  const size_t full_words = this->bit_count_ / BitsPerWord;
+  for (size_t i = 0; i < full_words; i++) {
+    hash = HashMix(hash ^ LoadWord(this->bytes_ + i * sizeof(uint64_t)));
+  }
+
+  // Padding bits past the bit count are unspecified so mask them out.
+  const size_t relevant_bits = this->bit_count_ % BitsPerWord;
+  if (relevant_bits > 0) {
+    const uint64_t word =
+        LoadWord(this->bytes_ + full_words * sizeof(uint64_t));
+    hash = HashMix(hash ^ (word & LowBitsMask(relevant_bits)));
+  }
+
+  return hash;
+}
+
+void BitVector::AccumulateSetBits(uint32_t* counts) const {
+  AccumulateSetBits(this->bytes_, this->bit_count_, counts);
+}
+
+// static
+void BitVector::AccumulateSetBits(const std::byte* bytes, size_t bit_count,
+                                  uint32_t* counts) {
+  const size_t full_words = bit_count / BitsPerWord;
+  AccumulateWordBits(bytes, full_words, counts);
+
+  // Only count the bits of the last word which are in the vector.
+  const size_t relevant_bits = bit_count % BitsPerWord;
+  if (relevant_bits > 0) {
+    const uint64_t word = LoadWord(bytes + full_words * sizeof(uint64_t));
+    uint32_t* word_counts = counts + full_words * BitsPerWord;
+    for (size_t bit = 0; bit < relevant_bits; bit++) {
+      word_counts[bit] += static_cast<uint32_t>((word >> bit) & 1U);
+    }
+  }
+}
+
+// static
+double BitVector::CalculateDiversity(const std::byte* const* rows,
+                                     size_t count, size_t bit_count) {
+  // Diversity of a single row would be zero.
+  if (count <= 1U || bit_count == 0) {
+    return 0.0;
+  }
+
+  // Count how many rows have each bit set.
+  std::vector<uint32_t> set_bit_counts(bit_count);
+  for (size_t i = 0; i < count; i++) {
+    AccumulateSetBits(rows[i], bit_count, set_bit_counts.data());
+  }
+
+  // If c rows have a bit set, that bit differs in c * (count - c) pairs of
+  // rows. Summing this over every bit gives the total Hamming distance
+  // between every pair of rows.
+  uint64_t distance = 0;
+  for (const uint32_t set_count : set_bit_counts) {
+    distance += static_cast<uint64_t>(set_count) * (count - set_count);
+  }
+
+  const size_t total_compares = (count * (count - 1U)) / 2U;
+  const double total_bits = static_cast<double>(total_compares) * bit_count;
+  return static_cast<double>(distance) / total_bits;
+}
+
+void BitVector::Blend(const BitVector& mask, const BitVector& left,
+                      const BitVector& right) {
+  assert(mask.bit_count_ == left.bit_count_);
+  assert(left.bit_count_ == right.bit_count_);
+
+  Resize(left.bit_count_);
+  BlendBytes(mask.bytes_, left.bytes_, right.bytes_, this->bytes_,
+             BytesRequired(left.bit_count_));
 }
 
 bool BitVector::Equals(const BitVector& rhs, size_t bits_to_compare) const {
   assert(rhs.bit_count_ >= bits_to_compare);
   assert(this->bit_count_ >= bits_to_compare);
 
-  return Compare(this->bytes_.data(), rhs.bytes_.data(), bits_to_compare);
+  return Compare(this->bytes_, rhs.bytes_, bits_to_compare);
 }
 
 bool BitVector::Equals(const BitVector& rhs) const {
@@ -342,13 +768,15 @@ void BitVector::FromStringHex(const char* buffer, size_t buffer_length) {
 
   this->SetBitCount(buffer_length / 2U * BitsPerByte);
 
+  // The byte buffer may be padded past the bytes we read from the string.
   constexpr int radix = 16;
+  const size_t byte_count = buffer_length / 2U;
   char temp_buffer[3];
-  size_t i = 0;
-  for (std::byte& b : this->bytes_) {
-    strncpy(temp_buffer, buffer + buffer_length - 2U * ++i, 2U);
+  for (size_t i = 0; i < byte_count; i++) {
+    strncpy(temp_buffer, buffer + buffer_length - 2U * (i + 1U), 2U);
     temp_buffer[2] = '\0';
-    b = static_cast<std::byte>(strtoul(temp_buffer, nullptr, radix));
+    this->bytes_[i] =
+        static_cast<std::byte>(strtoul(temp_buffer, nullptr, radix));
   }
 }
 
@@ -359,7 +787,7 @@ void BitVector::WriteToStream(std::ostream& out) const {
 }
 
 void BitVector::WriteToStreamHex(std::ostream& out) const {
-  if (this->bytes_.empty()) {
+  if (this->byte_capacity_ == 0) {
     return;
   }
 
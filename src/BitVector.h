@@ -11,6 +11,7 @@
 #include <climits>
 #include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <iostream>
 #include <vector>
 
@@ -20,6 +21,7 @@ class BitVector {
  public:
   explicit BitVector(size_t bit_count = 0);
   BitVector(const BitVector& source);
+  BitVector(BitVector&& source) noexcept;
   ~BitVector() = default;
 
   /**
@@ -89,6 +91,12 @@ class BitVector {
    */
   void Flip(size_t index);
 
+  /**
+   * Flip every bit which is set in |mask|.<br/>
+   * Note: |mask| must have the same bit count as this BitVector.
+   */
+  void FlipBits(const BitVector& mask);
+
   /**
    * Construct an integer from bits in the BitVector.
    * @param bit_index Starting bit index in the BitVector at which to fetch the
@@ -98,7 +106,7 @@ class BitVector {
   template <typename IntegerType = uint64_t>
   IntegerType GetInt(size_t bit_index, size_t bit_width) const {
     assert((bit_index + bit_width) <= this->bit_count_);
-    return ReadInt<IntegerType>(this->bytes_.data(), bit_index, bit_width);
+    return ReadInt<IntegerType>(this->bytes_, bit_index, bit_width);
   }
 
   /**
@@ -111,7 +119,7 @@ class BitVector {
   template <typename IntegerType = uint64_t>
   void SetInt(IntegerType value, size_t bit_index, size_t bit_width) {
     assert((bit_index + bit_width) <= this->bit_count_);
-    WriteInt<IntegerType>(this->bytes_.data(), bit_index, bit_width, value);
+    WriteInt<IntegerType>(this->bytes_, bit_index, bit_width, value);
   }
 
   /**
@@ -134,6 +142,69 @@ class BitVector {
    */
   size_t HammingDistance(const BitVector& rhs) const;
 
+  /**
+   * Count the bits which are set in this BitVector.
+   */
+  size_t GetSetBitCount() const;
+
+  /**
+   * Get the index of the first set bit at or after |start|.
+   * @return GetBitCount() if no bit at or after |start| is set.
+   */
+  size_t FindNextSetBit(size_t start) const;
+
+  /**
+   * Get the index of the first bit at or after |start| which differs between
+   * this and |rhs|.<br/>
+   * Note: |rhs| must have the same bit count as this BitVector.
+   * @return GetBitCount() if no bit at or after |start| differs.
+   */
+  size_t FindNextDifference(const BitVector& rhs, size_t start) const;
+
+  /**
+   * Calculate a 64-bit hash of the bits in this BitVector.<br/>
+   * BitVectors which are Equals and have the same bit count always have the
+   * same hash. Different BitVectors may collide so a matching hash must be
+   * confirmed with Equals.
+   */
+  uint64_t Hash() const;
+
+  /**
+   * Add one to |counts|[i] for every bit i which is set in this BitVector.
+   * <br/>Summing these counts over several BitVectors tells us how many of
+   * them have each bit set.<br/>
+   * Note: |counts| must have room for GetBitCount() elements.
+   */
+  void AccumulateSetBits(uint32_t* counts) const;
+
+  /**
+   * Add one to |counts|[i] for every bit i under |bit_count| which is set in
+   * |bytes|.<br/>
+   * Note: |bytes| must hold BytesRequired(|bit_count|) bytes and |counts|
+   * must have room for |bit_count| elements.
+   * @see AccumulateSetBits
+   */
+  static void AccumulateSetBits(const std::byte* bytes, size_t bit_count,
+                                uint32_t* counts);
+
+  /**
+   * Return the average Hamming distance between every pair of the |count|
+   * |rows| divided by |bit_count|.<br/>
+   * Every row holds |bit_count| bits laid out as in a BitVector.
+   */
+  static double CalculateDiversity(const std::byte* const* rows, size_t count,
+                                   size_t bit_count);
+
+  /**
+   * Set this BitVector to (|mask| & |left|) | (~|mask| & |right|).<br/>
+   * Each bit is copied from |left| where the same bit in |mask| is set and
+   * from |right| where it is unset.<br/>
+   * Resizes this to be the same size as |left|.<br/>
+   * Note: |mask|, |left|, and |right| must all have the same bit count.
+   */
+  void Blend(const BitVector& mask, const BitVector& left,
+             const BitVector& right);
+
   /**
    * Write a binary representation of this BitVector into a buffer.<br/>
    * The buffer will be null-terminated.<br/>
@@ -176,16 +247,86 @@ class BitVector {
    */
   void FromStringHex(const char* buffer, size_t buffer_length);
 
+  /**
+   * Get the number of bytes used to back |bit_count| bits.<br/>
+   * Storage is always padded to a whole number of 64-bit words so kernels
+   * can process the buffer a word at a time. The value of the padding bits
+   * past the bit count is unspecified.
+   */
+  static size_t BytesRequired(size_t bit_count);
+
+  /**
+   * Load the eight bytes starting at |bytes| as one word where bit i of the
+   * word is bit (i % 8) of byte (i / 8).<br/>
+   * |bytes| doesn't need to be aligned.
+   */
+  static uint64_t LoadUnalignedWord(const std::byte* bytes) {
+    uint64_t value = 0;
+    std::memcpy(&value, bytes, sizeof(value));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+  }
+
+  /**
+   * Store |value| into the eight bytes starting at |bytes| using the bit
+   * order of LoadUnalignedWord.<br/>
+   * |bytes| doesn't need to be aligned.
+   */
+  static void StoreUnalignedWord(std::byte* bytes, uint64_t value) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    std::memcpy(bytes, &value, sizeof(value));
+  }
+
+  /**
+   * Returns true if the bits of this BitVector live in storage owned by
+   * someone else.
+   * @see AttachStorage
+   */
+  bool HasExternalStorage() const;
+
+  /**
+   * Exchange the external storage of this BitVector with the external storage
+   * of |other| without copying any bits. Afterwards, this holds the bits
+   * |other| held before and vice versa.<br/>
+   * Note: Both BitVectors must use external storage and have the same bit
+   * count.
+   * @see AttachStorage
+   */
+  void SwapStorage(BitVector* other);
+
+  /**
+   * Get a read-only pointer to the bytes underlying this BitVector.<br/>
+   * At least BytesRequired(GetBitCount()) bytes are readable.
+   */
+  const std::byte* GetBytes() const;
+
  protected:
   /**
-   * Get a read-only view of the byte buffer underlying this BitVector.
+   * Construct a BitVector with |bit_count| unset bits stored in |storage|
+   * instead of a heap allocation owned by the BitVector.<br/>
+   * Note: |storage| must hold |byte_capacity| bytes, at least
+   * BytesRequired(|bit_count|), and outlive the BitVector.
+   * @see AttachStorage
    */
-  const std::vector<std::byte>& GetBytes() const;
+  BitVector(size_t bit_count, std::byte* storage, size_t byte_capacity);
 
   /**
-   * Get a writable view of the byte buffer underlying this BitVector.
+   * Get a writable pointer to the bytes underlying this BitVector.
    */
-  std::vector<std::byte>& GetBytesWritable();
+  std::byte* GetBytesWritable();
+
+  /**
+   * Copy the bits of this BitVector into |storage| and keep using |storage| to
+   * store the bits from now on. Any storage owned by the BitVector is freed.
+   * <br/>Once attached, the BitVector can't grow beyond |byte_capacity| bytes.
+   * <br/>Note: |storage| must outlive the BitVector or a later call to
+   * AttachStorage.
+   */
+  void AttachStorage(std::byte* storage, size_t byte_capacity);
 
   /**
    * Resize the BitVector such that it contains |bit_count| bits.
@@ -225,6 +366,7 @@ class BitVector {
    * |destination|.<br/> |source_start_bit_offset| and
    * |destination_start_bit_offset| are bit offsets into |source| and
    * |destination|.<br/> Supports non-byte-aligned copy, though this is slower.
+   * <br/>Only the bytes containing the copied bits are read or written.
    */
   static void WriteBytes(const std::byte* source,
                          size_t source_start_bit_offset, std::byte* destination,
@@ -239,6 +381,42 @@ class BitVector {
   static bool Compare(const std::byte* left, const std::byte* right,
                       size_t bits_to_compare);
 
+  /**
+   * Write (|mask| & |left|) | (~|mask| & |right|) into |destination| one word
+   * at a time.<br/>
+   * Note: |byte_count| must be a multiple of the word size.
+   */
+  static void BlendBytes(const std::byte* mask, const std::byte* left,
+                         const std::byte* right, std::byte* destination,
+                         size_t byte_count);
+
+  /**
+   * Write (|mask| & |left|) | (~|mask| & |right|) into the first
+   * |word_count| words of |destination|. Bit b of |mask|[i] selects bit
+   * 64 * i + b of the buffers.
+   */
+  static void BlendWords(const uint64_t* mask, const std::byte* left,
+                         const std::byte* right, std::byte* destination,
+                         size_t word_count);
+
+  /**
+   * Flip every bit of the first |word_count| words of |destination| where the
+   * matching bit of |mask| is set. Bit b of |mask|[i] matches bit
+   * 64 * i + b of the buffer.
+   * @return The number of bits flipped.
+   */
+  static size_t XorWords(const uint64_t* mask, std::byte* destination,
+                         size_t word_count);
+
+  /**
+   * Get the index of the first bit at or after |start| which is set in
+   * |left| ^ |right| or, if |right| is nullptr, in |left|. Both buffers hold
+   * |bit_count| bits.
+   * @return |bit_count| if there's no such bit.
+   */
+  static size_t FindNextBit(const std::byte* left, const std::byte* right,
+                            size_t bit_count, size_t start);
+
  public:
   struct HexFormatWrapper {
     std::ostream& os;
@@ -270,9 +448,23 @@ class BitVector {
 
  private:
   /**
-   * Underlying storage for the bits of the BitVector.
+   * Storage owned by the BitVector. Empty when the bits live in external
+   * storage.
+   */
+  std::vector<std::byte> owned_bytes_;
+
+  /**
+   * Underlying storage for the bits of the BitVector.<br/>
+   * Points either into owned_bytes_ or at external storage.<br/>
+   * Bit i is stored in bit (i % 8) of byte (i / 8).
+   * @see BytesRequired
+   */
+  std::byte* bytes_ = nullptr;
+
+  /**
+   * Count of bytes available at bytes_.
    */
-  std::vector<std::byte> bytes_;
+  size_t byte_capacity_ = 0;
 
   /**
    * Count of the bits stored in the BitVector.<br/>
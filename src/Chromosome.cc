@@ -6,8 +6,14 @@
 
 #include "Chromosome.h"
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+#include <vector>
 
 #include "Genome.h"
 #include "RandomWrapper.h"
@@ -15,6 +21,355 @@
 namespace {
 
 constexpr size_t BitsPerByte = CHAR_BIT;
+constexpr size_t BitsPerWord = sizeof(uint64_t) * BitsPerByte;
+
+// MaskFlipMutator rounds the mutation rate to a multiple of 2^-MaskRateBits.
+// Each mask word costs at most this many random words.
+constexpr unsigned MaskRateBits = 16U;
+
+// Number of mask words the mutators and crossovers build at once.
+constexpr size_t MaskChunkWords = 32;
+
+/**
+ * Get the bits of word |word_begin| / 64 which fall in [|begin|, |end|).
+ */
+uint64_t RangeBits(size_t word_begin, size_t begin, size_t end) {
+  begin = std::max(begin, word_begin);
+  end = std::min(end, word_begin + BitsPerWord);
+  if (begin >= end) {
+    return 0;
+  }
+  const size_t width = end - begin;
+  const uint64_t bits = width == BitsPerWord
+                            ? std::numeric_limits<uint64_t>::max()
+                            : (uint64_t{1} << width) - 1U;
+  return bits << (begin - word_begin);
+}
+
+/**
+ * Set the mask bits for chromosome bits [|begin|, |end|) in |mask|, which
+ * holds |word_count| words of mask bits starting at chromosome bit
+ * |window_begin|. Bits outside of the window are ignored.
+ */
+void SetMaskBits(uint64_t* mask, size_t window_begin, size_t word_count,
+                 size_t begin, size_t end) {
+  const size_t window_end = window_begin + word_count * BitsPerWord;
+  begin = std::max(begin, window_begin);
+  end = std::min(end, window_end);
+  if (begin >= end) {
+    return;
+  }
+
+  const size_t first_word = (begin - window_begin) / BitsPerWord;
+  const size_t last_word = (end - 1U - window_begin) / BitsPerWord;
+  for (size_t i = first_word; i <= last_word; i++) {
+    mask[i] |= RangeBits(window_begin + i * BitsPerWord, begin, end);
+  }
+}
+
+/**
+ * The chromosome bits [begin, end) holding the value genes of a genome, each
+ * of them |gene_bit_width| bits wide. Empty if there are no value genes.
+ */
+struct ValueGeneBits {
+  size_t begin = 0;
+  size_t end = 0;
+  size_t gene_bit_width = 0;
+
+  size_t Count() const { return end - begin; }
+
+  // Map |index| into the chromosome bits which aren't value gene bits.
+  size_t SkipValueGenes(size_t index) const {
+    return index < begin ? index : index + Count();
+  }
+};
+
+ValueGeneBits GetValueGeneBits(const panga::Genome& genome) {
+  ValueGeneBits bits;
+  if (genome.GetValueGeneCount() != 0) {
+    bits.gene_bit_width =
+        panga::GetValueGeneSize(genome.GetValueGeneType()) * BitsPerByte;
+    bits.begin = genome.GetValueGeneByteOffset() * BitsPerByte;
+    bits.end = bits.begin + genome.GetValueGeneCount() * bits.gene_bit_width;
+  }
+  return bits;
+}
+
+/**
+ * Copy the mask bit of the first bit of each value gene over the rest of
+ * that gene in |mask|, which holds |word_count| words of mask bits starting
+ * at chromosome bit |window_begin|. Crossovers then take every value whole
+ * from one parent instead of splicing the bytes of two values together.
+ */
+void SpreadValueGeneMasks(const ValueGeneBits& values, size_t window_begin,
+                          size_t word_count, uint64_t* mask) {
+  const size_t window_end = window_begin + word_count * BitsPerWord;
+  // Value genes are aligned to their width so none of them straddles a word.
+  for (size_t gene = std::max(values.begin, window_begin);
+       gene < std::min(values.end, window_end);
+       gene += values.gene_bit_width) {
+    const size_t offset = gene - window_begin;
+    const size_t shift = offset % BitsPerWord;
+    uint64_t& word = mask[offset / BitsPerWord];
+    const uint64_t gene_bits =
+        RangeBits(0, shift, shift + values.gene_bit_width);
+    word = ((word >> shift) & 1U) != 0 ? word | gene_bits : word & ~gene_bits;
+  }
+}
+
+/**
+ * Builds the crossover masks for k-point crossover chunk by chunk.<br/>
+ * The chromosome is split into k + 1 segments which alternate between the
+ * parents. Cut points are drawn in increasing order as the masks are built so
+ * chunks must be requested front to back. Cuts either fall on any bit or, if
+ * a Genome is given, only on gene boundaries.
+ */
+class KPointMask {
+ public:
+  KPointMask(size_t k, size_t bit_count, const panga::Genome* genome,
+             panga::RandomWrapper* random)
+      : random_(random),
+        genome_(genome),
+        k_(k),
+        bit_count_(bit_count),
+        slot_count_(genome != nullptr ? genome->GetGeneCount() : bit_count) {
+    segment_end_ = NextCut();
+  }
+
+  void operator()(size_t window_begin, size_t word_count, uint64_t* mask) {
+    const size_t window_end = window_begin + word_count * BitsPerWord;
+    std::fill_n(mask, word_count, uint64_t{0});
+    while (!is_done_ && segment_begin_ < window_end) {
+      // Bits set in the mask are taken from the first parent.
+      if (segment_index_ % 2U == 0) {
+        SetMaskBits(mask, window_begin, word_count, segment_begin_,
+                    segment_end_);
+      }
+      if (segment_end_ > window_end) {
+        break;
+      }
+      if (segment_index_ == k_) {
+        is_done_ = true;
+        break;
+      }
+      segment_index_++;
+      segment_begin_ = segment_end_;
+      segment_end_ = NextCut();
+    }
+  }
+
+ private:
+  size_t NextCut() {
+    // The last segment always runs to the end of the chromosome.
+    if (segment_index_ == k_) {
+      return bit_count_;
+    }
+    slot_ = random_->RandomInteger(slot_, slot_count_);
+    if (genome_ == nullptr) {
+      return slot_;
+    }
+    return slot_ < slot_count_ ? genome_->GetGeneStartBitIndex(slot_)
+                               : bit_count_;
+  }
+
+  panga::RandomWrapper* random_;
+  const panga::Genome* genome_;
+  size_t k_;
+  size_t bit_count_;
+  size_t slot_count_;
+  size_t slot_ = 0;
+  size_t segment_index_ = 0;
+  size_t segment_begin_ = 0;
+  size_t segment_end_ = 0;
+  bool is_done_ = false;
+};
+
+/**
+ * Builds the crossover masks for uniform crossover which respects gene
+ * boundaries chunk by chunk.<br/>
+ * Each gene with a bit width comes wholesale from one parent chosen by one
+ * random bit. Boolean genes are a single bit each so the mask over them is
+ * simply random.
+ */
+class UniformGeneMask {
+ public:
+  UniformGeneMask(size_t bit_count, const panga::Genome& genome,
+                  panga::RandomWrapper* random)
+      : random_(random),
+        genome_(genome),
+        bit_count_(bit_count),
+        gene_count_(genome.GetFirstBooleanGeneIndex()),
+        first_boolean_bit_(genome.GetFirstBooleanGeneBitIndex()) {}
+
+  void operator()(size_t window_begin, size_t word_count, uint64_t* mask) {
+    const size_t window_end = window_begin + word_count * BitsPerWord;
+    std::fill_n(mask, word_count, uint64_t{0});
+
+    while (gene_ < gene_count_) {
+      const size_t begin = genome_.GetGeneStartBitIndex(gene_);
+      if (begin >= window_end) {
+        break;
+      }
+      if (choice_bits_left_ == 0) {
+        choices_ = random_->RandomWord();
+        choice_bits_left_ = BitsPerWord;
+      }
+      const size_t end = begin + genome_.GetGeneBitWitdh(gene_);
+      if ((choices_ & 1U) != 0) {
+        SetMaskBits(mask, window_begin, word_count, begin, end);
+      }
+      // A gene which straddles the window keeps its choice for the next one.
+      if (end > window_end) {
+        break;
+      }
+      gene_++;
+      choices_ >>= 1U;
+      choice_bits_left_--;
+    }
+
+    for (size_t i = 0; i < word_count; i++) {
+      const uint64_t boolean_bits = RangeBits(window_begin + i * BitsPerWord,
+                                              first_boolean_bit_, bit_count_);
+      if (boolean_bits != 0) {
+        mask[i] |= random_->RandomWord() & boolean_bits;
+      }
+    }
+  }
+
+ private:
+  panga::RandomWrapper* random_;
+  const panga::Genome& genome_;
+  size_t bit_count_;
+  size_t gene_count_;
+  size_t first_boolean_bit_;
+  size_t gene_ = 0;
+  uint64_t choices_ = 0;
+  size_t choice_bits_left_ = 0;
+};
+
+/**
+ * Append the index of each gene holding one of the bits found by
+ * |find_next_bit| to |genes|. Calling |find_next_bit|(start) returns the
+ * first bit of interest at or after start or |bit_count| if there are no
+ * more. Once a gene is found, the rest of its bits are skipped.
+ */
+template <typename FindNextBitFunction>
+void AppendGenesForBits(const panga::Genome& genome, size_t bit_count,
+                        const FindNextBitFunction& find_next_bit,
+                        std::vector<size_t>* genes) {
+  assert(genes != nullptr);
+
+  const size_t gene_count = genome.GetGeneCount();
+  size_t bit_index = find_next_bit(0);
+  while (bit_index < bit_count) {
+    const size_t gene_index = genome.GetGeneIndexForBit(bit_index);
+    size_t next_bit_index = bit_index + 1U;
+    if (gene_index != gene_count) {
+      genes->push_back(gene_index);
+      next_bit_index = genome.GetGeneStartBitIndex(gene_index) +
+                       genome.GetGeneBitWitdh(gene_index);
+    }
+    bit_index = find_next_bit(next_bit_index);
+  }
+}
+
+constexpr double TwoPi = 6.283185307179586;
+
+/**
+ * Call |function| with a null pointer to the type of the values held by
+ * value genes of |type|.
+ */
+template <typename Function>
+void VisitValueGeneType(panga::ValueGeneType type, const Function& function) {
+  switch (type) {
+    case panga::ValueGeneType::Float:
+      function(static_cast<float*>(nullptr));
+      break;
+    case panga::ValueGeneType::Double:
+      function(static_cast<double*>(nullptr));
+      break;
+    case panga::ValueGeneType::Int32:
+      function(static_cast<int32_t*>(nullptr));
+      break;
+    case panga::ValueGeneType::Int64:
+      function(static_cast<int64_t*>(nullptr));
+      break;
+    default:
+      assert(false);
+  }
+}
+
+/**
+ * Convert |value| to a |ValueType| inside [|min|, |max|]. Integers are
+ * rounded to the nearest value.
+ */
+template <typename ValueType>
+ValueType ToValueGene(double value, double min, double max) {
+  if constexpr (std::is_integral_v<ValueType>) {
+    return static_cast<ValueType>(std::llround(std::clamp(value, min, max)));
+  } else {
+    // Clamp after narrowing so rounding can't leave the range.
+    return std::clamp(static_cast<ValueType>(value),
+                      static_cast<ValueType>(min),
+                      static_cast<ValueType>(max));
+  }
+}
+
+/**
+ * Set each value gene of |offspring| to |combine|(value1, value2, random) of
+ * the values of the same gene in |parent1| and |parent2|.
+ */
+template <typename ValueType, typename CombineFunction>
+void CombineValueGenes(const panga::Chromosome& parent1,
+                       const panga::Chromosome& parent2,
+                       panga::Chromosome* offspring,
+                       panga::RandomWrapper* random,
+                       const CombineFunction& combine) {
+  const panga::Genome& genome = parent1.GetGenome();
+  const double min = genome.GetValueGeneMin();
+  const double max = genome.GetValueGeneMax();
+  const size_t count = genome.GetValueGeneCount();
+  const ValueType* values1 = parent1.GetValueGenes<ValueType>();
+  const ValueType* values2 = parent2.GetValueGenes<ValueType>();
+  ValueType* values = offspring->GetValueGenesWritable<ValueType>();
+  for (size_t i = 0; i < count; i++) {
+    const double value = combine(static_cast<double>(values1[i]),
+                                 static_cast<double>(values2[i]), random);
+    values[i] = ToValueGene<ValueType>(value, min, max);
+  }
+}
+
+/**
+ * With |mutation_percentage| probability, move each value gene of
+ * |chromosome| by |perturb|(range, random) where range is the width of the
+ * value gene range.
+ * @return The number of values which changed.
+ */
+template <typename ValueType, typename PerturbFunction>
+size_t PerturbValueGenes(panga::Chromosome* chromosome,
+                         double mutation_percentage,
+                         panga::RandomWrapper* random,
+                         const PerturbFunction& perturb) {
+  const panga::Genome& genome = chromosome->GetGenome();
+  const double min = genome.GetValueGeneMin();
+  const double max = genome.GetValueGeneMax();
+  const size_t count = genome.GetValueGeneCount();
+  ValueType* values = chromosome->GetValueGenesWritable<ValueType>();
+  size_t changed_count = 0;
+  for (size_t i = 0; i < count; i++) {
+    if (!random->CoinFlip(mutation_percentage)) {
+      continue;
+    }
+    const ValueType value = ToValueGene<ValueType>(
+        static_cast<double>(values[i]) + perturb(max - min, random), min,
+        max);
+    if (value != values[i]) {
+      values[i] = value;
+      changed_count++;
+    }
+  }
+  return changed_count;
+}
 
 }  // namespace
 
@@ -23,12 +378,35 @@ namespace panga {
 Chromosome::Chromosome(const Genome& genome)
     : BitVector(genome.BitsRequired()), genome_(genome) {}
 
+Chromosome::Chromosome(const Genome& genome, std::byte* storage,
+                       size_t byte_capacity)
+    : BitVector(genome.BitsRequired(), storage, byte_capacity),
+      genome_(genome) {}
+
 const Genome& Chromosome::GetGenome() const { return genome_; }
 
 void Chromosome::Randomize(RandomWrapper* random) {
-  for (auto& byte : GetBytesWritable()) {
-    byte = random->RandomByte();
+  random->FillBytes(GetBytesWritable(), BytesRequired(GetBitCount()));
+
+  // Random bits don't make for values inside the range so draw those.
+  if (genome_.GetValueGeneCount() == 0) {
+    return;
   }
+  const double min = genome_.GetValueGeneMin();
+  const double max = genome_.GetValueGeneMax();
+  VisitValueGeneType(genome_.GetValueGeneType(), [&](auto* type_tag) {
+    using ValueType = std::remove_pointer_t<decltype(type_tag)>;
+    ValueType* values = GetValueGenesWritable<ValueType>();
+    for (size_t i = 0; i < genome_.GetValueGeneCount(); i++) {
+      if constexpr (std::is_integral_v<ValueType>) {
+        values[i] = random->RandomInteger<ValueType>(
+            static_cast<ValueType>(min), static_cast<ValueType>(max));
+      } else {
+        values[i] = ToValueGene<ValueType>(random->RandomFloat(min, max),
+                                           min, max);
+      }
+    }
+  });
 }
 
 bool Chromosome::DecodeBooleanGene(size_t gene_index) const {
@@ -53,6 +431,20 @@ void Chromosome::EncodeBooleanGene(size_t gene_index, bool value) {
   }
 }
 
+void Chromosome::FindChangedGenes(const BitVector& other,
+                                  std::vector<size_t>* changed_genes) const {
+  AppendGenesForBits(
+      genome_, GetBitCount(),
+      [this, &other](size_t start) { return FindNextDifference(other, start); },
+      changed_genes);
+}
+
+void Chromosome::FindGenesWithSetBits(std::vector<size_t>* genes) const {
+  AppendGenesForBits(
+      genome_, GetBitCount(),
+      [this](size_t start) { return FindNextSetBit(start); }, genes);
+}
+
 std::byte* Chromosome::GetRawGene(size_t gene_index, size_t* gene_bit_width) {
   assert(gene_index < genome_.GetFirstBooleanGeneIndex());
   assert(gene_bit_width != nullptr);
@@ -64,7 +456,35 @@ std::byte* Chromosome::GetRawGene(size_t gene_index, size_t* gene_bit_width) {
   assert(gene_bit_index % BitsPerByte == 0);
   assert(*gene_bit_width % BitsPerByte == 0);
 
-  return GetBytesWritable().data() + (gene_bit_index / BitsPerByte);
+  return GetBytesWritable() + (gene_bit_index / BitsPerByte);
+}
+
+// static
+template <typename MaskBuilder>
+void Chromosome::BlendWithMask(const Chromosome& parent1,
+                               const Chromosome& parent2,
+                               Chromosome* offspring,
+                               MaskBuilder* build_mask) {
+  // It's possible that the byte buffers backing each parent may have
+  // allocated a different number of bytes. We should be safe to use the
+  // number of bytes necessary to store the bit count because they both report
+  // to contain the same number of bits.
+  const size_t word_count =
+      BytesRequired(parent1.GetBitCount()) / sizeof(uint64_t);
+  const std::byte* parent1_bytes = parent1.GetBytes();
+  const std::byte* parent2_bytes = parent2.GetBytes();
+  std::byte* offspring_bytes = offspring->GetBytesWritable();
+  const ValueGeneBits values = GetValueGeneBits(parent1.GetGenome());
+
+  uint64_t mask[MaskChunkWords];
+  for (size_t first = 0; first < word_count; first += MaskChunkWords) {
+    const size_t count = std::min(MaskChunkWords, word_count - first);
+    (*build_mask)(first * BitsPerWord, count, mask);
+    SpreadValueGeneMasks(values, first * BitsPerWord, count, mask);
+    const size_t offset = first * sizeof(uint64_t);
+    BlendWords(mask, parent1_bytes + offset, parent2_bytes + offset,
+               offspring_bytes + offset, count);
+  }
 }
 
 // static
@@ -79,53 +499,21 @@ void Chromosome::UniformCrossover(const Chromosome& parent1,
 
   if (ignore_gene_boundaries) {
     // When we are ignoring the gene boundaries, every bit has equal random
-    // chance to be copied from either parent1 or parent2.
-    const auto& parent1_bytes = parent1.GetBytes();
-    const auto& parent2_bytes = parent2.GetBytes();
-    auto& offspring_bytes = offspring->GetBytesWritable();
-
-    // It's possible that the byte buffers backing each parent may have
-    // allocated a different number of bytes. We should be safe to use the
-    // number of bytes necessary to store the bit count because they both report
-    // to contain the same number of bits.
-    const size_t byte_count = offspring_bytes.size();
-    for (size_t i = 0; i < byte_count; i++) {
-      // Use a random byte to determine splitting.
-      // Bits turned on in this byte will be pulled from parent1 and bits turned
-      // off will be pulled from parent2.
-      const std::byte mask = random->RandomByte();
-      offspring_bytes[i] =
-          (mask & parent1_bytes[i]) | (~mask & parent2_bytes[i]);
-    }
+    // chance to be copied from either parent1 or parent2. Bits turned on in
+    // the mask will be pulled from parent1 and bits turned off will be pulled
+    // from parent2.
+    auto random_mask = [random](size_t /*window_begin*/, size_t word_count,
+                                uint64_t* mask) {
+      random->FillWords(mask, word_count);
+    };
+    BlendWithMask(parent1, parent2, offspring, &random_mask);
   } else {
     // We need to respect the gene boundaries, which effectively means each gene
     // has equal random chance to be copied wholesale from either parent1 or
     // parent2.
-    const Genome& genome = parent1.GetGenome();
-    for (size_t i = 0; i < genome.GetGeneCount(); i++) {
-      constexpr double equal_chance = 0.5;
-      const Chromosome& chunk_source =
-          random->CoinFlip(equal_chance) ? parent1 : parent2;
-      const size_t gene_bit_index = genome.GetGeneStartBitIndex(i);
-      const size_t gene_bit_width = genome.GetGeneBitWitdh(i);
-
-      // All boolean genes are located at the end of the vector.
-      if (i < genome.GetFirstBooleanGeneIndex()) {
-        // Copy all bits necessary for the gene out of the parent.
-        chunk_source.SubVector(offspring, gene_bit_index, gene_bit_index,
-                               gene_bit_width);
-      } else {
-        // TODO(boingoing): Probably makes sense to only copy the non-boolean
-        // genes via this loop and separately copy all the boolean genes similar
-        // to how we do uniform crossover when ignoring gene boundaries (ie:
-        // copying bytes at a time instead of bits).
-        if (chunk_source.Get(gene_bit_index)) {
-          offspring->Set(gene_bit_index);
-        } else {
-          offspring->Unset(gene_bit_index);
-        }
-      }
-    }
+    UniformGeneMask gene_mask(parent1.GetBitCount(), parent1.GetGenome(),
+                              random);
+    BlendWithMask(parent1, parent2, offspring, &gene_mask);
   }
 }
 
@@ -140,82 +528,23 @@ void Chromosome::KPointCrossover(size_t k, const Chromosome& parent1,
   // Make sure |offspring| has enough storage for these bits.
   offspring->Resize(bit_count);
 
-  if (ignore_gene_boundaries) {
-    // When we are ignoring the gene boundaries, cut points can happen anywhere
-    // in the chromosome.
-    size_t left_bit_index = 0;
-
-    // We need to copy k+1 chunks from the parents.
-    for (size_t i = 0; i < k + 1U; i++) {
-      // Copy a chunk of bits starting with left and ending at a randomly-chosen
-      // right. If this is the last chunk to take, make sure we take all the
-      // rest of the bits (ie: set right to bit count).
-      const size_t right_bit_index =
-          (i == k) ? bit_count
-                   : random->RandomInteger(left_bit_index, bit_count);
-
-      // Decide if this chunk of bits will come from parent1 or parent2 (this
-      // alternates with each chunk).
-      const Chromosome& chunkSource = i % 2U == 0 ? parent1 : parent2;
-
-      // It's possible that one of the randomly chosen cut points was at the end
-      // which means there's nothing left for us to copy now.
-      if (left_bit_index < bit_count) {
-        // Copy the current chunk of (right_bit_index - left_bit_index) bits
-        // beginning at left_bit_index and ending at right_bit_index.
-        chunkSource.SubVector(offspring, left_bit_index, left_bit_index,
-                              right_bit_index - left_bit_index);
-      }
-
-      // Adjust left so that the next chunk will start where right ended.
-      left_bit_index = right_bit_index;
-    }
-  } else {
-    // We need to respect the gene boundaries, cut points can only happen at
-    // gene boundaries.
-    const Genome& genome = parent1.GetGenome();
-    const size_t gene_count = genome.GetGeneCount();
-    size_t left_gene_index = 0;
-
-    // We need to copy genes in k+1 chunks from the parents.
-    for (size_t i = 0; i < k + 1U; i++) {
-      // Copy a chunk of genes starting with left and ending at a
-      // randomly-chosen right. If this is the last chunk to take, make sure we
-      // take all the rest of the genes (ie: set right to gene count).
-      const size_t right_gene_index =
-          (i == k) ? gene_count
-                   : random->RandomInteger(left_gene_index, gene_count);
-
-      // Decide if this chunk of genes will come from parent1 or parent2 (this
-      // alternates with each step).
-      const Chromosome& chunkSource = i % 2U == 0 ? parent1 : parent2;
-
-      // It's possible that one of the randomly chosen cut points was at the end
-      // which means there's nothing left for us to copy now.
-      if (left_gene_index < gene_count) {
-        // The current chunk of bits we need to copy from the parent starts at
-        // the bit index of left gene and ends at the ending bit index of right
-        // gene.
-        const size_t start_bit_index =
-            genome.GetGeneStartBitIndex(left_gene_index);
-        const size_t end_bit_index =
-            genome.GetGeneStartBitIndex(right_gene_index) +
-            genome.GetGeneBitWitdh(right_gene_index);
-        chunkSource.SubVector(offspring, start_bit_index, start_bit_index,
-                              end_bit_index - start_bit_index);
-      }
-
-      left_gene_index = right_gene_index;
-    }
-  }
+  // Chunks of the chromosome alternate between parent1 and parent2. When we
+  // are ignoring the gene boundaries, cut points can happen anywhere in the
+  // chromosome. Otherwise cut points can only happen at gene boundaries.
+  KPointMask cut_mask(k, bit_count,
+                      ignore_gene_boundaries ? nullptr : &parent1.GetGenome(),
+                      random);
+  BlendWithMask(parent1, parent2, offspring, &cut_mask);
 }
 
 // static
-void Chromosome::FlipMutator(Chromosome* chromosome, double mutation_percentage,
-                             RandomWrapper* random) {
+size_t Chromosome::FlipMutator(Chromosome* chromosome,
+                               double mutation_percentage,
+                               RandomWrapper* random) {
   // Calculate the number of bits we should flip as the mutation percentage
-  // times the length of the chromosome (in bits).
-  const size_t bit_count = chromosome->GetBitCount();
+  // times the length of the chromosome (in bits), leaving out value genes.
+  const ValueGeneBits values = GetValueGeneBits(chromosome->GetGenome());
+  const size_t bit_count = chromosome->GetBitCount() - values.Count();
   const size_t bits_to_flip = std::llround(bit_count * mutation_percentage);
 
   // Flip the number of bits we calculated by choosing a random index and
@@ -223,8 +552,236 @@ void Chromosome::FlipMutator(Chromosome* chromosome, double mutation_percentage,
   // times.
   for (size_t i = 0; i < bits_to_flip; i++) {
     const auto index = random->RandomInteger<size_t>(0, bit_count - 1U);
-    chromosome->Flip(index);
+    chromosome->Flip(values.SkipValueGenes(index));
+  }
+  return bits_to_flip;
+}
+
+// static
+size_t Chromosome::GeometricFlipMutator(Chromosome* chromosome,
+                                        double mutation_percentage,
+                                        RandomWrapper* random) {
+  const ValueGeneBits values = GetValueGeneBits(chromosome->GetGenome());
+  const size_t bit_count = chromosome->GetBitCount() - values.Count();
+  if (mutation_percentage <= 0.0 || bit_count == 0) {
+    return 0;
+  }
+  if (mutation_percentage >= 1.0) {
+    for (size_t i = 0; i < bit_count; i++) {
+      chromosome->Flip(values.SkipValueGenes(i));
+    }
+    return bit_count;
+  }
+
+  // The number of bits skipped before the next flip in a sequence of
+  // Bernoulli trials is geometrically distributed. Sample it by inversion:
+  // floor(log(1 - u) / log(1 - p)) for u uniform in [0, 1).
+  const double log_keep = std::log1p(-mutation_percentage);
+  size_t bits_flipped = 0;
+  size_t index = 0;
+  while (true) {
+    const double gap = std::floor(std::log1p(-random->RandomUnit()) / log_keep);
+    // Compare as a double first so huge gaps can't overflow the index.
+    if (gap >= static_cast<double>(bit_count - index)) {
+      break;
+    }
+    index += static_cast<size_t>(gap);
+    chromosome->Flip(values.SkipValueGenes(index));
+    bits_flipped++;
+    index++;
+  }
+  return bits_flipped;
+}
+
+// static
+size_t Chromosome::MaskFlipMutator(Chromosome* chromosome,
+                                   double mutation_percentage,
+                                   RandomWrapper* random) {
+  constexpr uint64_t rate_scale = uint64_t{1} << MaskRateBits;
+  const size_t bit_count = chromosome->GetBitCount();
+  const auto rate = static_cast<uint64_t>(std::llround(
+      std::clamp(mutation_percentage, 0.0, 1.0) * rate_scale));
+  if (rate == 0 || bit_count == 0) {
+    return 0;
+  }
+
+  // Write |rate| as the binary fraction 0.b1b2...b16 and walk the digits from
+  // the least significant set one. ORing in a uniform word maps a bit density
+  // of d to (1 + d) / 2 and ANDing maps it to d / 2, so after the last digit
+  // every mask bit is set with probability |rate| / 2^16.
+  const size_t word_count = BytesRequired(bit_count) / sizeof(uint64_t);
+  const size_t tail_bits = bit_count % BitsPerWord;
+  const ValueGeneBits values = GetValueGeneBits(chromosome->GetGenome());
+  std::byte* bytes = chromosome->GetBytesWritable();
+  uint64_t masks[MaskChunkWords];
+  uint64_t words[MaskChunkWords];
+  size_t bits_flipped = 0;
+  for (size_t begin = 0; begin < word_count; begin += MaskChunkWords) {
+    const size_t count = std::min(MaskChunkWords, word_count - begin);
+    if (rate == rate_scale) {
+      std::fill_n(masks, count, ~uint64_t{0});
+    } else {
+      // ANDing into an all-zero mask is a no-op so skip the trailing zeros.
+      unsigned digit = 0;
+      while (((rate >> digit) & 1U) == 0) {
+        digit++;
+      }
+      std::fill_n(masks, count, uint64_t{0});
+      for (; digit < MaskRateBits; digit++) {
+        const bool is_set = ((rate >> digit) & 1U) != 0;
+        random->FillWords(words, count);
+        for (size_t i = 0; i < count; i++) {
+          masks[i] = is_set ? (masks[i] | words[i]) : (masks[i] & words[i]);
+        }
+      }
+    }
+    // Never flip the padding bits past the end of the chromosome or the
+    // bits of value genes.
+    if (tail_bits != 0 && begin + count == word_count) {
+      masks[count - 1U] &= (uint64_t{1} << tail_bits) - 1U;
+    }
+    if (values.Count() != 0) {
+      for (size_t i = 0; i < count; i++) {
+        masks[i] &=
+            ~RangeBits((begin + i) * BitsPerWord, values.begin, values.end);
+      }
+    }
+    bits_flipped += XorWords(masks, bytes + begin * sizeof(uint64_t), count);
+  }
+  return bits_flipped;
+}
+
+void Chromosome::PrepareValueCrossover(const Chromosome& parent1,
+                                       const Chromosome& parent2,
+                                       Chromosome* offspring,
+                                       RandomWrapper* random,
+                                       bool ignore_gene_boundaries) {
+  assert(parent1.GetBitCount() == parent2.GetBitCount());
+
+  // Only spend random bits on crossing over the other genes if there are
+  // any.
+  const Genome& genome = parent1.GetGenome();
+  const size_t value_bit_count = genome.GetValueGeneCount() *
+                                 GetValueGeneSize(genome.GetValueGeneType()) *
+                                 BitsPerByte;
+  if (genome.BitsRequired() != value_bit_count) {
+    UniformCrossover(parent1, parent2, offspring, random,
+                     ignore_gene_boundaries);
+  } else {
+    offspring->Resize(parent1.GetBitCount());
+  }
+}
+
+void Chromosome::BlendCrossover(double alpha, const Chromosome& parent1,
+                                const Chromosome& parent2,
+                                Chromosome* offspring, RandomWrapper* random,
+                                bool ignore_gene_boundaries) {
+  PrepareValueCrossover(parent1, parent2, offspring, random,
+                        ignore_gene_boundaries);
+  const Genome& genome = parent1.GetGenome();
+  if (genome.GetValueGeneCount() == 0) {
+    return;
+  }
+
+  const auto blend = [alpha](double value1, double value2,
+                             RandomWrapper* random) {
+    const double low = std::min(value1, value2);
+    const double high = std::max(value1, value2);
+    const double extent = alpha * (high - low);
+    return random->RandomFloat(low - extent, high + extent);
+  };
+  VisitValueGeneType(genome.GetValueGeneType(), [&](auto* type_tag) {
+    using ValueType = std::remove_pointer_t<decltype(type_tag)>;
+    CombineValueGenes<ValueType>(parent1, parent2, offspring, random, blend);
+  });
+}
+
+void Chromosome::SimulatedBinaryCrossover(double distribution_index,
+                                          const Chromosome& parent1,
+                                          const Chromosome& parent2,
+                                          Chromosome* offspring,
+                                          RandomWrapper* random,
+                                          bool ignore_gene_boundaries) {
+  PrepareValueCrossover(parent1, parent2, offspring, random,
+                        ignore_gene_boundaries);
+  const Genome& genome = parent1.GetGenome();
+  if (genome.GetValueGeneCount() == 0) {
+    return;
+  }
+
+  const double exponent = 1.0 / (distribution_index + 1.0);
+  const auto simulated_binary = [exponent](double value1, double value2,
+                                           RandomWrapper* random) {
+    // The spread factor of the children around the mean of the parents.
+    const double unit = random->RandomUnit();
+    const double beta = unit <= 0.5
+                            ? std::pow(2.0 * unit, exponent)
+                            : std::pow(1.0 / (2.0 * (1.0 - unit)), exponent);
+    const double mean = 0.5 * (value1 + value2);
+    const double spread = 0.5 * beta * (value1 - value2);
+    return random->CoinFlip(0.5) ? mean + spread : mean - spread;
+  };
+  VisitValueGeneType(genome.GetValueGeneType(), [&](auto* type_tag) {
+    using ValueType = std::remove_pointer_t<decltype(type_tag)>;
+    CombineValueGenes<ValueType>(parent1, parent2, offspring, random,
+                                 simulated_binary);
+  });
+}
+
+size_t Chromosome::GaussianMutator(Chromosome* chromosome,
+                                   double mutation_percentage,
+                                   RandomWrapper* random) {
+  const Genome& genome = chromosome->GetGenome();
+  if (mutation_percentage <= 0.0) {
+    return 0;
+  }
+
+  // Box-Muller transform of two uniform values into a standard normal one.
+  const auto gaussian = [](double range, RandomWrapper* random) {
+    const double radius = std::sqrt(-2.0 * std::log1p(-random->RandomUnit()));
+    const double angle = TwoPi * random->RandomUnit();
+    return DefaultGaussianMutationScale * range * radius * std::cos(angle);
+  };
+  size_t changed_count = 0;
+  if (genome.GetValueGeneCount() != 0) {
+    VisitValueGeneType(genome.GetValueGeneType(), [&](auto* type_tag) {
+      using ValueType = std::remove_pointer_t<decltype(type_tag)>;
+      changed_count = PerturbValueGenes<ValueType>(
+          chromosome, mutation_percentage, random, gaussian);
+    });
+  }
+  // Every other gene is mutated by flipping bits.
+  return changed_count +
+         FlipMutator(chromosome, mutation_percentage, random);
+}
+
+size_t Chromosome::PolynomialMutator(Chromosome* chromosome,
+                                     double mutation_percentage,
+                                     RandomWrapper* random) {
+  const Genome& genome = chromosome->GetGenome();
+  if (mutation_percentage <= 0.0) {
+    return 0;
+  }
+
+  constexpr double exponent = 1.0 / (DefaultMutationDistributionIndex + 1.0);
+  const auto polynomial = [](double range, RandomWrapper* random) {
+    const double unit = random->RandomUnit();
+    const double delta =
+        unit < 0.5 ? std::pow(2.0 * unit, exponent) - 1.0
+                   : 1.0 - std::pow(2.0 * (1.0 - unit), exponent);
+    return delta * range;
+  };
+  size_t changed_count = 0;
+  if (genome.GetValueGeneCount() != 0) {
+    VisitValueGeneType(genome.GetValueGeneType(), [&](auto* type_tag) {
+      using ValueType = std::remove_pointer_t<decltype(type_tag)>;
+      changed_count = PerturbValueGenes<ValueType>(
+          chromosome, mutation_percentage, random, polynomial);
+    });
   }
+  // Every other gene is mutated by flipping bits.
+  return changed_count +
+         FlipMutator(chromosome, mutation_percentage, random);
 }
 
 }  // namespace panga
@@ -8,7 +8,10 @@
 #define CHROMOSOME_H__
 
 #include <cassert>
+#include <climits>
 #include <cstdint>
+#include <limits>
+#include <vector>
 
 #include "BitVector.h"
 #include "Genome.h"
@@ -39,7 +42,8 @@ class Chromosome : public BitVector {
   const Genome& GetGenome() const;
 
   /**
-   * Randomize all bits in the Chromosome.
+   * Randomize all bits in the Chromosome.<br/>
+   * Value genes are set to uniformly random values inside their range.
    */
   void Randomize(RandomWrapper* random);
 
@@ -62,11 +66,47 @@ class Chromosome : public BitVector {
       return min;
     }
 
-    const size_t gene_bit_index = genome_.GetGeneStartBitIndex(gene_index);
-    const size_t gene_width = genome_.GetGeneBitWitdh(gene_index);
-    assert(sizeof(IntegerType) * CHAR_BIT >= gene_width);
+    IntegerType value = 0;
+    if (HasGeneLayout(gene_index)) {
+      const GeneLayout& layout = genome_.GetGeneLayout(gene_index);
+      assert(sizeof(IntegerType) * CHAR_BIT >= layout.bit_width);
+      value = static_cast<IntegerType>(ReadGene(layout));
+    } else {
+      const size_t gene_bit_index = genome_.GetGeneStartBitIndex(gene_index);
+      const size_t gene_width = genome_.GetGeneBitWitdh(gene_index);
+      assert(sizeof(IntegerType) * CHAR_BIT >= gene_width);
+      value = GetInt<IntegerType>(gene_bit_index, gene_width);
+    }
+    if (use_gray_encoding) {
+      value = DecodeGray<IntegerType>(value);
+    }
+
+    // Clamp into range.
+    return (value % (max - min)) + min;
+  }
+
+  /**
+   * Same as DecodeIntegerGene for a gene whose width, |bit_width|, is known
+   * at compile time.<br/>
+   * The bit mask is a constant and genes up to 57 bits wide are read with
+   * one unaligned 64-bit load and a shift.<br/>
+   * Note: Requires the Genome to be frozen.
+   * @see DecodeIntegerGene
+   * @see Genome::Freeze
+   */
+  template <size_t bit_width, typename IntegerType = uint64_t,
+            bool use_gray_encoding = true>
+  IntegerType DecodeIntegerGeneOfWidth(
+      size_t gene_index, IntegerType min = 0,
+      IntegerType max = std::numeric_limits<IntegerType>::max()) const {
+    static_assert(sizeof(IntegerType) * CHAR_BIT >= bit_width,
+                  "IntegerType is too narrow for the gene");
+    if (min == max) {
+      return min;
+    }
 
-    auto value = GetInt<IntegerType>(gene_bit_index, gene_width);
+    auto value = static_cast<IntegerType>(
+        ReadGeneOfWidth<bit_width>(genome_.GetGeneLayout(gene_index)));
     if (use_gray_encoding) {
       value = DecodeGray<IntegerType>(value);
     }
@@ -75,6 +115,28 @@ class Chromosome : public BitVector {
     return (value % (max - min)) + min;
   }
 
+  /**
+   * Decode every gene with a bit width into |values| where |values|[i]
+   * receives the integer value of gene i, unscaled.<br/>
+   * |values| must have room for Genome::GetFirstBooleanGeneIndex values.
+   * <br/>Note: Requires the Genome to be frozen.
+   * @see Genome::Freeze
+   */
+  template <typename IntegerType = uint64_t, bool use_gray_encoding = true>
+  void DecodeAllIntegerGenes(IntegerType* values) const {
+    assert(genome_.IsFrozen());
+    const size_t gene_count = genome_.GetFirstBooleanGeneIndex();
+    for (size_t i = 0; i < gene_count; i++) {
+      const GeneLayout& layout = genome_.GetGeneLayout(i);
+      assert(sizeof(IntegerType) * CHAR_BIT >= layout.bit_width);
+      uint64_t value = ReadGene(layout);
+      if (use_gray_encoding) {
+        value = DecodeGray<uint64_t>(value);
+      }
+      values[i] = static_cast<IntegerType>(value);
+    }
+  }
+
   /**
    * Take an integer value and encode it into the binary data representing
    * a gene in the Chromosome.<br/>
@@ -109,12 +171,66 @@ class Chromosome : public BitVector {
   template <typename FloatType = double, bool use_gray_encoding = true>
   FloatType DecodeFloatGene(size_t gene_index, FloatType min,
                             FloatType max) const {
+    if (HasGeneLayout(gene_index)) {
+      const GeneLayout& layout = genome_.GetGeneLayout(gene_index);
+      uint64_t int_value = ReadGene(layout);
+      if (use_gray_encoding) {
+        int_value = DecodeGray<uint64_t>(int_value);
+      }
+      return ScaleFloat<FloatType>(int_value, layout.float_scale, min, max);
+    }
+
     const uint64_t int_value =
         DecodeIntegerGene<uint64_t, use_gray_encoding>(gene_index);
     const size_t gene_width = genome_.GetGeneBitWitdh(gene_index);
     return DecodeFloat<FloatType, uint64_t>(int_value, gene_width, min, max);
   }
 
+  /**
+   * Same as DecodeFloatGene for a gene whose width, |bit_width|, is known at
+   * compile time.<br/>
+   * Note: Requires the Genome to be frozen.
+   * @see DecodeFloatGene
+   * @see DecodeIntegerGeneOfWidth
+   */
+  template <size_t bit_width, typename FloatType = double,
+            bool use_gray_encoding = true>
+  FloatType DecodeFloatGeneOfWidth(size_t gene_index, FloatType min,
+                                   FloatType max) const {
+    constexpr double scale = 1.0 / static_cast<double>(LowBitsMask(bit_width));
+    uint64_t int_value =
+        ReadGeneOfWidth<bit_width>(genome_.GetGeneLayout(gene_index));
+    if (use_gray_encoding) {
+      int_value = DecodeGray<uint64_t>(int_value);
+    }
+    return ScaleFloat<FloatType>(int_value, scale, min, max);
+  }
+
+  /**
+   * Decode every gene with a bit width into |values| where |values|[i]
+   * receives gene i as a floating point number scaled between |min| and
+   * |max|.<br/>
+   * |values| must have room for Genome::GetFirstBooleanGeneIndex values.
+   * <br/>Note: Requires the Genome to be frozen.
+   * @see DecodeFloatGene
+   * @see Genome::Freeze
+   */
+  template <typename FloatType = double, bool use_gray_encoding = true>
+  void DecodeAllFloatGenes(FloatType* values, FloatType min,
+                           FloatType max) const {
+    assert(genome_.IsFrozen());
+    const size_t gene_count = genome_.GetFirstBooleanGeneIndex();
+    for (size_t i = 0; i < gene_count; i++) {
+      const GeneLayout& layout = genome_.GetGeneLayout(i);
+      uint64_t int_value = ReadGene(layout);
+      if (use_gray_encoding) {
+        int_value = DecodeGray<uint64_t>(int_value);
+      }
+      values[i] =
+          ScaleFloat<FloatType>(int_value, layout.float_scale, min, max);
+    }
+  }
+
   /**
    * Take a floating point value and encode it into the binary data
    * representing a gene in the Chromosome.<br/>
@@ -158,16 +274,60 @@ class Chromosome : public BitVector {
    */
   std::byte* GetRawGene(size_t gene_index, size_t* gene_bit_width);
 
+  /**
+   * Append the index of every gene holding a bit which differs between this
+   * Chromosome and |other| to |changed_genes| in increasing order.<br/>
+   * Differences are found a word at a time so this is cheap when only a few
+   * genes changed. Padding bits of byte-aligned genes are ignored.<br/>
+   * Note: |other| must have the same bit count as this Chromosome.
+   */
+  void FindChangedGenes(const BitVector& other,
+                        std::vector<size_t>* changed_genes) const;
+
+  /**
+   * Append the index of every gene holding a set bit to |genes| in
+   * increasing order.<br/>
+   * Useful when this Chromosome is a mask of the bits flipped in another.
+   */
+  void FindGenesWithSetBits(std::vector<size_t>* genes) const;
+
+  /**
+   * Get the values of every value gene in the Chromosome as an array of
+   * Genome::GetValueGeneCount() values.<br/>
+   * The values are stored natively so reading them doesn't decode
+   * anything.<br/>
+   * Note: |ValueType| must match the type the value genes were added with.
+   * @see Genome::AddValueGenes
+   */
+  template <typename ValueType>
+  const ValueType* GetValueGenes() const {
+    assert(genome_.GetValueGeneType() == ValueGeneTypeOf<ValueType>());
+    const std::byte* values = GetBytes() + genome_.GetValueGeneByteOffset();
+    assert(reinterpret_cast<uintptr_t>(values) % alignof(ValueType) == 0);
+    return reinterpret_cast<const ValueType*>(values);
+  }
+
+  template <typename ValueType>
+  ValueType* GetValueGenesWritable() {
+    assert(genome_.GetValueGeneType() == ValueGeneTypeOf<ValueType>());
+    std::byte* values = GetBytesWritable() + genome_.GetValueGeneByteOffset();
+    assert(reinterpret_cast<uintptr_t>(values) % alignof(ValueType) == 0);
+    return reinterpret_cast<ValueType*>(values);
+  }
+
   /**
    * Decode a binary integer from a gray-encoded value.
    * @param gray_value Gray-encoded value
    * @return Binary integer value
    */
   template <typename IntegerType = uint64_t>
-  static IntegerType DecodeGray(IntegerType gray_value) {
+  static constexpr IntegerType DecodeGray(IntegerType gray_value) {
+    // Each binary bit is the XOR of the gray bits at or above it. Fold those
+    // prefixes together in log2(bits) steps instead of one step per bit.
     IntegerType binary_value = gray_value;
-    while (gray_value >>= 1) {
-      binary_value ^= gray_value;
+    for (size_t shift = 1; shift < sizeof(IntegerType) * CHAR_BIT;
+         shift <<= 1U) {
+      binary_value ^= binary_value >> shift;
     }
     return binary_value;
   }
@@ -232,6 +392,7 @@ class Chromosome : public BitVector {
    * a single parent. Each gene still has uniformly equal chance of being copied
    * from either parent.<br/>If true, gene boundaries are ignored and every bit
    * in the chromosome has an equal chance to be copied from either parent.
+   * <br/>Value genes are always copied whole from a single parent.
    */
   static void UniformCrossover(const Chromosome& parent1,
                                const Chromosome& parent2, Chromosome* offspring,
@@ -247,7 +408,8 @@ class Chromosome : public BitVector {
    * a single parent. Genes are copied in chunks according to the cut
    * points.<br/>If true, gene boundaries are ignored and the chromosome is
    * treated as a single chunk of bits which is split into chunks according to
-   * the cut points.
+   * the cut points.<br/>Value genes are always copied whole from the parent
+   * their first bit is copied from.
    */
   static void KPointCrossover(size_t k, const Chromosome& parent1,
                               const Chromosome& parent2, Chromosome* offspring,
@@ -257,10 +419,194 @@ class Chromosome : public BitVector {
   /**
    * Perform flip mutation on |chromosome|.<br/>
    * Every bit in |chromosome| will have |mutation_percentage| chance of
-   * flipping.
+   * flipping. The bits of value genes are never flipped since that could
+   * turn them into values outside of their range.
+   * @return The number of bits flipped.
+   */
+  static size_t FlipMutator(Chromosome* chromosome,
+                            double mutation_percentage, RandomWrapper* random);
+
+  /**
+   * Perform flip mutation on |chromosome| where every bit independently flips
+   * with |mutation_percentage| probability.<br/>
+   * Instead of testing each bit, the distance to the next flipped bit is drawn
+   * from a geometric distribution so the cost is one random number per
+   * flipped bit. This is the best choice for low mutation rates. The bits of
+   * value genes are never flipped.
+   * @return The number of bits flipped.
+   */
+  static size_t GeometricFlipMutator(Chromosome* chromosome,
+                                     double mutation_percentage,
+                                     RandomWrapper* random);
+
+  /**
+   * Perform flip mutation on |chromosome| by XORing in random 64-bit masks
+   * where every bit is set with |mutation_percentage| probability.<br/>
+   * The rate is rounded to a multiple of 2^-16 and each mask word costs at
+   * most 16 random words, independent of the rate. This is the best choice
+   * for high mutation rates. The bits of value genes are never flipped.
+   * @return The number of bits flipped.
+   */
+  static size_t MaskFlipMutator(Chromosome* chromosome,
+                                double mutation_percentage,
+                                RandomWrapper* random);
+
+  /**
+   * Default parameters of the value gene operators.
+   * @see BlendCrossover
+   * @see SimulatedBinaryCrossover
+   * @see GaussianMutator
+   * @see PolynomialMutator
+   */
+  static constexpr double DefaultBlendAlpha = 0.5;
+  static constexpr double DefaultCrossoverDistributionIndex = 15.0;
+  static constexpr double DefaultGaussianMutationScale = 0.1;
+  static constexpr double DefaultMutationDistributionIndex = 20.0;
+
+  /**
+   * Perform blend crossover (BLX-alpha) on the value genes of |parent1| and
+   * |parent2|.<br/>
+   * Each value of |offspring| is drawn uniformly from the interval spanned by
+   * the parent values, widened by |alpha| times its length on either side,
+   * and kept inside the value gene range.<br/>
+   * Any bits outside the value genes are recombined as in UniformCrossover.
+   * @see Genome::AddValueGenes
+   */
+  static void BlendCrossover(double alpha, const Chromosome& parent1,
+                             const Chromosome& parent2, Chromosome* offspring,
+                             RandomWrapper* random,
+                             bool ignore_gene_boundaries = true);
+
+  /**
+   * Perform simulated binary crossover (SBX) on the value genes of |parent1|
+   * and |parent2|.<br/>
+   * Each value of |offspring| is one of the two children SBX produces from
+   * the parent values. Larger values of |distribution_index| keep children
+   * closer to their parents.<br/>
+   * Any bits outside the value genes are recombined as in UniformCrossover.
+   */
+  static void SimulatedBinaryCrossover(double distribution_index,
+                                       const Chromosome& parent1,
+                                       const Chromosome& parent2,
+                                       Chromosome* offspring,
+                                       RandomWrapper* random,
+                                       bool ignore_gene_boundaries = true);
+
+  /**
+   * Add normally distributed noise to each value gene of |chromosome| with
+   * |mutation_percentage| probability.<br/>
+   * The standard deviation of the noise is DefaultGaussianMutationScale
+   * times the width of the value gene range and mutated values are kept
+   * inside the range. Bits outside the value genes are mutated as in
+   * FlipMutator.
+   * @return The number of values and bits which changed.
+   */
+  static size_t GaussianMutator(Chromosome* chromosome,
+                                double mutation_percentage,
+                                RandomWrapper* random);
+
+  /**
+   * Perform polynomial mutation on each value gene of |chromosome| with
+   * |mutation_percentage| probability.<br/>
+   * The perturbation follows Deb's polynomial distribution with index
+   * DefaultMutationDistributionIndex, scaled to the value gene range. Bits
+   * outside the value genes are mutated as in FlipMutator.
+   * @return The number of values and bits which changed.
+   */
+  static size_t PolynomialMutator(Chromosome* chromosome,
+                                  double mutation_percentage,
+                                  RandomWrapper* random);
+
+ protected:
+  /**
+   * Get a mask with the low |bit_count| bits set.
+   */
+  static constexpr uint64_t LowBitsMask(size_t bit_count) {
+    return bit_count >= sizeof(uint64_t) * CHAR_BIT
+               ? std::numeric_limits<uint64_t>::max()
+               : (uint64_t{1} << bit_count) - 1U;
+  }
+
+  /**
+   * Scale |int_value| into [|min|, |max|] given |scale| is one over the
+   * largest value the gene can hold.
+   */
+  template <typename FloatType>
+  static FloatType ScaleFloat(uint64_t int_value, double scale, FloatType min,
+                              FloatType max) {
+    const auto factor =
+        static_cast<FloatType>(static_cast<double>(int_value) * scale);
+    return factor * (max - min) + min;
+  }
+
+  /**
+   * Recombine the bits of |parent1| and |parent2| outside of their value
+   * genes into |offspring| ahead of recombining the values themselves.
+   */
+  static void PrepareValueCrossover(const Chromosome& parent1,
+                                    const Chromosome& parent2,
+                                    Chromosome* offspring,
+                                    RandomWrapper* random,
+                                    bool ignore_gene_boundaries);
+
+  /**
+   * Blend |parent1| and |parent2| into |offspring| a chunk of mask words at a
+   * time.<br/>
+   * |build_mask| is called as (window_begin, word_count, mask) and must fill
+   * |mask| with |word_count| words of mask bits for the chromosome bits
+   * starting at |window_begin|. Chunks are requested front to back. Bits set
+   * in the mask are copied from |parent1| and the rest from |parent2|.
+   */
+  template <typename MaskBuilder>
+  static void BlendWithMask(const Chromosome& parent1,
+                            const Chromosome& parent2, Chromosome* offspring,
+                            MaskBuilder* build_mask);
+
+  /**
+   * Returns true if the gene at |gene_index| can be decoded from the layout
+   * table of a frozen Genome.
+   */
+  bool HasGeneLayout(size_t gene_index) const {
+    return genome_.IsFrozen() &&
+           gene_index < genome_.GetFirstBooleanGeneIndex();
+  }
+
+  /**
+   * Read the raw bits of the gene described by |layout|.
+   */
+  uint64_t ReadGene(const GeneLayout& layout) const {
+    if (layout.is_word_loadable) {
+      return (LoadUnalignedWord(GetBytes() + layout.byte_offset) >>
+              layout.bit_shift) &
+             layout.value_mask;
+    }
+    return GetInt<uint64_t>(layout.start_bit_index, layout.bit_width);
+  }
+
+  /**
+   * Read the raw bits of the gene described by |layout| which is known to be
+   * |bit_width| bits wide.
+   */
+  template <size_t bit_width>
+  uint64_t ReadGeneOfWidth(const GeneLayout& layout) const {
+    static_assert(bit_width > 0 && bit_width <= sizeof(uint64_t) * CHAR_BIT,
+                  "Genes are between 1 and 64 bits wide");
+    assert(layout.bit_width == bit_width);
+    if constexpr (bit_width <= GeneLayout::MaxWordLoadableBitWidth) {
+      if (layout.is_word_loadable) {
+        return (LoadUnalignedWord(GetBytes() + layout.byte_offset) >>
+                layout.bit_shift) &
+               LowBitsMask(bit_width);
+      }
+    }
+    return GetInt<uint64_t>(layout.start_bit_index, bit_width);
+  }
+
+  /**
+   * Construct a Chromosome for |genome| whose bits are stored in |storage|.
+   * @see BitVector::AttachStorage
    */
-  static void FlipMutator(Chromosome* chromosome, double mutation_percentage,
-                          RandomWrapper* random);
+  Chromosome(const Genome& genome, std::byte* storage, size_t byte_capacity);
 
  private:
   const Genome& genome_;
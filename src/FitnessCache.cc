@@ -0,0 +1,99 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include "FitnessCache.h"
+
+#include <cassert>
+
+namespace panga {
+
+FitnessCache::FitnessCache(size_t capacity) : capacity_(capacity) {
+  entries_.reserve(capacity_);
+  index_.reserve(capacity_);
+}
+
+bool FitnessCache::Find(const BitVector& chromosome, uint64_t hash,
+                        double* score) {
+  assert(score != nullptr);
+
+  const auto it = index_.find(hash);
+  if (it != index_.end()) {
+    auto& entry = entries_[it->second];
+    if (entry.chromosome.GetBitCount() == chromosome.GetBitCount() &&
+        entry.chromosome.Equals(chromosome)) {
+      entry.is_referenced = true;
+      *score = entry.score;
+      hit_count_++;
+      return true;
+    }
+  }
+
+  miss_count_++;
+  return false;
+}
+
+void FitnessCache::Insert(const BitVector& chromosome, uint64_t hash,
+                          double score) {
+  if (capacity_ == 0) {
+    return;
+  }
+
+  // A different chromosome with the same hash gets replaced. Both can't be
+  // found through the index at once.
+  size_t entry_index = 0;
+  const auto it = index_.find(hash);
+  if (it != index_.end()) {
+    entry_index = it->second;
+  } else {
+    entry_index = ClaimEntry();
+    index_[hash] = entry_index;
+  }
+
+  auto& entry = entries_[entry_index];
+  // Reuses the storage of the evicted chromosome when possible.
+  entry.chromosome = chromosome;
+  entry.hash = hash;
+  entry.score = score;
+  entry.is_referenced = false;
+}
+
+size_t FitnessCache::ClaimEntry() {
+  if (entries_.size() < capacity_) {
+    entries_.emplace_back();
+    return entries_.size() - 1U;
+  }
+
+  // Sweep the clock hand over the entries giving each recently used one a
+  // second chance until we find one which hasn't been used since the last
+  // sweep.
+  while (entries_[clock_hand_].is_referenced) {
+    entries_[clock_hand_].is_referenced = false;
+    clock_hand_ = (clock_hand_ + 1U) % capacity_;
+  }
+
+  const size_t entry_index = clock_hand_;
+  clock_hand_ = (clock_hand_ + 1U) % capacity_;
+  index_.erase(entries_[entry_index].hash);
+  return entry_index;
+}
+
+void FitnessCache::Clear() {
+  entries_.clear();
+  index_.clear();
+  clock_hand_ = 0;
+  hit_count_ = 0;
+  miss_count_ = 0;
+}
+
+size_t FitnessCache::GetCapacity() const { return capacity_; }
+
+size_t FitnessCache::Size() const { return entries_.size(); }
+
+size_t FitnessCache::GetHitCount() const { return hit_count_; }
+
+size_t FitnessCache::GetMissCount() const { return miss_count_; }
+
+}  // namespace panga
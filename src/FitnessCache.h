@@ -0,0 +1,105 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef FITNESSCACHE_H__
+#define FITNESSCACHE_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "BitVector.h"
+
+namespace panga {
+
+/**
+ * A bounded map from chromosome bits to the score the fitness function
+ * returned for them.<br/>
+ * Chromosomes are looked up by BitVector::Hash and confirmed with Equals so a
+ * hash collision can never return the wrong score.<br/>
+ * Once the cache is full, entries are evicted with the clock algorithm - an
+ * approximation of least-recently-used eviction which only needs one flag
+ * per entry.<br/>
+ * Note: The cache is not thread-safe.
+ */
+class FitnessCache {
+ public:
+  /**
+   * Construct a cache holding at most |capacity| chromosomes.
+   */
+  explicit FitnessCache(size_t capacity);
+  FitnessCache(const FitnessCache& rhs) = delete;
+  FitnessCache& operator=(const FitnessCache& rhs) = delete;
+  ~FitnessCache() = default;
+
+  /**
+   * Look up the score stored for |chromosome| whose hash is |hash|.<br/>
+   * Counts a hit or a miss.
+   * @return true and write the score into |score| if |chromosome| is in the
+   * cache.
+   */
+  bool Find(const BitVector& chromosome, uint64_t hash, double* score);
+
+  /**
+   * Store |score| for |chromosome| whose hash is |hash|, evicting another
+   * entry if the cache is full.
+   */
+  void Insert(const BitVector& chromosome, uint64_t hash, double score);
+
+  /**
+   * Remove every entry from the cache and reset the counters.
+   */
+  void Clear();
+
+  /**
+   * Get the maximum number of chromosomes the cache holds.
+   */
+  size_t GetCapacity() const;
+
+  /**
+   * Get the number of chromosomes currently in the cache.
+   */
+  size_t Size() const;
+
+  /**
+   * Get the number of calls to Find which found the chromosome.
+   */
+  size_t GetHitCount() const;
+
+  /**
+   * Get the number of calls to Find which did not find the chromosome.
+   */
+  size_t GetMissCount() const;
+
+ protected:
+  struct Entry {
+    BitVector chromosome;
+    uint64_t hash = 0;
+    double score = 0.0;
+    // Set when the entry is used. The clock hand clears it before evicting.
+    bool is_referenced = false;
+  };
+
+  /**
+   * Pick the entry to overwrite with a new chromosome.
+   * @return The index of an unused entry or of the evicted one.
+   */
+  size_t ClaimEntry();
+
+ private:
+  std::vector<Entry> entries_;
+  // Maps a hash to the index of the entry with that hash.
+  std::unordered_map<uint64_t, size_t> index_;
+  size_t capacity_;
+  size_t clock_hand_ = 0;
+  size_t hit_count_ = 0;
+  size_t miss_count_ = 0;
+};
+
+}  // namespace panga
+
+#endif  // FITNESSCACHE_H__
@@ -0,0 +1,326 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef FIXEDCHROMOSOME_H__
+#define FIXEDCHROMOSOME_H__
+
+#include <array>
+#include <cassert>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+
+#include "BitVector.h"
+#include "Chromosome.h"
+#include "Genome.h"
+
+namespace panga {
+
+/**
+ * A Genome whose layout is known at compile time.<br/>
+ * Genes are laid out the same way Genome does without byte alignment - one
+ * gene for each of |GeneWidths| followed by |BooleanGeneCount| boolean genes.
+ * <br/>For example, FixedGenome<4, 10, 7> describes a 10-bit gene, a 7-bit
+ * gene and 4 boolean genes for a total of 21 bits.
+ * @see FixedChromosome
+ */
+template <size_t BooleanGeneCount, size_t... GeneWidths>
+class FixedGenome {
+ public:
+  static constexpr size_t FirstBooleanGeneIndex = sizeof...(GeneWidths);
+  static constexpr size_t GeneCount = FirstBooleanGeneIndex + BooleanGeneCount;
+  static constexpr size_t FirstBooleanGeneBitIndex = (0U + ... + GeneWidths);
+  static constexpr size_t BitsRequired =
+      FirstBooleanGeneBitIndex + BooleanGeneCount;
+
+  static_assert(((GeneWidths != 0) && ...), "Genes must be at least one bit");
+  static_assert(((GeneWidths <= sizeof(uint64_t) * CHAR_BIT) && ...),
+                "Genes must be at most 64 bits");
+  static_assert(GeneCount != 0, "A genome needs at least one gene");
+
+  static constexpr size_t GetGeneBitWidth(size_t gene_index) {
+    assert(gene_index < GeneCount);
+    if (gene_index >= FirstBooleanGeneIndex) {
+      return 1;
+    }
+    constexpr std::array<size_t, FirstBooleanGeneIndex> widths = {
+        GeneWidths...};
+    return widths[gene_index];
+  }
+
+  static constexpr size_t GetGeneStartBitIndex(size_t gene_index) {
+    assert(gene_index < GeneCount);
+    if (gene_index >= FirstBooleanGeneIndex) {
+      return FirstBooleanGeneBitIndex + gene_index - FirstBooleanGeneIndex;
+    }
+    size_t start_bit_index = 0;
+    for (size_t i = 0; i < gene_index; i++) {
+      start_bit_index += GetGeneBitWidth(i);
+    }
+    return start_bit_index;
+  }
+
+  /**
+   * Add the genes of this layout to |genome| so a GeneticAlgorithm builds
+   * chromosomes FixedChromosome can read.<br/>
+   * |genome| should be empty.
+   */
+  static void AddGenesTo(Genome* genome) {
+    (genome->AddGene(GeneWidths), ...);
+    if (BooleanGeneCount != 0) {
+      genome->AddBooleanGenes(BooleanGeneCount);
+    }
+  }
+
+  /**
+   * Return true if |genome| places every gene where this layout does.
+   */
+  static bool Matches(const Genome& genome) {
+    if (genome.GetGeneCount() != GeneCount ||
+        genome.GetFirstBooleanGeneIndex() != FirstBooleanGeneIndex ||
+        genome.BitsRequired() != BitsRequired) {
+      return false;
+    }
+    for (size_t i = 0; i < GeneCount; i++) {
+      if (genome.GetGeneStartBitIndex(i) != GetGeneStartBitIndex(i) ||
+          genome.GetGeneBitWitdh(i) != GetGeneBitWidth(i)) {
+        return false;
+      }
+    }
+    return true;
+  }
+};
+
+/**
+ * Fixed-size copy of the bits of a chromosome laid out by a FixedGenome,
+ * |GenomeType|.<br/>
+ * The bits live inline in whole words so the type is trivially copyable and
+ * every gene offset, width and mask is a compile-time constant. Decoding a
+ * gene is a shift and a mask, or two for genes which straddle a word, and
+ * folds away entirely for constant chromosomes.<br/>
+ * Fitness functions for small genomes can load an Individual into a
+ * FixedChromosome once and decode from registers instead of going through
+ * the runtime Genome for each gene. Decoding gives the same values as the
+ * matching Chromosome methods.
+ * @see FixedGenome
+ * @see Chromosome::DecodeIntegerGene
+ */
+template <typename GenomeType>
+class FixedChromosome {
+ public:
+  static constexpr size_t BitsPerWord = sizeof(uint64_t) * CHAR_BIT;
+  static constexpr size_t BitCount = GenomeType::BitsRequired;
+  static constexpr size_t WordCount =
+      (BitCount + BitsPerWord - 1) / BitsPerWord;
+
+  constexpr FixedChromosome() = default;
+
+  /**
+   * Copy the bits of |chromosome|, which must hold exactly BitCount bits.
+   */
+  explicit FixedChromosome(const BitVector& chromosome) { Load(chromosome); }
+
+  /**
+   * Replace our bits with the bits of |chromosome|, which must hold exactly
+   * BitCount bits.
+   */
+  void Load(const BitVector& chromosome) {
+    assert(chromosome.GetBitCount() == BitCount);
+    // Bit i of the word is bit (i % 8) of byte (i / 8) regardless of the byte
+    // order of the host.
+    const std::byte* bytes = chromosome.GetBytes();
+    for (size_t w = 0; w < WordCount; w++) {
+      uint64_t word = 0;
+      for (size_t b = 0; b < sizeof(uint64_t); b++) {
+        word |= static_cast<uint64_t>(bytes[w * sizeof(uint64_t) + b])
+                << (b * CHAR_BIT);
+      }
+      words_[w] = word;
+    }
+    words_[WordCount - 1] &= LowBitsMask(TailBitCount);
+  }
+
+  /**
+   * Write our bits into |chromosome|, which must hold exactly BitCount bits.
+   */
+  void Store(BitVector* chromosome) const {
+    assert(chromosome->GetBitCount() == BitCount);
+    for (size_t w = 0; w < WordCount; w++) {
+      const size_t bit_width = w + 1 == WordCount ? TailBitCount : BitsPerWord;
+      chromosome->SetInt<uint64_t>(words_[w], w * BitsPerWord, bit_width);
+    }
+  }
+
+  constexpr bool Get(size_t index) const {
+    assert(index < BitCount);
+    return ((words_[index / BitsPerWord] >> (index % BitsPerWord)) & 1U) != 0;
+  }
+
+  constexpr void Set(size_t index) {
+    assert(index < BitCount);
+    words_[index / BitsPerWord] |= uint64_t{1} << (index % BitsPerWord);
+  }
+
+  constexpr void Unset(size_t index) {
+    assert(index < BitCount);
+    words_[index / BitsPerWord] &= ~(uint64_t{1} << (index % BitsPerWord));
+  }
+
+  constexpr void Flip(size_t index) {
+    assert(index < BitCount);
+    words_[index / BitsPerWord] ^= uint64_t{1} << (index % BitsPerWord);
+  }
+
+  /**
+   * Decode gene |gene_index| as an integer in [|min|, |max|).
+   * @see Chromosome::DecodeIntegerGene
+   */
+  template <size_t gene_index, typename IntegerType = uint64_t,
+            bool use_gray_encoding = true>
+  constexpr IntegerType DecodeIntegerGene(
+      IntegerType min = 0,
+      IntegerType max = std::numeric_limits<IntegerType>::max()) const {
+    constexpr size_t bit_width = GenomeType::GetGeneBitWidth(gene_index);
+    static_assert(gene_index < GenomeType::FirstBooleanGeneIndex,
+                  "Boolean genes have no integer value");
+    static_assert(bit_width != 0 && bit_width <= BitsPerWord,
+                  "Genes are between 1 and 64 bits wide");
+    static_assert(sizeof(IntegerType) * CHAR_BIT >= bit_width,
+                  "IntegerType is too narrow for the gene");
+    if (min == max) {
+      return min;
+    }
+
+    uint64_t value = ReadGene<gene_index>();
+    if (use_gray_encoding) {
+      value = Chromosome::DecodeGray(value);
+    }
+    // Clamp into range.
+    return (static_cast<IntegerType>(value) % (max - min)) + min;
+  }
+
+  /**
+   * Decode gene |gene_index| as a floating point number scaled between |min|
+   * and |max|.
+   * @see Chromosome::DecodeFloatGene
+   */
+  template <size_t gene_index, typename FloatType = double,
+            bool use_gray_encoding = true>
+  constexpr FloatType DecodeFloatGene(FloatType min, FloatType max) const {
+    static_assert(gene_index < GenomeType::FirstBooleanGeneIndex,
+                  "Boolean genes have no floating point value");
+    constexpr size_t bit_width = GenomeType::GetGeneBitWidth(gene_index);
+    static_assert(bit_width != 0 && bit_width <= BitsPerWord,
+                  "Genes are between 1 and 64 bits wide");
+    constexpr double scale = 1.0 / static_cast<double>(LowBitsMask(bit_width));
+    uint64_t value = ReadGene<gene_index>();
+    if (use_gray_encoding) {
+      value = Chromosome::DecodeGray(value);
+    }
+    const auto factor =
+        static_cast<FloatType>(static_cast<double>(value) * scale);
+    return factor * (max - min) + min;
+  }
+
+  /**
+   * Return the value of boolean gene |gene_index|.
+   */
+  template <size_t gene_index>
+  constexpr bool DecodeBooleanGene() const {
+    static_assert(gene_index >= GenomeType::FirstBooleanGeneIndex &&
+                      gene_index < GenomeType::GeneCount,
+                  "Not a boolean gene");
+    return Get(GenomeType::GetGeneStartBitIndex(gene_index));
+  }
+
+  /**
+   * Write |value| into gene |gene_index|.
+   * @see Chromosome::EncodeIntegerGene
+   */
+  template <size_t gene_index, bool use_gray_encoding = true>
+  constexpr void EncodeIntegerGene(uint64_t value) {
+    static_assert(gene_index < GenomeType::FirstBooleanGeneIndex,
+                  "Boolean genes have no integer value");
+    if (use_gray_encoding) {
+      value ^= value >> 1U;
+    }
+    WriteGene<gene_index>(value);
+  }
+
+  constexpr size_t HammingDistance(const FixedChromosome& other) const {
+    size_t distance = 0;
+    for (size_t w = 0; w < WordCount; w++) {
+      uint64_t difference = words_[w] ^ other.words_[w];
+      for (; difference != 0; difference &= difference - 1U) {
+        distance++;
+      }
+    }
+    return distance;
+  }
+
+  constexpr bool operator==(const FixedChromosome& other) const {
+    for (size_t w = 0; w < WordCount; w++) {
+      if (words_[w] != other.words_[w]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  constexpr bool operator!=(const FixedChromosome& other) const {
+    return !(*this == other);
+  }
+
+ protected:
+  // Bits used in the last word.
+  static constexpr size_t TailBitCount =
+      BitCount - (WordCount - 1) * BitsPerWord;
+
+  static constexpr uint64_t LowBitsMask(size_t bit_count) {
+    return bit_count >= BitsPerWord ? ~uint64_t{0}
+                                    : (uint64_t{1} << bit_count) - 1U;
+  }
+
+  template <size_t gene_index>
+  constexpr uint64_t ReadGene() const {
+    constexpr size_t start = GenomeType::GetGeneStartBitIndex(gene_index);
+    constexpr size_t bit_width = GenomeType::GetGeneBitWidth(gene_index);
+    constexpr size_t word = start / BitsPerWord;
+    constexpr size_t shift = start % BitsPerWord;
+    uint64_t value = words_[word] >> shift;
+    if constexpr (shift + bit_width > BitsPerWord) {
+      value |= words_[word + 1] << (BitsPerWord - shift);
+    }
+    return value & LowBitsMask(bit_width);
+  }
+
+  template <size_t gene_index>
+  constexpr void WriteGene(uint64_t value) {
+    constexpr size_t start = GenomeType::GetGeneStartBitIndex(gene_index);
+    constexpr size_t bit_width = GenomeType::GetGeneBitWidth(gene_index);
+    constexpr size_t word = start / BitsPerWord;
+    constexpr size_t shift = start % BitsPerWord;
+    constexpr uint64_t mask = LowBitsMask(bit_width);
+    value &= mask;
+    words_[word] = (words_[word] & ~(mask << shift)) | (value << shift);
+    if constexpr (shift + bit_width > BitsPerWord) {
+      constexpr size_t high_shift = BitsPerWord - shift;
+      words_[word + 1] =
+          (words_[word + 1] & ~(mask >> high_shift)) | (value >> high_shift);
+    }
+  }
+
+ private:
+  static_assert(BitCount != 0, "A chromosome needs at least one bit");
+
+  std::array<uint64_t, WordCount> words_{};
+};
+
+}  // namespace panga
+
+#endif  // FIXEDCHROMOSOME_H__
@@ -7,11 +7,70 @@
 #include "GeneticAlgorithm.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <limits>
+#include <mutex>
 #include <numeric>
+#include <shared_mutex>
+#include <sstream>
 #include <utility>
 
+#include "BinaryStream.h"
 #include "Individual.h"
 
+namespace {
+
+// Offspring streams are derived from their index in the population. Other
+// streams use identifiers which can never be a valid index.
+constexpr uint64_t DiversitySampleStream = std::numeric_limits<uint64_t>::max();
+
+// Mutation draws from a stream derived from the stream of each individual so
+// mutating a clone can be deferred until after it has taken its storage.
+constexpr uint64_t MutationStream = 0;
+
+// The reproduction backend keys the counter-based stream of each offspring by
+// a seed derived from the stream of the individual.
+constexpr uint64_t ReproductionStream = 1;
+
+// Screening candidates after the first draw from streams derived from this
+// stream of the individual, one per candidate.
+constexpr uint64_t ScreeningStream = 2;
+
+// Stream derived from the generation seed used by selectors which pick every
+// parent for the generation up front.
+constexpr uint64_t SelectionStream = DiversitySampleStream - 1U;
+
+// Stream derived from the seed which steady-state offspring streams are
+// derived from by counting evaluations.
+constexpr uint64_t SteadyStateStream = DiversitySampleStream - 2U;
+
+// Identifies a checkpoint file and the version of its format.
+constexpr char CheckpointMagic[] = {'P', 'A', 'N', 'G', 'A', 'C', 'K', 'P'};
+constexpr uint32_t CheckpointVersion = 4;
+// Stored in host byte order so a checkpoint written on a machine with a
+// different byte order is rejected.
+constexpr uint32_t CheckpointByteOrderMark = 0x01020304;
+
+// Marks an individual which isn't a clone of one from the last generation.
+constexpr size_t NotCloned = std::numeric_limits<size_t>::max();
+
+// Returns true if |left| and |right| hold the same genes, laid out the same
+// way.
+bool HasSameGenes(const panga::Genome& left, const panga::Genome& right) {
+  std::ostringstream left_stream;
+  std::ostringstream right_stream;
+  left.Save(&left_stream);
+  right.Save(&right_stream);
+  return left_stream.str() == right_stream.str();
+}
+
+}  // namespace
+
 namespace panga {
 
 GeneticAlgorithm::GeneticAlgorithm() {
@@ -19,6 +78,8 @@ GeneticAlgorithm::GeneticAlgorithm() {
   populations_.emplace_back(genome_);
 }
 
+GeneticAlgorithm::~GeneticAlgorithm() = default;
+
 Genome& GeneticAlgorithm::GetGenome() { return genome_; }
 
 void GeneticAlgorithm::SetMutatedEliteMutationRate(
@@ -64,6 +125,120 @@ FitnessFunction GeneticAlgorithm::GetFitnessFunction() const {
   return fitness_function_;
 }
 
+void GeneticAlgorithm::SetBatchFitnessFunction(
+    BatchFitnessFunction batch_fitness_function) {
+  batch_fitness_function_ = std::move(batch_fitness_function);
+}
+
+const BatchFitnessFunction& GeneticAlgorithm::GetBatchFitnessFunction() const {
+  return batch_fitness_function_;
+}
+
+void GeneticAlgorithm::SetAsyncFitnessFunction(
+    AsyncFitnessFunction async_fitness_function) {
+  async_fitness_function_ = std::move(async_fitness_function);
+}
+
+const AsyncFitnessFunction& GeneticAlgorithm::GetAsyncFitnessFunction() const {
+  return async_fitness_function_;
+}
+
+void GeneticAlgorithm::SetPipelinedEvaluation(bool pipelined_evaluation) {
+  pipelined_evaluation_ = pipelined_evaluation;
+}
+
+bool GeneticAlgorithm::GetPipelinedEvaluation() const {
+  return pipelined_evaluation_;
+}
+
+void GeneticAlgorithm::SetReproductionBackend(
+    ReproductionBackend* reproduction_backend) {
+  reproduction_backend_ = reproduction_backend;
+  for (auto& population : populations_) {
+    population.SetReproductionBackend(reproduction_backend_);
+  }
+}
+
+ReproductionBackend* GeneticAlgorithm::GetReproductionBackend() const {
+  return reproduction_backend_;
+}
+
+void GeneticAlgorithm::SetScreeningCandidateCount(
+    size_t screening_candidate_count) {
+  assert(screening_candidate_count != 0);
+  screening_candidate_count_ = screening_candidate_count;
+}
+
+size_t GeneticAlgorithm::GetScreeningCandidateCount() const {
+  return screening_candidate_count_;
+}
+
+void GeneticAlgorithm::SetSurrogateFunction(
+    SurrogateFunction surrogate_function) {
+  surrogate_function_ = surrogate_function;
+}
+
+SurrogateFunction GeneticAlgorithm::GetSurrogateFunction() const {
+  return surrogate_function_;
+}
+
+void GeneticAlgorithm::SetSurrogateArchiveCapacity(size_t capacity) {
+  if (capacity == 0) {
+    surrogate_archive_.reset();
+  } else {
+    surrogate_archive_ = std::make_unique<NearestNeighborSurrogate>(capacity);
+  }
+}
+
+size_t GeneticAlgorithm::GetSurrogateArchiveCapacity() const {
+  return surrogate_archive_ ? surrogate_archive_->GetCapacity() : 0;
+}
+
+const NearestNeighborSurrogate* GeneticAlgorithm::GetSurrogateArchive() const {
+  return surrogate_archive_.get();
+}
+
+size_t GeneticAlgorithm::GetScreenedOffspringCount() const {
+  return screened_offspring_count_;
+}
+
+void GeneticAlgorithm::SetMaxInFlightBatches(size_t max_in_flight_batches) {
+  assert(max_in_flight_batches != 0);
+  max_in_flight_batches_ = max_in_flight_batches;
+}
+
+size_t GeneticAlgorithm::GetMaxInFlightBatches() const {
+  return max_in_flight_batches_;
+}
+
+void GeneticAlgorithm::SetDeltaFitnessFunction(
+    DeltaFitnessFunction delta_fitness_function) {
+  delta_fitness_function_ = delta_fitness_function;
+  for (auto& population : populations_) {
+    population.SetDeltaFitnessFunction(delta_fitness_function);
+  }
+}
+
+DeltaFitnessFunction GeneticAlgorithm::GetDeltaFitnessFunction() const {
+  return delta_fitness_function_;
+}
+
+void GeneticAlgorithm::SetFitnessCacheCapacity(size_t capacity) {
+  if (capacity == 0) {
+    fitness_cache_.reset();
+  } else {
+    fitness_cache_ = std::make_unique<FitnessCache>(capacity);
+  }
+}
+
+size_t GeneticAlgorithm::GetFitnessCacheCapacity() const {
+  return fitness_cache_ ? fitness_cache_->GetCapacity() : 0;
+}
+
+const FitnessCache* GeneticAlgorithm::GetFitnessCache() const {
+  return fitness_cache_.get();
+}
+
 size_t GeneticAlgorithm::GetEliteCount() const { return elite_count_; }
 
 void GeneticAlgorithm::SetEliteCount(size_t elite_count) {
@@ -134,10 +309,68 @@ bool GeneticAlgorithm::GetAllowSameParentCouples() const {
   return allow_same_parent_couples_;
 }
 
+void GeneticAlgorithm::SetThreadCount(size_t thread_count) {
+  // A single thread doesn't need a pool at all, we just score on the thread
+  // calling Step.
+  if (thread_count == 1U) {
+    owned_thread_pool_.reset();
+  } else {
+    owned_thread_pool_ = std::make_unique<ThreadPool>(thread_count);
+  }
+  SetThreadPoolInternal(owned_thread_pool_.get());
+}
+
+size_t GeneticAlgorithm::GetThreadCount() const {
+  return thread_pool_ != nullptr ? thread_pool_->GetThreadCount() : 1U;
+}
+
+void GeneticAlgorithm::SetThreadPool(ThreadPool* thread_pool) {
+  SetThreadPoolInternal(thread_pool);
+  owned_thread_pool_.reset();
+}
+
+void GeneticAlgorithm::SetThreadPoolInternal(ThreadPool* thread_pool) {
+  thread_pool_ = thread_pool;
+  // Storage reserved from now on is first touched by the workers which will
+  // build and score the Individuals living in it.
+  for (auto& population : populations_) {
+    population.SetFirstTouchThreadPool(thread_pool_);
+  }
+}
+
+ThreadPool* GeneticAlgorithm::GetThreadPool() const { return thread_pool_; }
+
+void GeneticAlgorithm::SetEvaluationChunkSize(size_t evaluation_chunk_size) {
+  evaluation_chunk_size_ = evaluation_chunk_size;
+}
+
+size_t GeneticAlgorithm::GetEvaluationChunkSize() const {
+  return evaluation_chunk_size_;
+}
+
+void GeneticAlgorithm::SetRandomSeed(uint64_t random_seed) {
+  random_.SetSeed(random_seed);
+}
+
+uint64_t GeneticAlgorithm::GetRandomSeed() { return random_.GetSeed(); }
+
 size_t GeneticAlgorithm::GetCurrentGeneration() const {
   return current_generation_;
 }
 
+size_t GeneticAlgorithm::GetEvaluationCount() const {
+  return evaluation_count_;
+}
+
+void GeneticAlgorithm::SetStepStatsCallback(
+    StepStatsCallback step_stats_callback) {
+  step_stats_callback_ = std::move(step_stats_callback);
+}
+
+const StepStats& GeneticAlgorithm::GetLastStepStats() const {
+  return step_stats_;
+}
+
 void GeneticAlgorithm::SetTournamentSize(size_t tournament_size) {
   tournament_size_ = tournament_size;
 }
@@ -173,6 +406,16 @@ double GeneticAlgorithm::GetSelfAdaptiveMutationAggressiveRate() const {
   return self_adaptive_mutation_aggressive_rate_;
 }
 
+void GeneticAlgorithm::SetSelfAdaptiveMutationDiversitySampleSize(
+    size_t self_adaptive_mutation_diversity_sample_size) {
+  self_adaptive_mutation_diversity_sample_size_ =
+      self_adaptive_mutation_diversity_sample_size;
+}
+
+size_t GeneticAlgorithm::GetSelfAdaptiveMutationDiversitySampleSize() const {
+  return self_adaptive_mutation_diversity_sample_size_;
+}
+
 void GeneticAlgorithm::SetProportionalMutationBitCount(
     size_t proportional_mutation_bit_count) {
   proportional_mutation_bit_count_ = proportional_mutation_bit_count;
@@ -191,18 +434,274 @@ void GeneticAlgorithm::SetInitialPopulation(
   population.Initialize(initial_population);
 }
 
+void GeneticAlgorithm::SetInitialPopulation(const std::byte* chromosomes,
+                                            size_t chromosome_stride,
+                                            size_t count) {
+  auto& population = GetCurrentPopulation();
+  population.Initialize(chromosomes, chromosome_stride, count);
+}
+
+void GeneticAlgorithm::SetInitialPopulation(
+    size_t count, const ChromosomeInitializer& initializer) {
+  auto& population = GetCurrentPopulation();
+  population.Initialize(count, initializer);
+}
+
+bool GeneticAlgorithm::Save(const char* path) {
+  std::ofstream file(path, std::ios::binary | std::ios::trunc);
+  if (!file) {
+    return false;
+  }
+  return Save(&file);
+}
+
+bool GeneticAlgorithm::Save(std::ostream* stream) {
+  stream->write(CheckpointMagic, sizeof(CheckpointMagic));
+  WriteBinary(stream, CheckpointVersion);
+  WriteBinary(stream, CheckpointByteOrderMark);
+  genome_.Save(stream);
+
+  WriteBinary(stream, random_.GetSeed());
+  WriteSize(stream, current_generation_);
+  WriteSize(stream, evaluation_count_);
+  WriteSize(stream, steady_state_offspring_count_);
+  WriteFlag(stream, is_initial_population_evaluated_);
+
+  WriteSize(stream, population_size_);
+  WriteSize(stream, total_generations_);
+  WriteSize(stream, elite_count_);
+  WriteSize(stream, mutated_elite_count_);
+  WriteBinary(stream, mutation_rate_);
+  WriteBinary(stream, crossover_rate_);
+  WriteBinary(stream, mutated_elite_mutation_rate_);
+  WriteSize(stream, tournament_size_);
+  WriteSize(stream, k_point_crossover_point_count_);
+  WriteBinary(stream, self_adaptive_mutation_diversity_floor_);
+  WriteBinary(stream, self_adaptive_mutation_aggressive_rate_);
+  WriteSize(stream, self_adaptive_mutation_diversity_sample_size_);
+  WriteSize(stream, proportional_mutation_bit_count_);
+  WriteSize(stream, evaluation_chunk_size_);
+  WriteSize(stream, GetFitnessCacheCapacity());
+  WriteEnum(stream, crossover_type_);
+  WriteEnum(stream, mutator_type_);
+  WriteEnum(stream, selector_type_);
+  WriteEnum(stream, mutation_rate_schedule_);
+  WriteFlag(stream, crossover_ignore_gene_boundaries_);
+  WriteFlag(stream, allow_same_parent_couples_);
+  WriteSize(stream, screening_candidate_count_);
+  WriteSize(stream, screened_offspring_count_);
+  WriteSize(stream, GetSurrogateArchiveCapacity());
+  if (surrogate_archive_) {
+    surrogate_archive_->Save(stream);
+  }
+
+  for (const auto& population : populations_) {
+    population.Save(stream);
+  }
+  stream->flush();
+  return stream->good();
+}
+
+bool GeneticAlgorithm::Load(const char* path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  return Load(&file);
+}
+
+bool GeneticAlgorithm::Load(std::istream* stream) {
+  char magic[sizeof(CheckpointMagic)] = {};
+  uint32_t version = 0;
+  uint32_t byte_order_mark = 0;
+  stream->read(magic, sizeof(magic));
+  if (!ReadBinary(stream, &version) || !ReadBinary(stream, &byte_order_mark) ||
+      std::memcmp(magic, CheckpointMagic, sizeof(magic)) != 0 ||
+      version != CheckpointVersion ||
+      byte_order_mark != CheckpointByteOrderMark) {
+    return false;
+  }
+  Genome genome;
+  if (!genome.Load(stream)) {
+    return false;
+  }
+
+  const bool is_genome_empty =
+      genome_.GetGeneCount() == 0 && !genome_.IsFrozen();
+  if (!is_genome_empty) {
+    if (!HasSameGenes(genome_, genome) || !LoadState(stream)) {
+      return false;
+    }
+    genome_.Freeze();
+    return true;
+  }
+
+  // The populations are read against our own genome so it takes on the
+  // stored genes now and goes back to being empty if the rest fails.
+  genome_ = std::move(genome);
+  if (!LoadState(stream)) {
+    genome_ = Genome();
+    return false;
+  }
+  return true;
+}
+
+bool GeneticAlgorithm::LoadState(std::istream* stream) {
+  uint64_t seed = 0;
+  size_t current_generation = 0;
+  size_t evaluation_count = 0;
+  size_t steady_state_offspring_count = 0;
+  bool is_initial_population_evaluated = false;
+  size_t population_size = 0;
+  size_t total_generations = 0;
+  size_t elite_count = 0;
+  size_t mutated_elite_count = 0;
+  double mutation_rate = 0.0;
+  double crossover_rate = 0.0;
+  double mutated_elite_mutation_rate = 0.0;
+  size_t tournament_size = 0;
+  size_t k_point_crossover_point_count = 0;
+  double self_adaptive_mutation_diversity_floor = 0.0;
+  double self_adaptive_mutation_aggressive_rate = 0.0;
+  size_t self_adaptive_mutation_diversity_sample_size = 0;
+  size_t proportional_mutation_bit_count = 0;
+  size_t evaluation_chunk_size = 0;
+  size_t fitness_cache_capacity = 0;
+  CrossoverType crossover_type = CrossoverType::OnePoint;
+  MutatorType mutator_type = MutatorType::Flip;
+  SelectorType selector_type = SelectorType::Rank;
+  MutationRateSchedule mutation_rate_schedule = MutationRateSchedule::Constant;
+  bool crossover_ignore_gene_boundaries = false;
+  bool allow_same_parent_couples = false;
+  size_t screening_candidate_count = 0;
+  size_t screened_offspring_count = 0;
+  size_t surrogate_archive_capacity = 0;
+  const bool is_read =
+      ReadBinary(stream, &seed) && ReadSize(stream, &current_generation) &&
+      ReadSize(stream, &evaluation_count) &&
+      ReadSize(stream, &steady_state_offspring_count) &&
+      ReadFlag(stream, &is_initial_population_evaluated) &&
+      ReadSize(stream, &population_size) &&
+      ReadSize(stream, &total_generations) &&
+      ReadSize(stream, &elite_count) &&
+      ReadSize(stream, &mutated_elite_count) &&
+      ReadBinary(stream, &mutation_rate) &&
+      ReadBinary(stream, &crossover_rate) &&
+      ReadBinary(stream, &mutated_elite_mutation_rate) &&
+      ReadSize(stream, &tournament_size) &&
+      ReadSize(stream, &k_point_crossover_point_count) &&
+      ReadBinary(stream, &self_adaptive_mutation_diversity_floor) &&
+      ReadBinary(stream, &self_adaptive_mutation_aggressive_rate) &&
+      ReadSize(stream, &self_adaptive_mutation_diversity_sample_size) &&
+      ReadSize(stream, &proportional_mutation_bit_count) &&
+      ReadSize(stream, &evaluation_chunk_size) &&
+      ReadSize(stream, &fitness_cache_capacity) &&
+      ReadEnum(stream, CrossoverType::OnePoint,
+               CrossoverType::SimulatedBinary, &crossover_type) &&
+      ReadEnum(stream, MutatorType::Flip, MutatorType::Polynomial,
+               &mutator_type) &&
+      ReadEnum(stream, SelectorType::Rank,
+               SelectorType::StochasticUniversalSampling, &selector_type) &&
+      ReadEnum(stream, MutationRateSchedule::Constant,
+               MutationRateSchedule::Proportional, &mutation_rate_schedule) &&
+      ReadFlag(stream, &crossover_ignore_gene_boundaries) &&
+      ReadFlag(stream, &allow_same_parent_couples) &&
+      ReadSize(stream, &screening_candidate_count) &&
+      ReadSize(stream, &screened_offspring_count) &&
+      ReadSize(stream, &surrogate_archive_capacity);
+  if (!is_read || screening_candidate_count == 0 ||
+      elite_count > population_size ||
+      mutated_elite_count > population_size - elite_count ||
+      tournament_size > population_size) {
+    return false;
+  }
+
+  std::unique_ptr<NearestNeighborSurrogate> surrogate_archive;
+  if (surrogate_archive_capacity != 0) {
+    surrogate_archive =
+        std::make_unique<NearestNeighborSurrogate>(surrogate_archive_capacity);
+    if (!surrogate_archive->Load(stream, genome_.BitsRequired())) {
+      return false;
+    }
+  }
+
+  std::vector<Population> populations;
+  populations.reserve(populations_.size());
+  for (size_t i = 0; i < populations_.size(); i++) {
+    auto& population = populations.emplace_back(genome_);
+    population.SetFirstTouchThreadPool(thread_pool_);
+    population.SetReproductionBackend(reproduction_backend_);
+    population.SetDeltaFitnessFunction(delta_fitness_function_);
+    // Populations are only empty if the checkpoint was saved before the
+    // first one was created.
+    if (!population.Load(stream, population_size) ||
+        (population.Size() != 0 && population.Size() != population_size)) {
+      return false;
+    }
+  }
+
+  // Everything was read so nothing below can fail.
+  random_.SetSeed(seed);
+  current_generation_ = current_generation;
+  evaluation_count_ = evaluation_count;
+  steady_state_offspring_count_ = steady_state_offspring_count;
+  is_initial_population_evaluated_ = is_initial_population_evaluated;
+  population_size_ = population_size;
+  total_generations_ = total_generations;
+  elite_count_ = elite_count;
+  mutated_elite_count_ = mutated_elite_count;
+  mutation_rate_ = mutation_rate;
+  crossover_rate_ = crossover_rate;
+  mutated_elite_mutation_rate_ = mutated_elite_mutation_rate;
+  tournament_size_ = tournament_size;
+  k_point_crossover_point_count_ = k_point_crossover_point_count;
+  self_adaptive_mutation_diversity_floor_ =
+      self_adaptive_mutation_diversity_floor;
+  self_adaptive_mutation_aggressive_rate_ =
+      self_adaptive_mutation_aggressive_rate;
+  self_adaptive_mutation_diversity_sample_size_ =
+      self_adaptive_mutation_diversity_sample_size;
+  proportional_mutation_bit_count_ = proportional_mutation_bit_count;
+  evaluation_chunk_size_ = evaluation_chunk_size;
+  crossover_type_ = crossover_type;
+  mutator_type_ = mutator_type;
+  selector_type_ = selector_type;
+  mutation_rate_schedule_ = mutation_rate_schedule;
+  crossover_ignore_gene_boundaries_ = crossover_ignore_gene_boundaries;
+  allow_same_parent_couples_ = allow_same_parent_couples;
+  screening_candidate_count_ = screening_candidate_count;
+  screened_offspring_count_ = screened_offspring_count;
+  SetFitnessCacheCapacity(fitness_cache_capacity);
+  surrogate_archive_ = std::move(surrogate_archive);
+  populations_.swap(populations);
+  steady_state_offspring_.clear();
+  clone_mutation_masks_.clear();
+  return true;
+}
+
 void GeneticAlgorithm::Initialize() {
   // Reset the current generation.
   current_generation_ = 0;
+  evaluation_count_ = 0;
+  steady_state_offspring_count_ = 0;
+  screened_offspring_count_ = 0;
+  if (surrogate_archive_) {
+    surrogate_archive_->Clear();
+  }
+
+  // No more genes can be added once we build the population so lock in the
+  // gene layout for faster decoding.
+  genome_.Freeze();
 
   // If the population isn't full, this will fill it up with random individuals.
   auto& population = GetCurrentPopulation();
   population.Resize(population_size_, &random_);
 
   // The last generation population needs to have the same number of individuals
-  // in it but all random ones will do.
+  // in it but Step overwrites every one of them before they're read, so don't
+  // spend any time randomizing them.
   auto& last_generation_population = GetLastGenerationPopulation();
-  last_generation_population.Resize(population_size_, &random_);
+  last_generation_population.Resize(population_size_, nullptr);
 
   // Reset the flag to track if we have already evaluated the initial
   // population.
@@ -231,73 +730,444 @@ const Population& GeneticAlgorithm::GetPopulation() const {
 }
 
 void GeneticAlgorithm::Step() {
+  if constexpr (IsInstrumentationEnabled) {
+    step_stats_ = StepStats();
+    step_stats_.start_nanoseconds = InstrumentationNow();
+  }
+
   // If we're on any generation other than the 0th one, we need to build the
   // current population based on the previous generation.
   if (is_initial_population_evaluated_) {
-    current_generation_++;
-    auto& current_population = GetCurrentPopulation();
-    auto& last_generation_population = GetLastGenerationPopulation();
-
-    // Elitism
-    // Add the best individuals from last generation into the current
-    // population. Note: last_generation_population must already be sorted with
-    // best individuals at the front.
-    for (size_t i = 0; i < elite_count_; i++) {
-      // Overwrite the first i members of population with those from last
-      // generation.
-      const auto& elite = last_generation_population.GetIndividual(i);
-      current_population.Replace(i, elite);
-    }
-
-    // Mutated elitism
-    // Take the best individuals from the last generation but mutate them by a
-    // variable rate.
-    for (size_t i = 0; i < mutated_elite_count_; i++) {
-      const auto& elite = last_generation_population.GetIndividual(i);
-      const size_t index = elite_count_ + i;
-      current_population.Replace(index, elite);
-      auto& mutated_elite = current_population.GetIndividualWritable(index);
-      Mutate(&mutated_elite, mutated_elite_mutation_rate_);
-    }
-
-    // Get the mutation rate for the current generation.
-    // Note: This can depend on the previous population already having been
-    // evaluated.
-    const double current_mutation_rate = GetCurrentMutationRate();
-    // We already added elite_count_ + mutated_elite_count_ individuals based on
-    // the last generation.
-    size_t current_population_size = elite_count_ + mutated_elite_count_;
-    // Initialize the selector.
-    InitializeSelector(&last_generation_population);
-    // Create offspring from individuals in last generation.
-    while (current_population_size < population_size_) {
-      auto& offspring =
-          current_population.GetIndividualWritable(current_population_size++);
-
-      // Select a couple from the last generation.
-      const auto parents = SelectParents(last_generation_population);
-
-      // See if we will do crossover or duplicate a parent.
-      if (random_.CoinFlip(crossover_rate_)) {
-        Crossover(parents.first, parents.second, &offspring);
+    GenerationContext context;
+    BeginGeneration(&context);
+
+    uint64_t phase_begin = InstrumentationNow();
+    CreateOffspringGeneration(&context);
+    if (context.use_backend) {
+      ApplyBackendReproduction(&context);
+    }
+    RecordPhase(&step_stats_, StepPhase::Offspring, phase_begin);
+
+    phase_begin = InstrumentationNow();
+    const size_t copy_count = SwapCloneStorage(&context);
+    RecordPhase(&step_stats_, StepPhase::Elitism, phase_begin);
+
+    if constexpr (IsInstrumentationEnabled) {
+      step_stats_.selection_nanoseconds = context.selection_nanoseconds;
+      step_stats_.crossover_nanoseconds = context.crossover_nanoseconds;
+      step_stats_.mutation_nanoseconds = context.mutation_nanoseconds;
+      step_stats_.random_draw_count = context.random_draw_count;
+      step_stats_.chromosome_copy_count = copy_count;
+      step_stats_.bytes_copied =
+          copy_count * BitVector::BytesRequired(genome_.BitsRequired());
+    }
+  }
+
+  EvaluateCurrentPopulation();
+
+  if (current_generation_ == 0) {
+    is_initial_population_evaluated_ = true;
+  }
+
+  if constexpr (IsInstrumentationEnabled) {
+    step_stats_.generation = current_generation_;
+    if (step_stats_callback_) {
+      step_stats_callback_(step_stats_);
+    }
+  }
+}
+
+void GeneticAlgorithm::BeginGeneration(GenerationContext* context) {
+  current_generation_++;
+  const uint64_t phase_begin = InstrumentationNow();
+  auto& current_population = GetCurrentPopulation();
+  auto& last_generation_population = GetLastGenerationPopulation();
+  context->current_population = &current_population;
+  context->last_generation_population = &last_generation_population;
+  // Every worker writes individuals of the current population so drop its
+  // statistics up front rather than from each of them.
+  current_population.InvalidateStats();
+
+  // Every individual we construct for this generation draws random values
+  // from its own stream derived from the seed and the generation. This way
+  // the result doesn't depend on how the work is split between threads.
+  context->generation_seed =
+      RandomWrapper::DeriveSeed(random_.GetSeed(), current_generation_);
+
+  // Individuals which are exact copies of one from the last generation -
+  // elites, mutated elites, and offspring which duplicate a parent - are
+  // cloned after every other offspring has been created so they can take
+  // over the storage of the original instead of copying it.
+  // Note: last_generation_population must already be sorted with best
+  // individuals at the front.
+  context->first_offspring_index = elite_count_ + mutated_elite_count_;
+  clone_sources_.assign(population_size_, NotCloned);
+  for (size_t i = 0; i < elite_count_; i++) {
+    clone_sources_[i] = last_generation_population.GetStorageIndex(
+        last_generation_population.GetIndividual(i));
+  }
+  // Mutated elitism
+  // Take the best individuals from the last generation but mutate them by a
+  // variable rate.
+  for (size_t i = 0; i < mutated_elite_count_; i++) {
+    clone_sources_[elite_count_ + i] =
+        last_generation_population.GetStorageIndex(
+            last_generation_population.GetIndividual(i));
+  }
+
+  // Get the mutation rate for the current generation.
+  // Note: This can depend on the previous population already having been
+  // evaluated.
+  context->mutation_rate = GetCurrentMutationRate();
+  // Initialize the selector.
+  context->offspring_count =
+      population_size_ > context->first_offspring_index
+          ? population_size_ - context->first_offspring_index
+          : 0;
+  InitializeSelector(&last_generation_population, context->offspring_count,
+                     context->generation_seed);
+  RecordPhase(&step_stats_, StepPhase::InitializeSelector, phase_begin);
+
+  // Batch fitness functions always score whole chromosomes so only track
+  // the changed genes when they'll be used.
+  context->track_gene_deltas = delta_fitness_function_ != nullptr &&
+                               !batch_fitness_function_ &&
+                               !async_fitness_function_;
+  if (context->track_gene_deltas) {
+    current_population.ClearGeneDeltas();
+    const size_t worker_count = GetThreadCount();
+    while (clone_mutation_masks_.size() < worker_count) {
+      clone_mutation_masks_.emplace_back(genome_);
+    }
+  }
+
+  // In pipelined mode, offspring and mutated clones are scored as soon as
+  // they're built by the same worker which built them. The fitness cache
+  // is looked up serially so it would miss every one of them.
+  context->score_early = pipelined_evaluation_ && !batch_fitness_function_ &&
+                         !async_fitness_function_ && !fitness_cache_;
+  if (context->score_early) {
+    current_population.BeginEarlyScoring();
+  }
+
+  // With a reproduction backend, the couples are only recorded here and
+  // every offspring is built in one batch afterwards.
+  context->use_backend =
+      reproduction_backend_ != nullptr && CanUseReproductionBackend();
+  if (context->use_backend) {
+    backend_parents_.assign(context->offspring_count, {nullptr, nullptr});
+  }
+
+  // While screening, every offspring is picked from several candidates.
+  // Each worker builds the candidates after the first in scratch storage.
+  context->is_screening = !context->use_backend && IsScreeningEnabled();
+  context->candidate_count =
+      context->is_screening ? screening_candidate_count_ : 1U;
+  if (context->is_screening) {
+    const size_t worker_count = GetThreadCount();
+    while (screening_candidates_.size() < worker_count) {
+      screening_candidates_.emplace_back(genome_);
+    }
+  }
+}
+
+void GeneticAlgorithm::CreateOffspringGeneration(GenerationContext* context) {
+  // Create offspring from individuals in last generation.
+  ParallelFor(context->offspring_count, [&](size_t begin, size_t end) {
+    OffspringCounters counters;
+    for (size_t i = begin; i < end; i++) {
+      ScreenOffspring(*context, i, &counters);
+    }
+    context->screened_offspring_count += counters.screened_offspring_count;
+    if constexpr (IsInstrumentationEnabled) {
+      context->selection_nanoseconds += counters.selection_nanoseconds;
+      context->crossover_nanoseconds += counters.crossover_nanoseconds;
+      context->mutation_nanoseconds += counters.mutation_nanoseconds;
+      context->random_draw_count += counters.random_draw_count;
+    }
+  });
+  screened_offspring_count_ += context->screened_offspring_count;
+  if constexpr (IsInstrumentationEnabled) {
+    step_stats_.screened_offspring_count = context->screened_offspring_count;
+  }
+}
+
+void GeneticAlgorithm::ScreenOffspring(const GenerationContext& context,
+                                       size_t offspring_number,
+                                       OffspringCounters* counters) {
+  auto& current_population = *context.current_population;
+  const auto& last_generation_population = *context.last_generation_population;
+  const size_t index = context.first_offspring_index + offspring_number;
+  const uint64_t seed =
+      RandomWrapper::DeriveSeed(context.generation_seed, index);
+  auto& offspring = current_population.GetIndividualWritable(index);
+
+  // The first candidate is built in place. If a later one is estimated to be
+  // better, it's copied over the offspring.
+  const Individual* primary_parent = nullptr;
+  size_t clone_source = NotCloned;
+  double best_estimate = 0.0;
+  for (size_t candidate = 0; candidate < context.candidate_count;
+       candidate++) {
+    const uint64_t candidate_seed =
+        candidate == 0
+            ? seed
+            : RandomWrapper::DeriveSeed(
+                  RandomWrapper::DeriveSeed(seed, ScreeningStream), candidate);
+    RandomWrapper random(candidate_seed);
+
+    // Select a couple from the last generation. Only the first candidate
+    // gets the couple a selector may have sampled up front.
+    const uint64_t selection_begin = InstrumentationNow();
+    const auto parents =
+        candidate == 0
+            ? SelectParents(last_generation_population, &random,
+                            offspring_number)
+            : SelectCouple(last_generation_population, &random);
+    const uint64_t selection_end = InstrumentationNow();
+    counters->selection_nanoseconds += selection_end - selection_begin;
+
+    // See if we will do crossover or duplicate a parent.
+    const bool is_crossover = random.CoinFlip(crossover_rate_);
+    if (is_crossover && context.use_backend) {
+      // Built along with the rest of the batch once every couple has been
+      // selected.
+      backend_parents_[offspring_number] = {&parents.first, &parents.second};
+      counters->random_draw_count += random.GetDrawCount();
+      continue;
+    }
+
+    Individual* target = &offspring;
+    if (candidate != 0 && is_crossover) {
+      const size_t worker_index =
+          thread_pool_ != nullptr ? ThreadPool::GetCurrentWorkerIndex() : 0;
+      assert(worker_index < screening_candidates_.size());
+      target = &screening_candidates_[worker_index];
+    }
+    if (is_crossover) {
+      Crossover(parents.first, parents.second, target, &random);
+      const uint64_t crossover_end = InstrumentationNow();
+      counters->crossover_nanoseconds += crossover_end - selection_end;
+
+      // Mutate offspring.
+      RandomWrapper mutation_random(
+          RandomWrapper::DeriveSeed(candidate_seed, MutationStream));
+      Mutate(target, context.mutation_rate, &mutation_random);
+      counters->mutation_nanoseconds += InstrumentationNow() - crossover_end;
+      counters->random_draw_count += mutation_random.GetDrawCount();
+    }
+    counters->random_draw_count += random.GetDrawCount();
+
+    // Keep the first candidate unless a later one looks better.
+    if (context.is_screening) {
+      const double estimate =
+          is_crossover ? EstimateScore(*target) : parents.first.GetScore();
+      if (candidate != 0 && !(estimate < best_estimate)) {
+        if (is_crossover) {
+          counters->screened_offspring_count++;
+        }
+        continue;
+      }
+      if (candidate != 0 && primary_parent != nullptr) {
+        counters->screened_offspring_count++;
+      }
+      best_estimate = estimate;
+      if (target != &offspring) {
+        offspring = *target;
+      }
+    }
+    if (is_crossover) {
+      primary_parent = &parents.first;
+      clone_source = NotCloned;
+    } else {
+      // TODO(boingoing): Should we flip an even coin here to decide which
+      // parent to duplicate?
+      primary_parent = nullptr;
+      clone_source = last_generation_population.GetStorageIndex(parents.first);
+    }
+  }
+
+  clone_sources_[index] = clone_source;
+  if (primary_parent != nullptr) {
+    // The parents aren't touched until every offspring is built.
+    if (context.track_gene_deltas) {
+      current_population.RecordPrimaryParent(index, *primary_parent);
+    }
+    if (context.score_early) {
+      current_population.ScoreEarly(index, fitness_function_, user_data_);
+    }
+  }
+}
+
+void GeneticAlgorithm::ApplyBackendReproduction(GenerationContext* context) {
+  auto& current_population = *context->current_population;
+  const uint64_t batch_begin = InstrumentationNow();
+  CreateBackendOffspring(&current_population, context->first_offspring_index,
+                         context->generation_seed, context->mutation_rate);
+  context->crossover_nanoseconds += InstrumentationNow() - batch_begin;
+
+  // The parents aren't touched until every offspring is built.
+  ParallelFor(backend_offspring_indices_.size(), [&](size_t begin,
+                                                     size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const size_t index = backend_offspring_indices_[i];
+      current_population.GetIndividualWritable(index).SetDirty(true);
+      if (context->track_gene_deltas) {
+        current_population.RecordPrimaryParent(
+            index,
+            *backend_parents_[index - context->first_offspring_index].first);
+      }
+      if (context->score_early) {
+        current_population.ScoreEarly(index, fitness_function_, user_data_);
+      }
+    }
+  });
+}
+
+size_t GeneticAlgorithm::SwapCloneStorage(GenerationContext* context) {
+  auto& current_population = *context->current_population;
+  auto& last_generation_population = *context->last_generation_population;
+
+  // Each individual in the last generation can hand its storage over to one
+  // clone. Every other clone of the same individual has to copy it.
+  clone_takes_storage_.assign(population_size_, false);
+  is_clone_source_taken_.assign(last_generation_population.Size(), false);
+  size_t copy_count = 0;
+  for (size_t i = 0; i < population_size_; i++) {
+    const size_t source = clone_sources_[i];
+    if (source != NotCloned) {
+      if (!is_clone_source_taken_[source]) {
+        is_clone_source_taken_[source] = true;
+        clone_takes_storage_[i] = true;
       } else {
-        // TODO(boingoing): Should we flip an even coin here to decide which
-        // parent to duplicate?
-        offspring = parents.first;
+        copy_count++;
       }
+    }
+  }
 
-      // Mutate offspring.
-      Mutate(&offspring, current_mutation_rate);
+  // Make the copies first while every source still holds its bits. The last
+  // generation is about to be overwritten so its statistics are dropped up
+  // front rather than from each worker reading it.
+  last_generation_population.InvalidateStats();
+  ParallelFor(population_size_, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (clone_sources_[i] != NotCloned && !clone_takes_storage_[i]) {
+        current_population.GetIndividualWritable(i) =
+            last_generation_population.GetIndividualWritable(
+                clone_sources_[i]);
+        MutateClone(context, i);
+      }
+    }
+  });
+
+  // Then trade storage with the last generation which is about to be
+  // overwritten anyway. Mutation only writes the bits it flips.
+  for (size_t i = 0; i < population_size_; i++) {
+    if (clone_takes_storage_[i]) {
+      current_population.Swap(i, &last_generation_population,
+                              clone_sources_[i]);
     }
   }
+  ParallelFor(population_size_, [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (clone_takes_storage_[i]) {
+        MutateClone(context, i);
+      }
+    }
+  });
+  return copy_count;
+}
 
+void GeneticAlgorithm::MutateClone(GenerationContext* context, size_t index) {
+  // Clones are mutated after they've been created - except for the elites.
+  if (index < elite_count_) {
+    return;
+  }
+  auto& current_population = *context->current_population;
+  const double mutation_rate = index < context->first_offspring_index
+                                   ? mutated_elite_mutation_rate_
+                                   : context->mutation_rate;
+  RandomWrapper mutation_random(RandomWrapper::DeriveSeed(
+      RandomWrapper::DeriveSeed(context->generation_seed, index),
+      MutationStream));
+  auto& clone = current_population.GetIndividualWritable(index);
+  if (context->track_gene_deltas) {
+    // The source of a clone may have handed its storage over so we can't
+    // compare against it. Mutate a blank mask instead and flip the same bits
+    // in the clone. The bit mutators draw the same random values no matter
+    // what the bits are so the result doesn't change. Value mutators depend
+    // on the values so they mutate a copy of the clone which is then turned
+    // into the mask of the bits which changed.
+    const size_t worker_index =
+        thread_pool_ != nullptr ? ThreadPool::GetCurrentWorkerIndex() : 0;
+    assert(worker_index < clone_mutation_masks_.size());
+    auto& flipped_bits = clone_mutation_masks_[worker_index];
+    const bool is_value_mutator = mutator_type_ == MutatorType::Gaussian ||
+                                  mutator_type_ == MutatorType::Polynomial;
+    if (is_value_mutator) {
+      static_cast<BitVector&>(flipped_bits) = clone;
+    } else {
+      flipped_bits.Clear();
+    }
+    flipped_bits.SetDirty(false);
+    Mutate(&flipped_bits, mutation_rate, &mutation_random);
+    if (is_value_mutator) {
+      flipped_bits.FlipBits(clone);
+    }
+    if (flipped_bits.IsDirty()) {
+      clone.FlipBits(flipped_bits);
+      clone.SetDirty(true);
+      current_population.RecordFlippedBits(index, clone.GetScore(),
+                                           flipped_bits);
+    }
+  } else {
+    Mutate(&clone, mutation_rate, &mutation_random);
+  }
+  if (context->score_early && clone.IsDirty()) {
+    current_population.ScoreEarly(index, fitness_function_, user_data_);
+  }
+  if constexpr (IsInstrumentationEnabled) {
+    context->random_draw_count += mutation_random.GetDrawCount();
+  }
+}
+
+void GeneticAlgorithm::EvaluateCurrentPopulation() {
   // Score and sort the current population.
   // This population is either the result of Initialize() or a Step() operation.
   auto& current_population = GetCurrentPopulation();
-  current_population.Evaluate(fitness_function_, user_data_);
-
-  if (current_generation_ == 0) {
-    is_initial_population_evaluated_ = true;
+  current_population.SetRankedCount(GetRequiredRankCount());
+  StepStats* step_stats = IsInstrumentationEnabled ? &step_stats_ : nullptr;
+  // New offspring which reach the fitness function go into the surrogate
+  // archive.
+  if (surrogate_archive_) {
+    is_archive_candidate_.resize(current_population.Size());
+    for (size_t i = 0; i < current_population.Size(); i++) {
+      is_archive_candidate_[i] =
+          current_population.GetIndividualWritable(i).IsDirty() ? 1 : 0;
+    }
+  }
+  if (async_fitness_function_) {
+    current_population.Evaluate(async_fitness_function_,
+                                evaluation_chunk_size_, max_in_flight_batches_,
+                                fitness_cache_.get(), step_stats);
+  } else if (batch_fitness_function_) {
+    current_population.Evaluate(batch_fitness_function_, thread_pool_,
+                                evaluation_chunk_size_, fitness_cache_.get(),
+                                step_stats);
+  } else {
+    current_population.Evaluate(fitness_function_, user_data_, thread_pool_,
+                                evaluation_chunk_size_, fitness_cache_.get(),
+                                step_stats);
+  }
+  evaluation_count_ += current_population.Size();
+  if (surrogate_archive_) {
+    for (const size_t index : current_population.GetEvaluatedIndices()) {
+      if (is_archive_candidate_[index] != 0) {
+        const auto& individual =
+            current_population.GetIndividualWritable(index);
+        surrogate_archive_->Add(individual, individual.GetScore());
+      }
+    }
   }
 }
 
@@ -307,6 +1177,106 @@ void GeneticAlgorithm::Run() {
   }
 }
 
+void GeneticAlgorithm::RunSteadyState(size_t evaluation_count) {
+  // Offspring can only replace individuals which have been scored.
+  if (!is_initial_population_evaluated_) {
+    Step();
+  }
+
+  // The population tracks the worst individual itself until the run is
+  // over. Then it's sorted in full.
+  auto& population = GetCurrentPopulation();
+  population.SetRankedCount(0);
+  population.BeginSteadyState();
+
+  const double mutation_rate = GetCurrentMutationRate();
+  // Each offspring draws from a stream of its own identified by the number
+  // of offspring before it, so consecutive runs never repeat a stream.
+  const uint64_t steady_state_seed =
+      RandomWrapper::DeriveSeed(random_.GetSeed(), SteadyStateStream);
+  const size_t first_offspring = steady_state_offspring_count_;
+
+  const size_t worker_count =
+      thread_pool_ != nullptr ? thread_pool_->GetThreadCount() : 1U;
+  while (steady_state_offspring_.size() < worker_count) {
+    steady_state_offspring_.emplace_back(genome_);
+  }
+
+  std::atomic<size_t> scored_count{0};
+  const auto evaluate_offspring = [&](size_t begin, size_t end) {
+    const size_t worker_index =
+        thread_pool_ != nullptr ? ThreadPool::GetCurrentWorkerIndex() : 0;
+    assert(worker_index < steady_state_offspring_.size());
+    auto& offspring = steady_state_offspring_[worker_index];
+
+    for (size_t i = begin; i < end; i++) {
+      const uint64_t seed =
+          RandomWrapper::DeriveSeed(steady_state_seed, first_offspring + i);
+      RandomWrapper random(seed);
+      {
+        // Building an offspring only reads the population so every worker
+        // may do it at once.
+        const std::shared_lock<std::shared_mutex> lock(steady_state_mutex_);
+        CreateOffspring(population, seed, mutation_rate, &random, &offspring);
+      }
+
+      // Score the offspring without holding the lock so other workers can go
+      // on selecting and inserting in the meantime.
+      uint64_t hash = 0;
+      bool is_cached = false;
+      const bool needs_score = offspring.IsDirty();
+      if (needs_score) {
+        double score = 0.0;
+        if (fitness_cache_) {
+          hash = offspring.Hash();
+          const std::lock_guard<std::shared_mutex> lock(steady_state_mutex_);
+          is_cached = fitness_cache_->Find(offspring, hash, &score);
+        }
+        if (!is_cached) {
+          score = ScoreIndividual(&offspring);
+          scored_count++;
+        }
+        offspring.SetScore(score);
+        offspring.SetDirty(false);
+      }
+
+      const std::lock_guard<std::shared_mutex> lock(steady_state_mutex_);
+      if (needs_score && !is_cached) {
+        if (fitness_cache_) {
+          fitness_cache_->Insert(offspring, hash, offspring.GetScore());
+        }
+        if (surrogate_archive_) {
+          surrogate_archive_->Add(offspring, offspring.GetScore());
+        }
+      }
+      population.ReplaceWorst(offspring);
+    }
+  };
+  if (thread_pool_ != nullptr) {
+    // Hand out one offspring at a time so a slow evaluation never holds up
+    // any others.
+    thread_pool_->ParallelFor(evaluation_count, 1U, evaluate_offspring);
+  } else {
+    evaluate_offspring(0, evaluation_count);
+  }
+  population.EndSteadyState();
+  steady_state_offspring_count_ += evaluation_count;
+  evaluation_count_ += scored_count;
+}
+
+bool GeneticAlgorithm::ReplaceWorstIndividual(Individual* individual) {
+  assert(is_initial_population_evaluated_);
+  if (individual->IsDirty()) {
+    individual->SetScore(ScoreIndividual(individual));
+    individual->SetDirty(false);
+    evaluation_count_++;
+    if (surrogate_archive_) {
+      surrogate_archive_->Add(*individual, individual->GetScore());
+    }
+  }
+  return GetCurrentPopulation().ReplaceWorst(*individual);
+}
+
 double GeneticAlgorithm::GetCurrentMutationRate() {
   switch (mutation_rate_schedule_) {
     case MutationRateSchedule::Constant:
@@ -330,8 +1300,19 @@ double GeneticAlgorithm::GetCurrentMutationRate() {
     }
     case MutationRateSchedule::SelfAdaptive: {
       const auto& last_generation_population = GetLastGenerationPopulation();
-      if (last_generation_population.GetPopulationDiversity() <
-          self_adaptive_mutation_diversity_floor_) {
+      double diversity = 0.0;
+      if (self_adaptive_mutation_diversity_sample_size_ != 0) {
+        // Sample from a stream of its own so the result doesn't depend on
+        // anything else drawing random values this generation.
+        RandomWrapper random(RandomWrapper::DeriveSeed(
+            RandomWrapper::DeriveSeed(random_.GetSeed(), current_generation_),
+            DiversitySampleStream));
+        diversity = last_generation_population.EstimatePopulationDiversity(
+            self_adaptive_mutation_diversity_sample_size_, &random);
+      } else {
+        diversity = last_generation_population.GetPopulationDiversity();
+      }
+      if (diversity < self_adaptive_mutation_diversity_floor_) {
         return self_adaptive_mutation_aggressive_rate_;
       }
       return mutation_rate_;
@@ -350,91 +1331,342 @@ double GeneticAlgorithm::GetCurrentMutationRate() {
 
 void GeneticAlgorithm::Crossover(const Individual& parent1,
                                  const Individual& parent2,
-                                 Individual* offspring) {
+                                 Individual* offspring, RandomWrapper* random) {
   switch (crossover_type_) {
     case CrossoverType::OnePoint:
-      Chromosome::KPointCrossover(1, parent1, parent2, offspring, &random_,
+      Chromosome::KPointCrossover(1, parent1, parent2, offspring, random,
                                   crossover_ignore_gene_boundaries_);
       break;
     case CrossoverType::TwoPoint:
-      Chromosome::KPointCrossover(2, parent1, parent2, offspring, &random_,
+      Chromosome::KPointCrossover(2, parent1, parent2, offspring, random,
                                   crossover_ignore_gene_boundaries_);
       break;
     case CrossoverType::KPoint:
       Chromosome::KPointCrossover(k_point_crossover_point_count_, parent1,
-                                  parent2, offspring, &random_,
+                                  parent2, offspring, random,
                                   crossover_ignore_gene_boundaries_);
       break;
     case CrossoverType::Uniform:
-      Chromosome::UniformCrossover(parent1, parent2, offspring, &random_,
+      Chromosome::UniformCrossover(parent1, parent2, offspring, random,
                                    crossover_ignore_gene_boundaries_);
       break;
+    case CrossoverType::Blend:
+      Chromosome::BlendCrossover(Chromosome::DefaultBlendAlpha, parent1,
+                                 parent2, offspring, random,
+                                 crossover_ignore_gene_boundaries_);
+      break;
+    case CrossoverType::SimulatedBinary:
+      Chromosome::SimulatedBinaryCrossover(
+          Chromosome::DefaultCrossoverDistributionIndex, parent1, parent2,
+          offspring, random, crossover_ignore_gene_boundaries_);
+      break;
     default:
       assert(false);
   }
+  offspring->SetDirty(true);
+}
+
+bool GeneticAlgorithm::IsScreeningEnabled() const {
+  return screening_candidate_count_ > 1U &&
+         (surrogate_function_ != nullptr || surrogate_archive_);
+}
+
+double GeneticAlgorithm::EstimateScore(const Individual& individual) const {
+  if (surrogate_function_ != nullptr) {
+    return surrogate_function_(&individual, user_data_);
+  }
+  double score = std::numeric_limits<double>::infinity();
+  if (surrogate_archive_) {
+    surrogate_archive_->Estimate(individual, &score);
+  }
+  return score;
+}
+
+bool GeneticAlgorithm::CanUseReproductionBackend() const {
+  // Backends work on raw bits so they would split value genes apart.
+  if (!crossover_ignore_gene_boundaries_ || genome_.GetValueGeneCount() != 0) {
+    return false;
+  }
+  switch (crossover_type_) {
+    case CrossoverType::OnePoint:
+    case CrossoverType::TwoPoint:
+    case CrossoverType::KPoint:
+    case CrossoverType::Uniform:
+      break;
+    default:
+      return false;
+  }
+  return mutator_type_ == MutatorType::Flip ||
+         mutator_type_ == MutatorType::GeometricFlip ||
+         mutator_type_ == MutatorType::MaskFlip;
+}
+
+size_t GeneticAlgorithm::GetBackendCrossoverPointCount() const {
+  switch (crossover_type_) {
+    case CrossoverType::OnePoint:
+      return 1;
+    case CrossoverType::TwoPoint:
+      return 2;
+    case CrossoverType::KPoint:
+      return k_point_crossover_point_count_;
+    default:
+      return 0;
+  }
 }
 
-void GeneticAlgorithm::Mutate(Individual* individual,
-                              double mutation_percentage) {
+void GeneticAlgorithm::CreateBackendOffspring(Population* population,
+                                              size_t first_offspring_index,
+                                              uint64_t generation_seed,
+                                              double mutation_rate) {
+  backend_offspring_indices_.clear();
+  backend_first_parent_rows_.clear();
+  backend_second_parent_rows_.clear();
+  backend_offspring_rows_.clear();
+  backend_seeds_.clear();
+  for (size_t i = 0; i < backend_parents_.size(); i++) {
+    const auto& couple = backend_parents_[i];
+    if (couple.first == nullptr) {
+      continue;
+    }
+    const size_t index = first_offspring_index + i;
+    assert(population->GetIndividualWritable(index).GetBitCount() ==
+           couple.first->GetBitCount());
+    backend_offspring_indices_.push_back(index);
+    backend_first_parent_rows_.push_back(couple.first->GetBytes());
+    backend_second_parent_rows_.push_back(couple.second->GetBytes());
+    backend_offspring_rows_.push_back(population->GetChromosomeStorage(index));
+    backend_seeds_.push_back(RandomWrapper::DeriveSeed(
+        RandomWrapper::DeriveSeed(generation_seed, index), ReproductionStream));
+  }
+
+  OffspringBatch batch;
+  batch.first_parents = backend_first_parent_rows_.data();
+  batch.second_parents = backend_second_parent_rows_.data();
+  batch.offspring = backend_offspring_rows_.data();
+  batch.seeds = backend_seeds_.data();
+  batch.count = backend_offspring_indices_.size();
+  batch.bit_count = genome_.BitsRequired();
+  batch.crossover_point_count = GetBackendCrossoverPointCount();
+  batch.mutation_rate = mutation_rate;
+  if (batch.count != 0) {
+    reproduction_backend_->CreateOffspring(batch);
+  }
+}
+
+void GeneticAlgorithm::Mutate(Individual* individual, double mutation_percentage,
+                              RandomWrapper* random) {
   switch (mutator_type_) {
     case MutatorType::Flip:
-      Chromosome::FlipMutator(individual, mutation_percentage, &random_);
+      if (Chromosome::FlipMutator(individual, mutation_percentage, random) !=
+          0) {
+        individual->SetDirty(true);
+      }
+      break;
+    case MutatorType::GeometricFlip:
+      if (Chromosome::GeometricFlipMutator(individual, mutation_percentage,
+                                           random) != 0) {
+        individual->SetDirty(true);
+      }
+      break;
+    case MutatorType::MaskFlip:
+      if (Chromosome::MaskFlipMutator(individual, mutation_percentage,
+                                      random) != 0) {
+        individual->SetDirty(true);
+      }
+      break;
+    case MutatorType::Gaussian:
+      if (Chromosome::GaussianMutator(individual, mutation_percentage,
+                                      random) != 0) {
+        individual->SetDirty(true);
+      }
+      break;
+    case MutatorType::Polynomial:
+      if (Chromosome::PolynomialMutator(individual, mutation_percentage,
+                                        random) != 0) {
+        individual->SetDirty(true);
+      }
       break;
     default:
       assert(false);
   }
 }
 
-void GeneticAlgorithm::InitializeSelector(Population* population) {
-  if (selector_type_ == SelectorType::RouletteWheel) {
-    population->InitializePartialSums();
+void GeneticAlgorithm::ParallelFor(size_t count,
+                                   const ThreadPool::RangeFunction& function) {
+  if (thread_pool_ != nullptr) {
+    thread_pool_->ParallelFor(count, 0, function);
+  } else {
+    function(0, count);
   }
 }
 
-const Individual& GeneticAlgorithm::SelectOne(const Population& population) {
+size_t GeneticAlgorithm::GetRequiredRankCount() const {
+  switch (selector_type_) {
+    case SelectorType::RouletteWheel:
+    case SelectorType::StochasticUniversalSampling:
+      // Partial sums are laid out in rank order.
+      return 0;
+    default:
+      // Elites are copied by rank and the rank selector looks at the two best
+      // individuals. Other selectors only compare fitness values.
+      return std::max<size_t>(elite_count_ + mutated_elite_count_, 2U);
+  }
+}
+
+void GeneticAlgorithm::InitializeSelector(Population* population,
+                                          size_t couple_count, uint64_t seed) {
+  switch (selector_type_) {
+    case SelectorType::RouletteWheel:
+      population->InitializePartialSums();
+      break;
+    case SelectorType::Alias:
+      population->InitializeAliasTable();
+      break;
+    case SelectorType::StochasticUniversalSampling: {
+      population->InitializePartialSums();
+      RandomWrapper random(RandomWrapper::DeriveSeed(seed, SelectionStream));
+      population->StochasticUniversalSelect(couple_count * 2U, &random,
+                                            &sampled_parents_);
+      if (!allow_same_parent_couples_) {
+        SeparateSampledCouples(*population, &random);
+      }
+      // Screening candidates after the first select through SelectOne.
+      if (IsScreeningEnabled()) {
+        population->InitializeAliasTable();
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+void GeneticAlgorithm::CreateOffspring(const Population& population,
+                                       uint64_t seed, double mutation_rate,
+                                       RandomWrapper* random,
+                                       Individual* offspring) {
+  // Selectors which pick every parent up front select one at a time here.
+  const auto& first = SelectOne(population, random);
+  const auto& second =
+      SelectOne(population, random,
+                allow_same_parent_couples_ ? nullptr : &first);
+
+  // See if we will do crossover or duplicate a parent.
+  if (random->CoinFlip(crossover_rate_)) {
+    Crossover(first, second, offspring, random);
+  } else {
+    *offspring = first;
+  }
+
+  RandomWrapper mutation_random(
+      RandomWrapper::DeriveSeed(seed, MutationStream));
+  Mutate(offspring, mutation_rate, &mutation_random);
+}
+
+double GeneticAlgorithm::ScoreIndividual(Individual* individual) {
+  if (!batch_fitness_function_ && !async_fitness_function_) {
+    return fitness_function_(individual, user_data_);
+  }
+
+  double score = 0.0;
+  const std::byte* chromosome = individual->GetBytes();
+  FitnessBatch batch;
+  batch.individuals = individual;
+  batch.chromosomes = &chromosome;
+  batch.chromosome_bytes = BitVector::BytesRequired(genome_.BitsRequired());
+  batch.count = 1;
+  batch.scores = &score;
+  if (async_fitness_function_) {
+    // Async batches always say where their individuals are.
+    constexpr size_t index = 0;
+    batch.indices = &index;
+
+    // Steady-state workers each wait for their own offspring.
+    std::promise<void> scored;
+    std::future<void> is_scored = scored.get_future();
+    async_fitness_function_(batch, [&scored]() { scored.set_value(); });
+    is_scored.wait();
+  } else {
+    batch_fitness_function_(batch);
+  }
+  return score;
+}
+
+void GeneticAlgorithm::SeparateSampledCouples(const Population& population,
+                                              RandomWrapper* random) {
+  const size_t count = sampled_parents_.size();
+  for (size_t first = 0; first + 1U < count; first += 2U) {
+    const Individual* parent = sampled_parents_[first];
+    if (sampled_parents_[first + 1U] != parent) {
+      continue;
+    }
+
+    // Trade the second parent with one from another couple as long as that
+    // doesn't pair |parent| with itself over there.
+    bool is_separated = false;
+    for (size_t offset = 2U; offset < count && !is_separated; offset++) {
+      const size_t other = (first + offset) % count;
+      const Individual* partner = sampled_parents_[other ^ 1U];
+      if (sampled_parents_[other] != parent && partner != parent) {
+        std::swap(sampled_parents_[first + 1U], sampled_parents_[other]);
+        is_separated = true;
+      }
+    }
+
+    // Every other sample is |parent| so settle for any other individual.
+    if (!is_separated) {
+      sampled_parents_[first + 1U] = &population.UniformSelect(random, parent);
+    }
+  }
+}
+
+const Individual& GeneticAlgorithm::SelectOne(const Population& population,
+                                              RandomWrapper* random,
+                                              const Individual* excluded) {
   switch (selector_type_) {
     case SelectorType::Uniform:
-      return population.UniformSelect(&random_);
+      return population.UniformSelect(random, excluded);
     case SelectorType::RouletteWheel:
-      return population.RouletteWheelSelect(&random_);
+      return population.RouletteWheelSelect(random, excluded);
     case SelectorType::Tournament:
-      return population.TournamentSelect(tournament_size_, &random_);
+      return population.TournamentSelect(tournament_size_, random, excluded);
+    // Outside of the couples sampled up front, stochastic universal sampling
+    // selects like the alias selector would.
+    case SelectorType::Alias:
+    case SelectorType::StochasticUniversalSampling:
+      return population.AliasSelect(random, excluded);
     default:
       assert(false);
       // If asserts are turned off, this will fail to build unless we return
       // something here so blindly fall-thru into the rank selector case.
       [[fallthrough]];
     case SelectorType::Rank:
-      return population.RankSelect();
+      return population.RankSelect(excluded);
   }
 }
 
 std::pair<const Individual&, const Individual&> GeneticAlgorithm::SelectParents(
-    const Population& population) {
+    const Population& population, RandomWrapper* random, size_t couple_index) {
   assert(population.Size() > 0);
 
-  const auto& first = SelectOne(population);
-
-  // If we can select the same parent for each pair element, we can just select
-  // another one and return them.
-  if (allow_same_parent_couples_) {
-    const auto& second = SelectOne(population);
-    return {first, second};
+  if (selector_type_ == SelectorType::StochasticUniversalSampling) {
+    assert(couple_index * 2U + 1U < sampled_parents_.size());
+    return {*sampled_parents_[couple_index * 2U],
+            *sampled_parents_[couple_index * 2U + 1U]};
   }
+  return SelectCouple(population, random);
+}
 
-  // When we want to avoid selecting the same parent for each pair element, do
-  // the simple thing and select from a population which doesn't contain
-  // |first|.
-  Population temp(genome_);
-  temp.Resize(population.Size() - 1U, &random_);
-  for (size_t target_index = 0, i = 0; i < population.Size(); i++) {
-    const auto& individual = population.GetIndividual(i);
-    if (&individual != &first) {
-      temp.Replace(target_index++, individual);
-    }
-  }
-  InitializeSelector(&temp);
-  const auto& second = SelectOne(temp);
+std::pair<const Individual&, const Individual&> GeneticAlgorithm::SelectCouple(
+    const Population& population, RandomWrapper* random) {
+  const auto& first = SelectOne(population, random);
+
+  // If we can select the same parent for each pair element, we can just select
+  // another one and return them. Otherwise, select the second parent as if
+  // |first| was not in the population.
+  const auto& second =
+      SelectOne(population, random,
+                allow_same_parent_couples_ ? nullptr : &first);
   return {first, second};
 }
 
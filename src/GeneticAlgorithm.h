@@ -7,11 +7,21 @@
 #ifndef GENETICALGORITHM_H__
 #define GENETICALGORITHM_H__
 
+#include <atomic>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <shared_mutex>
 #include <vector>
 
+#include "FitnessCache.h"
 #include "Genome.h"
+#include "Instrumentation.h"
 #include "Population.h"
 #include "RandomWrapper.h"
+#include "ReproductionBackend.h"
+#include "Surrogate.h"
+#include "ThreadPool.h"
 
 namespace panga {
 
@@ -75,7 +85,24 @@ class GeneticAlgorithm {
      * either parent.
      * @see Chromosome::UniformCrossover
      */
-    Uniform
+    Uniform,
+
+    /**
+     * Perform blend crossover (BLX-alpha) on the value genes.<br/>
+     * Each value is drawn from around the interval between the parent
+     * values. Other genes are recombined as in uniform crossover.
+     * @see Chromosome::BlendCrossover
+     * @see Genome::AddValueGenes
+     */
+    Blend,
+
+    /**
+     * Perform simulated binary crossover (SBX) on the value genes.<br/>
+     * Other genes are recombined as in uniform crossover.
+     * @see Chromosome::SimulatedBinaryCrossover
+     * @see Genome::AddValueGenes
+     */
+    SimulatedBinary
   };
 
   /**
@@ -93,7 +120,43 @@ class GeneticAlgorithm {
      * Every bit in the chromosome has a mutation rate chance of flipping.
      * @see Chromosome::FlipMutator
      */
-    Flip = 1
+    Flip = 1,
+
+    /**
+     * Flip every bit in the chromosome independently with the mutation rate
+     * chance.<br/>
+     * Gaps between flipped bits are drawn from a geometric distribution so
+     * the cost scales with the number of bits flipped.
+     * @see Chromosome::GeometricFlipMutator
+     */
+    GeometricFlip = 2,
+
+    /**
+     * Flip bits by XORing in random masks with a bit density equal to the
+     * mutation rate.<br/>
+     * The cost depends only on the chromosome length which makes this the
+     * fastest per-bit mutator at high mutation rates.
+     * @see Chromosome::MaskFlipMutator
+     */
+    MaskFlip = 3,
+
+    /**
+     * Add normally distributed noise to value genes with the mutation rate
+     * chance.<br/>
+     * Only value genes are mutated.
+     * @see Chromosome::GaussianMutator
+     * @see Genome::AddValueGenes
+     */
+    Gaussian = 4,
+
+    /**
+     * Perform polynomial mutation on value genes with the mutation rate
+     * chance.<br/>
+     * Only value genes are mutated.
+     * @see Chromosome::PolynomialMutator
+     * @see Genome::AddValueGenes
+     */
+    Polynomial = 5
   };
 
   /**
@@ -154,7 +217,29 @@ class GeneticAlgorithm {
      * @see GetTournamentSize
      * @see Population::TournamentSelect
      */
-    Tournament
+    Tournament,
+
+    /**
+     * Alias selector.<br/>
+     * Selects individuals with the same probabilities as the roulette wheel
+     * selector but each selection takes constant time. An alias table is
+     * built once per generation instead of partial sums.
+     * @see InitializeSelector
+     * @see Population::AliasSelect
+     */
+    Alias,
+
+    /**
+     * Stochastic universal sampling selector.<br/>
+     * Spins the roulette wheel once with one evenly spaced pointer per parent
+     * needed for the generation. Every parent is selected up front in one
+     * sweep and the number of times an individual is selected stays within
+     * one of its expected count, which gives less selection noise than the
+     * roulette wheel selector.
+     * @see InitializeSelector
+     * @see Population::StochasticUniversalSelect
+     */
+    StochasticUniversalSampling
   };
 
   /**
@@ -234,7 +319,7 @@ class GeneticAlgorithm {
   GeneticAlgorithm();
   GeneticAlgorithm(const GeneticAlgorithm& rhs) = delete;
   GeneticAlgorithm& operator=(const GeneticAlgorithm& rhs) = delete;
-  ~GeneticAlgorithm() = default;
+  ~GeneticAlgorithm();
 
   /**
    * Get the writable genome we will use to construct Individuals which make up
@@ -302,6 +387,17 @@ class GeneticAlgorithm {
       double self_adaptive_mutation_aggressive_rate);
   double GetSelfAdaptiveMutationAggressiveRate() const;
 
+  /**
+   * Set the number of Individuals sampled to estimate the population
+   * diversity for the self-adaptive mutation rate schedule.<br/>
+   * If |self_adaptive_mutation_diversity_sample_size| is 0 (the default), the
+   * exact diversity of the whole population is used.
+   * @see Population::EstimatePopulationDiversity
+   */
+  void SetSelfAdaptiveMutationDiversitySampleSize(
+      size_t self_adaptive_mutation_diversity_sample_size);
+  size_t GetSelfAdaptiveMutationDiversitySampleSize() const;
+
   /**
    * Set the number of bits we should attempt to mutate with each mutation
    * operation.
@@ -405,7 +501,12 @@ class GeneticAlgorithm {
 
   /**
    * Set some data which will be passed into the fitness function called to
-   * score each Individual.
+   * score each Individual.<br/>
+   * Note: The same user data is shared by every call to the fitness function.
+   * When the population is evaluated in parallel, the fitness function must
+   * not modify the user data without synchronization. Per-thread scratch
+   * storage can be indexed via ThreadPool::GetCurrentWorkerIndex.
+   * @see SetThreadCount
    */
   void SetUserData(void* user_data);
   void* GetUserData() const;
@@ -419,6 +520,230 @@ class GeneticAlgorithm {
   void SetFitnessFunction(FitnessFunction fitness_function);
   FitnessFunction GetFitnessFunction() const;
 
+  /**
+   * Set a fitness function which scores many Individuals in one call.<br/>
+   * When set, it is used instead of the function set via SetFitnessFunction
+   * and the user data is not passed along - capture any state needed in the
+   * callable instead. Without a thread pool, each generation is scored in a
+   * single call. With one, each call receives one evaluation chunk.<br/>
+   * Pass an empty function to go back to scoring one Individual at a time.
+   * @see FitnessBatch
+   * @see SetEvaluationChunkSize
+   */
+  void SetBatchFitnessFunction(BatchFitnessFunction batch_fitness_function);
+  const BatchFitnessFunction& GetBatchFitnessFunction() const;
+
+  /**
+   * Set a fitness function which starts scoring a batch of Individuals and
+   * reports back once the scores are in, such as one sending requests to a
+   * remote service.<br/>
+   * When set, it is used instead of the other fitness functions. Each
+   * generation, the Individuals needing a score are gathered into batches of
+   * the evaluation chunk size and every batch is started without waiting
+   * for the others, up to the limit set via SetMaxInFlightBatches. Step
+   * sorts the population once every batch is done.<br/>
+   * Pass an empty function to stop using it.
+   * @see AsyncFitnessFunction
+   * @see SetEvaluationChunkSize
+   * @see SetMaxInFlightBatches
+   */
+  void SetAsyncFitnessFunction(AsyncFitnessFunction async_fitness_function);
+  const AsyncFitnessFunction& GetAsyncFitnessFunction() const;
+
+  /**
+   * Score each offspring and mutated clone right after it's built instead of
+   * waiting for the whole next generation to be built first.<br/>
+   * The worker which built an Individual goes on to score it, so scoring
+   * starts with the first offspring rather than after the last one and
+   * uneven fitness costs are balanced along with reproduction. Unmutated
+   * clones are scored at the end of the step as usual.<br/>
+   * Only applies to the fitness function set via SetFitnessFunction and the
+   * delta fitness function, and not while the fitness cache is enabled.
+   * This is false by default.
+   * @see SetFitnessFunction
+   */
+  void SetPipelinedEvaluation(bool pipelined_evaluation);
+  bool GetPipelinedEvaluation() const;
+
+  /**
+   * Hand crossover, mutation, and diversity calculations over whole
+   * populations to |reproduction_backend|, which must outlive the
+   * GeneticAlgorithm or be reset before it is destroyed.<br/>
+   * Parents are still selected on the calling threads. The offspring of each
+   * generation are then built in one batch by the backend. Clones are
+   * mutated as usual.<br/>
+   * The backend is only used for bit-wise k-point and uniform crossover
+   * which ignore gene boundaries paired with one of the flip mutators, on
+   * genomes without value genes. Other operators and genomes, and
+   * steady-state mode, keep building offspring one at a time.
+   * Each backend offspring draws from a counter-based stream so the result
+   * differs from building the same offspring without a backend, though it
+   * still only depends on the seed.<br/>
+   * Pass nullptr, the default, to stop using a backend.
+   * @see ReproductionBackend
+   */
+  void SetReproductionBackend(ReproductionBackend* reproduction_backend);
+  ReproductionBackend* GetReproductionBackend() const;
+
+  /**
+   * Build |screening_candidate_count| candidate offspring for every place in
+   * the next generation and keep only the one with the best estimated score.
+   * <br/>Every candidate is a full offspring - parents are selected, crossed
+   * over, and mutated anew - but only the kept one is passed to the fitness
+   * function. Clones are estimated by the score of the Individual they copy.
+   * <br/>With stochastic universal sampling, the first candidate uses the
+   * couple sampled up front and the others select their parents via the
+   * alias selector, the same as in steady-state mode.
+   * <br/>Screening needs a surrogate, either the function set via
+   * SetSurrogateFunction or the nearest neighbor archive enabled via
+   * SetSurrogateArchiveCapacity. It doesn't apply with a reproduction
+   * backend or in steady-state mode.<br/>
+   * The default of 1 disables screening.
+   * @see GetScreenedOffspringCount
+   */
+  void SetScreeningCandidateCount(size_t screening_candidate_count);
+  size_t GetScreeningCandidateCount() const;
+
+  /**
+   * Estimate the score of screening candidates via |surrogate_function|,
+   * which is passed the user data.<br/>
+   * Takes precedence over the surrogate archive. Pass nullptr to stop using
+   * it.
+   * @see SetScreeningCandidateCount
+   * @see SetUserData
+   */
+  void SetSurrogateFunction(SurrogateFunction surrogate_function);
+  SurrogateFunction GetSurrogateFunction() const;
+
+  /**
+   * Remember up to |capacity| scored chromosomes and estimate the score of
+   * screening candidates from the nearest one.<br/>
+   * Every new offspring passed to the fitness function is added to the
+   * archive once it has been scored - in Step, RunSteadyState, and
+   * ReplaceWorstIndividual alike. Fitness cache hits and unchanged
+   * Individuals which are scored again aren't added.<br/>
+   * A |capacity| of 0, the default, disables the archive.
+   * @see NearestNeighborSurrogate
+   * @see SetScreeningCandidateCount
+   */
+  void SetSurrogateArchiveCapacity(size_t capacity);
+  size_t GetSurrogateArchiveCapacity() const;
+
+  /**
+   * Get the surrogate archive.<br/>
+   * Returns nullptr when the archive is disabled.
+   * @see SetSurrogateArchiveCapacity
+   */
+  const NearestNeighborSurrogate* GetSurrogateArchive() const;
+
+  /**
+   * Get the number of changed candidate offspring discarded by screening
+   * since Initialize. Each of them is an evaluation of the fitness function
+   * saved.
+   * @see SetScreeningCandidateCount
+   */
+  size_t GetScreenedOffspringCount() const;
+
+  /**
+   * Set the most batches which may be handed to the async fitness function
+   * without being done yet.<br/>
+   * Note: |max_in_flight_batches| must not be 0.
+   * @see SetAsyncFitnessFunction
+   */
+  void SetMaxInFlightBatches(size_t max_in_flight_batches);
+  size_t GetMaxInFlightBatches() const;
+
+  /**
+   * Set a fitness function which scores an offspring from the score of its
+   * primary parent and the genes which changed since.<br/>
+   * Offspring made by crossover have the first selected parent as their
+   * primary parent and mutated clones have the Individual they were cloned
+   * from. Step finds the changed genes while building each offspring and
+   * the delta function is used in place of the function set via
+   * SetFitnessFunction for every offspring with a primary parent. It gets
+   * the same user data. Initial populations and unchanged clones are still
+   * scored by the full fitness function.<br/>
+   * The delta function must return the same score the full fitness function
+   * would. It isn't used along with a batch fitness function or by
+   * RunSteadyState. Pass nullptr to stop using it.
+   * @see GeneDelta
+   */
+  void SetDeltaFitnessFunction(DeltaFitnessFunction delta_fitness_function);
+  DeltaFitnessFunction GetDeltaFitnessFunction() const;
+
+  /**
+   * Remember the scores of up to |capacity| chromosomes so chromosomes which
+   * show up again in a later generation aren't scored again.<br/>
+   * Individuals which haven't changed since they were scored - such as the
+   * elites - keep their score without even a cache lookup.<br/>
+   * Only enable the cache if the fitness function always returns the same
+   * score for the same chromosome. A |capacity| of 0 (the default) disables
+   * the cache. Changing the capacity clears the cache.
+   * @see GetFitnessCache
+   */
+  void SetFitnessCacheCapacity(size_t capacity);
+  size_t GetFitnessCacheCapacity() const;
+
+  /**
+   * Get the fitness cache, which tracks how many lookups hit and missed.
+   * <br/>Returns nullptr when the cache is disabled.
+   * @see SetFitnessCacheCapacity
+   */
+  const FitnessCache* GetFitnessCache() const;
+
+  /**
+   * Set the seed used to generate every random value in the GeneticAlgorithm.
+   * <br/>Two runs with the same seed and settings produce the same sequence of
+   * populations regardless of the thread count.<br/>
+   * If no seed is set, a random one is chosen when it's first needed.
+   * Call this before Initialize().
+   */
+  void SetRandomSeed(uint64_t random_seed);
+  uint64_t GetRandomSeed();
+
+  /**
+   * Set the number of threads used to evaluate the population and construct
+   * offspring.<br/>
+   * When |thread_count| is greater than 1, the GeneticAlgorithm owns a
+   * ThreadPool and builds and scores several Individuals at once.<br/>
+   * If |thread_count| is 0, one thread per hardware thread is used.<br/>
+   * The default thread count of 1 runs everything serially on the thread
+   * calling Step.<br/>
+   * Note: Replaces any thread pool previously set via SetThreadPool.
+   * @see SetThreadPool
+   * @see SetUserData
+   */
+  void SetThreadCount(size_t thread_count);
+  size_t GetThreadCount() const;
+
+  /**
+   * Use an externally-owned |thread_pool| to evaluate the population.<br/>
+   * This lets several GeneticAlgorithm instances (or other work) share one set
+   * of worker threads. Pass nullptr to evaluate serially.<br/>
+   * Population storage allocated by Initialize is first touched by the
+   * workers of the pool so, with a pool pinned to the CPUs of one NUMA node,
+   * the Individuals stay in memory local to that node.<br/>
+   * Note: |thread_pool| must outlive the GeneticAlgorithm or be reset before
+   * it is destroyed.
+   * @see SetThreadCount
+   */
+  void SetThreadPool(ThreadPool* thread_pool);
+  ThreadPool* GetThreadPool() const;
+
+  /**
+   * Set how many Individuals each worker claims at a time when the population
+   * is evaluated in parallel.<br/>
+   * Small chunks balance uneven fitness costs better while large chunks reduce
+   * scheduling overhead for cheap fitness functions.<br/>
+   * If |evaluation_chunk_size| is 0 (the default), a chunk size is chosen
+   * based on the population size and the number of threads.<br/>
+   * The async fitness function receives batches of this many Individuals.
+   * If it's 0, they're split evenly over the most batches allowed in flight.
+   * @see ThreadPool::ParallelFor
+   */
+  void SetEvaluationChunkSize(size_t evaluation_chunk_size);
+  size_t GetEvaluationChunkSize() const;
+
   /**
    * Each generation, we will construct and evaluate |population_size|
    * Individuals.
@@ -433,14 +758,21 @@ class GeneticAlgorithm {
   size_t GetCurrentGeneration() const;
 
   /**
-   * Get the current genetic algorithm population.
+   * Get the current genetic algorithm population.<br/>
+   * Note: Unless the selector needs the rank of every individual, only the
+   * elites, the two best individuals, and the worst individual are kept in
+   * rank order.
+   * @see Population::SetRankedCount
    */
   const Population& GetPopulation() const;
 
   /**
    * Initialize the state of the GeneticAlgorithm.<br/>
-   * Initializes missing population members randomly.
+   * Initializes missing population members randomly. The population holding
+   * the last generation is only sized since Step overwrites all of it.<br/>
+   * Freezes the genome, so no more genes may be added afterwards.
    * @see SetInitialPopulation
+   * @see Genome::Freeze
    */
   void Initialize();
 
@@ -453,6 +785,66 @@ class GeneticAlgorithm {
    */
   void SetInitialPopulation(const std::vector<BitVector>& initial_population);
 
+  /**
+   * Initialize the GeneticAlgorithm population with |count| chromosomes
+   * stored |chromosome_stride| bytes apart in |chromosomes|, such as the rows
+   * of a memory-mapped file.<br/>
+   * The rows are copied straight into the population storage without
+   * allocating anything per individual.<br/>
+   * Note: The genome must be complete and we need to call this before
+   * calling Initialize().
+   * @see Population::Initialize
+   */
+  void SetInitialPopulation(const std::byte* chromosomes,
+                            size_t chromosome_stride, size_t count);
+
+  /**
+   * Initialize the GeneticAlgorithm population with |count| individuals
+   * whose chromosome bits |initializer| writes straight into the population
+   * storage.<br/>
+   * Use this to stream an initial population in from a generator or an
+   * iterator without building a std::vector<BitVector> first.<br/>
+   * Note: The genome must be complete and we need to call this before
+   * calling Initialize().
+   * @see Population::Initialize
+   */
+  void SetInitialPopulation(size_t count,
+                            const ChromosomeInitializer& initializer);
+
+  /**
+   * Write a checkpoint of the GeneticAlgorithm to the file at |path|.<br/>
+   * The checkpoint is a compact binary file holding the genome, every
+   * setting, the current generation and evaluation count, the random seed,
+   * the surrogate archive and screened offspring count, and the raw
+   * chromosome bytes, scores, and fitness values of both populations. Random
+   * values are all derived from the seed and the generation so the seed is
+   * the only random state needed to resume.<br/>
+   * The fitness and surrogate functions, user data, thread count, in-flight
+   * batch limit, pipelined evaluation flag, and the contents of the fitness
+   * cache aren't saved.<br/>
+   * Note: Chooses the random seed now if none has been set.
+   * @return false if the file couldn't be written.
+   * @see Load
+   */
+  bool Save(const char* path);
+  bool Save(std::ostream* stream);
+
+  /**
+   * Restore the GeneticAlgorithm from a checkpoint written by Save.<br/>
+   * Afterwards, calling Step continues the run exactly where the saved one
+   * left off. Set the fitness function and thread count again before
+   * stepping. If the genome already has genes, they must match the genes in
+   * the checkpoint. Otherwise the genome is rebuilt from it.<br/>
+   * Each population is read with one bulk read of its chromosome rows
+   * without parsing anything or allocating per individual.<br/>
+   * The whole checkpoint is read and checked before anything is replaced so
+   * if loading fails the GeneticAlgorithm is left exactly as it was.
+   * @return false if the checkpoint couldn't be read or doesn't match the
+   * genome.
+   */
+  bool Load(const char* path);
+  bool Load(std::istream* stream);
+
   /**
    * Perform one step of the genetic algorithm:<br/>
    *   1. Use the previous generation population to construct the new current
@@ -475,23 +867,91 @@ class GeneticAlgorithm {
    */
   void Run();
 
+  /**
+   * Run the genetic algorithm in steady-state mode until |evaluation_count|
+   * more offspring have been created and scored.<br/>
+   * Instead of building a whole generation at a time, every worker in the
+   * thread pool repeatedly selects a couple from the current population,
+   * creates one offspring from it, scores that offspring, and inserts it in
+   * place of the worst individual if it scored better. Workers never wait on
+   * each other to finish scoring so fitness functions whose cost varies a lot
+   * between individuals keep every worker busy.<br/>
+   * Offspring are created with the selector, crossover, and mutator chosen
+   * for the generational mode and the mutation rate of the current
+   * generation. Elitism doesn't apply since only the worst individual is ever
+   * replaced.<br/>
+   * The initial population is evaluated first if that hasn't happened yet.
+   * The current generation doesn't advance, progress is tracked by
+   * GetEvaluationCount instead.<br/>
+   * Workers build offspring concurrently and only wait on each other to
+   * insert one. The population tracks its worst individual and the sums the
+   * selectors need incrementally so inserting an offspring takes logarithmic
+   * time in the population size.<br/>
+   * Note: Without a thread pool, the result only depends on the seed. With
+   * more than one worker, the order in which offspring are inserted depends
+   * on how long each one took to score.
+   * @see GetEvaluationCount
+   * @see Population::BeginSteadyState
+   */
+  void RunSteadyState(size_t evaluation_count);
+
+  /**
+   * Get the number of individuals scored since Initialize.<br/>
+   * Each Step counts every individual of the population it evaluates.
+   * RunSteadyState only counts the offspring it passes to the fitness
+   * function, not unchanged copies of a parent which keep the score of that
+   * parent or offspring found in the fitness cache.
+   */
+  size_t GetEvaluationCount() const;
+
+  /**
+   * Call |step_stats_callback| at the end of every Step with the timings and
+   * counters of that step.<br/>
+   * The callback runs on the thread which called Step. Pass an empty
+   * function to stop receiving stats.<br/>
+   * Note: Stats are only collected when instrumentation is compiled in.
+   * Otherwise the callback is never called.
+   * @see IsInstrumentationEnabled
+   * @see ChromeTraceWriter
+   */
+  void SetStepStatsCallback(StepStatsCallback step_stats_callback);
+
+  /**
+   * Get the timings and counters of the last Step.<br/>
+   * Note: Always empty unless instrumentation is compiled in.
+   */
+  const StepStats& GetLastStepStats() const;
+
+  /**
+   * Insert |individual| into the current population in place of the worst
+   * individual if |individual| scored better.<br/>
+   * This is how Individuals from another population, such as migrants from
+   * another island, join this one. If |individual| is dirty it's scored with
+   * our fitness function first, which counts as an evaluation.<br/>
+   * Note: The current population must have been evaluated.
+   * @return true if |individual| was inserted.
+   * @see Population::ReplaceWorst
+   */
+  bool ReplaceWorstIndividual(Individual* individual);
+
  protected:
   /**
    * Uses the selected crossover operator to construct |offspring| based on
-   * |parent1| and |parent2|.
+   * |parent1| and |parent2| drawing random values from |random|.
    * @see SetCrossoverType
    * @see CrossoverType
    */
   void Crossover(const Individual& parent1, const Individual& parent2,
-                 Individual* offspring);
+                 Individual* offspring, RandomWrapper* random);
 
   /**
    * Uses the selected mutation operator to mutate |individual| by
-   * |mutation_percentage|.
+   * |mutation_percentage| drawing random values from |random|.
    * @see MutatorType
    * @see SetMutatorType
    */
-  void Mutate(Individual* individual, double mutation_percentage);
+  void Mutate(Individual* individual, double mutation_percentage,
+              RandomWrapper* random);
 
   /**
    * Get the mutation rate we should use for the current generation.<br/>
@@ -502,28 +962,207 @@ class GeneticAlgorithm {
    */
   double GetCurrentMutationRate();
 
+  /**
+   * Call |function| over [0, |count|) on the thread pool if we have one or
+   * on the current thread otherwise.
+   * @see ThreadPool::ParallelFor
+   */
+  void ParallelFor(size_t count, const ThreadPool::RangeFunction& function);
+
+  /**
+   * Use |thread_pool| for parallel work and for first touching the storage
+   * of both populations.
+   */
+  void SetThreadPoolInternal(ThreadPool* thread_pool);
+
+  /**
+   * Get the number of best individuals in a population which must be ordered
+   * by rank for the elites and the selector, or 0 if the whole population
+   * must be sorted.
+   * @see Population::SetRankedCount
+   */
+  size_t GetRequiredRankCount() const;
+
   /**
    * If the selector we're using requires some initialization based on the
-   * population, this function will perform that initialization.
+   * population, this function will perform that initialization.<br/>
+   * |couple_count| is the number of couples SelectParents will be asked for.
+   * Selectors which pick every parent up front draw random values from a
+   * stream derived from |seed|.
    */
-  void InitializeSelector(Population* population);
+  void InitializeSelector(Population* population, size_t couple_count,
+                          uint64_t seed);
+
+  /**
+   * Rearrange sampled_parents_ so no couple is made of the same Individual
+   * twice. Only the second parent of a couple is ever moved.
+   */
+  void SeparateSampledCouples(const Population& population,
+                              RandomWrapper* random);
 
   /**
    * Uses the selector to choose a pair of individuals from |population|.<br/>
    * Respects the allow_same_parent_couples_ flag to enable/disable choosing the
-   * same individual for both parents.
+   * same individual for both parents.<br/>
+   * |couple_index| identifies the couple among those requested from
+   * InitializeSelector. Selectors which pick every parent up front return
+   * the couple stored at that index.
    * @see SetAllowSameParentCouples
    * @see SelectOne
    */
   std::pair<const Individual&, const Individual&> SelectParents(
-      const Population& population);
+      const Population& population, RandomWrapper* random,
+      size_t couple_index);
+
+  /**
+   * Choose a pair of individuals from |population| one at a time via
+   * SelectOne, even for selectors which pick every parent up front.
+   * @see SelectParents
+   */
+  std::pair<const Individual&, const Individual&> SelectCouple(
+      const Population& population, RandomWrapper* random);
 
   /**
-   * Uses the selector to choose one Individual from |population|.
+   * Returns true if the crossover and mutator types can be run by the
+   * reproduction backend on the genome.
+   * @see SetReproductionBackend
+   */
+  bool CanUseReproductionBackend() const;
+
+  /**
+   * Number of cut points the reproduction backend should use for the
+   * crossover type. Uniform crossover uses none.
+   */
+  size_t GetBackendCrossoverPointCount() const;
+
+  /**
+   * Build every offspring recorded in backend_parents_ via the reproduction
+   * backend. Offspring i is stored at |first_offspring_index| + i of
+   * |population| and mutated at |mutation_rate|.
+   */
+  void CreateBackendOffspring(Population* population,
+                              size_t first_offspring_index,
+                              uint64_t generation_seed, double mutation_rate);
+
+  /**
+   * What Step has worked out about the generation it's building, shared by
+   * the helpers which build it.
+   */
+  struct GenerationContext {
+    Population* current_population = nullptr;
+    Population* last_generation_population = nullptr;
+    // Every individual of the generation draws random values from a stream
+    // derived from this seed and its index.
+    uint64_t generation_seed = 0;
+    size_t first_offspring_index = 0;
+    size_t offspring_count = 0;
+    double mutation_rate = 0.0;
+    bool track_gene_deltas = false;
+    bool score_early = false;
+    bool use_backend = false;
+    bool is_screening = false;
+    size_t candidate_count = 1;
+    // Each chunk of work adds its own timings and counts once it's done.
+    std::atomic<uint64_t> selection_nanoseconds{0};
+    std::atomic<uint64_t> crossover_nanoseconds{0};
+    std::atomic<uint64_t> mutation_nanoseconds{0};
+    std::atomic<uint64_t> random_draw_count{0};
+    std::atomic<size_t> screened_offspring_count{0};
+  };
+
+  /**
+   * Timings and counts of one chunk of offspring, summed without atomics.
+   */
+  struct OffspringCounters {
+    uint64_t selection_nanoseconds = 0;
+    uint64_t crossover_nanoseconds = 0;
+    uint64_t mutation_nanoseconds = 0;
+    uint64_t random_draw_count = 0;
+    size_t screened_offspring_count = 0;
+  };
+
+  /**
+   * Move on to the next generation. Marks the elites as clones, initializes
+   * the selector, and fills in |context| with the modes used to build the
+   * generation.
+   */
+  void BeginGeneration(GenerationContext* context);
+
+  /**
+   * Build every offspring of the generation across the thread pool.<br/>
+   * With a reproduction backend, crossovers are only recorded for
+   * ApplyBackendReproduction to build.
+   */
+  void CreateOffspringGeneration(GenerationContext* context);
+
+  /**
+   * Build offspring |offspring_number| of the generation. While screening,
+   * build each candidate and keep the one with the best estimated score.
+   * <br/>Offspring which duplicate a parent are only marked as clones.
+   */
+  void ScreenOffspring(const GenerationContext& context,
+                       size_t offspring_number, OffspringCounters* counters);
+
+  /**
+   * Build the crossovers recorded by CreateOffspringGeneration via the
+   * reproduction backend and finish them like every other offspring.
+   */
+  void ApplyBackendReproduction(GenerationContext* context);
+
+  /**
+   * Fill in every clone of the generation and mutate it. The first clone of
+   * an Individual takes over its storage and the others copy it.
+   * @return The number of clones which were copied.
+   */
+  size_t SwapCloneStorage(GenerationContext* context);
+
+  /**
+   * Mutate the clone at |index| unless it's an elite.
+   */
+  void MutateClone(GenerationContext* context, size_t index);
+
+  /**
+   * Score and sort the current population and archive the new offspring
+   * which were scored.
+   */
+  void EvaluateCurrentPopulation();
+
+  /**
+   * Returns true if Step should build several candidates per offspring.
+   * @see SetScreeningCandidateCount
+   */
+  bool IsScreeningEnabled() const;
+
+  /**
+   * Estimate the score of |individual| with the surrogate.<br/>
+   * Returns infinity if the surrogate has no estimate.
+   */
+  double EstimateScore(const Individual& individual) const;
+
+  /**
+   * Select a couple from |population| and build |offspring| from it the same
+   * way Step builds each offspring of a generation.<br/>
+   * Mutation draws random values from a stream derived from |seed| and
+   * everything else comes from |random|.
+   */
+  void CreateOffspring(const Population& population, uint64_t seed,
+                       double mutation_rate, RandomWrapper* random,
+                       Individual* offspring);
+
+  /**
+   * Call the fitness function on |individual| and return the score.
+   */
+  double ScoreIndividual(Individual* individual);
+
+  /**
+   * Uses the selector to choose one Individual from |population|.<br/>
+   * If |excluded| is not nullptr, that Individual will not be chosen.
    * @see SelectorType
    * @see SetSelectorType
    */
-  const Individual& SelectOne(const Population& population);
+  const Individual& SelectOne(const Population& population,
+                              RandomWrapper* random,
+                              const Individual* excluded = nullptr);
 
   /**
    * We store two populations and alternate between them between generations. In
@@ -548,26 +1187,90 @@ class GeneticAlgorithm {
    */
   Population& GetLastGenerationPopulation();
 
+  /**
+   * Read everything in a checkpoint after the genome and replace our state
+   * with it if all of it could be read.<br/>
+   * The genome must already hold the genes of the checkpoint.
+   * @see Load
+   */
+  bool LoadState(std::istream* stream);
+
  private:
   static constexpr double DefaultMutationRate = 0.0005;
   static constexpr double DefaultCrossoverRate = 0.9;
   static constexpr double DefaultMutatedEliteMutationRate = 0.33;
-  static constexpr double DefaultSelfAdaptiveMutationDiversityFloor = 0.0002;
+  // Diversity used to be reported at twice its real value so this is half
+  // the old floor of 0.0002, which keeps the default switch point the same.
+  static constexpr double DefaultSelfAdaptiveMutationDiversityFloor = 0.0001;
   static constexpr double DefaultSelfAdaptiveMutationAggressiveRate = 0.1;
   static constexpr size_t DefaultTournamentSize = 2;
   static constexpr size_t DefaultKPointCrossoverCount = 3;
   static constexpr size_t DefaultProportionalMutationBitCount = 1;
+  static constexpr size_t DefaultMaxInFlightBatches = 64;
 
   Genome genome_;
   std::vector<Population> populations_;
+
+  // Scratch space used by Step to track which individuals are clones of one
+  // from the last generation and which of those take over its storage.
+  std::vector<size_t> clone_sources_;
+  std::vector<bool> clone_takes_storage_;
+  std::vector<bool> is_clone_source_taken_;
+  // Parents chosen up front by the stochastic universal sampling selector.
+  // Couple i is made of elements 2i and 2i + 1.
+  std::vector<const Individual*> sampled_parents_;
+  // One offspring under construction per worker in steady-state mode.
+  std::vector<Individual> steady_state_offspring_;
+  // One mask of the bits flipped in a clone per worker, used to find the
+  // genes which changed for the delta fitness function.
+  std::vector<Individual> clone_mutation_masks_;
+  // Couple chosen for each offspring built by the reproduction backend, or
+  // nullptr for offspring which are clones. The batch arrays are rebuilt
+  // from these each generation.
+  std::vector<std::pair<const Individual*, const Individual*>>
+      backend_parents_;
+  std::vector<size_t> backend_offspring_indices_;
+  std::vector<const std::byte*> backend_first_parent_rows_;
+  std::vector<const std::byte*> backend_second_parent_rows_;
+  std::vector<std::byte*> backend_offspring_rows_;
+  std::vector<uint64_t> backend_seeds_;
+  // One candidate offspring under construction per worker while screening.
+  std::vector<Individual> screening_candidates_;
+  // Set for each Individual, by storage index, which was dirty before the
+  // population was evaluated. Only these are added to the surrogate archive.
+  std::vector<uint8_t> is_archive_candidate_;
+  // Shared by steady-state workers while they build offspring from the
+  // current population and held alone while one inserts its offspring.
+  std::shared_mutex steady_state_mutex_;
   RandomWrapper random_;
 
+  std::unique_ptr<ThreadPool> owned_thread_pool_;
+  ThreadPool* thread_pool_ = nullptr;
+  size_t evaluation_chunk_size_ = 0;
+
   void* user_data_ = nullptr;
   FitnessFunction fitness_function_ = nullptr;
+  BatchFitnessFunction batch_fitness_function_;
+  AsyncFitnessFunction async_fitness_function_;
+  size_t max_in_flight_batches_ = DefaultMaxInFlightBatches;
+  bool pipelined_evaluation_ = false;
+  ReproductionBackend* reproduction_backend_ = nullptr;
+  size_t screening_candidate_count_ = 1;
+  SurrogateFunction surrogate_function_ = nullptr;
+  std::unique_ptr<NearestNeighborSurrogate> surrogate_archive_;
+  DeltaFitnessFunction delta_fitness_function_ = nullptr;
+  std::unique_ptr<FitnessCache> fitness_cache_;
+
+  StepStats step_stats_;
+  StepStatsCallback step_stats_callback_;
 
   size_t population_size_ = 0;
   size_t total_generations_ = 0;
   size_t current_generation_ = 0;
+  size_t evaluation_count_ = 0;
+  // Offspring created by RunSteadyState, which identify their streams.
+  size_t steady_state_offspring_count_ = 0;
+  size_t screened_offspring_count_ = 0;
 
   size_t elite_count_ = 0;
   size_t mutated_elite_count_ = 0;
@@ -582,6 +1285,7 @@ class GeneticAlgorithm {
       DefaultSelfAdaptiveMutationDiversityFloor;
   double self_adaptive_mutation_aggressive_rate_ =
       DefaultSelfAdaptiveMutationAggressiveRate;
+  size_t self_adaptive_mutation_diversity_sample_size_ = 0;
   size_t proportional_mutation_bit_count_ = DefaultProportionalMutationBitCount;
 
   CrossoverType crossover_type_ = CrossoverType::Uniform;
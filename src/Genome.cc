@@ -6,22 +6,48 @@
 
 #include "Genome.h"
 
+#include <algorithm>
 #include <cassert>
 #include <climits>
+#include <limits>
+#include <utility>
+
+#include "BinaryStream.h"
+#include "BitVector.h"
 
 namespace {
 
 constexpr size_t BitsPerByte = CHAR_BIT;
+constexpr size_t BitsPerWord = sizeof(uint64_t) * BitsPerByte;
 
 }  // namespace
 
 namespace panga {
 
+size_t GetValueGeneSize(ValueGeneType type) {
+  switch (type) {
+    case ValueGeneType::Float:
+      return sizeof(float);
+    case ValueGeneType::Double:
+      return sizeof(double);
+    case ValueGeneType::Int32:
+      return sizeof(int32_t);
+    case ValueGeneType::Int64:
+      return sizeof(int64_t);
+    default:
+      return 0;
+  }
+}
+
 void Genome::SetBooleanGeneCount(size_t boolean_gene_count) {
+  assert(!is_frozen_);
   boolean_gene_count_ = boolean_gene_count;
 }
 
-void Genome::AddBooleanGenes(size_t count) { boolean_gene_count_ += count; }
+void Genome::AddBooleanGenes(size_t count) {
+  assert(!is_frozen_);
+  boolean_gene_count_ += count;
+}
 
 size_t Genome::GetFirstBooleanGeneBitIndex() const {
   return first_boolean_gene_bit_index_;
@@ -37,7 +63,7 @@ size_t Genome::GetGeneStartBitIndex(size_t gene_index) const {
   assert(gene_index < GetGeneCount());
 
   return gene_index >= GetFirstBooleanGeneIndex()
-             ? first_boolean_gene_bit_index_ + genes_.size() - gene_index
+             ? first_boolean_gene_bit_index_ + gene_index - genes_.size()
              : genes_[gene_index].start_bit_index;
 }
 
@@ -49,6 +75,30 @@ size_t Genome::GetGeneBitWitdh(size_t gene_index) const {
              : genes_[gene_index].bit_width;
 }
 
+size_t Genome::GetGeneIndexForBit(size_t bit_index) const {
+  if (bit_index >= first_boolean_gene_bit_index_) {
+    const size_t boolean_index = bit_index - first_boolean_gene_bit_index_;
+    return boolean_index < boolean_gene_count_
+               ? GetFirstBooleanGeneIndex() + boolean_index
+               : GetGeneCount();
+  }
+
+  // Genes are stored in order of their start bit so find the last one which
+  // starts at or before the bit.
+  const auto after = std::upper_bound(
+      genes_.cbegin(), genes_.cend(), bit_index,
+      [](size_t index, const Gene& gene) {
+        return index < gene.start_bit_index;
+      });
+  if (after == genes_.cbegin()) {
+    return GetGeneCount();
+  }
+  const auto gene = after - 1;
+  return bit_index < gene->start_bit_index + gene->bit_width
+             ? static_cast<size_t>(gene - genes_.cbegin())
+             : GetGeneCount();
+}
+
 size_t Genome::GetBooleanGeneCount() const { return boolean_gene_count_; }
 
 size_t Genome::BitsRequired() const {
@@ -62,6 +112,7 @@ size_t Genome::BitsRequired() const {
 
 size_t Genome::AddGene(size_t bit_width, bool byte_align) {
   assert(bit_width != 0);
+  assert(!is_frozen_);
 
   // First gene starts at bit index 0.
   // Subsequent genes start at the previous index + the previous bit width.
@@ -103,4 +154,204 @@ size_t Genome::AddGene(size_t bit_width, bool byte_align) {
   return gene_index;
 }
 
+size_t Genome::AddValueGenes(ValueGeneType type, size_t count, double min,
+                             double max) {
+  assert(type != ValueGeneType::None);
+  assert(count != 0);
+  assert(min <= max);
+  assert(!is_frozen_);
+
+  const size_t value_bit_width = GetValueGeneSize(type) * BitsPerByte;
+  if (value_gene_count_ != 0) {
+    // Only extend the run of value genes we already have.
+    assert(type == value_gene_type_);
+    assert(min == value_gene_min_ && max == value_gene_max_);
+    assert(first_value_gene_index_ + value_gene_count_ == genes_.size());
+  } else {
+    value_gene_type_ = type;
+    first_value_gene_index_ = genes_.size();
+    value_gene_min_ = min;
+    value_gene_max_ = max;
+  }
+
+  // Align the first value to its own size so the values can be accessed as
+  // an array. Chromosome storage itself is at least that aligned.
+  size_t bit_start_index = first_boolean_gene_bit_index_;
+  const size_t bit_gap = bit_start_index % value_bit_width;
+  if (bit_gap != 0) {
+    bit_start_index += value_bit_width - bit_gap;
+  }
+
+  const size_t gene_index = genes_.size();
+  for (size_t i = 0; i < count; i++) {
+    genes_.push_back({bit_start_index, value_bit_width});
+    bit_start_index += value_bit_width;
+  }
+  value_gene_count_ += count;
+  first_boolean_gene_bit_index_ = bit_start_index;
+
+  return gene_index;
+}
+
+ValueGeneType Genome::GetValueGeneType() const { return value_gene_type_; }
+
+size_t Genome::GetFirstValueGeneIndex() const {
+  return first_value_gene_index_;
+}
+
+size_t Genome::GetValueGeneCount() const { return value_gene_count_; }
+
+size_t Genome::GetValueGeneByteOffset() const {
+  return value_gene_count_ == 0
+             ? 0
+             : genes_[first_value_gene_index_].start_bit_index / BitsPerByte;
+}
+
+double Genome::GetValueGeneMin() const { return value_gene_min_; }
+
+double Genome::GetValueGeneMax() const { return value_gene_max_; }
+
+void Genome::Freeze() {
+  if (is_frozen_) {
+    return;
+  }
+
+  const size_t storage_bytes = BitVector::BytesRequired(BitsRequired());
+  layout_.resize(genes_.size());
+  for (size_t i = 0; i < genes_.size(); i++) {
+    const Gene& gene = genes_[i];
+    GeneLayout& layout = layout_[i];
+    layout.start_bit_index = gene.start_bit_index;
+    layout.bit_width = gene.bit_width;
+    layout.byte_offset = gene.start_bit_index / BitsPerByte;
+    layout.bit_shift =
+        static_cast<unsigned>(gene.start_bit_index % BitsPerByte);
+    layout.value_mask = gene.bit_width >= BitsPerWord
+                            ? std::numeric_limits<uint64_t>::max()
+                            : (uint64_t{1} << gene.bit_width) - 1U;
+    layout.float_scale = 1.0 / static_cast<double>(layout.value_mask);
+    layout.is_word_loadable =
+        gene.bit_width <= GeneLayout::MaxWordLoadableBitWidth &&
+        layout.byte_offset + sizeof(uint64_t) <= storage_bytes;
+  }
+  is_frozen_ = true;
+}
+
+bool Genome::IsFrozen() const { return is_frozen_; }
+
+void Genome::Save(std::ostream* stream) const {
+  WriteSize(stream, genes_.size());
+  for (const auto& gene : genes_) {
+    WriteSize(stream, gene.start_bit_index);
+    WriteSize(stream, gene.bit_width);
+  }
+  WriteSize(stream, first_boolean_gene_bit_index_);
+  WriteSize(stream, boolean_gene_count_);
+  WriteEnum(stream, value_gene_type_);
+  WriteSize(stream, first_value_gene_index_);
+  WriteSize(stream, value_gene_count_);
+  WriteBinary(stream, value_gene_min_);
+  WriteBinary(stream, value_gene_max_);
+}
+
+bool Genome::Load(std::istream* stream) {
+  size_t gene_count = 0;
+  if (!ReadSize(stream, &gene_count)) {
+    return false;
+  }
+  std::vector<Gene> genes;
+  for (size_t i = 0; i < gene_count; i++) {
+    Gene gene{};
+    if (!ReadSize(stream, &gene.start_bit_index) ||
+        !ReadSize(stream, &gene.bit_width)) {
+      return false;
+    }
+    genes.push_back(gene);
+  }
+  size_t first_boolean_gene_bit_index = 0;
+  size_t boolean_gene_count = 0;
+  ValueGeneType value_gene_type = ValueGeneType::None;
+  size_t first_value_gene_index = 0;
+  size_t value_gene_count = 0;
+  double value_gene_min = 0.0;
+  double value_gene_max = 0.0;
+  if (!ReadSize(stream, &first_boolean_gene_bit_index) ||
+      !ReadSize(stream, &boolean_gene_count) ||
+      !ReadEnum(stream, ValueGeneType::None, ValueGeneType::Int64,
+                &value_gene_type) ||
+      !ReadSize(stream, &first_value_gene_index) ||
+      !ReadSize(stream, &value_gene_count) ||
+      !ReadBinary(stream, &value_gene_min) ||
+      !ReadBinary(stream, &value_gene_max)) {
+    return false;
+  }
+  if ((value_gene_type == ValueGeneType::None) != (value_gene_count == 0) ||
+      first_value_gene_index > genes.size() ||
+      value_gene_count > genes.size() - first_value_gene_index) {
+    return false;
+  }
+
+  // Genes must fit in a word and follow one another without overlapping, with
+  // the boolean genes starting right after the last of them. Value genes are
+  // as wide as their type.
+  size_t gene_end_bit_index = 0;
+  for (const auto& gene : genes) {
+    if (gene.bit_width == 0 || gene.bit_width > BitsPerWord ||
+        gene.start_bit_index < gene_end_bit_index ||
+        gene.bit_width > std::numeric_limits<size_t>::max() -
+                             gene.start_bit_index) {
+      return false;
+    }
+    gene_end_bit_index = gene.start_bit_index + gene.bit_width;
+  }
+  const size_t value_bit_width =
+      GetValueGeneSize(value_gene_type) * BitsPerByte;
+  for (size_t i = 0; i < value_gene_count; i++) {
+    const Gene& gene = genes[first_value_gene_index + i];
+    if (gene.bit_width != value_bit_width ||
+        gene.start_bit_index % value_bit_width != 0 ||
+        (i != 0 && gene.start_bit_index !=
+                       genes[first_value_gene_index + i - 1].start_bit_index +
+                           value_bit_width)) {
+      return false;
+    }
+  }
+  if (first_boolean_gene_bit_index != gene_end_bit_index ||
+      boolean_gene_count > std::numeric_limits<size_t>::max() -
+                               first_boolean_gene_bit_index) {
+    return false;
+  }
+
+  if (genes_.empty() && boolean_gene_count_ == 0 && !is_frozen_) {
+    genes_ = std::move(genes);
+    first_boolean_gene_bit_index_ = first_boolean_gene_bit_index;
+    boolean_gene_count_ = boolean_gene_count;
+    value_gene_type_ = value_gene_type;
+    first_value_gene_index_ = first_value_gene_index;
+    value_gene_count_ = value_gene_count;
+    value_gene_min_ = value_gene_min;
+    value_gene_max_ = value_gene_max;
+  } else {
+    if (genes.size() != genes_.size() ||
+        first_boolean_gene_bit_index != first_boolean_gene_bit_index_ ||
+        boolean_gene_count != boolean_gene_count_ ||
+        value_gene_type != value_gene_type_ ||
+        first_value_gene_index != first_value_gene_index_ ||
+        value_gene_count != value_gene_count_ ||
+        value_gene_min != value_gene_min_ ||
+        value_gene_max != value_gene_max_) {
+      return false;
+    }
+    for (size_t i = 0; i < genes.size(); i++) {
+      if (genes[i].start_bit_index != genes_[i].start_bit_index ||
+          genes[i].bit_width != genes_[i].bit_width) {
+        return false;
+      }
+    }
+  }
+
+  Freeze();
+  return true;
+}
+
 }  // namespace panga
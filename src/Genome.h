@@ -8,10 +8,80 @@
 #define GENOME_H__
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <type_traits>
 #include <vector>
 
 namespace panga {
 
+/**
+ * Precomputed location of one gene with a bit width inside a
+ * chromosome.<br/>
+ * Built for every non-boolean gene when the Genome is frozen so decoding a
+ * gene doesn't need to look anything up or divide.
+ * @see Genome::Freeze
+ */
+struct GeneLayout {
+  // Genes up to this wide fit in one 64-bit load no matter which bit of the
+  // first byte they start at.
+  static constexpr size_t MaxWordLoadableBitWidth = 57;
+
+  size_t start_bit_index = 0;
+  size_t bit_width = 0;
+  // Byte holding the first bit of the gene and the position of the first bit
+  // within that byte.
+  size_t byte_offset = 0;
+  unsigned bit_shift = 0;
+  // The low |bit_width| bits set - also the largest value the gene can hold.
+  uint64_t value_mask = 0;
+  // 1 / value_mask so float genes can be scaled into [0, 1] by multiplying.
+  double float_scale = 0.0;
+  // True if the gene fits in one unaligned 64-bit load starting at
+  // |byte_offset| which doesn't run past the chromosome storage.
+  bool is_word_loadable = false;
+};
+
+/**
+ * The element type of the value genes in a Genome.<br/>
+ * Value genes hold a native float, double, or integer in host byte order so
+ * they're read and written without any decoding.
+ * @see Genome::AddValueGenes
+ */
+enum class ValueGeneType : uint8_t {
+  // The Genome has no value genes.
+  None = 0,
+  Float,
+  Double,
+  Int32,
+  Int64
+};
+
+/**
+ * Get the ValueGeneType for genes holding values of |ValueType|.
+ */
+template <typename ValueType>
+constexpr ValueGeneType ValueGeneTypeOf() {
+  if constexpr (std::is_same_v<ValueType, float>) {
+    return ValueGeneType::Float;
+  } else if constexpr (std::is_same_v<ValueType, double>) {
+    return ValueGeneType::Double;
+  } else if constexpr (std::is_same_v<ValueType, int32_t>) {
+    return ValueGeneType::Int32;
+  } else {
+    static_assert(std::is_same_v<ValueType, int64_t>,
+                  "Value genes hold float, double, int32_t, or int64_t");
+    return ValueGeneType::Int64;
+  }
+}
+
+/**
+ * Get the number of bytes each value gene of |type| takes up.
+ */
+size_t GetValueGeneSize(ValueGeneType type);
+
 /**
  * Provides a representation of the genes which, taken together, represent a
  * genome for members of a species.<br/>
@@ -20,12 +90,15 @@ namespace panga {
  * The Genome data may be constructed by adding genes one-at-a-time via AddGene
  * along with an optional number of boolean genes.<br/>
  * The genome is structured into two pieces:<br/>
- *    1. Genes with a bit width<br/>
+ *    1. Genes with a bit width, which may include one run of value genes<br/>
  *    2. Boolean genes which have only one bit value<br/>
  * For performance reasons, all of the boolean genes are located at the end of
  * the Genome. It is preferable to add a boolean gene than add a gene with bit
- * width of 1.
+ * width of 1.<br/>
+ * Once every gene has been added, the Genome may be frozen which precomputes
+ * the layout of each gene and speeds up decoding.
  * @see AddGene
+ * @see Freeze
  * @see Chromosome
  */
 class Genome {
@@ -40,6 +113,7 @@ class Genome {
   Genome(const Genome& rhs) = delete;
   Genome(Genome&& rhs) = default;
   Genome& operator=(const Genome& rhs) = delete;
+  Genome& operator=(Genome&& rhs) = default;
   ~Genome() = default;
 
   /**
@@ -55,6 +129,31 @@ class Genome {
    */
   size_t AddGene(size_t bit_width, bool byte_align = false);
 
+  /**
+   * Add |count| value genes holding native values of |ValueType| in the range
+   * [|min|, |max|] to the end of the Genome.<br/>
+   * The values are stored back to back as an array aligned to the size of
+   * |ValueType| so fitness functions can read them straight out of the
+   * chromosome via Chromosome::GetValueGenes.<br/>
+   * Note: A Genome holds a single run of value genes of one type. Calling
+   * this again extends the run and must use the same type and range without
+   * adding other genes in between.
+   * @see Chromosome::GetValueGenes
+   * @return The gene index of the first newly-added gene.
+   */
+  template <typename ValueType>
+  size_t AddValueGenes(size_t count, ValueType min, ValueType max) {
+    return AddValueGenes(ValueGeneTypeOf<ValueType>(), count,
+                         static_cast<double>(min), static_cast<double>(max));
+  }
+
+  /**
+   * Same as AddValueGenes above for values of |type|.<br/>
+   * Note: 64-bit integer bounds are only kept to double precision.
+   */
+  size_t AddValueGenes(ValueGeneType type, size_t count, double min,
+                       double max);
+
   /**
    * Set the number of boolean genes in this Genome.<br/>
    * This overwrites any value currently in the boolean gene count.
@@ -87,6 +186,14 @@ class Genome {
    */
   size_t GetGeneBitWitdh(size_t gene_index) const;
 
+  /**
+   * Get the index of the gene which holds the bit at |bit_index|.<br/>
+   * Byte-aligned genes may leave padding bits between genes which don't
+   * belong to any gene.
+   * @return GetGeneCount() if the bit doesn't belong to a gene.
+   */
+  size_t GetGeneIndexForBit(size_t bit_index) const;
+
   /**
    * Get the bit index of the first boolean gene in the Genome.
    */
@@ -103,15 +210,89 @@ class Genome {
    */
   size_t GetGeneCount() const;
 
+  /**
+   * Get the type of the value genes in this Genome.
+   * @return ValueGeneType::None if the Genome has no value genes.
+   */
+  ValueGeneType GetValueGeneType() const;
+
+  /**
+   * Get the gene index of the first value gene and the number of value
+   * genes.
+   */
+  size_t GetFirstValueGeneIndex() const;
+  size_t GetValueGeneCount() const;
+
+  /**
+   * Get the byte offset of the first value gene within a chromosome.
+   */
+  size_t GetValueGeneByteOffset() const;
+
+  /**
+   * Get the range every value gene is kept inside of.
+   */
+  double GetValueGeneMin() const;
+  double GetValueGeneMax() const;
+
   /**
    * Get the number of bits needed to encode this Genome.
    */
   size_t BitsRequired() const;
 
+  /**
+   * Precompute the layout of every gene with a bit width.<br/>
+   * After freezing, no more genes may be added. Chromosomes using a frozen
+   * Genome decode genes from the layout table and may use the bulk decoders.
+   * Freezing an already frozen Genome does nothing.<br/>
+   * GeneticAlgorithm::Initialize freezes the genome of the genetic algorithm.
+   * @see GetGeneLayout
+   * @see Chromosome::DecodeAllIntegerGenes
+   */
+  void Freeze();
+
+  /**
+   * Returns true if the layout of the genes has been computed.
+   * @see Freeze
+   */
+  bool IsFrozen() const;
+
+  /**
+   * Write the genes of this Genome to |stream| in the binary checkpoint
+   * format.
+   * @see Load
+   */
+  void Save(std::ostream* stream) const;
+
+  /**
+   * Read genes written by Save from |stream| and freeze the Genome.<br/>
+   * An empty Genome takes on the stored genes. Otherwise the stored genes
+   * must match the genes already in this Genome.
+   * @return false if the stream is truncated or the genes don't match.
+   */
+  bool Load(std::istream* stream);
+
+  /**
+   * Get the precomputed layout of the gene at |gene_index|.<br/>
+   * Note: Requires the Genome to be frozen and |gene_index| must not be the
+   * index of a boolean gene.
+   */
+  const GeneLayout& GetGeneLayout(size_t gene_index) const {
+    assert(is_frozen_);
+    assert(gene_index < layout_.size());
+    return layout_[gene_index];
+  }
+
  private:
   std::vector<Gene> genes_;
+  std::vector<GeneLayout> layout_;
   size_t first_boolean_gene_bit_index_ = 0;
   size_t boolean_gene_count_ = 0;
+  ValueGeneType value_gene_type_ = ValueGeneType::None;
+  size_t first_value_gene_index_ = 0;
+  size_t value_gene_count_ = 0;
+  double value_gene_min_ = 0.0;
+  double value_gene_max_ = 0.0;
+  bool is_frozen_ = false;
 };
 
 }  // namespace panga
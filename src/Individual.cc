@@ -8,6 +8,7 @@
 
 #include <algorithm>
 #include <cassert>
+#include <utility>
 
 #include "Genome.h"
 
@@ -23,25 +24,67 @@ Individual::Individual(const Genome& genome, const BitVector& chromosome)
   BitVector::operator=(chromosome);
 }
 
+Individual::Individual(const Genome& genome, const Storage& storage)
+    : Chromosome(genome, storage.bytes, storage.byte_capacity),
+      fitness_(storage.fitness),
+      score_(storage.score) {
+  assert(fitness_ != nullptr);
+  assert(score_ != nullptr);
+  *fitness_ = 0.0;
+  *score_ = 0.0;
+}
+
+Individual::Individual(Individual&& rhs) noexcept
+    : Chromosome(std::move(rhs)),
+      fitness_(rhs.fitness_),
+      score_(rhs.score_),
+      owned_fitness_(rhs.owned_fitness_),
+      owned_score_(rhs.owned_score_),
+      is_dirty_(rhs.is_dirty_) {
+  // Scores owned by |rhs| move along with this object.
+  if (fitness_ == &rhs.owned_fitness_) {
+    fitness_ = &owned_fitness_;
+  }
+  if (score_ == &rhs.owned_score_) {
+    score_ = &owned_score_;
+  }
+}
+
 Individual& Individual::operator=(const Individual& rhs) {
   if (this != &rhs) {
-    score_ = rhs.score_;
-    fitness_ = rhs.fitness_;
+    *score_ = *rhs.score_;
+    *fitness_ = *rhs.fitness_;
+    is_dirty_ = rhs.is_dirty_;
     BitVector::operator=(rhs);
   }
   return *this;
 }
 
 bool Individual::operator<(const Individual& rhs) const {
-  return score_ < rhs.score_;
+  return *score_ < *rhs.score_;
 }
 
-double Individual::GetFitness() const { return fitness_; }
+double Individual::GetFitness() const { return *fitness_; }
 
-double Individual::GetScore() const { return score_; }
+double Individual::GetScore() const { return *score_; }
 
-void Individual::SetFitness(double fitness) { fitness_ = fitness; }
+void Individual::SetFitness(double fitness) { *fitness_ = fitness; }
 
-void Individual::SetScore(double score) { score_ = score; }
+void Individual::SetScore(double score) { *score_ = score; }
+
+bool Individual::IsDirty() const { return is_dirty_; }
+
+void Individual::SetDirty(bool is_dirty) { is_dirty_ = is_dirty; }
+
+void Individual::AttachStorage(const Storage& storage) {
+  assert(storage.fitness != nullptr);
+  assert(storage.score != nullptr);
+
+  *storage.fitness = *fitness_;
+  *storage.score = *score_;
+  fitness_ = storage.fitness;
+  score_ = storage.score;
+  BitVector::AttachStorage(storage.bytes, storage.byte_capacity);
+}
 
 }  // namespace panga
@@ -15,14 +15,36 @@ class BitVector;
 class Genome;
 
 /**
- * An Individual is a Chromosome with a fitness score.
+ * An Individual is a Chromosome with a fitness score.<br/>
+ * A standalone Individual owns its bits and scores. Individuals inside a
+ * Population are views into storage owned by the Population instead.
+ * @see Population
  */
 class Individual : public Chromosome {
  public:
+  /**
+   * Locations where a view Individual stores its data.
+   */
+  struct Storage {
+    std::byte* bytes = nullptr;
+    size_t byte_capacity = 0;
+    double* score = nullptr;
+    double* fitness = nullptr;
+  };
+
   explicit Individual(const Genome& genome);
   Individual(const Genome& genome, const BitVector& chromosome);
+
+  /**
+   * Construct an Individual whose chromosome bits, score, and fitness live in
+   * |storage|.<br/>
+   * The chromosome starts out with all bits unset and a score and fitness of
+   * zero.<br/>
+   * Note: |storage| must outlive the Individual.
+   */
+  Individual(const Genome& genome, const Storage& storage);
   Individual(const Individual& rhs) = delete;
-  Individual(Individual&& rhs) = default;
+  Individual(Individual&& rhs) noexcept;
   ~Individual() = default;
 
   /**
@@ -51,16 +73,42 @@ class Individual : public Chromosome {
   double GetFitness() const;
   void SetFitness(double fitness);
 
+  /**
+   * An Individual is dirty when its chromosome may have changed since it was
+   * last scored.<br/>
+   * New Individuals start out dirty and scoring one makes it clean. Copying an
+   * Individual copies the flag along with the score. The genetic operators
+   * mark the Individuals they change as dirty.<br/>
+   * Note: Call SetDirty(true) after modifying the chromosome directly.
+   */
+  bool IsDirty() const;
+  void SetDirty(bool is_dirty);
+
+  /**
+   * Copy the chromosome bits, score, and fitness of this Individual into
+   * |storage| and keep using |storage| from now on.
+   * @see BitVector::AttachStorage
+   */
+  void AttachStorage(const Storage& storage);
+
  private:
   /**
    * Proportional fitness score.
    */
-  double fitness_ = 0.0;
+  double* fitness_ = &owned_fitness_;
 
   /**
    * Raw score received from fitness function.
    */
-  double score_ = 0.0;
+  double* score_ = &owned_score_;
+
+  /**
+   * Storage used for the scores when this Individual isn't a view.
+   */
+  double owned_fitness_ = 0.0;
+  double owned_score_ = 0.0;
+
+  bool is_dirty_ = true;
 };
 
 }  // namespace panga
@@ -0,0 +1,103 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include "Instrumentation.h"
+
+#include <cassert>
+#include <string>
+
+namespace {
+
+constexpr const char* StepPhaseNames[] = {"InitializeSelector", "Offspring",
+                                          "Elitism", "Evaluation", "Sort"};
+static_assert(sizeof(StepPhaseNames) / sizeof(StepPhaseNames[0]) ==
+                  panga::StepPhaseCount,
+              "Every StepPhase needs a name");
+
+constexpr uint64_t NanosecondsPerMicrosecond = 1000;
+constexpr size_t FractionDigits = 3;
+
+// Trace timestamps are in microseconds. Format |nanoseconds| as a decimal
+// count of microseconds without going through floating point.
+std::string ToMicroseconds(uint64_t nanoseconds) {
+  std::string fraction =
+      std::to_string(nanoseconds % NanosecondsPerMicrosecond);
+  fraction.insert(0, FractionDigits - fraction.size(), '0');
+  return std::to_string(nanoseconds / NanosecondsPerMicrosecond) + "." +
+         fraction;
+}
+
+}  // namespace
+
+namespace panga {
+
+const char* GetStepPhaseName(StepPhase phase) {
+  const auto index = static_cast<size_t>(phase);
+  assert(index < StepPhaseCount);
+  return StepPhaseNames[index];
+}
+
+ChromeTraceWriter::ChromeTraceWriter(std::ostream* stream) : stream_(stream) {
+  assert(stream_ != nullptr);
+  *stream_ << "{\"traceEvents\":[";
+}
+
+ChromeTraceWriter::~ChromeTraceWriter() { Finish(); }
+
+void ChromeTraceWriter::Write(const StepStats& stats) {
+  assert(!is_finished_);
+
+  for (size_t i = 0; i < StepPhaseCount; i++) {
+    const auto phase = static_cast<StepPhase>(i);
+    const auto& timing = stats.GetPhase(phase);
+    BeginEvent();
+    *stream_ << "{\"name\":\"" << GetStepPhaseName(phase)
+             << "\",\"cat\":\"panga\",\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+             << "\"ts\":"
+             << ToMicroseconds(stats.start_nanoseconds +
+                               timing.start_nanoseconds)
+             << ",\"dur\":" << ToMicroseconds(timing.duration_nanoseconds)
+             << ",\"args\":{\"generation\":" << stats.generation;
+    if (phase == StepPhase::Offspring) {
+      *stream_ << ",\"selection_us\":"
+               << ToMicroseconds(stats.selection_nanoseconds)
+               << ",\"crossover_us\":"
+               << ToMicroseconds(stats.crossover_nanoseconds)
+               << ",\"mutation_us\":"
+               << ToMicroseconds(stats.mutation_nanoseconds);
+    }
+    *stream_ << "}}";
+  }
+
+  BeginEvent();
+  *stream_ << "{\"name\":\"Counters\",\"cat\":\"panga\",\"ph\":\"C\","
+           << "\"pid\":0,\"ts\":" << ToMicroseconds(stats.start_nanoseconds)
+           << ",\"args\":{\"evaluations\":" << stats.evaluation_count
+           << ",\"fitness_cache_hits\":" << stats.fitness_cache_hit_count
+           << ",\"chromosome_copies\":" << stats.chromosome_copy_count
+           << ",\"bytes_copied\":" << stats.bytes_copied
+           << ",\"random_draws\":" << stats.random_draw_count
+           << ",\"screened_offspring\":" << stats.screened_offspring_count
+           << "}}";
+}
+
+void ChromeTraceWriter::Finish() {
+  if (is_finished_) {
+    return;
+  }
+  *stream_ << "]}";
+  stream_->flush();
+  is_finished_ = true;
+}
+
+void ChromeTraceWriter::BeginEvent() {
+  if (has_events_) {
+    *stream_ << ",";
+  }
+  has_events_ = true;
+}
+
+}  // namespace panga
@@ -0,0 +1,224 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef INSTRUMENTATION_H__
+#define INSTRUMENTATION_H__
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+namespace panga {
+
+/**
+ * Instrumentation is compiled in by defining PANGA_ENABLE_INSTRUMENTATION
+ * (or configuring cmake with -DPANGA_ENABLE_INSTRUMENTATION=ON).<br/>
+ * Without it, every timer and counter compiles away to nothing and StepStats
+ * are never filled in.
+ */
+#if defined(PANGA_ENABLE_INSTRUMENTATION)
+constexpr bool IsInstrumentationEnabled = true;
+#else
+constexpr bool IsInstrumentationEnabled = false;
+#endif
+
+/**
+ * The phases of GeneticAlgorithm::Step which are timed, in the order they
+ * run.
+ */
+enum class StepPhase : uint8_t {
+  /**
+   * Choosing the mutation rate for the generation and preparing the selector.
+   */
+  InitializeSelector = 0,
+
+  /**
+   * Selecting parents for every offspring, crossing them over, and mutating
+   * the result.
+   */
+  Offspring,
+
+  /**
+   * Copying or moving elites and other exact clones of last generation
+   * individuals into the new population and mutating them.
+   */
+  Elitism,
+
+  /**
+   * Looking up cached scores and running the fitness function.
+   */
+  Evaluation,
+
+  /**
+   * Ranking the population by score and calculating fitness values.
+   */
+  Sort
+};
+
+constexpr size_t StepPhaseCount = 5;
+
+/**
+ * Get a printable name for |phase|.
+ */
+const char* GetStepPhaseName(StepPhase phase);
+
+/**
+ * When one phase of a step ran.
+ */
+struct PhaseTiming {
+  /**
+   * Nanoseconds from the start of the step to the start of the phase.
+   */
+  uint64_t start_nanoseconds = 0;
+
+  uint64_t duration_nanoseconds = 0;
+};
+
+/**
+ * Timings and counters collected during one GeneticAlgorithm::Step.<br/>
+ * Only filled in when instrumentation is compiled in.
+ * @see IsInstrumentationEnabled
+ */
+struct StepStats {
+  /**
+   * The generation this step produced.
+   */
+  size_t generation = 0;
+
+  /**
+   * Nanoseconds since the steady clock epoch at which the step started.
+   */
+  uint64_t start_nanoseconds = 0;
+
+  /**
+   * Wall-clock time of each phase, indexed by StepPhase.
+   */
+  std::array<PhaseTiming, StepPhaseCount> phases{};
+
+  /**
+   * Thread time spent selecting parents, crossing them over, and mutating
+   * offspring during the Offspring phase, summed over every thread.
+   */
+  uint64_t selection_nanoseconds = 0;
+  uint64_t crossover_nanoseconds = 0;
+  uint64_t mutation_nanoseconds = 0;
+
+  /**
+   * Number of individuals passed to the fitness function.
+   */
+  size_t evaluation_count = 0;
+
+  /**
+   * Number of individuals whose score was found in the fitness cache.
+   */
+  size_t fitness_cache_hit_count = 0;
+
+  /**
+   * Number of chromosomes copied from the last generation and the bytes
+   * those copies wrote. Clones which take over the storage of their source
+   * aren't counted.
+   */
+  size_t chromosome_copy_count = 0;
+  size_t bytes_copied = 0;
+
+  /**
+   * Number of 64-bit words drawn from random engines while creating
+   * offspring and mutating clones.
+   */
+  uint64_t random_draw_count = 0;
+
+  /**
+   * Number of changed candidate offspring discarded by screening, each an
+   * evaluation of the fitness function saved.
+   */
+  size_t screened_offspring_count = 0;
+
+  const PhaseTiming& GetPhase(StepPhase phase) const {
+    return phases[static_cast<size_t>(phase)];
+  }
+};
+
+/**
+ * Receives the StepStats of every GeneticAlgorithm::Step as it finishes.
+ * @see GeneticAlgorithm::SetStepStatsCallback
+ */
+using StepStatsCallback = std::function<void(const StepStats&)>;
+
+/**
+ * Read the steady clock in nanoseconds.<br/>
+ * Returns 0 without touching the clock when instrumentation is compiled out.
+ */
+inline uint64_t InstrumentationNow() {
+  if constexpr (IsInstrumentationEnabled) {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+  } else {
+    return 0;
+  }
+}
+
+/**
+ * Record that |phase| of the step tracked by |stats| ran from |begin|, as
+ * returned by InstrumentationNow, until now.
+ */
+inline void RecordPhase(StepStats* stats, StepPhase phase, uint64_t begin) {
+  if constexpr (IsInstrumentationEnabled) {
+    auto& timing = stats->phases[static_cast<size_t>(phase)];
+    timing.start_nanoseconds = begin - stats->start_nanoseconds;
+    timing.duration_nanoseconds = InstrumentationNow() - begin;
+  }
+}
+
+/**
+ * Writes StepStats as Chrome trace event JSON which can be loaded by
+ * chrome://tracing, Perfetto, and other tools understanding the format.<br/>
+ * Each phase becomes a complete event and the counters of each step become
+ * counter events. Pass an instance of this to
+ * GeneticAlgorithm::SetStepStatsCallback via a lambda or call Write from
+ * your own callback.
+ */
+class ChromeTraceWriter {
+ public:
+  /**
+   * Construct a writer which writes to |stream|.<br/>
+   * |stream| must outlive the writer.
+   */
+  explicit ChromeTraceWriter(std::ostream* stream);
+  ChromeTraceWriter(const ChromeTraceWriter& rhs) = delete;
+  ChromeTraceWriter& operator=(const ChromeTraceWriter& rhs) = delete;
+
+  /**
+   * Finish the trace if it hasn't been finished yet.
+   */
+  ~ChromeTraceWriter();
+
+  /**
+   * Append the events describing |stats| to the trace.
+   */
+  void Write(const StepStats& stats);
+
+  /**
+   * Close the JSON document. No more events may be written afterwards.
+   */
+  void Finish();
+
+ protected:
+  void BeginEvent();
+
+ private:
+  std::ostream* stream_;
+  bool has_events_ = false;
+  bool is_finished_ = false;
+};
+
+}  // namespace panga
+
+#endif  // INSTRUMENTATION_H__
@@ -0,0 +1,293 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include "IslandModel.h"
+
+#include <cassert>
+#include <exception>
+#include <functional>
+#include <thread>
+#include <utility>
+
+#include "Individual.h"
+#include "Population.h"
+#include "ThreadPool.h"
+
+namespace panga {
+
+IslandModel::Mailbox::~Mailbox() {
+  std::vector<Migrant> unclaimed;
+  Collect(&unclaimed);
+}
+
+void IslandModel::Mailbox::Post(std::vector<Migrant> migrants) {
+  auto* node =
+      new Node{std::move(migrants), head_.load(std::memory_order_relaxed)};
+  while (!head_.compare_exchange_weak(node->next, node,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+void IslandModel::Mailbox::Collect(std::vector<Migrant>* migrants) {
+  assert(migrants != nullptr);
+
+  // Taking the whole list at once means the consumer never races with other
+  // consumers and producers only ever touch the head.
+  Node* node = head_.exchange(nullptr, std::memory_order_acquire);
+  while (node != nullptr) {
+    const std::unique_ptr<Node> owned_node(node);
+    for (auto& migrant : node->migrants) {
+      migrants->push_back(std::move(migrant));
+    }
+    node = node->next;
+  }
+}
+
+IslandModel::IslandModel(size_t island_count) {
+  assert(island_count != 0);
+
+  islands_.reserve(island_count);
+  for (size_t i = 0; i < island_count; i++) {
+    islands_.push_back(std::make_unique<GeneticAlgorithm>());
+  }
+  mailboxes_ = std::make_unique<Mailbox[]>(island_count);
+  migration_randoms_ = std::make_unique<RandomWrapper[]>(island_count);
+  island_cpus_.resize(island_count);
+}
+
+IslandModel::~IslandModel() = default;
+
+size_t IslandModel::GetIslandCount() const { return islands_.size(); }
+
+GeneticAlgorithm& IslandModel::GetIsland(size_t island_index) {
+  assert(island_index < islands_.size());
+  return *islands_[island_index];
+}
+
+const GeneticAlgorithm& IslandModel::GetIsland(size_t island_index) const {
+  assert(island_index < islands_.size());
+  return *islands_[island_index];
+}
+
+void IslandModel::SetMigrationInterval(size_t migration_interval) {
+  migration_interval_ = migration_interval;
+}
+
+size_t IslandModel::GetMigrationInterval() const { return migration_interval_; }
+
+void IslandModel::SetMigrantCount(size_t migrant_count) {
+  migrant_count_ = migrant_count;
+}
+
+size_t IslandModel::GetMigrantCount() const { return migrant_count_; }
+
+void IslandModel::SetMigrationTopology(MigrationTopology migration_topology) {
+  migration_topology_ = migration_topology;
+}
+
+IslandModel::MigrationTopology IslandModel::GetMigrationTopology() const {
+  return migration_topology_;
+}
+
+void IslandModel::SetMigrationTransport(
+    MigrationTransport* migration_transport) {
+  migration_transport_ = migration_transport;
+}
+
+void IslandModel::SetIslandCpus(size_t island_index,
+                                std::vector<size_t> cpus) {
+  assert(island_index < island_cpus_.size());
+  island_cpus_[island_index] = std::move(cpus);
+}
+
+const std::vector<size_t>& IslandModel::GetIslandCpus(
+    size_t island_index) const {
+  assert(island_index < island_cpus_.size());
+  return island_cpus_[island_index];
+}
+
+void IslandModel::SetRandomSeed(uint64_t random_seed) {
+  random_.SetSeed(random_seed);
+}
+
+uint64_t IslandModel::GetRandomSeed() { return random_.GetSeed(); }
+
+void IslandModel::Initialize() {
+  const uint64_t seed = random_.GetSeed();
+  const size_t island_count = islands_.size();
+  // Populations are allocated by the thread which initializes them so doing
+  // that on the island threads keeps them local to the island.
+  RunOnIslandThreads([&](size_t island_index) {
+    auto& island = *islands_[island_index];
+    island.SetRandomSeed(RandomWrapper::DeriveSeed(seed, island_index));
+    island.Initialize();
+    migration_randoms_[island_index].SetSeed(
+        RandomWrapper::DeriveSeed(seed, island_count + island_index));
+
+    // Drop migrants left over from an earlier run.
+    std::vector<Migrant> unclaimed;
+    mailboxes_[island_index].Collect(&unclaimed);
+  });
+  accepted_migrant_count_ = 0;
+  rejected_migrant_count_ = 0;
+}
+
+void IslandModel::Run(size_t generation_count) {
+  RunOnIslandThreads([this, generation_count](size_t island_index) {
+    RunIsland(island_index, generation_count);
+  });
+}
+
+void IslandModel::RunOnIslandThreads(
+    const std::function<void(size_t)>& function) {
+  const size_t island_count = islands_.size();
+  std::vector<std::exception_ptr> exceptions(island_count);
+  const auto run_island = [&](size_t island_index) {
+    try {
+      function(island_index);
+    } catch (...) {
+      exceptions[island_index] = std::current_exception();
+    }
+  };
+  const auto run_pinned_island = [&](size_t island_index) {
+    if (!island_cpus_[island_index].empty()) {
+      ThreadPool::SetCurrentThreadAffinity(island_cpus_[island_index]);
+    }
+    run_island(island_index);
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(island_count - 1U);
+  for (size_t i = 1; i < island_count; i++) {
+    threads.emplace_back(run_pinned_island, i);
+  }
+
+  // The calling thread runs the first island and gets its own affinity back
+  // afterwards.
+  if (island_cpus_[0].empty()) {
+    run_island(0);
+  } else {
+    const std::vector<size_t> caller_cpus =
+        ThreadPool::GetCurrentThreadAffinity();
+    run_pinned_island(0);
+    if (!caller_cpus.empty()) {
+      ThreadPool::SetCurrentThreadAffinity(caller_cpus);
+    }
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  for (const auto& exception : exceptions) {
+    if (exception) {
+      std::rethrow_exception(exception);
+    }
+  }
+}
+
+void IslandModel::RunIsland(size_t island_index, size_t generation_count) {
+  auto& island = *islands_[island_index];
+  for (size_t i = 0; i < generation_count; i++) {
+    island.Step();
+
+    // Generations are counted from 0 so the island has evaluated one more
+    // generation than the current one.
+    if (migration_interval_ != 0 &&
+        (island.GetCurrentGeneration() + 1U) % migration_interval_ == 0) {
+      Migrate(island_index);
+    }
+  }
+}
+
+void IslandModel::Migrate(size_t island_index) {
+  auto& island = *islands_[island_index];
+  const size_t island_count = islands_.size();
+
+  std::vector<const Individual*> best;
+  island.GetPopulation().GetBestIndividuals(migrant_count_, &best);
+  std::vector<Migrant> emigrants;
+  emigrants.reserve(best.size());
+  for (const Individual* individual : best) {
+    emigrants.push_back({BitVector(*individual), individual->GetScore()});
+  }
+
+  if (!emigrants.empty()) {
+    if (migration_transport_ != nullptr) {
+      migration_transport_->Send(island_index, emigrants);
+    }
+
+    if (island_count > 1U) {
+      switch (migration_topology_) {
+        case MigrationTopology::Ring:
+          mailboxes_[(island_index + 1U) % island_count].Post(
+              std::move(emigrants));
+          break;
+        case MigrationTopology::FullyConnected:
+          for (size_t i = 0; i < island_count; i++) {
+            if (i != island_index) {
+              mailboxes_[i].Post(emigrants);
+            }
+          }
+          break;
+        case MigrationTopology::Random: {
+          // Pick any island but this one. The bound is inclusive.
+          auto destination = static_cast<size_t>(
+              migration_randoms_[island_index].RandomBounded(island_count -
+                                                             2U));
+          if (destination >= island_index) {
+            destination++;
+          }
+          mailboxes_[destination].Post(std::move(emigrants));
+          break;
+        }
+        default:
+          assert(false);
+      }
+    }
+  }
+
+  std::vector<Migrant> immigrants;
+  mailboxes_[island_index].Collect(&immigrants);
+  if (migration_transport_ != nullptr) {
+    migration_transport_->Receive(island_index, &immigrants);
+  }
+  const size_t bit_count = island.GetGenome().BitsRequired();
+  for (const auto& migrant : immigrants) {
+    if (migrant.chromosome.GetBitCount() != bit_count) {
+      rejected_migrant_count_++;
+      continue;
+    }
+    // The score came from the fitness function of the sending island so the
+    // immigrant is scored again by this one.
+    Individual immigrant(island.GetGenome(), migrant.chromosome);
+    immigrant.SetDirty(true);
+    if (island.ReplaceWorstIndividual(&immigrant)) {
+      accepted_migrant_count_++;
+    }
+  }
+}
+
+const Individual& IslandModel::GetBestIndividual() const {
+  const Individual* best = &islands_[0]->GetPopulation().GetBestIndividual();
+  for (size_t i = 1; i < islands_.size(); i++) {
+    const auto& candidate = islands_[i]->GetPopulation().GetBestIndividual();
+    if (candidate < *best) {
+      best = &candidate;
+    }
+  }
+  return *best;
+}
+
+size_t IslandModel::GetAcceptedMigrantCount() const {
+  return accepted_migrant_count_;
+}
+
+size_t IslandModel::GetRejectedMigrantCount() const {
+  return rejected_migrant_count_;
+}
+
+}  // namespace panga
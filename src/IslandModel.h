@@ -0,0 +1,284 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef ISLANDMODEL_H__
+#define ISLANDMODEL_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "BitVector.h"
+#include "GeneticAlgorithm.h"
+#include "RandomWrapper.h"
+
+namespace panga {
+
+class Individual;
+
+/**
+ * An Individual leaving one island for another.<br/>
+ * Only the chromosome bits and the score travel so migrants can be
+ * serialized and sent between processes. The score is the one given by the
+ * sending island - the island a migrant arrives at scores it again with its
+ * own fitness function before inserting it.
+ */
+struct Migrant {
+  BitVector chromosome;
+  double score = 0.0;
+};
+
+/**
+ * Moves migrants between islands which live in different processes or on
+ * different nodes.<br/>
+ * Note: Send and Receive are called from the thread running each island, so
+ * implementations must be thread-safe.
+ * @see IslandModel::SetMigrationTransport
+ */
+class MigrationTransport {
+ public:
+  virtual ~MigrationTransport() = default;
+
+  /**
+   * Send |migrants| which left the local island |island_index| to any remote
+   * islands.
+   */
+  virtual void Send(size_t island_index,
+                    const std::vector<Migrant>& migrants) = 0;
+
+  /**
+   * Append any migrants which arrived from remote islands for the local
+   * island |island_index| to |migrants|. Must not block waiting for
+   * migrants to arrive.
+   */
+  virtual void Receive(size_t island_index, std::vector<Migrant>* migrants) = 0;
+};
+
+/**
+ * Runs several GeneticAlgorithm islands side by side, each on its own thread,
+ * and periodically moves the best Individuals of each island to others.<br/>
+ * Islands evolve independently between migrations which keeps their
+ * populations diverse while still sharing good solutions.<br/>
+ * Every migration_interval_ generations, an island sends copies of its
+ * migrant_count_ best Individuals to the islands picked by the migration
+ * topology and inserts any migrants which arrived for it in place of its
+ * worst Individuals. Islands never wait for each other - migrants are posted
+ * to a lock-free mailbox and picked up by the destination whenever it next
+ * migrates.<br/>
+ * Each island can be kept on one NUMA node by pinning the thread it runs on
+ * via SetIslandCpus. Islands are initialized on those threads as well so
+ * their populations live in memory local to the node, leaving migrants as
+ * the only data which crosses nodes.<br/>
+ * Note: Since islands run at their own pace, the order in which migrants
+ * arrive depends on timing so runs with the same seed may differ once
+ * migration is enabled.
+ */
+class IslandModel {
+ public:
+  /**
+   * Chooses which islands receive the migrants of each island.
+   * @see SetMigrationTopology
+   */
+  enum class MigrationTopology : uint8_t {
+    /**
+     * Island i sends its migrants to island i + 1 with the last island
+     * sending to the first.
+     */
+    Ring = 1,
+
+    /**
+     * Every island sends its migrants to every other island.
+     */
+    FullyConnected,
+
+    /**
+     * Each migration, an island sends its migrants to one other island
+     * chosen at random.
+     */
+    Random
+  };
+
+  /**
+   * Construct a model made of |island_count| islands.
+   */
+  explicit IslandModel(size_t island_count);
+  IslandModel(const IslandModel& rhs) = delete;
+  IslandModel& operator=(const IslandModel& rhs) = delete;
+  ~IslandModel();
+
+  size_t GetIslandCount() const;
+
+  /**
+   * Get the GeneticAlgorithm running island |island_index|.<br/>
+   * Configure the genome, fitness function, and operators of every island
+   * through this before calling Initialize. Islands may use different
+   * settings, including different fitness functions, but their genomes must
+   * require the same number of bits.
+   */
+  GeneticAlgorithm& GetIsland(size_t island_index);
+  const GeneticAlgorithm& GetIsland(size_t island_index) const;
+
+  /**
+   * Islands migrate after every |migration_interval| generations they
+   * evaluate.<br/>
+   * If |migration_interval| is 0, islands never migrate.
+   */
+  void SetMigrationInterval(size_t migration_interval);
+  size_t GetMigrationInterval() const;
+
+  /**
+   * Number of the best Individuals from an island which migrate each
+   * time.
+   */
+  void SetMigrantCount(size_t migrant_count);
+  size_t GetMigrantCount() const;
+
+  /**
+   * @see MigrationTopology
+   */
+  void SetMigrationTopology(MigrationTopology migration_topology);
+  MigrationTopology GetMigrationTopology() const;
+
+  /**
+   * Exchange migrants with islands in other processes through
+   * |migration_transport| in addition to the islands of this model.<br/>
+   * The transport must outlive the model. Passing nullptr, the default,
+   * keeps migration within this process.
+   */
+  void SetMigrationTransport(MigrationTransport* migration_transport);
+
+  /**
+   * Run island |island_index| on a thread restricted to |cpus|.<br/>
+   * Give the island a ThreadPool pinned to the same CPUs via
+   * GeneticAlgorithm::SetThreadPool to keep its parallel work there too.
+   * <br/>Pinning is best-effort and an empty |cpus|, the default, lets the
+   * island run anywhere. Call this before Initialize().
+   * @see ThreadPool::GetNodeCpus
+   */
+  void SetIslandCpus(size_t island_index, std::vector<size_t> cpus);
+  const std::vector<size_t>& GetIslandCpus(size_t island_index) const;
+
+  /**
+   * Set the seed every island seed is derived from.<br/>
+   * If no seed is set, a random one is chosen when it's first needed.
+   * Call this before Initialize().
+   */
+  void SetRandomSeed(uint64_t random_seed);
+  uint64_t GetRandomSeed();
+
+  /**
+   * Seed and initialize every island, each on its own thread.<br/>
+   * Each island gets a seed of its own derived from the model seed.
+   * @see GeneticAlgorithm::Initialize
+   */
+  void Initialize();
+
+  /**
+   * Step every island |generation_count| times, each on its own thread,
+   * migrating as configured.<br/>
+   * Blocks until every island is done. If an island throws, the first
+   * exception thrown is rethrown after all islands have stopped.
+   */
+  void Run(size_t generation_count);
+
+  /**
+   * Return the best Individual found by any island.<br/>
+   * Note: Requires every island to have evaluated its population.
+   */
+  const Individual& GetBestIndividual() const;
+
+  /**
+   * Get the number of migrants which took the place of an Individual on
+   * the island they arrived at.
+   */
+  size_t GetAcceptedMigrantCount() const;
+
+  /**
+   * Get the number of migrants which were dropped because their chromosome
+   * didn't have as many bits as the genome of the island they arrived at.
+   * <br/>Migrants from other processes are checked as well so a transport
+   * with a mismatched genome can't corrupt an island.
+   */
+  size_t GetRejectedMigrantCount() const;
+
+ protected:
+  static constexpr size_t DefaultMigrationInterval = 10;
+  static constexpr size_t DefaultMigrantCount = 2;
+
+  /**
+   * Lock-free multi-producer single-consumer queue of migrant batches sent
+   * to one island.<br/>
+   * Any island may Post to the mailbox but only the owning island Collects.
+   */
+  class Mailbox {
+   public:
+    Mailbox() = default;
+    Mailbox(const Mailbox& rhs) = delete;
+    Mailbox& operator=(const Mailbox& rhs) = delete;
+    ~Mailbox();
+
+    /**
+     * Add |migrants| to the mailbox.
+     */
+    void Post(std::vector<Migrant> migrants);
+
+    /**
+     * Take every migrant posted so far and append them to |migrants|.
+     */
+    void Collect(std::vector<Migrant>* migrants);
+
+   private:
+    struct Node {
+      std::vector<Migrant> migrants;
+      Node* next = nullptr;
+    };
+
+    std::atomic<Node*> head_{nullptr};
+  };
+
+  /**
+   * Step island |island_index| |generation_count| times, migrating after
+   * every migration_interval_ generations.
+   */
+  void RunIsland(size_t island_index, size_t generation_count);
+
+  /**
+   * Call |function| with the index of every island, each on its own thread
+   * pinned to the CPUs of that island.<br/>
+   * The calling thread runs the first island. Rethrows the first exception
+   * thrown by |function| after every island is done.
+   */
+  void RunOnIslandThreads(const std::function<void(size_t)>& function);
+
+  /**
+   * Send the best Individuals of island |island_index| to its destinations
+   * and insert the migrants which arrived for it.
+   */
+  void Migrate(size_t island_index);
+
+ private:
+  std::vector<std::unique_ptr<GeneticAlgorithm>> islands_;
+  std::unique_ptr<Mailbox[]> mailboxes_;
+  // Chooses destinations for the random topology, one per island.
+  std::unique_ptr<RandomWrapper[]> migration_randoms_;
+  std::vector<std::vector<size_t>> island_cpus_;
+  RandomWrapper random_;
+
+  MigrationTransport* migration_transport_ = nullptr;
+  std::atomic<size_t> accepted_migrant_count_{0};
+  std::atomic<size_t> rejected_migrant_count_{0};
+
+  size_t migration_interval_ = DefaultMigrationInterval;
+  size_t migrant_count_ = DefaultMigrantCount;
+  MigrationTopology migration_topology_ = MigrationTopology::Ring;
+};
+
+}  // namespace panga
+
+#endif  // ISLANDMODEL_H__
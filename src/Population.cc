@@ -7,38 +7,431 @@
 #include "Population.h"
 
 #include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <utility>
 
+#include "BinaryStream.h"
+#include "BitVector.h"
+#include "FitnessCache.h"
+#include "Genome.h"
 #include "Individual.h"
+#include "Instrumentation.h"
 #include "RandomWrapper.h"
+#include "ReproductionBackend.h"
+#include "ThreadPool.h"
+
+namespace {
+
+constexpr size_t CacheLineSize = 64;
+
+// AliasSelect gives up rejecting an excluded individual after this many
+// tries. Only a population with nearly all of its fitness in one individual
+// gets that far.
+constexpr size_t MaxAliasRejections = 64;
+
+/**
+ * Get the number of bytes between the chromosomes of neighboring individuals
+ * in the arena given each chromosome needs |chromosome_bytes| bytes.<br/>
+ * Chromosomes of a cache line or more are padded to whole cache lines.
+ * Smaller ones are padded to a power of two so no chromosome straddles a
+ * cache line.
+ */
+size_t ChromosomeStride(size_t chromosome_bytes) {
+  if (chromosome_bytes >= CacheLineSize) {
+    return (chromosome_bytes + CacheLineSize - 1U) / CacheLineSize *
+           CacheLineSize;
+  }
+  size_t stride = chromosome_bytes == 0 ? 0 : sizeof(uint64_t);
+  while (stride < chromosome_bytes) {
+    stride *= 2U;
+  }
+  return stride;
+}
+
+/**
+ * Get the lowest set bit of |value|, which is the number of elements covered
+ * by node |value| of a Fenwick tree.
+ */
+size_t LowestSetBit(size_t value) { return value & (~value + 1U); }
+
+/**
+ * Read the raw bits of the gene at |gene_index| in |chromosome|, keeping
+ * only the low 64 bits of wider genes.
+ */
+uint64_t ReadGeneValue(const panga::Chromosome& chromosome,
+                       size_t gene_index) {
+  constexpr size_t max_width = sizeof(uint64_t) * CHAR_BIT;
+  const auto& genome = chromosome.GetGenome();
+  return chromosome.GetInt<uint64_t>(
+      genome.GetGeneStartBitIndex(gene_index),
+      std::min(genome.GetGeneBitWitdh(gene_index), max_width));
+}
+
+/**
+ * Counts the batches handed to an AsyncFitnessFunction which aren't done yet
+ * so the number in flight can be limited.
+ */
+class InFlightBatches {
+ public:
+  /**
+   * Wait until fewer than |limit| batches are in flight and count another.
+   */
+  void Begin(size_t limit) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [&]() { return in_flight_count_ < limit; });
+    in_flight_count_++;
+  }
+
+  /**
+   * Called once a batch is done, from any thread.
+   */
+  void End() {
+    // Notify while holding the lock so the waiter can't destroy us first.
+    std::lock_guard<std::mutex> lock(mutex_);
+    assert(in_flight_count_ != 0);
+    in_flight_count_--;
+    condition_.notify_all();
+  }
+
+  void WaitForAll() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [&]() { return in_flight_count_ == 0; });
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  size_t in_flight_count_ = 0;
+};
+
+}  // namespace
 
 namespace panga {
 
 Population::Population(const Genome& genome) : genome_(genome) {}
 
+Population::Population(Population&& rhs) noexcept
+    : genome_(rhs.genome_),
+      arena_(std::move(rhs.arena_)),
+      chromosome_stride_(rhs.chromosome_stride_),
+      capacity_(rhs.capacity_),
+      first_touch_thread_pool_(rhs.first_touch_thread_pool_),
+      reproduction_backend_(rhs.reproduction_backend_),
+      scores_(std::move(rhs.scores_)),
+      fitnesses_(std::move(rhs.fitnesses_)),
+      individuals_(std::move(rhs.individuals_)),
+      rows_(std::move(rhs.rows_)),
+      storage_partner_(rhs.storage_partner_),
+      partial_sums_(std::move(rhs.partial_sums_)),
+      alias_table_(std::move(rhs.alias_table_)),
+      sorted_indices_(std::move(rhs.sorted_indices_)),
+      ranks_(std::move(rhs.ranks_)),
+      ranked_count_(rhs.ranked_count_),
+      sorted_count_(rhs.sorted_count_),
+      stats_(rhs.stats_),
+      has_score_stats_(rhs.has_score_stats_),
+      has_diversity_(rhs.has_diversity_),
+      async_chromosomes_(std::move(rhs.async_chromosomes_)),
+      async_scores_(std::move(rhs.async_scores_)),
+      pending_indices_(std::move(rhs.pending_indices_)),
+      evaluated_indices_(std::move(rhs.evaluated_indices_)),
+      chromosome_hashes_(std::move(rhs.chromosome_hashes_)),
+      delta_fitness_function_(rhs.delta_fitness_function_),
+      changed_genes_(std::move(rhs.changed_genes_)),
+      parent_gene_values_(std::move(rhs.parent_gene_values_)),
+      parent_scores_(std::move(rhs.parent_scores_)),
+      has_gene_delta_(std::move(rhs.has_gene_delta_)),
+      is_scored_early_(std::move(rhs.is_scored_early_)),
+      worst_heap_(std::move(rhs.worst_heap_)),
+      score_tree_(std::move(rhs.score_tree_)),
+      best_index_(rhs.best_index_),
+      second_best_index_(rhs.second_best_index_),
+      is_steady_state_(rhs.is_steady_state_),
+      is_sorted_(rhs.is_sorted_) {
+  // None of the storage moved so only our partner needs to know where we are.
+  if (storage_partner_ != nullptr) {
+    storage_partner_->storage_partner_ = this;
+  }
+  rhs.capacity_ = 0;
+  rhs.storage_partner_ = nullptr;
+}
+
+Population::~Population() { RestoreStorage(); }
+
 size_t Population::Size() const { return individuals_.size(); }
 
+void Population::Reserve(size_t capacity) {
+  // Genes may be added to the genome after the population is constructed so
+  // the stride is only known once we start adding individuals.
+  const size_t stride =
+      ChromosomeStride(BitVector::BytesRequired(genome_.BitsRequired()));
+  if (capacity <= capacity_ && stride == chromosome_stride_) {
+    return;
+  }
+  assert(stride == chromosome_stride_ || individuals_.empty());
+
+  // Every individual needs to live in our own arena before it goes away.
+  RestoreStorage();
+
+  // Grow geometrically so adding individuals one at a time stays cheap.
+  capacity = std::max(capacity, capacity_ * 2U);
+
+  const size_t arena_bytes = capacity * stride;
+  std::unique_ptr<std::byte[], ArenaDeleter> arena(static_cast<std::byte*>(
+      ::operator new[](arena_bytes, std::align_val_t(CacheLineSize))));
+  auto scores = std::make_unique<double[]>(capacity);
+  auto fitnesses = std::make_unique<double[]>(capacity);
+
+  // Keep the padding bytes of the new arena zeroed so nothing uninitialized is
+  // ever read by the word-wise kernels.
+  if (first_touch_thread_pool_ != nullptr) {
+    std::byte* arena_begin = arena.get();
+    first_touch_thread_pool_->ParallelForEachWorker(
+        capacity, [arena_begin, stride](size_t begin, size_t end) {
+          std::fill_n(arena_begin + begin * stride, (end - begin) * stride,
+                      std::byte{0});
+        });
+  } else {
+    std::fill_n(arena.get(), arena_bytes, std::byte{0});
+  }
+
+  // Move every existing individual over into the new storage.
+  for (size_t i = 0; i < individuals_.size(); i++) {
+    rows_[i] = arena.get() + i * stride;
+    individuals_[i].AttachStorage(
+        {rows_[i], stride, &scores[i], &fitnesses[i]});
+  }
+
+  arena_ = std::move(arena);
+  chromosome_stride_ = stride;
+  scores_ = std::move(scores);
+  fitnesses_ = std::move(fitnesses);
+  capacity_ = capacity;
+  individuals_.reserve(capacity_);
+  rows_.reserve(capacity_);
+}
+
+void Population::SetFirstTouchThreadPool(ThreadPool* thread_pool) {
+  first_touch_thread_pool_ = thread_pool;
+}
+
+void Population::ArenaDeleter::operator()(std::byte* arena) const {
+  ::operator delete[](arena, std::align_val_t(CacheLineSize));
+}
+
+size_t Population::GetCapacity() const { return capacity_; }
+
+Individual& Population::AddIndividual() {
+  const size_t index = individuals_.size();
+  assert(index < capacity_);
+  std::byte* row = arena_.get() + index * chromosome_stride_;
+  rows_.push_back(row);
+  return individuals_.emplace_back(
+      genome_, Individual::Storage{row, chromosome_stride_, &scores_[index],
+                                   &fitnesses_[index]});
+}
+
+bool Population::OwnsRow(const std::byte* row) const {
+  const std::less<const std::byte*> less;
+  const std::byte* arena_end = arena_.get() + capacity_ * chromosome_stride_;
+  return !less(row, arena_.get()) && less(row, arena_end);
+}
+
 void Population::Resize(size_t size, RandomWrapper* random) {
-  // TODO(boingoing): Only support extending the population. To shrink it, we'll
-  // need to support move semantics for Individuals.
-  assert(individuals_.size() < size);
+  if (size < individuals_.size()) {
+    // Dropped individuals may be holding storage we traded away.
+    RestoreStorage();
+    while (individuals_.size() > size) {
+      individuals_.pop_back();
+      rows_.pop_back();
+    }
+    is_sorted_ = false;
+    InvalidateStats();
+    return;
+  }
+
+  InvalidateStats();
 
-  // If we're inserting new random individuals, construct them in the vector.
+  // If we're inserting new random individuals, construct them in the
+  // storage.
+  Reserve(size);
   while (individuals_.size() < size) {
-    auto& individual = individuals_.emplace_back(genome_);
-    individual.Randomize(random);
+    auto& individual = AddIndividual();
+    if (random != nullptr) {
+      individual.Randomize(random);
+    }
   }
 }
 
 void Population::Initialize(const std::vector<BitVector>& initial_population) {
   // Destroy any individuals currently in the population and construct new ones
-  // based on the |initial_population| BVs.
+  // based on the |initial_population| BVs. The storage is reused.
+  RestoreStorage();
   individuals_.clear();
+  rows_.clear();
+  is_sorted_ = false;
+  InvalidateStats();
 
+  Reserve(initial_population.size());
   for (const auto& bv : initial_population) {
-    individuals_.emplace_back(genome_, bv);
+    // Chromosome source vector must have the same number of bits as our
+    // genome.
+    assert(bv.GetBitCount() == genome_.BitsRequired());
+    auto& individual = AddIndividual();
+    static_cast<BitVector&>(individual) = bv;
+  }
+}
+
+void Population::Initialize(const std::byte* chromosomes,
+                            size_t chromosome_stride, size_t count) {
+  const size_t bit_count = genome_.BitsRequired();
+  const size_t row_bytes = (bit_count + CHAR_BIT - 1U) / CHAR_BIT;
+  assert(chromosomes != nullptr || count == 0);
+  assert(chromosome_stride >= row_bytes);
+
+  RestoreStorage();
+  individuals_.clear();
+  rows_.clear();
+  is_sorted_ = false;
+  InvalidateStats();
+
+  Reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    AddIndividual();
+    std::copy_n(chromosomes + i * chromosome_stride, row_bytes, rows_[i]);
+  }
+}
+
+void Population::Initialize(size_t count,
+                            const ChromosomeInitializer& initializer) {
+  RestoreStorage();
+  individuals_.clear();
+  rows_.clear();
+  is_sorted_ = false;
+  InvalidateStats();
+
+  Reserve(count);
+  for (size_t i = 0; i < count; i++) {
+    auto& individual = AddIndividual();
+    // Rows may be left over from individuals we just cleared.
+    individual.Clear();
+    initializer(i, &individual);
+  }
+}
+
+void Population::Save(std::ostream* stream) const {
+  const size_t size = individuals_.size();
+  WriteSize(stream, size);
+  WriteSize(stream, genome_.BitsRequired());
+  WriteSize(stream, chromosome_stride_);
+  WriteSize(stream, sorted_count_);
+  WriteFlag(stream, is_sorted_);
+
+  // Rows may live in the arena of our storage partner so write them one at a
+  // time. They still end up as one block just like our arena.
+  WriteAlignment(stream);
+  for (size_t i = 0; i < size; i++) {
+    stream->write(reinterpret_cast<const char*>(rows_[i]),
+                  static_cast<std::streamsize>(chromosome_stride_));
+  }
+
+  WriteAlignment(stream);
+  stream->write(reinterpret_cast<const char*>(scores_.get()),
+                static_cast<std::streamsize>(size * sizeof(double)));
+  WriteAlignment(stream);
+  stream->write(reinterpret_cast<const char*>(fitnesses_.get()),
+                static_cast<std::streamsize>(size * sizeof(double)));
+
+  // Sorting starts from the last order so it's kept even when out of date
+  // for the result to be the same once resumed.
+  WriteAlignment(stream);
+  WriteSize(stream, sorted_indices_.size());
+  for (const size_t index : sorted_indices_) {
+    WriteSize(stream, index);
+  }
+  for (const auto& individual : individuals_) {
+    WriteFlag(stream, individual.IsDirty());
   }
 }
 
+bool Population::Load(std::istream* stream, size_t max_size) {
+  size_t size = 0;
+  size_t bit_count = 0;
+  size_t stride = 0;
+  size_t sorted_count = 0;
+  bool is_sorted = false;
+  if (!ReadSize(stream, &size) || !ReadSize(stream, &bit_count) ||
+      !ReadSize(stream, &stride) || !ReadSize(stream, &sorted_count) ||
+      !ReadFlag(stream, &is_sorted)) {
+    return false;
+  }
+  if (bit_count != genome_.BitsRequired() ||
+      stride != ChromosomeStride(BitVector::BytesRequired(bit_count)) ||
+      sorted_count > size || size > max_size ||
+      !HasBytesLeft(stream, size, stride + 2U * sizeof(double))) {
+    return false;
+  }
+
+  RestoreStorage();
+  individuals_.clear();
+  rows_.clear();
+  is_sorted_ = false;
+  InvalidateStats();
+
+  // The rows are laid out like the arena so they're read in one go.
+  Reserve(size);
+  for (size_t i = 0; i < size; i++) {
+    AddIndividual();
+  }
+  if (!ReadAlignment(stream)) {
+    return false;
+  }
+  stream->read(reinterpret_cast<char*>(arena_.get()),
+               static_cast<std::streamsize>(size * stride));
+
+  ReadAlignment(stream);
+  stream->read(reinterpret_cast<char*>(scores_.get()),
+               static_cast<std::streamsize>(size * sizeof(double)));
+  ReadAlignment(stream);
+  stream->read(reinterpret_cast<char*>(fitnesses_.get()),
+               static_cast<std::streamsize>(size * sizeof(double)));
+  size_t sorted_size = 0;
+  if (!ReadAlignment(stream) || !ReadSize(stream, &sorted_size) ||
+      (sorted_size != size && (sorted_size != 0 || is_sorted))) {
+    return false;
+  }
+
+  sorted_indices_.resize(sorted_size);
+  ranks_.assign(sorted_size, size);
+  for (size_t rank = 0; rank < sorted_size; rank++) {
+    size_t index = 0;
+    if (!ReadSize(stream, &index) || index >= size || ranks_[index] != size) {
+      return false;
+    }
+    sorted_indices_[rank] = index;
+    ranks_[index] = rank;
+  }
+  for (auto& individual : individuals_) {
+    bool is_dirty = false;
+    if (!ReadFlag(stream, &is_dirty)) {
+      return false;
+    }
+    individual.SetDirty(is_dirty);
+  }
+
+  sorted_count_ = sorted_count;
+  is_sorted_ = is_sorted;
+  return true;
+}
+
 void Population::InitializePartialSums() {
   assert(!individuals_.empty());
 
@@ -58,6 +451,57 @@ void Population::InitializePartialSums() {
   }
 }
 
+void Population::InitializeAliasTable() {
+  assert(!individuals_.empty());
+
+  const size_t size = individuals_.size();
+  alias_table_.resize(size);
+
+  // Scale each weight so the average is 1. If the fitness values don't make
+  // a valid distribution, every individual gets an equal chance.
+  const double total = std::accumulate(fitnesses_.get(),
+                                       fitnesses_.get() + size, 0.0);
+  const bool is_valid = total > 0.0 && std::isfinite(total);
+  const double scale = is_valid ? static_cast<double>(size) / total : 0.0;
+
+  // Split the columns into those with less than the average weight and those
+  // with at least the average. Each small column is topped up by one large
+  // column, which leaves the large column with less weight to hand out.
+  // Both worklists share one buffer: small from the front, large from the
+  // back.
+  pending_indices_.resize(size);
+  size_t small_end = 0;
+  size_t large_begin = size;
+  for (size_t i = 0; i < size; i++) {
+    alias_table_[i] = {is_valid ? fitnesses_[i] * scale : 1.0, i};
+    if (alias_table_[i].probability < 1.0) {
+      pending_indices_[small_end++] = i;
+    } else {
+      pending_indices_[--large_begin] = i;
+    }
+  }
+
+  while (small_end != 0 && large_begin != size) {
+    const size_t small = pending_indices_[--small_end];
+    const size_t large = pending_indices_[large_begin];
+    alias_table_[small].alias = large;
+    alias_table_[large].probability -= 1.0 - alias_table_[small].probability;
+    if (alias_table_[large].probability < 1.0) {
+      // The large column moves over to the small worklist.
+      large_begin++;
+      pending_indices_[small_end++] = large;
+    }
+  }
+
+  // Whatever is left over is only off from 1 due to rounding.
+  for (size_t i = 0; i < small_end; i++) {
+    alias_table_[pending_indices_[i]].probability = 1.0;
+  }
+  for (size_t i = large_begin; i < size; i++) {
+    alias_table_[pending_indices_[i]].probability = 1.0;
+  }
+}
+
 void Population::Sort() {
   // Only initialize the set of sorted indices once or when the size of the
   // population has changed.
@@ -70,19 +514,261 @@ void Population::Sort() {
   }
 
   assert(sorted_indices_.size() == individuals_.size());
-  std::sort(sorted_indices_.begin(), sorted_indices_.end(),
-            [=](const size_t& left, const size_t& right) {
-              return individuals_[left] < individuals_[right];
-            });
+  const auto by_score = [this](const size_t& left, const size_t& right) {
+    return scores_[left] < scores_[right];
+  };
+  const size_t size = sorted_indices_.size();
+  const size_t ranked_count =
+      ranked_count_ == 0 ? size : std::min(ranked_count_, size);
+  if (ranked_count + 1U >= size) {
+    std::sort(sorted_indices_.begin(), sorted_indices_.end(), by_score);
+    sorted_count_ = size;
+  } else {
+    // Only the top of the population needs to be in order but fitness
+    // normalization relies on the worst individual being last.
+    const auto ranked_end = sorted_indices_.begin() + ranked_count;
+    std::partial_sort(sorted_indices_.begin(), ranked_end,
+                      sorted_indices_.end(), by_score);
+    std::iter_swap(
+        std::max_element(ranked_end, sorted_indices_.end(), by_score),
+        sorted_indices_.end() - 1);
+    sorted_count_ = ranked_count;
+  }
+
+  ranks_.resize(sorted_indices_.size());
+  for (size_t rank = 0; rank < sorted_indices_.size(); rank++) {
+    ranks_[sorted_indices_[rank]] = rank;
+  }
 
   is_sorted_ = true;
 }
 
+void Population::SetRankedCount(size_t ranked_count) {
+  ranked_count_ = ranked_count;
+}
+
+size_t Population::GetRankedCount() const { return ranked_count_; }
+
 void Population::Replace(size_t index, const Individual& individual) {
   assert(individuals_.size() > index);
 
   // TODO(boingoing): Should we replace based on sorted index?
   individuals_[index] = individual;
+  InvalidateStats();
+}
+
+bool Population::ReplaceWorst(const Individual& individual) {
+  assert(!individuals_.empty());
+  if (is_steady_state_) {
+    const size_t worst = worst_heap_.front();
+    const double score = individual.GetScore();
+    if (!(score < scores_[worst])) {
+      return false;
+    }
+    AddToScoreTree(worst, score - scores_[worst]);
+    individuals_[worst] = individual;
+
+    // Only the top of the heap got better so it sinks to its place.
+    const size_t size = worst_heap_.size();
+    size_t position = 0;
+    while (true) {
+      size_t worse = position;
+      for (size_t child = position * 2U + 1U;
+           child < size && child <= position * 2U + 2U; child++) {
+        if (scores_[worst_heap_[child]] > scores_[worst_heap_[worse]]) {
+          worse = child;
+        }
+      }
+      if (worse == position) {
+        break;
+      }
+      std::swap(worst_heap_[position], worst_heap_[worse]);
+      position = worse;
+    }
+
+    // Replacing one of the best individuals only happens in tiny or
+    // converged populations so look for them again.
+    if (worst == best_index_ || worst == second_best_index_) {
+      FindBestIndividuals();
+    } else if (score < scores_[best_index_]) {
+      second_best_index_ = best_index_;
+      best_index_ = worst;
+    } else if (score < scores_[second_best_index_]) {
+      second_best_index_ = worst;
+    }
+    InvalidateStats();
+    return true;
+  }
+  assert(is_sorted_);
+
+  // The new worst individual could be anywhere outside of the ranked ones.
+  if (sorted_count_ + 1U < individuals_.size()) {
+    const size_t ranked_count = ranked_count_;
+    ranked_count_ = 0;
+    Sort();
+    ranked_count_ = ranked_count;
+  }
+
+  const size_t worst = sorted_indices_.back();
+  if (!(individual.GetScore() < scores_[worst])) {
+    return false;
+  }
+  individuals_[worst] = individual;
+
+  // Everything else is still in order so moving the new individual up to
+  // its rank only touches the ranks in between.
+  const auto by_score = [this](const size_t& left, const size_t& right) {
+    return scores_[left] < scores_[right];
+  };
+  const auto last = sorted_indices_.end() - 1;
+  const auto position =
+      std::upper_bound(sorted_indices_.begin(), last, worst, by_score);
+  std::rotate(position, last, sorted_indices_.end());
+  for (size_t rank = static_cast<size_t>(position - sorted_indices_.begin());
+       rank < sorted_indices_.size(); rank++) {
+    ranks_[sorted_indices_[rank]] = rank;
+  }
+
+  CalculateFitness();
+  CalculateScoreStats(&stats_);
+  has_score_stats_ = true;
+  has_diversity_ = false;
+  return true;
+}
+
+void Population::BeginSteadyState() {
+  assert(!individuals_.empty());
+
+  const size_t size = individuals_.size();
+  const auto by_score = [this](const size_t& left, const size_t& right) {
+    return scores_[left] < scores_[right];
+  };
+  worst_heap_.resize(size);
+  std::iota(worst_heap_.begin(), worst_heap_.end(), size_t{0});
+  std::make_heap(worst_heap_.begin(), worst_heap_.end(), by_score);
+
+  // Each node of the tree adds itself to the next node covering it.
+  score_tree_.assign(size + 1U, 0.0);
+  std::copy(scores_.get(), scores_.get() + size, score_tree_.begin() + 1);
+  for (size_t node = 1; node <= size; node++) {
+    const size_t parent = node + LowestSetBit(node);
+    if (parent <= size) {
+      score_tree_[parent] += score_tree_[node];
+    }
+  }
+
+  FindBestIndividuals();
+  is_sorted_ = false;
+  is_steady_state_ = true;
+}
+
+void Population::EndSteadyState() {
+  if (!is_steady_state_) {
+    return;
+  }
+  is_steady_state_ = false;
+
+  Sort();
+  CalculateFitness();
+  CalculateScoreStats(&stats_);
+  has_score_stats_ = true;
+  has_diversity_ = false;
+}
+
+void Population::FindBestIndividuals() {
+  best_index_ = 0;
+  second_best_index_ = 0;
+  for (size_t i = 1; i < individuals_.size(); i++) {
+    if (scores_[i] < scores_[best_index_]) {
+      second_best_index_ = best_index_;
+      best_index_ = i;
+    } else if (second_best_index_ == best_index_ ||
+               scores_[i] < scores_[second_best_index_]) {
+      second_best_index_ = i;
+    }
+  }
+}
+
+void Population::AddToScoreTree(size_t index, double delta) {
+  for (size_t node = index + 1U; node < score_tree_.size();
+       node += LowestSetBit(node)) {
+    score_tree_[node] += delta;
+  }
+}
+
+double Population::SumScores(size_t count) const {
+  double sum = 0.0;
+  for (size_t node = count; node != 0; node -= LowestSetBit(node)) {
+    sum += score_tree_[node];
+  }
+  return sum;
+}
+
+void Population::Swap(size_t index, Population* other, size_t other_index) {
+  assert(other != nullptr && other != this);
+  assert(index < individuals_.size());
+  assert(other_index < other->individuals_.size());
+  assert(&genome_ == &other->genome_);
+
+  if (chromosome_stride_ != 0) {
+    // Remember who we traded with so the storage can be given back.
+    assert(storage_partner_ == nullptr || storage_partner_ == other);
+    assert(other->storage_partner_ == nullptr ||
+           other->storage_partner_ == this);
+    storage_partner_ = other;
+    other->storage_partner_ = this;
+
+    individuals_[index].SwapStorage(&other->individuals_[other_index]);
+    std::swap(rows_[index], other->rows_[other_index]);
+  }
+  std::swap(scores_[index], other->scores_[other_index]);
+  std::swap(fitnesses_[index], other->fitnesses_[other_index]);
+  auto& individual = individuals_[index];
+  auto& other_individual = other->individuals_[other_index];
+  const bool is_dirty = individual.IsDirty();
+  individual.SetDirty(other_individual.IsDirty());
+  other_individual.SetDirty(is_dirty);
+
+  is_sorted_ = false;
+  other->is_sorted_ = false;
+  InvalidateStats();
+  other->InvalidateStats();
+}
+
+void Population::RestoreStorage() {
+  if (storage_partner_ == nullptr) {
+    return;
+  }
+  Population* partner = storage_partner_;
+
+  // Rows only ever trade places between the two of us so every row of ours
+  // held by the partner matches one row of theirs held by us.
+  std::vector<size_t> borrowed;
+  for (size_t i = 0; i < rows_.size(); i++) {
+    if (!OwnsRow(rows_[i])) {
+      borrowed.push_back(i);
+    }
+  }
+  std::vector<size_t> lent;
+  for (size_t i = 0; i < partner->rows_.size(); i++) {
+    if (!partner->OwnsRow(partner->rows_[i])) {
+      lent.push_back(i);
+    }
+  }
+  assert(borrowed.size() == lent.size());
+
+  // Swap the bits between each pair of rows and then the rows themselves so
+  // every individual keeps its bits but lives in its own arena again.
+  for (size_t i = 0; i < borrowed.size(); i++) {
+    std::byte*& our_row = rows_[borrowed[i]];
+    std::byte*& their_row = partner->rows_[lent[i]];
+    std::swap_ranges(our_row, our_row + chromosome_stride_, their_row);
+    individuals_[borrowed[i]].SwapStorage(&partner->individuals_[lent[i]]);
+    std::swap(our_row, their_row);
+  }
+
+  storage_partner_ = nullptr;
+  partner->storage_partner_ = nullptr;
 }
 
 const Individual& Population::GetBestIndividual() const {
@@ -90,6 +776,30 @@ const Individual& Population::GetBestIndividual() const {
   return GetIndividual(0);
 }
 
+void Population::GetBestIndividuals(
+    size_t count, std::vector<const Individual*>* best) const {
+  assert(best != nullptr);
+  assert(is_sorted_);
+
+  count = std::min(count, individuals_.size());
+  best->clear();
+  if (count <= sorted_count_) {
+    for (size_t i = 0; i < count; i++) {
+      best->push_back(&GetIndividual(i));
+    }
+    return;
+  }
+
+  for (const auto& individual : individuals_) {
+    best->push_back(&individual);
+  }
+  std::partial_sort(best->begin(), best->begin() + count, best->end(),
+                    [](const Individual* left, const Individual* right) {
+                      return *left < *right;
+                    });
+  best->resize(count);
+}
+
 const Individual& Population::GetIndividual(size_t index) const {
   assert(!sorted_indices_.empty());
   assert(!individuals_.empty());
@@ -102,125 +812,680 @@ const Individual& Population::GetIndividual(size_t index) const {
 
 Individual& Population::GetIndividualWritable(size_t index) {
   assert(index < individuals_.size());
+  if (has_score_stats_ || has_diversity_) {
+    InvalidateStats();
+  }
   return individuals_[index];
 }
 
+std::byte* Population::GetChromosomeStorage(size_t index) {
+  assert(index < rows_.size());
+  if (has_score_stats_ || has_diversity_) {
+    InvalidateStats();
+  }
+  return rows_[index];
+}
+
+PopulationStats Population::GetStats() const {
+  if (!has_score_stats_) {
+    PopulationStats stats;
+    CalculateScoreStats(&stats);
+    stats.diversity = CalculateDiversity(nullptr, individuals_.size());
+    return stats;
+  }
+
+  if (!has_diversity_) {
+    stats_.diversity = CalculateDiversity(nullptr, individuals_.size());
+    has_diversity_ = true;
+  }
+  return stats_;
+}
+
 double Population::GetMinimumScore() const {
-  return GetBestIndividual().GetScore();
+  if (has_score_stats_) {
+    return stats_.minimum_score;
+  }
+  PopulationStats stats;
+  CalculateScoreStats(&stats);
+  return stats.minimum_score;
 }
 
-double Population::GetAverageScore() const {
-  assert(!individuals_.empty());
+double Population::GetMaximumScore() const {
+  if (has_score_stats_) {
+    return stats_.maximum_score;
+  }
+  PopulationStats stats;
+  CalculateScoreStats(&stats);
+  return stats.maximum_score;
+}
 
-  double sum = 0.0;
-  for (const auto& i : individuals_) {
-    sum += i.GetScore();
+double Population::GetAverageScore() const {
+  if (has_score_stats_) {
+    return stats_.average_score;
   }
-  return sum / individuals_.size();
+  PopulationStats stats;
+  CalculateScoreStats(&stats);
+  return stats.average_score;
 }
 
 double Population::GetScoreStandardDeviation() const {
+  if (has_score_stats_) {
+    return stats_.score_standard_deviation;
+  }
+  PopulationStats stats;
+  CalculateScoreStats(&stats);
+  return stats.score_standard_deviation;
+}
+
+double Population::GetPopulationDiversity() const {
+  if (has_score_stats_) {
+    return GetStats().diversity;
+  }
+  return CalculateDiversity(nullptr, individuals_.size());
+}
+
+void Population::SetReproductionBackend(ReproductionBackend* backend) {
+  reproduction_backend_ = backend;
+  has_diversity_ = false;
+}
+
+void Population::CalculateScoreStats(PopulationStats* stats) const {
+  assert(!individuals_.empty());
+
+  const size_t size = individuals_.size();
+  double mean = 0.0;
+  double squared_deviations = 0.0;
+  double minimum = scores_[0];
+  double maximum = scores_[0];
+  for (size_t i = 0; i < size; i++) {
+    const double score = scores_[i];
+    const double delta = score - mean;
+    mean += delta / static_cast<double>(i + 1U);
+    squared_deviations += delta * (score - mean);
+    minimum = std::min(minimum, score);
+    maximum = std::max(maximum, score);
+  }
+
+  stats->average_score = mean;
   // stdev of a single score is 0.
-  if (individuals_.size() <= 1U) {
-    return 0.0;
+  stats->score_standard_deviation =
+      size > 1U ? std::sqrt(squared_deviations / static_cast<double>(size - 1U))
+                : 0.0;
+  stats->minimum_score = minimum;
+  stats->maximum_score = maximum;
+}
+
+void Population::InvalidateStats() {
+  has_score_stats_ = false;
+  has_diversity_ = false;
+}
+
+double Population::EstimatePopulationDiversity(size_t sample_size,
+                                               RandomWrapper* random) const {
+  if (sample_size >= individuals_.size()) {
+    return GetPopulationDiversity();
   }
 
-  const double mean = GetAverageScore();
-  double sum = 0.0;
-  for (const auto& i : individuals_) {
-    const double score = i.GetScore();
-    sum += (score - mean) * (score - mean);
+  // Choose |sample_size| distinct individuals via a partial Fisher-Yates
+  // shuffle of the individual indices.
+  std::vector<size_t> indices(individuals_.size());
+  std::iota(indices.begin(), indices.end(), 0);
+  for (size_t i = 0; i < sample_size; i++) {
+    const auto j = random->RandomInteger<size_t>(i, indices.size() - 1U);
+    std::swap(indices[i], indices[j]);
   }
-  return std::sqrt(sum / (individuals_.size() - 1U));
+  return CalculateDiversity(indices.data(), sample_size);
 }
 
-double Population::GetPopulationDiversity() const {
+double Population::CalculateDiversity(const size_t* indices,
+                                      size_t count) const {
   // Diversity of a single individual would be zero.
-  if (individuals_.size() <= 1U) {
+  if (count <= 1U) {
+    return 0.0;
+  }
+
+  const size_t genome_bits = genome_.BitsRequired();
+  if (genome_bits == 0) {
     return 0.0;
   }
 
-  size_t distance = 0;
-  size_t j = 0;
+  const std::byte* const* rows = rows_.data();
+  std::vector<const std::byte*> selected_rows;
+  if (indices != nullptr) {
+    selected_rows.resize(count);
+    for (size_t i = 0; i < count; i++) {
+      selected_rows[i] = rows_[indices[i]];
+    }
+    rows = selected_rows.data();
+  }
+
+  if (reproduction_backend_ != nullptr) {
+    return reproduction_backend_->CalculateDiversity(rows, count, genome_bits);
+  }
+  return BitVector::CalculateDiversity(rows, count, genome_bits);
+}
+
+void Population::SetDeltaFitnessFunction(
+    DeltaFitnessFunction delta_fitness_function) {
+  delta_fitness_function_ = delta_fitness_function;
+}
+
+DeltaFitnessFunction Population::GetDeltaFitnessFunction() const {
+  return delta_fitness_function_;
+}
+
+void Population::ClearGeneDeltas() {
+  const size_t size = individuals_.size();
+  if (changed_genes_.size() < size) {
+    changed_genes_.resize(size);
+    parent_gene_values_.resize(size);
+    parent_scores_.resize(size);
+  }
+  has_gene_delta_.assign(size, 0);
+}
+
+void Population::RecordPrimaryParent(size_t index, const Individual& parent) {
+  assert(index < has_gene_delta_.size());
+  auto& changed_genes = changed_genes_[index];
+  changed_genes.clear();
+  individuals_[index].FindChangedGenes(parent, &changed_genes);
+
+  auto& parent_gene_values = parent_gene_values_[index];
+  parent_gene_values.clear();
+  for (const size_t gene_index : changed_genes) {
+    parent_gene_values.push_back(ReadGeneValue(parent, gene_index));
+  }
+  parent_scores_[index] = parent.GetScore();
+  has_gene_delta_[index] = 1;
+}
+
+void Population::RecordFlippedBits(size_t index, double parent_score,
+                                   const Chromosome& flipped_bits) {
+  assert(index < has_gene_delta_.size());
+  auto& changed_genes = changed_genes_[index];
+  changed_genes.clear();
+  flipped_bits.FindGenesWithSetBits(&changed_genes);
+
+  // Flipping the same bits again gives back the value the parent had.
+  const auto& individual = individuals_[index];
+  auto& parent_gene_values = parent_gene_values_[index];
+  parent_gene_values.clear();
+  for (const size_t gene_index : changed_genes) {
+    parent_gene_values.push_back(ReadGeneValue(individual, gene_index) ^
+                                 ReadGeneValue(flipped_bits, gene_index));
+  }
+  parent_scores_[index] = parent_score;
+  has_gene_delta_[index] = 1;
+}
+
+bool Population::HasGeneDelta(size_t index) const {
+  return index < has_gene_delta_.size() && has_gene_delta_[index] != 0;
+}
+
+void Population::BeginEarlyScoring() {
+  is_scored_early_.assign(individuals_.size(), 0);
+}
+
+void Population::ScoreEarly(size_t index, FitnessFunction fitness_function,
+                            void* user_data) {
+  assert(index < is_scored_early_.size());
+  individuals_[index].SetScore(
+      ScoreIndividual(index, fitness_function, user_data));
+  is_scored_early_[index] = 1;
+}
+
+double Population::ScoreIndividual(size_t index,
+                                   FitnessFunction fitness_function,
+                                   void* user_data) {
+  auto& individual = individuals_[index];
+  if (delta_fitness_function_ != nullptr && HasGeneDelta(index)) {
+    GeneDelta delta;
+    delta.parent_score = parent_scores_[index];
+    delta.changed_genes = changed_genes_[index].data();
+    delta.parent_gene_values = parent_gene_values_[index].data();
+    delta.changed_gene_count = changed_genes_[index].size();
+    return delta_fitness_function_(&individual, delta, user_data);
+  }
+  return fitness_function(&individual, user_data);
+}
+
+void Population::Evaluate(FitnessFunction fitness_function, void* user_data,
+                          ThreadPool* thread_pool, size_t chunk_size,
+                          FitnessCache* fitness_cache, StepStats* step_stats) {
+  const uint64_t evaluation_begin = InstrumentationNow();
+  const size_t pending_count = FindPendingIndividuals(
+      fitness_cache, thread_pool, chunk_size, step_stats);
 
-  // Compute the total number of differing bits between each individual and
-  // every other in the population.
-  for (const auto& i : individuals_) {
-    // Compare the individual only against members at further indices in the
-    // population. This way we don't double count each comparison.
-    for (auto it = individuals_.cbegin() + ++j; it != individuals_.cend();
-         it++) {
-      distance += i.HammingDistance(*it);
+  // Score members of population. Individuals with a primary parent only need
+  // the changes since that parent to be scored.
+  const auto score_range = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      const size_t index = pending_indices_[i];
+      individuals_[index].SetScore(
+          ScoreIndividual(index, fitness_function, user_data));
     }
+  };
+  if (thread_pool != nullptr) {
+    // Blocks until every individual has a score.
+    thread_pool->ParallelFor(pending_count, chunk_size, score_range);
+  } else {
+    score_range(0, pending_count);
   }
 
-  const size_t genome_bits = individuals_[0].GetGenome().BitsRequired();
-  const size_t total_compares =
-      (individuals_.size() * (individuals_.size() - 1U)) >> 2U;
-  const size_t total_bits = total_compares * genome_bits;
-  return static_cast<double>(distance) / total_bits;
+  FinishEvaluation(fitness_cache, step_stats, evaluation_begin);
 }
 
-void Population::Evaluate(FitnessFunction fitness_function, void* user_data) {
-  // Score members of population.
-  for (auto& individual : individuals_) {
-    individual.SetScore(fitness_function(&individual, user_data));
+void Population::Evaluate(const BatchFitnessFunction& batch_fitness_function,
+                          ThreadPool* thread_pool, size_t chunk_size,
+                          FitnessCache* fitness_cache, StepStats* step_stats) {
+  const uint64_t evaluation_begin = InstrumentationNow();
+  const size_t pending_count = FindPendingIndividuals(
+      fitness_cache, thread_pool, chunk_size, step_stats);
+  const size_t chromosome_bytes =
+      BitVector::BytesRequired(genome_.BitsRequired());
+
+  // Pass each run of consecutive individuals which need a score as one batch.
+  const auto score_batches = [&](size_t begin, size_t end) {
+    size_t run_begin = begin;
+    while (run_begin < end) {
+      size_t run_end = run_begin + 1U;
+      while (run_end < end &&
+             pending_indices_[run_end] == pending_indices_[run_end - 1U] + 1U) {
+        run_end++;
+      }
+
+      const size_t first = pending_indices_[run_begin];
+      FitnessBatch batch;
+      batch.individuals = individuals_.data() + first;
+      batch.chromosomes = rows_.data() + first;
+      batch.chromosome_bytes = chromosome_bytes;
+      batch.count = run_end - run_begin;
+      batch.scores = scores_.get() + first;
+      batch_fitness_function(batch);
+
+      run_begin = run_end;
+    }
+  };
+  if (thread_pool != nullptr) {
+    thread_pool->ParallelFor(pending_count, chunk_size, score_batches);
+  } else {
+    score_batches(0, pending_count);
+  }
+
+  FinishEvaluation(fitness_cache, step_stats, evaluation_begin);
+}
+
+void Population::Evaluate(const AsyncFitnessFunction& async_fitness_function,
+                          size_t batch_size, size_t max_in_flight,
+                          FitnessCache* fitness_cache, StepStats* step_stats) {
+  assert(max_in_flight != 0);
+  const uint64_t evaluation_begin = InstrumentationNow();
+  const size_t pending_count =
+      FindPendingIndividuals(fitness_cache, nullptr, 0, step_stats);
+  if (batch_size == 0) {
+    batch_size = std::max<size_t>(
+        (pending_count + max_in_flight - 1U) / max_in_flight, 1U);
+  }
+
+  // Gather the individuals to score so every batch is a single request no
+  // matter where its individuals are stored.
+  async_chromosomes_.resize(pending_count);
+  async_scores_.resize(pending_count);
+  for (size_t i = 0; i < pending_count; i++) {
+    async_chromosomes_[i] = rows_[pending_indices_[i]];
+  }
+
+  InFlightBatches in_flight;
+  const auto done = [&in_flight]() { in_flight.End(); };
+  for (size_t begin = 0; begin < pending_count; begin += batch_size) {
+    FitnessBatch batch;
+    batch.individuals = individuals_.data();
+    batch.indices = pending_indices_.data() + begin;
+    batch.chromosomes = async_chromosomes_.data() + begin;
+    batch.chromosome_bytes = BitVector::BytesRequired(genome_.BitsRequired());
+    batch.count = std::min(batch_size, pending_count - begin);
+    batch.scores = async_scores_.data() + begin;
+    in_flight.Begin(max_in_flight);
+    async_fitness_function(batch, done);
+  }
+  in_flight.WaitForAll();
+
+  for (size_t i = 0; i < pending_count; i++) {
+    individuals_[pending_indices_[i]].SetScore(async_scores_[i]);
+  }
+
+  FinishEvaluation(fitness_cache, step_stats, evaluation_begin);
+}
+
+const std::vector<size_t>& Population::GetEvaluatedIndices() const {
+  return evaluated_indices_;
+}
+
+size_t Population::FindPendingIndividuals(FitnessCache* fitness_cache,
+                                          ThreadPool* thread_pool,
+                                          size_t chunk_size,
+                                          StepStats* step_stats) {
+  pending_indices_.clear();
+  const bool has_early_scores = !is_scored_early_.empty();
+  const auto is_scored_early = [&](size_t index) {
+    return has_early_scores && is_scored_early_[index] != 0;
+  };
+  // Individuals scored early are still finished like the others.
+  const auto append_early_scored = [&]() {
+    for (size_t i = 0; has_early_scores && i < individuals_.size(); i++) {
+      if (is_scored_early(i)) {
+        pending_indices_.push_back(i);
+      }
+    }
+  };
+
+  // Without a cache, every individual which wasn't scored early is scored.
+  if (fitness_cache == nullptr) {
+    if (!has_early_scores) {
+      pending_indices_.resize(individuals_.size());
+      std::iota(pending_indices_.begin(), pending_indices_.end(), 0);
+    } else {
+      for (size_t i = 0; i < individuals_.size(); i++) {
+        if (!is_scored_early(i)) {
+          pending_indices_.push_back(i);
+        }
+      }
+    }
+    const size_t pending_count = pending_indices_.size();
+    append_early_scored();
+    if constexpr (IsInstrumentationEnabled) {
+      if (step_stats != nullptr) {
+        step_stats->evaluation_count = pending_indices_.size();
+        step_stats->fitness_cache_hit_count = 0;
+      }
+    }
+    return pending_count;
+  }
+
+  // Clean individuals still have the right score. Hash the dirty ones in
+  // parallel and then look them up in the cache.
+  chromosome_hashes_.resize(individuals_.size());
+  const auto hash_range = [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      if (individuals_[i].IsDirty()) {
+        chromosome_hashes_[i] = individuals_[i].Hash();
+      }
+    }
+  };
+  if (thread_pool != nullptr) {
+    thread_pool->ParallelFor(individuals_.size(), chunk_size, hash_range);
+  } else {
+    hash_range(0, individuals_.size());
+  }
+
+  const size_t hit_count = fitness_cache->GetHitCount();
+  for (size_t i = 0; i < individuals_.size(); i++) {
+    auto& individual = individuals_[i];
+    if (!individual.IsDirty() || is_scored_early(i)) {
+      continue;
+    }
+    double score = 0.0;
+    if (fitness_cache->Find(individual, chromosome_hashes_[i], &score)) {
+      individual.SetScore(score);
+      individual.SetDirty(false);
+    } else {
+      pending_indices_.push_back(i);
+    }
   }
+  const size_t pending_count = pending_indices_.size();
+  append_early_scored();
+  if constexpr (IsInstrumentationEnabled) {
+    if (step_stats != nullptr) {
+      step_stats->evaluation_count = pending_indices_.size();
+      step_stats->fitness_cache_hit_count =
+          fitness_cache->GetHitCount() - hit_count;
+    }
+  }
+  return pending_count;
+}
 
+void Population::FinishEvaluation(FitnessCache* fitness_cache,
+                                  StepStats* step_stats,
+                                  uint64_t evaluation_begin) {
+  // Sorting reuses pending_indices_ as scratch space for the alias table.
+  evaluated_indices_.assign(pending_indices_.begin(), pending_indices_.end());
+  for (const size_t index : pending_indices_) {
+    auto& individual = individuals_[index];
+    if (fitness_cache != nullptr) {
+      fitness_cache->Insert(individual, chromosome_hashes_[index],
+                            individual.GetScore());
+    }
+    individual.SetDirty(false);
+  }
+  // Every record describes the last generation from now on.
+  std::fill(has_gene_delta_.begin(), has_gene_delta_.end(), 0);
+  is_scored_early_.clear();
+
+  if (step_stats != nullptr) {
+    RecordPhase(step_stats, StepPhase::Evaluation, evaluation_begin);
+  }
+  const uint64_t sort_begin = InstrumentationNow();
+  UpdateFitness();
+  if (step_stats != nullptr) {
+    RecordPhase(step_stats, StepPhase::Sort, sort_begin);
+  }
+}
+
+void Population::UpdateFitness() {
   // Sort the population by increasing raw score.
   Sort();
+  CalculateFitness();
 
+  CalculateScoreStats(&stats_);
+  has_score_stats_ = true;
+  has_diversity_ = false;
+}
+
+void Population::CalculateFitness() {
   // Calculate the Individual fitness scores.
   double fitness_sum = 0.0;
   const double best_score = GetBestIndividual().GetScore();
   const double worst_score = GetIndividual(Size() - 1U).GetScore();
+  const size_t size = individuals_.size();
 
   // We need to invert the trend of scores.
   // First, calculate best+worst - score[i] as an intermediate fitness score.
-  for (auto& individual : individuals_) {
-    const double temp_fitness =
-        best_score + worst_score - individual.GetScore();
+  for (size_t i = 0; i < size; i++) {
+    const double temp_fitness = best_score + worst_score - scores_[i];
     fitness_sum += temp_fitness;
-    individual.SetFitness(temp_fitness);
+    fitnesses_[i] = temp_fitness;
   }
 
   // Now calculate fitness as a proportion of the intermediate sum.
-  for (auto& individual : individuals_) {
-    individual.SetFitness(individual.GetFitness() / fitness_sum);
+  for (size_t i = 0; i < size; i++) {
+    fitnesses_[i] /= fitness_sum;
+  }
+}
+
+size_t Population::GetStorageIndex(const Individual& individual) const {
+  assert(&individual >= individuals_.data());
+  assert(&individual < individuals_.data() + individuals_.size());
+  return static_cast<size_t>(&individual - individuals_.data());
+}
+
+const Individual& Population::UniformSelect(
+    RandomWrapper* random, const Individual* excluded) const {
+  assert(!individuals_.empty());
+
+  if (excluded == nullptr || individuals_.size() == 1U) {
+    const auto index =
+        random->RandomInteger<size_t>(0, individuals_.size() - 1U);
+    return individuals_[index];
   }
+
+  // Choose among the other n - 1 individuals by skipping over the excluded
+  // index.
+  const size_t excluded_index = GetStorageIndex(*excluded);
+  auto index = random->RandomInteger<size_t>(0, individuals_.size() - 2U);
+  if (index >= excluded_index) {
+    index++;
+  }
+  return individuals_[index];
 }
 
-const Individual& Population::UniformSelect(RandomWrapper* random) const {
+const Individual& Population::RouletteWheelSelect(
+    RandomWrapper* random, const Individual* excluded) const {
   assert(!individuals_.empty());
+  if (is_steady_state_) {
+    return ScoreTreeSelect(random, excluded);
+  }
+  assert(individuals_.size() == partial_sums_.size());
+
+  if (excluded == nullptr || individuals_.size() == 1U) {
+    const auto cutoff = random->RandomFloat<double>(0.0, 1.0);
+
+    // Perform binary search across partial sums to find the first slice which
+    // ends after the cutoff.
+    const auto it =
+        std::upper_bound(partial_sums_.cbegin(), partial_sums_.cend(), cutoff);
+    const auto index = std::min<size_t>(individuals_.size() - 1U,
+                                        it - partial_sums_.cbegin());
+    return GetIndividual(index);
+  }
+
+  // Spin a wheel which is shorter by the width of the excluded slice and then
+  // skip over the excluded slice if the cutoff lands at or after its start.
+  assert(ranks_.size() == individuals_.size());
+  const size_t excluded_rank = ranks_[GetStorageIndex(*excluded)];
+  const double slice_start =
+      excluded_rank == 0 ? 0.0 : partial_sums_[excluded_rank - 1U];
+  const double slice_width = partial_sums_[excluded_rank] - slice_start;
+  auto cutoff = random->RandomFloat<double>(0.0, 1.0 - slice_width);
+  if (cutoff >= slice_start) {
+    cutoff += slice_width;
+  }
+
+  const auto it =
+      std::upper_bound(partial_sums_.cbegin(), partial_sums_.cend(), cutoff);
+  auto index = std::min<size_t>(individuals_.size() - 1U,
+                                it - partial_sums_.cbegin());
+
+  // Rounding could still land us on the excluded slice, pick a neighbor.
+  if (index == excluded_rank) {
+    index = index + 1U < individuals_.size() ? index + 1U : index - 1U;
+  }
+  return GetIndividual(index);
+}
+
+const Individual& Population::AliasSelect(RandomWrapper* random,
+                                          const Individual* excluded) const {
+  assert(!individuals_.empty());
+  if (is_steady_state_) {
+    return ScoreTreeSelect(random, excluded);
+  }
+  assert(individuals_.size() == alias_table_.size());
+
+  const size_t size = individuals_.size();
+  const size_t excluded_index =
+      excluded == nullptr || size == 1U ? size : GetStorageIndex(*excluded);
+  for (size_t attempt = 0; attempt < MaxAliasRejections; attempt++) {
+    // One uniform draw picks the column and, from its fractional part,
+    // whether to keep the column or take its alias.
+    const double spin = random->RandomUnit() * static_cast<double>(size);
+    const size_t column = std::min(static_cast<size_t>(spin), size - 1U);
+    const AliasSlot& slot = alias_table_[column];
+    const size_t index = spin - static_cast<double>(column) < slot.probability
+                             ? column
+                             : slot.alias;
+    if (index != excluded_index) {
+      return individuals_[index];
+    }
+  }
+  return UniformSelect(random, excluded);
+}
 
-  const auto index = random->RandomInteger<size_t>(0, individuals_.size() - 1U);
+const Individual& Population::ScoreTreeSelect(
+    RandomWrapper* random, const Individual* excluded) const {
+  const size_t size = individuals_.size();
+
+  // Every slice is as wide as the fitness of the individual before
+  // CalculateFitness normalizes it, best + worst - score. The width of a run
+  // of slices follows from the sum of their scores.
+  const double offset = scores_[best_index_] + scores_[worst_heap_.front()];
+  const double total =
+      offset * static_cast<double>(size) - SumScores(size);
+  size_t excluded_index = size;
+  double slice_start = 0.0;
+  double slice_width = 0.0;
+  if (excluded != nullptr && size > 1U) {
+    excluded_index = GetStorageIndex(*excluded);
+    slice_start = offset * static_cast<double>(excluded_index) -
+                  SumScores(excluded_index);
+    slice_width = offset - scores_[excluded_index];
+  }
+  if (!(total - slice_width > 0.0) || !std::isfinite(total)) {
+    return UniformSelect(random, excluded);
+  }
+  auto cutoff = random->RandomFloat<double>(0.0, total - slice_width);
+  if (excluded_index != size && cutoff >= slice_start) {
+    cutoff += slice_width;
+  }
+
+  // Walk down the tree from the widest node, skipping every run of slices
+  // which ends before the cutoff.
+  size_t step = 1;
+  while (step * 2U <= size) {
+    step *= 2U;
+  }
+  size_t index = 0;
+  for (; step != 0; step /= 2U) {
+    if (index + step <= size) {
+      const double width =
+          offset * static_cast<double>(step) - score_tree_[index + step];
+      if (width <= cutoff) {
+        cutoff -= width;
+        index += step;
+      }
+    }
+  }
+  index = std::min(index, size - 1U);
+
+  // Rounding could still land us on the excluded slice, pick a neighbor.
+  if (index == excluded_index) {
+    index = index + 1U < size ? index + 1U : index - 1U;
+  }
   return individuals_[index];
 }
 
-const Individual& Population::RouletteWheelSelect(RandomWrapper* random) const {
+void Population::StochasticUniversalSelect(
+    size_t count, RandomWrapper* random,
+    std::vector<const Individual*>* selected) const {
   assert(!individuals_.empty());
   assert(individuals_.size() == partial_sums_.size());
 
-  const auto cutoff = random->RandomFloat<double>(0.0, 1.0);
-  size_t lower = 0;
-  size_t upper = individuals_.size() - 1U;
+  selected->resize(count);
+  if (count == 0) {
+    return;
+  }
 
-  // Perform binary search across partial sums.
-  while (upper >= lower) {
-    const auto i = lower + (upper - lower) / 2U;
-    if (partial_sums_[i] > cutoff) {
-      upper = i - 1;
-    } else {
-      lower = i + 1;
+  // Walk |count| pointers spaced 1 / |count| apart starting from one random
+  // offset over the partial sums in a single pass.
+  const double spacing = 1.0 / static_cast<double>(count);
+  const double start = random->RandomUnit() * spacing;
+  size_t rank = 0;
+  for (size_t i = 0; i < count; i++) {
+    const double pointer = start + static_cast<double>(i) * spacing;
+    while (rank + 1U < individuals_.size() && partial_sums_[rank] <= pointer) {
+      rank++;
     }
+    (*selected)[i] = &GetIndividual(rank);
   }
 
-  lower = std::min(individuals_.size() - 1U, lower);
-  return GetIndividual(lower);
+  // The sweep produces individuals in rank order. Shuffle them so callers
+  // can pair up neighbors.
+  for (size_t i = count - 1U; i > 0; i--) {
+    std::swap((*selected)[i], (*selected)[random->RandomInteger<size_t>(0, i)]);
+  }
 }
 
-const Individual& Population::TournamentSelect(size_t tournament_size,
-                                               RandomWrapper* random) const {
+const Individual& Population::TournamentSelect(
+    size_t tournament_size, RandomWrapper* random,
+    const Individual* excluded) const {
   assert(tournament_size > 0);
 
   // If asserts are turned off, we might deref a nullptr to return below. As a
@@ -228,19 +1493,22 @@ const Individual& Population::TournamentSelect(size_t tournament_size,
   // TODO(boingoing): Should make these selector methods return std::optional,
   // probably.
   if (tournament_size == 0) {
-    return UniformSelect(random);
+    return UniformSelect(random, excluded);
   }
 
   const Individual* selected = nullptr;
 
   // Choose random individuals from the population to be part of the tournament.
   for (size_t i = 0; i < tournament_size; i++) {
-    const auto& temp = UniformSelect(random);
+    const auto& temp = UniformSelect(random, excluded);
 
     // If this is the first individual we've picked, it will be the winner for
     // now. Otherwise, choose the most fit between the previous winner and the
-    // new member of the tournament.
-    if (selected == nullptr || temp.GetFitness() > selected->GetFitness()) {
+    // new member of the tournament. Fitness values aren't kept up to date in
+    // steady-state mode but the lower score is always the more fit.
+    if (selected == nullptr ||
+        (is_steady_state_ ? temp.GetScore() < selected->GetScore()
+                          : temp.GetFitness() > selected->GetFitness())) {
       selected = &temp;
     }
   }
@@ -249,6 +1517,19 @@ const Individual& Population::TournamentSelect(size_t tournament_size,
   return *selected;
 }
 
-const Individual& Population::RankSelect() const { return GetBestIndividual(); }
+const Individual& Population::RankSelect(const Individual* excluded) const {
+  if (is_steady_state_) {
+    const auto& best = individuals_[best_index_];
+    if (excluded == &best && individuals_.size() > 1U) {
+      return individuals_[second_best_index_];
+    }
+    return best;
+  }
+  const auto& best = GetBestIndividual();
+  if (excluded == &best && individuals_.size() > 1U) {
+    return GetIndividual(1);
+  }
+  return best;
+}
 
 }  // namespace panga
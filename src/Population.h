@@ -7,21 +7,134 @@
 #ifndef POPULATION_H__
 #define POPULATION_H__
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <ostream>
 #include <vector>
 
 namespace panga {
 
 class BitVector;
+class Chromosome;
+class FitnessCache;
 class Genome;
 class Individual;
 class RandomWrapper;
+class ReproductionBackend;
+class ThreadPool;
+struct StepStats;
 
 using FitnessFunction = double (*)(Individual*, void*);
 
+/**
+ * A contiguous run of Individuals handed to a BatchFitnessFunction.<br/>
+ * Individual i of the batch is |individuals|[i] and its raw chromosome bits
+ * start at |chromosomes|[i]. Each chromosome is |chromosome_bytes| bytes long
+ * with bit b stored in bit (b % 8) of byte (b / 8). Chromosomes are usually
+ * laid out back to back in the population storage but may be anywhere.<br/>
+ * Batches gathered from Individuals which aren't next to each other also
+ * carry |indices|. In that case individual i of the batch is
+ * |individuals|[|indices|[i]].<br/>
+ * The fitness function must write the score of individual i into
+ * |scores|[i].
+ */
+struct FitnessBatch {
+  const Individual* individuals = nullptr;
+  const size_t* indices = nullptr;
+  const std::byte* const* chromosomes = nullptr;
+  size_t chromosome_bytes = 0;
+  size_t count = 0;
+  double* scores = nullptr;
+};
+
+/**
+ * Summary statistics describing the scores and chromosomes of a population.
+ * @see Population::GetStats
+ */
+struct PopulationStats {
+  double average_score = 0.0;
+  double score_standard_deviation = 0.0;
+  double minimum_score = 0.0;
+  double maximum_score = 0.0;
+  double diversity = 0.0;
+};
+
+/**
+ * Scores a whole batch of Individuals in a single call.<br/>
+ * Any callable will do, so state can be captured instead of passed through
+ * user data.
+ * @see FitnessBatch
+ */
+using BatchFitnessFunction = std::function<void(const FitnessBatch& batch)>;
+
+/**
+ * Signals that every score of a batch handed to an AsyncFitnessFunction has
+ * been written. May be called from any thread but only once per batch.
+ */
+using FitnessCompletion = std::function<void()>;
+
+/**
+ * Starts scoring a batch of Individuals and returns without waiting for the
+ * scores, such as by sending the chromosomes to a remote service. The
+ * batches it receives always carry indices.<br/>
+ * Once the scores are written into the batch, |done| must be called. What
+ * the batch points to stays valid until then. |done| may also be called
+ * before returning.
+ * @see Population::Evaluate
+ */
+using AsyncFitnessFunction =
+    std::function<void(FitnessBatch batch, FitnessCompletion done)>;
+
+/**
+ * Describes how an offspring differs from its primary parent - the parent it
+ * was copied from before crossover and mutation changed some of its
+ * genes.<br/>
+ * The |changed_gene_count| indices in |changed_genes| are the genes which
+ * differ from the primary parent, in increasing order. |parent_score| is the
+ * score of the primary parent and |parent_gene_values|[i] holds the raw bits
+ * gene |changed_genes|[i] had in the primary parent, as read by
+ * BitVector::GetInt. Only the low 64 bits of wider genes are kept.
+ * @see DeltaFitnessFunction
+ */
+struct GeneDelta {
+  double parent_score = 0.0;
+  const size_t* changed_genes = nullptr;
+  const uint64_t* parent_gene_values = nullptr;
+  size_t changed_gene_count = 0;
+};
+
+/**
+ * Scores an Individual by updating the score of its primary parent for only
+ * the genes which changed.<br/>
+ * For objectives which are a sum over genes, this costs time in proportion
+ * to the number of changed genes instead of the size of the chromosome.
+ * @see Population::SetDeltaFitnessFunction
+ */
+using DeltaFitnessFunction = double (*)(Individual*, const GeneDelta&, void*);
+
+/**
+ * Writes the chromosome bits of the Individual at |index| of a population
+ * being initialized.<br/>
+ * |chromosome| points straight into the population storage and starts with
+ * every bit unset.
+ * @see Population::Initialize
+ */
+using ChromosomeInitializer =
+    std::function<void(size_t index, Chromosome* chromosome)>;
+
 /**
  * Just a collection of Individual objects.<br/>
  * We can select Individuals from this population according to their
  * fitness values.<br/>
+ * The population owns the storage for all of its Individuals. Chromosome bits
+ * are packed into one cache-aligned arena with a fixed stride per Individual
+ * and the scores and fitness values are kept in parallel arrays. Each
+ * Individual is only a view into these. Scoring, sorting, and the statistics
+ * stream linearly through memory and replacing individuals between
+ * generations never allocates.<br/>
  * Note: In order for the select functions to work correctly, the population
  * must be sorted in decreasing fitness order with the Individual at index 0
  * being the most fit.
@@ -31,19 +144,52 @@ class Population {
   Population() = delete;
   explicit Population(const Genome& genome);
   Population(const Population& rhs) = delete;
-  Population(Population&& rhs) = default;
+  Population(Population&& rhs) noexcept;
   Population& operator=(const Population& rhs) = delete;
-  ~Population() = default;
+  ~Population();
 
   /**
    * Return the number of individuals in the population.
    */
   size_t Size() const;
 
+  /**
+   * Make sure the population has storage for at least |capacity| individuals
+   * so growing the population up to |capacity| won't need to move the
+   * storage.<br/>
+   * The stride of each chromosome is taken from the Genome here, not at
+   * construction, so genes may be added until the first individual is.<br/>
+   * Note: Moving the storage invalidates references to the Individuals as
+   * well as pointers into their chromosome bits.
+   */
+  void Reserve(size_t capacity);
+
+  /**
+   * Zero newly reserved storage from the workers of |thread_pool| so each
+   * worker first touches the rows in its own slice of the population.<br/>
+   * Operating systems place a page on the NUMA node of the thread which
+   * first writes it so this keeps every row local to the worker which
+   * processes it in ParallelFor.<br/>
+   * Pass nullptr, the default, to zero the storage on the calling thread.
+   * @see ThreadPool::ParallelForEachWorker
+   */
+  void SetFirstTouchThreadPool(ThreadPool* thread_pool);
+
+  /**
+   * Get the number of individuals the population has storage for.
+   */
+  size_t GetCapacity() const;
+
   /**
    * Resize the population to hold |size| individuals.<br/>
    * If |size| is greater than the current size of the population, new random
-   * individuals will be added until we reach |size| individuals.
+   * individuals will be added until we reach |size| individuals. If |size| is
+   * smaller, the individuals stored past |size| are dropped. The storage is
+   * kept either way.<br/>
+   * Pass nullptr for |random| to add individuals without randomizing them.
+   * They keep whatever bits their storage holds, which is all zero unless
+   * the storage held an individual before. This suits a population which is
+   * always overwritten before it is read.
    */
   void Resize(size_t size, RandomWrapper* random);
 
@@ -55,37 +201,257 @@ class Population {
    */
   void Initialize(const std::vector<BitVector>& initial_population);
 
+  /**
+   * Initialize the population with |count| individuals whose chromosome bits
+   * are stored back to back in |chromosomes|, |chromosome_stride| bytes
+   * apart.<br/>
+   * Each row needs to hold at least enough whole bytes for the bits of the
+   * genome. The rows are copied straight into the population storage so
+   * no per-individual allocations are made, which suits rows mapped from a
+   * file.<br/>
+   * Clears any individuals currently in the population.
+   */
+  void Initialize(const std::byte* chromosomes, size_t chromosome_stride,
+                  size_t count);
+
+  /**
+   * Initialize the population with |count| individuals whose chromosome bits
+   * are written in place by |initializer|, such as individuals streamed from
+   * a generator or an iterator.<br/>
+   * Nothing is copied or allocated per individual.<br/>
+   * Clears any individuals currently in the population.
+   */
+  void Initialize(size_t count, const ChromosomeInitializer& initializer);
+
+  /**
+   * Write every individual in the population to |stream| in the binary
+   * checkpoint format.<br/>
+   * The chromosome rows are written as one block laid out exactly like the
+   * population storage, followed by the scores, fitness values, rank order,
+   * and dirty flags. Each block starts at a multiple of CheckpointAlignment
+   * bytes.
+   * @see Load
+   */
+  void Save(std::ostream* stream) const;
+
+  /**
+   * Replace the individuals in the population with those written by Save.
+   * <br/>Scores, fitness values, and the rank order are restored as they were
+   * so selection can continue without evaluating the population again.
+   * @param max_size Populations larger than this are rejected before any
+   * storage is allocated for them.
+   * @return false if the stream is truncated, holds more than |max_size|
+   * individuals or was written for a genome requiring a different number of
+   * bits.
+   */
+  bool Load(std::istream* stream, size_t max_size);
+
   /**
    * Initialize the set of partial sums we use for the roulette wheel
    * selector.<br/> Note: Requires the population to have been sorted.
    */
   void InitializePartialSums();
 
+  /**
+   * Initialize the alias table we use for the alias selector.<br/>
+   * Built with Vose's method in time linear in the population size.<br/>
+   * Note: Requires fitness values to have been calculated.
+   * @see AliasSelect
+   */
+  void InitializeAliasTable();
+
   /**
    * Sort the individuals in the population by decreasing fitness - ie: the best
    * individual will be stored at index 0, the second best at index 1, etc.<br/>
    * This must be called before using the selection functions as they rely on
-   * the population being sorted.
+   * the population being sorted.<br/>
+   * If a ranked count was set, only that many of the best individuals are put
+   * in order and the worst individual is moved to the last index.
+   * @see SetRankedCount
    */
   void Sort();
 
+  /**
+   * Limit Sort to putting the best |ranked_count| individuals in order, which
+   * is cheaper than sorting everything when only the top few are ever
+   * looked at by rank.<br/>
+   * The remaining individuals are left in no particular order except that the
+   * worst one is always last. Selectors which need the rank of every
+   * individual, such as RouletteWheelSelect, require a full sort.<br/>
+   * Passing 0, the default, sorts the whole population.
+   * @see Sort
+   */
+  void SetRankedCount(size_t ranked_count);
+  size_t GetRankedCount() const;
+
   /**
    * Replace the individual currently at |index| in the population with
    * |individual|.
    */
   void Replace(size_t index, const Individual& individual);
 
+  /**
+   * Replace the worst individual in the population with |individual| if
+   * |individual| has a better score.<br/>
+   * The population stays sorted and the fitness values and cached statistics
+   * are updated to include |individual|, so selection can continue right
+   * away. This is the insertion step of a steady-state genetic algorithm.<br/>
+   * Note: Requires the population to be evaluated. If only some of the
+   * individuals are in rank order, the whole population is sorted first.
+   * |individual| must already have a score. In steady-state mode, the
+   * replacement takes logarithmic time and nothing is re-ranked.
+   * @return true if |individual| took the place of the worst individual.
+   * @see SetRankedCount
+   * @see BeginSteadyState
+   */
+  bool ReplaceWorst(const Individual& individual);
+
+  /**
+   * Enter steady-state mode, where individuals are only ever replaced by
+   * ReplaceWorst.<br/>
+   * The worst individual is tracked with a heap and the scores are summed in
+   * a Fenwick tree so ReplaceWorst and the fitness-proportional selectors
+   * take logarithmic time instead of re-ranking the population after every
+   * replacement. RouletteWheelSelect and AliasSelect still select in
+   * proportion to fitness, RankSelect selects the best individual, and
+   * TournamentSelect compares scores. The order of the individuals, their
+   * fitness values, and the cached statistics aren't updated until
+   * EndSteadyState.<br/>
+   * Note: Requires the population to be evaluated. Nothing but ReplaceWorst
+   * may change the population until EndSteadyState.
+   * @see EndSteadyState
+   */
+  void BeginSteadyState();
+
+  /**
+   * Leave steady-state mode, sorting the population and updating the fitness
+   * values and cached statistics to include every replacement.
+   * @see BeginSteadyState
+   */
+  void EndSteadyState();
+
+  /**
+   * Score the Individuals which have a recorded primary parent with
+   * |delta_fitness_function| instead of the fitness function passed to
+   * Evaluate.<br/>
+   * Individuals without a record are scored by the full fitness function.
+   * Every record is dropped once the population has been evaluated. Pass
+   * nullptr to always use the full fitness function.<br/>
+   * Note: Only the Evaluate overload taking a FitnessFunction uses this and
+   * passes its user data along.
+   * @see RecordPrimaryParent
+   */
+  void SetDeltaFitnessFunction(DeltaFitnessFunction delta_fitness_function);
+  DeltaFitnessFunction GetDeltaFitnessFunction() const;
+
+  /**
+   * Drop every recorded primary parent and make room for one record per
+   * Individual.<br/>
+   * Call this before recording primary parents from several threads.
+   */
+  void ClearGeneDeltas();
+
+  /**
+   * Record |parent| as the primary parent of the Individual at storage
+   * |index| and find the genes where the two differ.<br/>
+   * Call this once the Individual has been fully built. Records for
+   * different indices may be made concurrently.
+   * @see ClearGeneDeltas
+   * @see Chromosome::FindChangedGenes
+   */
+  void RecordPrimaryParent(size_t index, const Individual& parent);
+
+  /**
+   * Record that the Individual at storage |index| is a copy of a parent
+   * whose score was |parent_score| with the bits set in |flipped_bits|
+   * flipped.<br/>
+   * Call this after the bits have been flipped.<br/>
+   * Records for different indices may be made concurrently.
+   * @see ClearGeneDeltas
+   */
+  void RecordFlippedBits(size_t index, double parent_score,
+                         const Chromosome& flipped_bits);
+
+  /**
+   * Returns true if the Individual at storage |index| has a recorded primary
+   * parent.
+   */
+  bool HasGeneDelta(size_t index) const;
+
+  /**
+   * Make room to score Individuals ahead of the next Evaluate.<br/>
+   * Call this before scoring Individuals early from several threads.
+   * @see ScoreEarly
+   */
+  void BeginEarlyScoring();
+
+  /**
+   * Score the Individual at storage |index| with |fitness_function| now
+   * instead of during the next Evaluate, such as right after it was
+   * created.<br/>
+   * The delta fitness function is used if the Individual has a recorded
+   * primary parent, so call this after recording one. The next Evaluate
+   * keeps the score, adds it to the fitness cache, and counts the
+   * Individual as evaluated. Individuals at different indices may be scored
+   * concurrently.
+   * @see BeginEarlyScoring
+   */
+  void ScoreEarly(size_t index, FitnessFunction fitness_function,
+                  void* user_data);
+
+  /**
+   * Exchange the individual stored at |index| in this population with the
+   * individual stored at |other_index| in |other|.<br/>
+   * The chromosomes trade storage instead of being copied so this costs the
+   * same no matter how large the genome is. Both indices are storage indices
+   * as used by GetIndividualWritable and neither population is sorted
+   * afterwards.<br/>
+   * Note: |other| must use the same Genome. Each population may only trade
+   * storage with one other population until RestoreStorage is called.
+   * @see RestoreStorage
+   */
+  void Swap(size_t index, Population* other, size_t other_index);
+
+  /**
+   * Move every chromosome which lives in the storage of the population we
+   * traded with via Swap back into storage owned by this population.<br/>
+   * The individuals themselves are unchanged. This happens automatically
+   * before the storage is reallocated, before individuals are dropped, and
+   * when the population is destroyed.
+   * @see Swap
+   */
+  void RestoreStorage();
+
+  /**
+   * Get the storage index of |individual|, ie: the index which returns
+   * |individual| from GetIndividualWritable.<br/>
+   * Note: |individual| must be a member of this population.
+   */
+  size_t GetStorageIndex(const Individual& individual) const;
+
   /**
    * Return the Individual with highest fitness value in the population.<br/>
    * Note: Requires the population to have been sorted.
    */
   const Individual& GetBestIndividual() const;
 
+  /**
+   * Store the |count| best Individuals in the population into |best| ordered
+   * from the best one down.<br/>
+   * This works even when fewer than |count| individuals are in rank order.
+   * <br/>Note: Requires the population to have been sorted.
+   * @see SetRankedCount
+   */
+  void GetBestIndividuals(size_t count,
+                          std::vector<const Individual*>* best) const;
+
   /**
    * Return the Individual at |index| position in the population based on
    * fitness where the individual at index 0 is the most fit, the second most
    * fit is at index 1, etc.<br/> Note: Requires the population to have been
-   * sorted.
+   * sorted. With a ranked count set, only indices below it and the last index
+   * follow fitness order.
+   * @see SetRankedCount
    */
   const Individual& GetIndividual(size_t index) const;
 
@@ -98,18 +464,59 @@ class Population {
    */
   Individual& GetIndividualWritable(size_t index);
 
+  /**
+   * Get the storage holding the chromosome bits of the individual at
+   * |index| position in the population so it can be written in bulk.<br/>
+   * Note: Writing the storage doesn't mark the individual dirty.
+   * @see GetIndividualWritable
+   */
+  std::byte* GetChromosomeStorage(size_t index);
+
+  /**
+   * Get a snapshot of the statistics which describe the population.<br/>
+   * The score statistics are calculated in a single pass at the end of
+   * Evaluate and the diversity is calculated the first time it's needed
+   * afterwards. Both are cached until the population is evaluated again or
+   * changed by Resize, Initialize, or Swap. Without an evaluation since the
+   * last change, the statistics are calculated on every call.<br/>
+   * Getting an individual or its storage to write also drops the cached
+   * statistics.<br/>
+   * Note: Changes made through a writable reference kept from before the
+   * statistics were last calculated aren't noticed until the next Evaluate.
+   * @see PopulationStats
+   */
+  PopulationStats GetStats() const;
+
+  /**
+   * Drop the cached statistics after the population changed.<br/>
+   * Writable accessors only drop statistics which are cached so calling this
+   * before handing individuals to several threads lets them share the
+   * population without writing to it.
+   * @see GetStats
+   */
+  void InvalidateStats();
+
   /**
    * Get the minimum score among individuals in the population.
+   * @see GetStats
    */
   double GetMinimumScore() const;
 
+  /**
+   * Get the maximum score among individuals in the population.
+   * @see GetStats
+   */
+  double GetMaximumScore() const;
+
   /**
    * Get the average score between individuals in the population.
+   * @see GetStats
    */
   double GetAverageScore() const;
 
   /**
    * Get the standard deviation of scores between individuals in the population.
+   * @see GetStats
    */
   double GetScoreStandardDeviation() const;
 
@@ -118,48 +525,331 @@ class Population {
    * The population diversity is a metric used to indicate how much the
    * genetic material backing the individuals varies. A high diversity value
    * means the individuals have very different genetic components. A value
-   * of zero means the individuals are identical.
+   * of zero means the individuals are identical.<br/>
+   * Computed as the average Hamming distance between every pair of
+   * individuals divided by the number of bits in the genome. Rather than
+   * comparing every pair, we count how many individuals have each bit set
+   * which takes time linear in the population size.
+   * @see GetStats
    */
   double GetPopulationDiversity() const;
 
   /**
-   * Select an individual from the population at random.
+   * Calculate the population diversity via |backend|, which must outlive
+   * the population.<br/>
+   * Pass nullptr, the default, to calculate it on the calling thread.
+   * @see GetPopulationDiversity
+   */
+  void SetReproductionBackend(ReproductionBackend* backend);
+
+  /**
+   * Estimate the population diversity from a random sample of
+   * |sample_size| distinct individuals.<br/>
+   * The estimate is unbiased and much cheaper than GetPopulationDiversity
+   * for very large populations. If |sample_size| is at least the population
+   * size, this returns the exact population diversity.
+   * @see GetPopulationDiversity
+   */
+  double EstimatePopulationDiversity(size_t sample_size,
+                                     RandomWrapper* random) const;
+
+  /**
+   * Select an individual from the population at random.<br/>
+   * Each of the selectors below accepts an optional |excluded| individual from
+   * this population which will never be selected. Selection then behaves as
+   * if |excluded| had been removed from the population, without copying
+   * anything. If the population only contains |excluded|, it is returned.
    */
-  const Individual& UniformSelect(RandomWrapper* random) const;
+  const Individual& UniformSelect(RandomWrapper* random,
+                                  const Individual* excluded = nullptr) const;
 
   /**
    * Spin a roulette wheel to select an individual where each slice on the wheel
    * corresponds to the partial sum of a ranked individual. The size of each
    * partial sum on the wheel is relative to the fitness of that individual with
    * more fit individuals having a larger-sized slice.<br/> Patial sums must
-   * have already been created via InitializePartialSums.
+   * have already been created via InitializePartialSums.<br/>
+   * When an individual is |excluded|, we spin a wheel with its slice cut out.
+   * @see InitializePartialSums
+   */
+  const Individual& RouletteWheelSelect(
+      RandomWrapper* random, const Individual* excluded = nullptr) const;
+
+  /**
+   * Select an individual with probability proportional to its fitness, the
+   * same as RouletteWheelSelect, in constant time by using an alias
+   * table.<br/>
+   * The alias table must have already been created via
+   * InitializeAliasTable.<br/>
+   * When an individual is |excluded|, we reject it and select again. If
+   * |excluded| holds nearly all of the fitness, we fall back to
+   * UniformSelect.
+   * @see InitializeAliasTable
+   */
+  const Individual& AliasSelect(RandomWrapper* random,
+                                const Individual* excluded = nullptr) const;
+
+  /**
+   * Select |count| individuals with stochastic universal sampling and store
+   * them in |selected| in random order.<br/>
+   * This spins the roulette wheel once with |count| evenly spaced pointers
+   * so the number of times each individual is selected never differs by more
+   * than one from its expected count. The whole selection is one sweep over
+   * the partial sums.<br/>
+   * Partial sums must have already been created via InitializePartialSums.
    * @see InitializePartialSums
    */
-  const Individual& RouletteWheelSelect(RandomWrapper* random) const;
+  void StochasticUniversalSelect(
+      size_t count, RandomWrapper* random,
+      std::vector<const Individual*>* selected) const;
 
   /**
    * Randomly select |tournament_size| individuals from the population and
    * return the one with highest fitness.
    */
-  const Individual& TournamentSelect(size_t tournament_size,
-                                     RandomWrapper* random) const;
+  const Individual& TournamentSelect(
+      size_t tournament_size, RandomWrapper* random,
+      const Individual* excluded = nullptr) const;
 
   /**
    * Select the individual in the population with highest fitness score.
    */
-  const Individual& RankSelect() const;
+  const Individual& RankSelect(const Individual* excluded = nullptr) const;
 
   /**
    * Use |fitness_function| to score each Individual in the population and then
-   * sort the population in terms of decreasing fitness.
+   * sort the population in terms of decreasing fitness.<br/>
+   * If |thread_pool| is not nullptr, the individuals are split into chunks of
+   * |chunk_size| and scored in parallel across the workers of the pool. The
+   * population is only sorted once every individual has been scored.<br/>
+   * If |fitness_cache| is not nullptr, only dirty Individuals are scored
+   * and each one is looked up in the cache first. Scores computed by
+   * |fitness_function| are added to the cache.<br/>
+   * If |step_stats| is not nullptr and instrumentation is compiled in, the
+   * evaluation and sort phases and their counters are recorded into it.<br/>
+   * Note: When scoring in parallel, |fitness_function| is called concurrently
+   * from several threads with the same |user_data|.
+   * @see ThreadPool::ParallelFor
+   * @see Individual::IsDirty
+   */
+  void Evaluate(FitnessFunction fitness_function, void* user_data,
+                ThreadPool* thread_pool = nullptr, size_t chunk_size = 0,
+                FitnessCache* fitness_cache = nullptr,
+                StepStats* step_stats = nullptr);
+
+  /**
+   * Use |batch_fitness_function| to score the Individuals in the population
+   * and then sort the population in terms of decreasing fitness.<br/>
+   * Without a |thread_pool|, the whole population is scored in one call. With
+   * one, the population is split into batches of |chunk_size| Individuals
+   * which are scored in parallel.<br/>
+   * With a |fitness_cache|, only the Individuals which missed the cache are
+   * scored and each run of consecutive ones is passed as a batch.<br/>
+   * |step_stats| is filled in the same way as the other overload.<br/>
+   * Note: When scoring in parallel, |batch_fitness_function| is called
+   * concurrently from several threads.
+   * @see FitnessBatch
+   */
+  void Evaluate(const BatchFitnessFunction& batch_fitness_function,
+                ThreadPool* thread_pool = nullptr, size_t chunk_size = 0,
+                FitnessCache* fitness_cache = nullptr,
+                StepStats* step_stats = nullptr);
+
+  /**
+   * Use |async_fitness_function| to score the Individuals in the population
+   * and then sort the population in terms of decreasing fitness.<br/>
+   * The Individuals needing a score are gathered into batches of
+   * |batch_size| and every batch is started without waiting for the ones
+   * before it, with at most |max_in_flight| batches started but not yet
+   * done at any time. If |batch_size| is 0, the Individuals are split evenly
+   * into |max_in_flight| batches. Returns once every batch is done.<br/>
+   * |fitness_cache| and |step_stats| are used in the same way as the other
+   * overloads.
+   * @see AsyncFitnessFunction
+   */
+  void Evaluate(const AsyncFitnessFunction& async_fitness_function,
+                size_t batch_size, size_t max_in_flight,
+                FitnessCache* fitness_cache = nullptr,
+                StepStats* step_stats = nullptr);
+
+  /**
+   * Get the storage indices of the Individuals which the last Evaluate
+   * passed to the fitness function, including the ones scored early.<br/>
+   * Fitness cache hits and Individuals which were already clean are left
+   * out when a cache is in use.
+   * @see Evaluate
+   * @see ScoreEarly
+   */
+  const std::vector<size_t>& GetEvaluatedIndices() const;
+
+ protected:
+  /**
+   * Sort the population by score and calculate the fitness of each
+   * Individual from those scores.
+   */
+  void UpdateFitness();
+
+  /**
+   * Calculate the fitness of each Individual from the scores of the sorted
+   * population.
+   */
+  void CalculateFitness();
+
+  /**
+   * Find the best and second best individuals in steady-state mode.
+   */
+  void FindBestIndividuals();
+
+  /**
+   * Add |delta| to the score of the individual at storage |index| in the
+   * steady-state score tree.
+   */
+  void AddToScoreTree(size_t index, double delta);
+
+  /**
+   * Sum the scores of the first |count| individuals by storage index from
+   * the steady-state score tree.
+   */
+  double SumScores(size_t count) const;
+
+  /**
+   * Select an individual with probability proportional to its fitness by
+   * descending the steady-state score tree. |excluded| is handled the same
+   * way as RouletteWheelSelect.
+   */
+  const Individual& ScoreTreeSelect(RandomWrapper* random,
+                                    const Individual* excluded) const;
+
+  /**
+   * Calculate the average, standard deviation, minimum, and maximum of the
+   * scores in one pass with Welford's method and store them in |stats|.
+   */
+  void CalculateScoreStats(PopulationStats* stats) const;
+
+  /**
+   * Score the Individual at storage |index| with |fitness_function|, or with
+   * the delta fitness function if it has a recorded primary parent.
+   */
+  double ScoreIndividual(size_t index, FitnessFunction fitness_function,
+                         void* user_data);
+
+  /**
+   * Collect the storage indices of the Individuals which need to be scored
+   * into pending_indices_. With a |fitness_cache|, that's only the dirty
+   * Individuals which aren't found in the cache. Individuals scored early
+   * are never scored again and are added after the ones to score. Counts the
+   * cache hits and evaluated Individuals into |step_stats|, if any.
+   * @return The number of Individuals to score.
    */
-  void Evaluate(FitnessFunction fitness_function, void* user_data);
+  size_t FindPendingIndividuals(FitnessCache* fitness_cache,
+                                ThreadPool* thread_pool, size_t chunk_size,
+                                StepStats* step_stats);
+
+  /**
+   * Add the newly scored Individuals to |fitness_cache|, mark them clean,
+   * and update the fitness of the population.<br/>
+   * The evaluation, which began at |evaluation_begin|, and the update are
+   * recorded into |step_stats|, if any.
+   */
+  void FinishEvaluation(FitnessCache* fitness_cache, StepStats* step_stats,
+                        uint64_t evaluation_begin);
+
+  /**
+   * Calculate the diversity between the |count| individuals whose indices
+   * are stored in |indices|. If |indices| is nullptr, use the first |count|
+   * individuals.
+   */
+  double CalculateDiversity(const size_t* indices, size_t count) const;
+
+  /**
+   * Construct a new Individual at the end of the population using the next
+   * free slot in the storage.<br/>
+   * Note: Requires the population to have capacity for another Individual.
+   */
+  Individual& AddIndividual();
+
+  /**
+   * Returns true if |row| points into the arena owned by this population.
+   */
+  bool OwnsRow(const std::byte* row) const;
 
  private:
+  /**
+   * One column of the alias table. The column is chosen uniformly and then
+   * we keep it with |probability| or take |alias| otherwise.
+   */
+  struct AliasSlot {
+    double probability;
+    size_t alias;
+  };
+
+  /**
+   * Frees the cache-aligned chromosome arena.
+   */
+  struct ArenaDeleter {
+    void operator()(std::byte* arena) const;
+  };
+
   const Genome& genome_;
+
+  // Chromosome bits for every Individual, |chromosome_stride_| bytes apart.
+  std::unique_ptr<std::byte[], ArenaDeleter> arena_;
+  size_t chromosome_stride_ = 0;
+  size_t capacity_ = 0;
+  ThreadPool* first_touch_thread_pool_ = nullptr;
+  ReproductionBackend* reproduction_backend_ = nullptr;
+
+  // Raw scores and fitness values indexed the same as individuals_.
+  std::unique_ptr<double[]> scores_;
+  std::unique_ptr<double[]> fitnesses_;
+
   std::vector<Individual> individuals_;
+
+  // Chromosome storage used by each Individual. This may point into the
+  // arena of storage_partner_ after a Swap.
+  std::vector<std::byte*> rows_;
+  Population* storage_partner_ = nullptr;
+
   std::vector<double> partial_sums_;
+  std::vector<AliasSlot> alias_table_;
   std::vector<size_t> sorted_indices_;
+  // Inverse of sorted_indices_ - the rank of each individual by storage index.
+  std::vector<size_t> ranks_;
+  size_t ranked_count_ = 0;
+  // Number of individuals at the front of sorted_indices_ in rank order.
+  size_t sorted_count_ = 0;
+  // Statistics cached by Evaluate. The diversity is filled in on demand.
+  mutable PopulationStats stats_;
+  bool has_score_stats_ = false;
+  mutable bool has_diversity_ = false;
+  // Gathered chromosomes and scores of the batches handed to an
+  // AsyncFitnessFunction.
+  std::vector<const std::byte*> async_chromosomes_;
+  std::vector<double> async_scores_;
+  // Scratch space used by Evaluate and InitializeAliasTable.
+  std::vector<size_t> pending_indices_;
+  // Storage indices scored by the fitness function during the last Evaluate.
+  std::vector<size_t> evaluated_indices_;
+  std::vector<uint64_t> chromosome_hashes_;
+  // Changed genes and primary parent score of each Individual, by storage
+  // index, for the delta fitness function.
+  DeltaFitnessFunction delta_fitness_function_ = nullptr;
+  std::vector<std::vector<size_t>> changed_genes_;
+  std::vector<std::vector<uint64_t>> parent_gene_values_;
+  std::vector<double> parent_scores_;
+  // Bytes rather than bools so records can be made concurrently.
+  std::vector<uint8_t> has_gene_delta_;
+  // Individuals, by storage index, scored by ScoreEarly since the last
+  // Evaluate.
+  std::vector<uint8_t> is_scored_early_;
+  // Steady-state mode keeps the storage indices in a heap with the worst
+  // individual on top, a Fenwick tree of the scores by storage index, and
+  // the storage indices of the two best individuals.
+  std::vector<size_t> worst_heap_;
+  std::vector<double> score_tree_;
+  size_t best_index_ = 0;
+  size_t second_best_index_ = 0;
+  bool is_steady_state_ = false;
   bool is_sorted_ = false;
 };
 
@@ -6,38 +6,106 @@
 
 #include "RandomWrapper.h"
 
-#include <array>
 #include <cassert>
+#include <climits>
 #include <cstddef>
 #include <cstdint>
-#include <functional>
+#include <cstring>
 #include <random>
 
+namespace {
+
+/**
+ * One round of the SplitMix64 generator.<br/>
+ * Used to scramble seeds so nearby seed values don't produce correlated
+ * streams.
+ */
+uint64_t SplitMix64(uint64_t value) {
+  constexpr uint64_t increment = 0x9e3779b97f4a7c15ULL;
+  constexpr uint64_t multiplier1 = 0xbf58476d1ce4e5b9ULL;
+  constexpr uint64_t multiplier2 = 0x94d049bb133111ebULL;
+  constexpr unsigned shift1 = 30U;
+  constexpr unsigned shift2 = 27U;
+  constexpr unsigned shift3 = 31U;
+
+  uint64_t z = value + increment;
+  z = (z ^ (z >> shift1)) * multiplier1;
+  z = (z ^ (z >> shift2)) * multiplier2;
+  return z ^ (z >> shift3);
+}
+
+}  // namespace
+
 namespace panga {
 
+Xoshiro256StarStar::Xoshiro256StarStar(uint64_t seed) {
+  // Each SplitMix64 round consumes the output of the last so the four state
+  // words are distinct and never all zero.
+  for (auto& word : state_) {
+    seed = SplitMix64(seed);
+    word = seed;
+  }
+}
+
+RandomWrapper::RandomWrapper(uint64_t seed) : seed_(seed) {}
+
+void RandomWrapper::SetSeed(uint64_t seed) {
+  seed_ = seed;
+  engine_.reset();
+  byte_buffer_count_ = 0;
+  draw_count_ = 0;
+}
+
+uint64_t RandomWrapper::GetSeed() {
+  if (!seed_.has_value()) {
+    constexpr unsigned bits_per_word = 32U;
+    std::random_device r;
+    seed_ = static_cast<uint64_t>(r()) << bits_per_word | r();
+  }
+  return *seed_;
+}
+
+// static
+uint64_t RandomWrapper::DeriveSeed(uint64_t seed, uint64_t stream) {
+  return SplitMix64(SplitMix64(seed) ^ stream);
+}
+
 bool RandomWrapper::CoinFlip(double probability) {
-  std::bernoulli_distribution dist(probability);
-  return dist(Engine());
+  return RandomUnit<double>() < probability;
 }
 
 std::byte RandomWrapper::RandomByte() {
   constexpr auto max_byte = 0xff;
-  auto& engine = Engine();
-  const auto val = engine();
-  return static_cast<std::byte>(val & max_byte);
+  if (byte_buffer_count_ == 0) {
+    byte_buffer_ = RandomWord();
+    byte_buffer_count_ = sizeof(uint64_t);
+  }
+  const auto val = static_cast<std::byte>(byte_buffer_ & max_byte);
+  byte_buffer_ >>= CHAR_BIT;
+  byte_buffer_count_--;
+  return val;
 }
 
-std::mt19937& RandomWrapper::Engine() {
-  if (!engine_.has_value()) {
-    constexpr size_t seed_size = 624U;
-    std::array<int, seed_size> seed_data;
-    std::random_device r;
-    std::generate_n(seed_data.data(), seed_data.size(), std::ref(r));
-    std::seed_seq seq(std::begin(seed_data), std::end(seed_data));
-    const std::mt19937 eng(seq);
-    engine_ = eng;
+void RandomWrapper::FillBytes(std::byte* buffer, size_t count) {
+  // Copy whole words at a time and then part of one more word for the tail.
+  const size_t word_count = count / sizeof(uint64_t);
+  for (size_t i = 0; i < word_count; i++) {
+    const uint64_t word = RandomWord();
+    std::memcpy(buffer + i * sizeof(uint64_t), &word, sizeof(uint64_t));
+  }
+  const size_t remaining = count % sizeof(uint64_t);
+  if (remaining != 0) {
+    const uint64_t word = RandomWord();
+    std::memcpy(buffer + word_count * sizeof(uint64_t), &word, remaining);
+  }
+}
+
+void RandomWrapper::FillWords(uint64_t* buffer, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    buffer[i] = RandomWord();
   }
-  return *engine_;
 }
 
+void RandomWrapper::InitializeEngine() { engine_.emplace(GetSeed()); }
+
 }  // namespace panga
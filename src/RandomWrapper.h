@@ -7,31 +7,173 @@
 #ifndef RANDOMWRAPPER_H__
 #define RANDOMWRAPPER_H__
 
+#include <cassert>
 #include <cstddef>
 #include <cstdint>
+#include <limits>
 #include <optional>
 #include <random>
+#include <type_traits>
+
+#include "Instrumentation.h"
 
 namespace panga {
 
 /**
- * A simple wrapper which may be used to generate random values.
+ * The xoshiro256** pseudo-random number generator by David Blackman and
+ * Sebastiano Vigna.<br/>
+ * Small (32 bytes of state), fast, and produces 64 high-quality bits per
+ * call. Satisfies the UniformRandomBitGenerator requirements so it can be
+ * used with the standard distributions as well.
+ */
+class Xoshiro256StarStar {
+ public:
+  using result_type = uint64_t;
+
+  /**
+   * Seed the generator state from a single 64-bit |seed|.<br/>
+   * The seed is expanded via SplitMix64 so that every seed (including 0)
+   * produces a valid state.
+   */
+  explicit Xoshiro256StarStar(uint64_t seed);
+
+  static constexpr result_type min() {
+    return std::numeric_limits<result_type>::min();
+  }
+  static constexpr result_type max() {
+    return std::numeric_limits<result_type>::max();
+  }
+
+  result_type operator()() {
+    constexpr unsigned multiply_shift = 7U;
+    constexpr uint64_t multiplier1 = 5U;
+    constexpr uint64_t multiplier2 = 9U;
+    constexpr unsigned state_shift = 17U;
+    constexpr unsigned rotate_shift = 45U;
+
+    const uint64_t result =
+        RotateLeft(state_[1] * multiplier1, multiply_shift) * multiplier2;
+    const uint64_t t = state_[1] << state_shift;
+    state_[2] ^= state_[0];
+    state_[3] ^= state_[1];
+    state_[1] ^= state_[2];
+    state_[0] ^= state_[3];
+    state_[2] ^= t;
+    state_[3] = RotateLeft(state_[3], rotate_shift);
+    return result;
+  }
+
+ private:
+  static constexpr uint64_t RotateLeft(uint64_t value, unsigned shift) {
+    constexpr unsigned bits_per_word = 64U;
+    return (value << shift) | (value >> (bits_per_word - shift));
+  }
+
+  static constexpr size_t StateSize = 4;
+  uint64_t state_[StateSize];
+};
+
+/**
+ * The engine used by RandomWrapper to produce random bits.<br/>
+ * Defaults to xoshiro256**. Define PANGA_USE_MT19937 (or configure cmake with
+ * -DPANGA_USE_MT19937=ON) to use the standard 64-bit Mersenne Twister
+ * instead.
+ */
+#if defined(PANGA_USE_MT19937)
+using RandomEngine = std::mt19937_64;
+#else
+using RandomEngine = Xoshiro256StarStar;
+#endif
+
+/**
+ * A simple wrapper which may be used to generate random values.<br/>
+ * Each RandomWrapper is driven by a 64-bit seed. If no seed is provided, one
+ * is drawn from std::random_device the first time a random value is needed.
+ * <br/>Independent streams of random values can be derived from a seed via
+ * DeriveSeed which lets several threads generate random values in parallel
+ * while still producing reproducible results.<br/>
+ * Every random value is built from 64-bit words produced by the engine
+ * without constructing standard distribution objects.
  */
 class RandomWrapper {
  public:
   RandomWrapper() = default;
+  explicit RandomWrapper(uint64_t seed);
   RandomWrapper(const RandomWrapper& rhs) = delete;
   RandomWrapper& operator=(const RandomWrapper& rhs) = delete;
   ~RandomWrapper() = default;
 
+  /**
+   * Generates a uniformly random 64-bit word.
+   */
+  uint64_t RandomWord() {
+    if constexpr (IsInstrumentationEnabled) {
+      draw_count_++;
+    }
+    return Engine()();
+  }
+
+  /**
+   * Generates a uniformly random integer in the range [0, |range|].
+   */
+  uint64_t RandomBounded(uint64_t range) {
+    if (range == std::numeric_limits<uint64_t>::max()) {
+      return RandomWord();
+    }
+    const uint64_t bound = range + 1U;
+#if defined(__SIZEOF_INT128__)
+    // Lemire's nearly divisionless method. Take the high word of a 128-bit
+    // product and only fall back to a division when the low word lands in the
+    // small biased region.
+    constexpr unsigned bits_per_word = 64U;
+    auto product = static_cast<unsigned __int128>(RandomWord()) * bound;
+    auto low = static_cast<uint64_t>(product);
+    if (low < bound) {
+      const uint64_t threshold = (0U - bound) % bound;
+      while (low < threshold) {
+        product = static_cast<unsigned __int128>(RandomWord()) * bound;
+        low = static_cast<uint64_t>(product);
+      }
+    }
+    return static_cast<uint64_t>(product >> bits_per_word);
+#else
+    // Reject the values which would make the modulo biased.
+    const uint64_t threshold = (0U - bound) % bound;
+    uint64_t value = RandomWord();
+    while (value < threshold) {
+      value = RandomWord();
+    }
+    return value % bound;
+#endif
+  }
+
   /**
    * Generates a uniformly random integer of type |IntegerType| in the range
    * [|min|, |max|].
    */
   template <typename IntegerType = uint32_t>
   IntegerType RandomInteger(IntegerType min, IntegerType max) {
-    std::uniform_int_distribution<IntegerType> dist(min, max);
-    return dist(Engine());
+    static_assert(std::is_integral_v<IntegerType>,
+                  "RandomInteger requires an integer type");
+    assert(min <= max);
+    using UnsignedType = std::make_unsigned_t<IntegerType>;
+    const auto range = static_cast<UnsignedType>(
+        static_cast<UnsignedType>(max) - static_cast<UnsignedType>(min));
+    return static_cast<IntegerType>(
+        static_cast<UnsignedType>(min) +
+        static_cast<UnsignedType>(RandomBounded(range)));
+  }
+
+  /**
+   * Fill |values| with |count| uniformly random integers of type
+   * |IntegerType| in the range [|min|, |max|].
+   */
+  template <typename IntegerType = uint32_t>
+  void RandomIntegers(IntegerType min, IntegerType max, IntegerType* values,
+                      size_t count) {
+    for (size_t i = 0; i < count; i++) {
+      values[i] = RandomInteger<IntegerType>(min, max);
+    }
   }
 
   /**
@@ -40,8 +182,29 @@ class RandomWrapper {
    */
   template <typename FloatType = double>
   FloatType RandomFloat(FloatType min, FloatType max) {
-    std::uniform_real_distribution<FloatType> dist(min, max);
-    return dist(Engine());
+    return min + (max - min) * RandomUnit<FloatType>();
+  }
+
+  /**
+   * Generates a uniformly random floating point value of type |FloatType| in
+   * the range [0, 1).<br/>
+   * Uses the top bits of one random word, as many as the mantissa can hold.
+   */
+  template <typename FloatType = double>
+  FloatType RandomUnit() {
+    static_assert(std::is_floating_point_v<FloatType>,
+                  "RandomUnit requires a floating point type");
+    constexpr unsigned bits_per_word = 64U;
+    constexpr unsigned max_bits = 63U;
+    constexpr unsigned mantissa_bits =
+        std::numeric_limits<FloatType>::digits < max_bits
+            ? std::numeric_limits<FloatType>::digits
+            : max_bits;
+    constexpr FloatType scale =
+        FloatType{1} / static_cast<FloatType>(uint64_t{1} << mantissa_bits);
+    return static_cast<FloatType>(RandomWord() >>
+                                  (bits_per_word - mantissa_bits)) *
+           scale;
   }
 
   /**
@@ -51,15 +214,71 @@ class RandomWrapper {
   bool CoinFlip(double probability);
 
   /**
-   * Generates a uniformly random byte.
+   * Generates a uniformly random byte.<br/>
+   * Bytes are carved out of 64-bit words so only one engine call is made per
+   * eight bytes.
    */
   std::byte RandomByte();
 
+  /**
+   * Fill |buffer| with |count| uniformly random bytes.
+   */
+  void FillBytes(std::byte* buffer, size_t count);
+
+  /**
+   * Fill |buffer| with |count| uniformly random 64-bit words.
+   */
+  void FillWords(uint64_t* buffer, size_t count);
+
+  /**
+   * Reset this RandomWrapper to produce the sequence of values determined by
+   * |seed|.
+   */
+  void SetSeed(uint64_t seed);
+
+  /**
+   * Get the seed which determines the values produced by this RandomWrapper.
+   * <br/>If no seed has been set, a random one is chosen now.
+   */
+  uint64_t GetSeed();
+
+  /**
+   * Derive the seed for an independent stream of random values from a parent
+   * |seed| and a |stream| identifier.<br/>
+   * The same |seed| and |stream| always derive the same seed while different
+   * |stream| values derive statistically unrelated seeds.
+   */
+  static uint64_t DeriveSeed(uint64_t seed, uint64_t stream);
+
+  /**
+   * Get the number of 64-bit words drawn from the engine since the seed was
+   * last set.<br/>
+   * Always 0 unless instrumentation is compiled in.
+   * @see IsInstrumentationEnabled
+   */
+  uint64_t GetDrawCount() const { return draw_count_; }
+
  protected:
-  std::mt19937& Engine();
+  RandomEngine& Engine() {
+    if (!engine_.has_value()) {
+      InitializeEngine();
+    }
+    return *engine_;
+  }
+
+  void InitializeEngine();
 
  private:
-  std::optional<std::mt19937> engine_;
+  std::optional<RandomEngine> engine_;
+  std::optional<uint64_t> seed_;
+
+  /**
+   * Random bits left over from the last word used by RandomByte.
+   */
+  uint64_t byte_buffer_ = 0;
+  size_t byte_buffer_count_ = 0;
+
+  uint64_t draw_count_ = 0;
 };
 
 }  // namespace panga
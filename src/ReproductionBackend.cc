@@ -0,0 +1,159 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include "ReproductionBackend.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "BitVector.h"
+#include "RandomWrapper.h"
+#include "ThreadPool.h"
+
+namespace {
+
+constexpr size_t BitsPerWord = sizeof(uint64_t) * CHAR_BIT;
+
+// The mutation rate is rounded to a multiple of 2^-MutationRateBits, the same
+// as MaskFlipMutator.
+constexpr unsigned MutationRateBits = 16U;
+
+// Mutation masks are drawn from a key of their own so they never reuse the
+// counters of the crossover mask.
+constexpr uint64_t MutationStream = std::numeric_limits<uint64_t>::max();
+
+constexpr unsigned HalfWordBits = 32U;
+
+// Random word number |counter| of the stream keyed by |key|.
+uint64_t CounterWord(uint64_t key, uint64_t counter) {
+  return panga::RandomWrapper::DeriveSeed(key, counter);
+}
+
+// Scale a random word into [0, |range|) via a multiply so the result is the
+// same everywhere, even without 128-bit integers.
+size_t ScaleWord(uint64_t word, size_t range) {
+  assert(range <= std::numeric_limits<uint32_t>::max());
+  return static_cast<size_t>(((word >> HalfWordBits) * range) >> HalfWordBits);
+}
+
+// Build word |word_index| of the mask of bits which flip. Write the rate as
+// the binary fraction 0.b1b2...b16 and walk the digits from the least
+// significant set one - ORing in a uniform word maps a bit density of d to
+// (1 + d) / 2 and ANDing maps it to d / 2.
+uint64_t MutationMask(uint64_t key, uint64_t rate, size_t word_index,
+                      size_t word_count) {
+  constexpr uint64_t rate_scale = uint64_t{1} << MutationRateBits;
+  if (rate == 0) {
+    return 0;
+  }
+  if (rate == rate_scale) {
+    return ~uint64_t{0};
+  }
+  unsigned digit = 0;
+  while (((rate >> digit) & 1U) == 0) {
+    digit++;
+  }
+  uint64_t mask = 0;
+  for (; digit < MutationRateBits; digit++) {
+    const uint64_t word = CounterWord(key, digit * word_count + word_index);
+    mask = ((rate >> digit) & 1U) != 0 ? (mask | word) : (mask & word);
+  }
+  return mask;
+}
+
+}  // namespace
+
+namespace panga {
+
+CpuReproductionBackend::CpuReproductionBackend(ThreadPool* thread_pool)
+    : thread_pool_(thread_pool) {}
+
+void CpuReproductionBackend::CreateOffspring(const OffspringBatch& batch) {
+  const auto create = [&batch](size_t begin, size_t end) {
+    std::vector<size_t> cuts;
+    for (size_t i = begin; i < end; i++) {
+      CreateOffspring(batch, i, &cuts);
+    }
+  };
+  if (thread_pool_ != nullptr) {
+    thread_pool_->ParallelFor(batch.count, 0, create);
+  } else {
+    create(0, batch.count);
+  }
+}
+
+// static
+void CpuReproductionBackend::CreateOffspring(const OffspringBatch& batch,
+                                             size_t index,
+                                             std::vector<size_t>* cuts) {
+  assert(index < batch.count);
+  assert(cuts != nullptr);
+  const size_t word_count =
+      BitVector::BytesRequired(batch.bit_count) / sizeof(uint64_t);
+  if (word_count == 0) {
+    return;
+  }
+  const uint64_t seed = batch.seeds[index];
+  const std::byte* first_parent = batch.first_parents[index];
+  const std::byte* second_parent = batch.second_parents[index];
+  std::byte* offspring = batch.offspring[index];
+
+  // Cut points are the first bits taken from the other parent.
+  cuts->resize(batch.crossover_point_count);
+  for (size_t i = 0; i < cuts->size(); i++) {
+    (*cuts)[i] = ScaleWord(CounterWord(seed, i), batch.bit_count);
+  }
+  std::sort(cuts->begin(), cuts->end());
+
+  constexpr double rate_scale = uint64_t{1} << MutationRateBits;
+  const auto rate = static_cast<uint64_t>(
+      std::llround(std::clamp(batch.mutation_rate, 0.0, 1.0) * rate_scale));
+  const uint64_t mutation_key = RandomWrapper::DeriveSeed(seed, MutationStream);
+  const size_t tail_bits = batch.bit_count % BitsPerWord;
+
+  // Bits set in the crossover mask come from the first parent.
+  uint64_t cut_state = ~uint64_t{0};
+  size_t next_cut = 0;
+  for (size_t w = 0; w < word_count; w++) {
+    uint64_t mask = 0;
+    if (cuts->empty()) {
+      mask = CounterWord(seed, w);
+    } else {
+      mask = cut_state;
+      const size_t word_end = (w + 1U) * BitsPerWord;
+      for (; next_cut < cuts->size() && (*cuts)[next_cut] < word_end;
+           next_cut++) {
+        // Every bit from the cut onwards switches parents.
+        mask ^= ~uint64_t{0} << ((*cuts)[next_cut] % BitsPerWord);
+        cut_state = ~cut_state;
+      }
+    }
+
+    const size_t offset = w * sizeof(uint64_t);
+    const uint64_t first = BitVector::LoadUnalignedWord(first_parent + offset);
+    const uint64_t second =
+        BitVector::LoadUnalignedWord(second_parent + offset);
+    const uint64_t word = (first & mask) | (second & ~mask);
+    uint64_t flips = MutationMask(mutation_key, rate, w, word_count);
+    // Never flip the padding bits past the end of the chromosome.
+    if (tail_bits != 0 && w + 1U == word_count) {
+      flips &= (uint64_t{1} << tail_bits) - 1U;
+    }
+    BitVector::StoreUnalignedWord(offspring + offset, word ^ flips);
+  }
+}
+
+double CpuReproductionBackend::CalculateDiversity(const std::byte* const* rows,
+                                                  size_t count,
+                                                  size_t bit_count) {
+  return BitVector::CalculateDiversity(rows, count, bit_count);
+}
+
+}  // namespace panga
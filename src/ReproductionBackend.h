@@ -0,0 +1,120 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef REPRODUCTIONBACKEND_H__
+#define REPRODUCTIONBACKEND_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace panga {
+
+class ThreadPool;
+
+/**
+ * Describes the offspring of one generation which are built by crossing over
+ * two parents and mutating the result.<br/>
+ * Every array holds |count| entries. Rows are the raw chromosome bits of each
+ * Individual, BitVector::BytesRequired(|bit_count|) bytes long.
+ */
+struct OffspringBatch {
+  const std::byte* const* first_parents = nullptr;
+  const std::byte* const* second_parents = nullptr;
+  std::byte* const* offspring = nullptr;
+
+  /**
+   * Each offspring draws every random value from a counter-based generator
+   * keyed by its seed, so the result doesn't depend on the order in which
+   * offspring are built.
+   * @see RandomWrapper::DeriveSeed
+   */
+  const uint64_t* seeds = nullptr;
+
+  size_t count = 0;
+  size_t bit_count = 0;
+
+  /**
+   * Number of cut points for k-point crossover. Bits between cut points
+   * alternate between the parents, starting with the first parent.<br/>
+   * If this is 0, every bit is picked from either parent at random.
+   */
+  size_t crossover_point_count = 0;
+
+  /**
+   * Probability that each bit of an offspring flips after crossover.
+   */
+  double mutation_rate = 0.0;
+};
+
+/**
+ * Builds offspring and measures diversity over whole populations at once so
+ * the work can be handed to an accelerator.<br/>
+ * A GeneticAlgorithm with a backend still selects parents on the CPU but
+ * passes every crossover of a generation to CreateOffspring in one batch.
+ * Implementations may run the batch anywhere as long as they produce the
+ * same bits as CpuReproductionBackend, which makes results independent of
+ * the backend in use.
+ * @see GeneticAlgorithm::SetReproductionBackend
+ */
+class ReproductionBackend {
+ public:
+  virtual ~ReproductionBackend() = default;
+
+  /**
+   * Cross over and mutate every offspring described by |batch|.<br/>
+   * The rows of the parents never overlap the rows of the offspring.
+   */
+  virtual void CreateOffspring(const OffspringBatch& batch) = 0;
+
+  /**
+   * Return the average Hamming distance between every pair of the |count|
+   * |rows| divided by |bit_count|.
+   * @see Population::GetPopulationDiversity
+   */
+  virtual double CalculateDiversity(const std::byte* const* rows, size_t count,
+                                    size_t bit_count) = 0;
+};
+
+/**
+ * Reference implementation of ReproductionBackend which runs on the CPU.
+ * <br/>Crossover masks are built a word at a time and bits flip via the
+ * same binary expansion of the mutation rate used by MaskFlipMutator, so
+ * every kernel maps directly onto one work item per word of each offspring.
+ */
+class CpuReproductionBackend : public ReproductionBackend {
+ public:
+  /**
+   * Construct a backend which splits offspring across the workers of
+   * |thread_pool|.<br/>
+   * If |thread_pool| is nullptr, the default, everything runs on the calling
+   * thread. The pool must outlive the backend.
+   */
+  explicit CpuReproductionBackend(ThreadPool* thread_pool = nullptr);
+  CpuReproductionBackend(const CpuReproductionBackend& rhs) = delete;
+  CpuReproductionBackend& operator=(const CpuReproductionBackend& rhs) =
+      delete;
+  ~CpuReproductionBackend() override = default;
+
+  void CreateOffspring(const OffspringBatch& batch) override;
+  double CalculateDiversity(const std::byte* const* rows, size_t count,
+                            size_t bit_count) override;
+
+  /**
+   * Cross over and mutate offspring |index| of |batch|.<br/>
+   * |cuts| is scratch space for the crossover points which each worker
+   * reuses across the offspring it creates.
+   */
+  static void CreateOffspring(const OffspringBatch& batch, size_t index,
+                              std::vector<size_t>* cuts);
+
+ private:
+  ThreadPool* thread_pool_;
+};
+
+}  // namespace panga
+
+#endif  // REPRODUCTIONBACKEND_H__
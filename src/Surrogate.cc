@@ -0,0 +1,225 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include "Surrogate.h"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstdint>
+#include <limits>
+#include <utility>
+
+#include "BinaryStream.h"
+
+namespace {
+
+constexpr size_t BitsPerWord = sizeof(uint64_t) * CHAR_BIT;
+
+}  // namespace
+
+namespace panga {
+
+NearestNeighborSurrogate::NearestNeighborSurrogate(size_t capacity)
+    : capacity_(capacity) {
+  assert(capacity_ != 0);
+  entries_.reserve(capacity_);
+}
+
+void NearestNeighborSurrogate::Add(const BitVector& chromosome, double score) {
+  const size_t set_bit_count = chromosome.GetSetBitCount();
+  size_t slot = entries_.size();
+  if (entries_.size() < capacity_) {
+    entries_.emplace_back();
+  } else {
+    slot = next_slot_;
+    next_slot_ = (next_slot_ + 1U) % capacity_;
+    RemoveFromBucket(slot);
+  }
+
+  if (buckets_.size() <= set_bit_count) {
+    buckets_.resize(set_bit_count + 1U);
+  }
+  auto& bucket = buckets_[set_bit_count];
+  auto& entry = entries_[slot];
+  entry.chromosome = chromosome;
+  entry.score = score;
+  entry.set_bit_count = set_bit_count;
+  entry.bucket_position = bucket.size();
+  bucket.push_back(slot);
+}
+
+bool NearestNeighborSurrogate::Estimate(const BitVector& chromosome,
+                                        double* score) const {
+  if (entries_.empty()) {
+    return false;
+  }
+
+  const size_t set_bit_count = chromosome.GetSetBitCount();
+  size_t best_distance = std::numeric_limits<size_t>::max();
+  // Every chromosome in the buckets |offset| away from ours is at least
+  // |offset| bits away so stop once that can't beat the best we found.
+  for (size_t offset = 0; offset < best_distance; offset++) {
+    const bool has_lower = offset <= set_bit_count;
+    const bool has_upper = set_bit_count + offset < buckets_.size();
+    if (!has_lower && !has_upper) {
+      break;
+    }
+    if (has_lower) {
+      SearchBucket(chromosome, set_bit_count - offset, &best_distance, score);
+    }
+    if (has_upper && offset != 0) {
+      SearchBucket(chromosome, set_bit_count + offset, &best_distance, score);
+    }
+  }
+  return true;
+}
+
+void NearestNeighborSurrogate::Clear() {
+  entries_.clear();
+  buckets_.clear();
+  next_slot_ = 0;
+}
+
+size_t NearestNeighborSurrogate::Size() const { return entries_.size(); }
+
+size_t NearestNeighborSurrogate::GetCapacity() const { return capacity_; }
+
+void NearestNeighborSurrogate::Save(std::ostream* stream) const {
+  WriteSize(stream, capacity_);
+  WriteSize(stream, next_slot_);
+  WriteSize(stream, entries_.size());
+  for (const auto& entry : entries_) {
+    const size_t bit_count = entry.chromosome.GetBitCount();
+    WriteSize(stream, bit_count);
+    for (size_t bit = 0; bit < bit_count; bit += BitsPerWord) {
+      const size_t bit_width = std::min(BitsPerWord, bit_count - bit);
+      WriteBinary(stream, entry.chromosome.GetInt<uint64_t>(bit, bit_width));
+    }
+    WriteBinary(stream, entry.score);
+  }
+
+  // Ties go to the chromosome found first so the order of each bucket is
+  // part of the archive.
+  WriteSize(stream, buckets_.size());
+  for (const auto& bucket : buckets_) {
+    WriteSize(stream, bucket.size());
+    for (const size_t slot : bucket) {
+      WriteSize(stream, slot);
+    }
+  }
+}
+
+bool NearestNeighborSurrogate::Load(std::istream* stream, size_t bit_count) {
+  Clear();
+  size_t capacity = 0;
+  size_t next_slot = 0;
+  size_t entry_count = 0;
+  // Each entry is its bit count, its chromosome words and its score.
+  const size_t entry_word_count =
+      bit_count / BitsPerWord + (bit_count % BitsPerWord != 0 ? 1U : 0U) + 2U;
+  if (!ReadSize(stream, &capacity) || !ReadSize(stream, &next_slot) ||
+      !ReadSize(stream, &entry_count) || capacity != capacity_ ||
+      next_slot >= capacity_ || entry_count > capacity_ ||
+      entry_word_count >
+          std::numeric_limits<size_t>::max() / sizeof(uint64_t) ||
+      !HasBytesLeft(stream, entry_count, entry_word_count * sizeof(uint64_t))) {
+    return false;
+  }
+
+  entries_.resize(entry_count);
+  for (auto& entry : entries_) {
+    size_t entry_bit_count = 0;
+    if (!ReadSize(stream, &entry_bit_count) || entry_bit_count != bit_count) {
+      Clear();
+      return false;
+    }
+    entry.chromosome.SetBitCount(bit_count);
+    for (size_t bit = 0; bit < bit_count; bit += BitsPerWord) {
+      const size_t bit_width = std::min(BitsPerWord, bit_count - bit);
+      uint64_t word = 0;
+      if (!ReadBinary(stream, &word)) {
+        Clear();
+        return false;
+      }
+      entry.chromosome.SetInt<uint64_t>(word, bit, bit_width);
+    }
+    if (!ReadBinary(stream, &entry.score)) {
+      Clear();
+      return false;
+    }
+  }
+
+  // Every entry must be in exactly the bucket for its set bit count.
+  size_t bucket_count = 0;
+  if (!ReadSize(stream, &bucket_count) || bucket_count > bit_count + 1U) {
+    Clear();
+    return false;
+  }
+  std::vector<bool> is_bucketed(entry_count);
+  size_t bucketed_count = 0;
+  buckets_.resize(bucket_count);
+  for (size_t set_bit_count = 0; set_bit_count < bucket_count;
+       set_bit_count++) {
+    size_t bucket_size = 0;
+    if (!ReadSize(stream, &bucket_size) ||
+        bucket_size > entry_count - bucketed_count) {
+      Clear();
+      return false;
+    }
+    auto& bucket = buckets_[set_bit_count];
+    for (size_t position = 0; position < bucket_size; position++) {
+      size_t slot = 0;
+      if (!ReadSize(stream, &slot) || slot >= entry_count ||
+          is_bucketed[slot] ||
+          entries_[slot].chromosome.GetSetBitCount() != set_bit_count) {
+        Clear();
+        return false;
+      }
+      is_bucketed[slot] = true;
+      entries_[slot].set_bit_count = set_bit_count;
+      entries_[slot].bucket_position = position;
+      bucket.push_back(slot);
+    }
+    bucketed_count += bucket_size;
+  }
+  if (bucketed_count != entry_count) {
+    Clear();
+    return false;
+  }
+  next_slot_ = next_slot;
+  return true;
+}
+
+void NearestNeighborSurrogate::SearchBucket(const BitVector& chromosome,
+                                            size_t set_bit_count,
+                                            size_t* best_distance,
+                                            double* score) const {
+  if (set_bit_count >= buckets_.size()) {
+    return;
+  }
+  for (const size_t slot : buckets_[set_bit_count]) {
+    const auto& entry = entries_[slot];
+    const size_t distance = chromosome.HammingDistance(entry.chromosome);
+    if (distance < *best_distance) {
+      *best_distance = distance;
+      *score = entry.score;
+    }
+  }
+}
+
+void NearestNeighborSurrogate::RemoveFromBucket(size_t slot) {
+  // Move the last slot of the bucket into the place of the one we remove.
+  auto& bucket = buckets_[entries_[slot].set_bit_count];
+  const size_t position = entries_[slot].bucket_position;
+  assert(bucket[position] == slot);
+  const size_t moved_slot = bucket.back();
+  bucket[position] = moved_slot;
+  entries_[moved_slot].bucket_position = position;
+  bucket.pop_back();
+}
+
+}  // namespace panga
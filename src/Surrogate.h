@@ -0,0 +1,118 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef SURROGATE_H__
+#define SURROGATE_H__
+
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "BitVector.h"
+
+namespace panga {
+
+class Individual;
+
+/**
+ * Cheaply estimates the score the fitness function would give an
+ * Individual.<br/>
+ * Lower estimates are better, the same as scores. Called concurrently from
+ * every thread building offspring so it must be thread-safe.
+ * @see GeneticAlgorithm::SetSurrogateFunction
+ */
+using SurrogateFunction = double (*)(const Individual*, void*);
+
+/**
+ * Estimates scores from the nearest of a bounded archive of chromosomes
+ * which have already been scored.<br/>
+ * The archive is indexed by the number of set bits in each chromosome. Two
+ * chromosomes whose set bit counts differ by d are at least d bits apart so
+ * the search walks outwards from the set bit count of the query and stops
+ * as soon as no closer chromosome can exist.<br/>
+ * Once the archive is full, the oldest chromosome is replaced.<br/>
+ * Note: Estimate may be called from several threads at once but Add must not
+ * run concurrently with anything else.
+ */
+class NearestNeighborSurrogate {
+ public:
+  /**
+   * Construct an archive holding at most |capacity| chromosomes.
+   */
+  explicit NearestNeighborSurrogate(size_t capacity);
+  NearestNeighborSurrogate(const NearestNeighborSurrogate& rhs) = delete;
+  NearestNeighborSurrogate& operator=(const NearestNeighborSurrogate& rhs) =
+      delete;
+  ~NearestNeighborSurrogate() = default;
+
+  /**
+   * Remember that |chromosome| was given |score|.
+   */
+  void Add(const BitVector& chromosome, double score);
+
+  /**
+   * Estimate the score of |chromosome| as the score of the archived
+   * chromosome with the smallest Hamming distance to it.<br/>
+   * Ties go to the chromosome found first.
+   * @return false, leaving |score| untouched, if the archive is empty.
+   */
+  bool Estimate(const BitVector& chromosome, double* score) const;
+
+  /**
+   * Forget every archived chromosome.
+   */
+  void Clear();
+
+  size_t Size() const;
+  size_t GetCapacity() const;
+
+  /**
+   * Write every archived chromosome and score to |stream| along with the
+   * order in which they are searched and replaced.
+   * @see Load
+   */
+  void Save(std::ostream* stream) const;
+
+  /**
+   * Replace the archive with the one written by Save.<br/>
+   * The archive must have the same capacity as the saved one and every
+   * archived chromosome must hold |bit_count| bits.
+   * @return false, leaving the archive empty, if the stream doesn't hold a
+   * matching archive.
+   */
+  bool Load(std::istream* stream, size_t bit_count);
+
+ protected:
+  struct Entry {
+    BitVector chromosome;
+    double score = 0.0;
+    size_t set_bit_count = 0;
+    // Position of this entry in the bucket for its set bit count.
+    size_t bucket_position = 0;
+  };
+
+  /**
+   * Look for a chromosome closer to |chromosome| than |*best_distance| in
+   * the bucket of chromosomes with |set_bit_count| bits set.
+   */
+  void SearchBucket(const BitVector& chromosome, size_t set_bit_count,
+                    size_t* best_distance, double* score) const;
+
+  void RemoveFromBucket(size_t slot);
+
+ private:
+  std::vector<Entry> entries_;
+  // Slots into entries_ of the chromosomes having each number of set bits.
+  std::vector<std::vector<size_t>> buckets_;
+  size_t capacity_;
+  // Slot the next chromosome replaces once the archive is full.
+  size_t next_slot_ = 0;
+};
+
+}  // namespace panga
+
+#endif  // SURROGATE_H__
@@ -0,0 +1,346 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <fstream>
+#include <utility>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace {
+
+// When the caller doesn't pick a chunk size, split each worker slice into
+// roughly this many chunks. More chunks means finer-grained stealing.
+constexpr size_t DefaultChunksPerWorker = 8;
+
+// Index of the worker running on the current thread.
+thread_local size_t current_worker_index = 0;
+
+// Set while the current thread is executing chunks of a ParallelFor job so
+// nested calls can fall back to running serially.
+thread_local bool is_running_job = false;
+
+// Number the current thread as |worker_index| until the scope ends.
+class ScopedWorkerIndex {
+ public:
+  explicit ScopedWorkerIndex(size_t worker_index)
+      : previous_worker_index_(current_worker_index) {
+    current_worker_index = worker_index;
+  }
+  ScopedWorkerIndex(const ScopedWorkerIndex& rhs) = delete;
+  ScopedWorkerIndex& operator=(const ScopedWorkerIndex& rhs) = delete;
+  ~ScopedWorkerIndex() { current_worker_index = previous_worker_index_; }
+
+ private:
+  size_t previous_worker_index_;
+};
+
+constexpr size_t DecimalBase = 10;
+
+// Parse the decimal number at |*position| in |text| and advance |*position|
+// past it.
+bool ParseCpu(const std::string& text, size_t* position, size_t* cpu) {
+  const size_t begin = *position;
+  size_t value = 0;
+  while (*position < text.size() && text[*position] >= '0' &&
+         text[*position] <= '9') {
+    value = value * DecimalBase + static_cast<size_t>(text[*position] - '0');
+    (*position)++;
+  }
+  *cpu = value;
+  return *position != begin;
+}
+
+}  // namespace
+
+namespace panga {
+
+ThreadPool::ThreadPool(size_t thread_count) : ThreadPool(thread_count, {}) {}
+
+ThreadPool::ThreadPool(size_t thread_count, std::vector<size_t> cpus)
+    : cpus_(std::move(cpus)) {
+  if (thread_count == 0) {
+    thread_count = std::max<size_t>(1U, std::thread::hardware_concurrency());
+  }
+  thread_count_ = thread_count;
+  slices_ = std::make_unique<WorkerSlice[]>(thread_count_);
+
+  // The calling thread acts as worker 0 so we only need the rest.
+  threads_.reserve(thread_count_ - 1U);
+  for (size_t i = 1; i < thread_count_; i++) {
+    threads_.emplace_back(&ThreadPool::WorkerLoop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    is_shutting_down_ = true;
+  }
+  work_available_.notify_all();
+
+  for (auto& thread : threads_) {
+    thread.join();
+  }
+}
+
+size_t ThreadPool::GetThreadCount() const { return thread_count_; }
+
+// static
+size_t ThreadPool::GetCurrentWorkerIndex() { return current_worker_index; }
+
+void ThreadPool::ParallelFor(size_t count, size_t chunk_size,
+                             const RangeFunction& function) {
+  if (chunk_size == 0) {
+    chunk_size =
+        std::max<size_t>(1U, count / (thread_count_ * DefaultChunksPerWorker));
+  }
+  RunJob(count, chunk_size, true, function);
+}
+
+void ThreadPool::ParallelForEachWorker(size_t count,
+                                       const RangeFunction& function) {
+  // One chunk covers the largest slice so each worker makes a single call.
+  const size_t chunk_size =
+      std::max<size_t>(1U, (count + thread_count_ - 1U) / thread_count_);
+  RunJob(count, chunk_size, false, function);
+}
+
+size_t ThreadPool::GetWorkerCpu(size_t worker_index) const {
+  assert(worker_index < thread_count_);
+  if (worker_index == 0 || cpus_.empty()) {
+    return NotPinned;
+  }
+  return cpus_[worker_index % cpus_.size()];
+}
+
+// static
+bool ThreadPool::SetCurrentThreadAffinity(const std::vector<size_t>& cpus) {
+#if defined(__linux__)
+  if (cpus.empty()) {
+    return false;
+  }
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  for (const size_t cpu : cpus) {
+    if (cpu >= CPU_SETSIZE) {
+      return false;
+    }
+    CPU_SET(cpu, &cpu_set);
+  }
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) ==
+         0;
+#else
+  static_cast<void>(cpus);
+  return false;
+#endif
+}
+
+// static
+std::vector<size_t> ThreadPool::GetCurrentThreadAffinity() {
+  std::vector<size_t> cpus;
+#if defined(__linux__)
+  cpu_set_t cpu_set;
+  CPU_ZERO(&cpu_set);
+  if (pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0) {
+    for (size_t cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpu_set)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  return cpus;
+}
+
+// static
+std::vector<size_t> ThreadPool::GetNodeCpus(size_t node) {
+#if defined(__linux__)
+  std::ifstream stream("/sys/devices/system/node/node" + std::to_string(node) +
+                       "/cpulist");
+  std::string cpu_list;
+  if (std::getline(stream, cpu_list)) {
+    return ParseCpuList(cpu_list);
+  }
+#else
+  static_cast<void>(node);
+#endif
+  return {};
+}
+
+// static
+std::vector<size_t> ThreadPool::ParseCpuList(const std::string& cpu_list) {
+  std::vector<size_t> cpus;
+  size_t position = 0;
+  while (position < cpu_list.size()) {
+    size_t first = 0;
+    if (!ParseCpu(cpu_list, &position, &first)) {
+      return {};
+    }
+    size_t last = first;
+    if (position < cpu_list.size() && cpu_list[position] == '-') {
+      position++;
+      if (!ParseCpu(cpu_list, &position, &last) || last < first) {
+        return {};
+      }
+    }
+    for (size_t cpu = first; cpu <= last; cpu++) {
+      cpus.push_back(cpu);
+    }
+    if (position < cpu_list.size()) {
+      if (cpu_list[position] != ',' || position + 1U == cpu_list.size()) {
+        return {};
+      }
+      position++;
+    }
+  }
+  return cpus;
+}
+
+void ThreadPool::RunJob(size_t count, size_t chunk_size, bool allow_stealing,
+                        const RangeFunction& function) {
+  if (count == 0) {
+    return;
+  }
+
+  // Nothing to distribute with a single worker and we can't hand nested work
+  // to workers which are already busy with the outer range.
+  // Either way the calling thread is the only worker of this job, even if
+  // it's a worker of some other pool, so per-worker scratch sized for this
+  // pool can be indexed by the worker index.
+  if (thread_count_ == 1U || is_running_job) {
+    const ScopedWorkerIndex worker_index(0);
+    function(0, count);
+    return;
+  }
+
+  const std::lock_guard<std::mutex> job_lock(job_mutex_);
+  assert(chunk_size != 0);
+
+  // Give each worker one contiguous slice of the range. Any remainder is
+  // spread one index at a time over the first few slices.
+  const size_t slice_size = count / thread_count_;
+  const size_t remainder = count % thread_count_;
+  size_t slice_begin = 0;
+  for (size_t i = 0; i < thread_count_; i++) {
+    const size_t slice_end = slice_begin + slice_size + (i < remainder ? 1 : 0);
+    slices_[i].next.store(slice_begin, std::memory_order_relaxed);
+    slices_[i].end = slice_end;
+    slice_begin = slice_end;
+  }
+  assert(slice_begin == count);
+
+  {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    function_ = &function;
+    chunk_size_ = chunk_size;
+    allow_stealing_ = allow_stealing;
+    exception_ = nullptr;
+    workers_running_ = thread_count_ - 1U;
+    job_id_++;
+  }
+  work_available_.notify_all();
+
+  // Help out with the work on the calling thread.
+  {
+    const ScopedWorkerIndex worker_index(0);
+    RunWorker(0);
+  }
+
+  std::exception_ptr exception;
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_complete_.wait(lock, [this] { return workers_running_ == 0; });
+    function_ = nullptr;
+    std::swap(exception, exception_);
+  }
+
+  if (exception) {
+    std::rethrow_exception(exception);
+  }
+}
+
+void ThreadPool::WorkerLoop(size_t worker_index) {
+  current_worker_index = worker_index;
+  size_t last_job_id = 0;
+
+  const size_t cpu = GetWorkerCpu(worker_index);
+  if (cpu != NotPinned) {
+    // Pinning is best-effort. An unavailable CPU leaves the thread wherever
+    // the scheduler puts it.
+    SetCurrentThreadAffinity({cpu});
+  }
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_available_.wait(lock, [this, last_job_id] {
+        return is_shutting_down_ || job_id_ != last_job_id;
+      });
+      if (is_shutting_down_) {
+        return;
+      }
+      last_job_id = job_id_;
+    }
+
+    RunWorker(worker_index);
+
+    bool is_last_worker = false;
+    {
+      const std::lock_guard<std::mutex> lock(mutex_);
+      is_last_worker = --workers_running_ == 0;
+    }
+    if (is_last_worker) {
+      work_complete_.notify_one();
+    }
+  }
+}
+
+void ThreadPool::RunWorker(size_t worker_index) {
+  assert(function_ != nullptr);
+  is_running_job = true;
+
+  // Start with our own slice and then walk over the other slices stealing
+  // whatever chunks are left.
+  const size_t slice_count = allow_stealing_ ? thread_count_ : 1U;
+  for (size_t offset = 0; offset < slice_count; offset++) {
+    WorkerSlice* slice = &slices_[(worker_index + offset) % thread_count_];
+    size_t begin = 0;
+    size_t end = 0;
+    while (ClaimChunk(slice, &begin, &end)) {
+      try {
+        (*function_)(begin, end);
+      } catch (...) {
+        const std::lock_guard<std::mutex> lock(mutex_);
+        if (!exception_) {
+          exception_ = std::current_exception();
+        }
+      }
+    }
+  }
+
+  is_running_job = false;
+}
+
+bool ThreadPool::ClaimChunk(WorkerSlice* slice, size_t* begin,
+                            size_t* end) const {
+  const size_t chunk_begin =
+      slice->next.fetch_add(chunk_size_, std::memory_order_relaxed);
+  if (chunk_begin >= slice->end) {
+    return false;
+  }
+  *begin = chunk_begin;
+  *end = std::min(chunk_begin + chunk_size_, slice->end);
+  return true;
+}
+
+}  // namespace panga
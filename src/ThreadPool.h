@@ -0,0 +1,205 @@
+//-------------------------------------------------------------------------------------------------------
+// Copyright (C) Taylor Woll and panga contributors. All rights reserved.
+// Licensed under the MIT license. See LICENSE.txt file in the project root for
+// full license information.
+//-------------------------------------------------------------------------------------------------------
+
+#ifndef THREADPOOL_H__
+#define THREADPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace panga {
+
+/**
+ * A small fixed-size pool of worker threads which can be used to split a
+ * range of indices across cores.<br/>
+ * The thread calling ParallelFor participates in the work so a pool with a
+ * thread count of n uses n - 1 background threads.<br/>
+ * Work is distributed by splitting the index range into one contiguous slice
+ * per worker. Each worker consumes its own slice in chunks and, once that
+ * slice is exhausted, steals chunks from the slices of other workers. This
+ * keeps all workers busy even when the cost of each index varies a lot.<br/>
+ * On machines with several NUMA nodes, pool threads can be pinned to CPUs so
+ * each worker stays next to the memory it first touched.
+ * @see ParallelForEachWorker
+ */
+class ThreadPool {
+ public:
+  /**
+   * Signature of the function executed by ParallelFor.<br/>
+   * Called with a half-open range [|begin|, |end|) of indices to process.
+   */
+  using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+  /**
+   * Construct a pool with |thread_count| workers (including the calling
+   * thread).<br/>
+   * If |thread_count| is 0, we will use one worker per hardware thread.
+   */
+  explicit ThreadPool(size_t thread_count = 0);
+
+  /**
+   * Construct a pool with |thread_count| workers and pin worker i to CPU
+   * |cpus|[i % |cpus|.size()].<br/>
+   * Worker 0 is whichever thread calls ParallelFor so it isn't pinned by the
+   * pool. Pin the calling thread via SetCurrentThreadAffinity if it should
+   * stay on the same node as the rest of the workers.<br/>
+   * If |cpus| is empty, no thread is pinned.
+   * @see GetNodeCpus
+   */
+  ThreadPool(size_t thread_count, std::vector<size_t> cpus);
+  ThreadPool(const ThreadPool& rhs) = delete;
+  ThreadPool& operator=(const ThreadPool& rhs) = delete;
+  ~ThreadPool();
+
+  /**
+   * Get the number of workers in the pool, including the calling thread.
+   */
+  size_t GetThreadCount() const;
+
+  /**
+   * Call |function| over every index in [0, |count|) split into chunks of
+   * |chunk_size| indices and spread across the workers in the pool.<br/>
+   * Blocks until every index has been processed.<br/>
+   * If |chunk_size| is 0, a chunk size is chosen based on |count| and the
+   * number of workers.<br/>
+   * If |function| throws, the first exception thrown is rethrown on the
+   * calling thread after all workers have stopped.<br/>
+   * Note: Calling ParallelFor from inside |function| runs the nested range
+   * serially on the current worker.
+   */
+  void ParallelFor(size_t count, size_t chunk_size,
+                   const RangeFunction& function);
+
+  /**
+   * Call |function| once on every worker with the slice of [0, |count|)
+   * owned by that worker. Workers don't steal from each other so, for a given
+   * |count|, the same worker always processes the same indices.<br/>
+   * ParallelFor hands out the same slices before it starts stealing so
+   * memory first touched here ends up local to the worker which mostly uses
+   * it afterwards.<br/>
+   * Workers whose slice is empty, which happens when |count| is less than
+   * the number of workers, aren't called.
+   * @see ParallelFor
+   */
+  void ParallelForEachWorker(size_t count, const RangeFunction& function);
+
+  /**
+   * Get the index of the worker executing the current thread.<br/>
+   * The calling thread of ParallelFor is worker 0 and pool threads are
+   * numbered 1 through GetThreadCount() - 1. Threads which are not part of
+   * any pool also return 0, as does a worker of another pool while it runs
+   * a nested ParallelFor serially.<br/>
+   * This can be used to index into per-worker scratch storage from inside a
+   * fitness function.
+   */
+  static size_t GetCurrentWorkerIndex();
+
+  /**
+   * Get the CPU worker |worker_index| is pinned to.<br/>
+   * Returns NotPinned if the pool doesn't pin that worker.
+   */
+  size_t GetWorkerCpu(size_t worker_index) const;
+
+  static constexpr size_t NotPinned = static_cast<size_t>(-1);
+
+  /**
+   * Restrict the current thread to running on |cpus|.<br/>
+   * Returns false if the affinity couldn't be set, which is always the case
+   * on platforms other than Linux.
+   */
+  static bool SetCurrentThreadAffinity(const std::vector<size_t>& cpus);
+
+  /**
+   * Get the CPUs the current thread may run on.<br/>
+   * Returns an empty vector if the affinity isn't known.
+   */
+  static std::vector<size_t> GetCurrentThreadAffinity();
+
+  /**
+   * Get the CPUs belonging to NUMA node |node|.<br/>
+   * Returns an empty vector if there is no such node or the topology isn't
+   * known, which is always the case on platforms other than Linux.
+   */
+  static std::vector<size_t> GetNodeCpus(size_t node);
+
+  /**
+   * Parse a Linux cpulist such as "0-3,8,10-11" into a list of CPUs.<br/>
+   * Returns an empty vector if |cpu_list| is malformed.
+   */
+  static std::vector<size_t> ParseCpuList(const std::string& cpu_list);
+
+ protected:
+  static constexpr size_t CacheLineSize = 64;
+
+  /**
+   * The slice of the index range owned by one worker.<br/>
+   * |next| is advanced by the owner and by thieves alike so claiming a chunk
+   * never requires a lock.
+   */
+  struct alignas(CacheLineSize) WorkerSlice {
+    std::atomic<size_t> next{0};
+    size_t end = 0;
+  };
+
+  /**
+   * Main loop run by each background thread.
+   */
+  void WorkerLoop(size_t worker_index);
+
+  /**
+   * Process chunks from the slice owned by |worker_index| and then steal
+   * chunks from other slices until the whole range is complete.
+   */
+  void RunWorker(size_t worker_index);
+
+  /**
+   * Split [0, |count|) into one slice per worker and hand it to the workers,
+   * running worker 0 on the calling thread.
+   */
+  void RunJob(size_t count, size_t chunk_size, bool allow_stealing,
+              const RangeFunction& function);
+
+  /**
+   * Try to claim a chunk from |slice|.
+   * @return true if a chunk was claimed and stored in |begin| and |end|.
+   */
+  bool ClaimChunk(WorkerSlice* slice, size_t* begin, size_t* end) const;
+
+ private:
+  std::vector<std::thread> threads_;
+  std::unique_ptr<WorkerSlice[]> slices_;
+  std::vector<size_t> cpus_;
+  size_t thread_count_ = 1;
+
+  // Held for the duration of a ParallelFor call so concurrent callers take
+  // turns using the workers.
+  std::mutex job_mutex_;
+
+  std::mutex mutex_;
+  std::condition_variable work_available_;
+  std::condition_variable work_complete_;
+
+  // State describing the currently running ParallelFor job.
+  const RangeFunction* function_ = nullptr;
+  size_t chunk_size_ = 1;
+  bool allow_stealing_ = true;
+  size_t job_id_ = 0;
+  size_t workers_running_ = 0;
+  std::exception_ptr exception_;
+  bool is_shutting_down_ = false;
+};
+
+}  // namespace panga
+
+#endif  // THREADPOOL_H__
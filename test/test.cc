@@ -4,15 +4,32 @@
 // full license information.
 //-------------------------------------------------------------------------------------------------------
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <sstream>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "BinaryStream.h"
 #include "BitVector.h"
+#include "FitnessCache.h"
+#include "FixedChromosome.h"
 #include "GeneticAlgorithm.h"
 #include "Individual.h"
+#include "Instrumentation.h"
+#include "IslandModel.h"
 
 #define AssertTrue(expr, msg)                                               \
   if (!(expr)) {                                                            \
@@ -28,10 +45,21 @@
   }
 
 using panga::BitVector;
+using panga::Chromosome;
+using panga::FixedChromosome;
+using panga::FixedGenome;
 using panga::GeneticAlgorithm;
 using panga::Genome;
 using panga::Individual;
+using panga::IslandModel;
+using panga::Population;
 using panga::RandomWrapper;
+using panga::ReadEnum;
+using panga::StepPhase;
+using panga::StepStats;
+using panga::ThreadPool;
+using panga::WriteBinary;
+using panga::WriteEnum;
 
 namespace testing {
 
@@ -58,7 +86,10 @@ double TestObjective(Individual* individual, void* user_test_data) {
   return static_cast<double>(fail_bits);
 }
 
-bool TestSolveMatchingProblem(const char* target) {
+bool TestSolveMatchingProblem(
+    const char* target,
+    GeneticAlgorithm::MutatorType mutator_type =
+        GeneticAlgorithm::MutatorType::Flip) {
   GeneticAlgorithm ga;
   Genome& genome = ga.GetGenome();
   TestUserData test_data;
@@ -94,7 +125,7 @@ bool TestSolveMatchingProblem(const char* target) {
   ga.SetMutationRateSchedule(
       GeneticAlgorithm::MutationRateSchedule::Proportional);
   ga.SetCrossoverType(GeneticAlgorithm::CrossoverType::Uniform);
-  ga.SetMutatorType(GeneticAlgorithm::MutatorType::Flip);
+  ga.SetMutatorType(mutator_type);
   ga.SetSelectorType(GeneticAlgorithm::SelectorType::Tournament);
   ga.SetTournamentSize(tournament_size);
   ga.SetKPointCrossoverPointCount(k_point_count);
@@ -133,6 +164,2567 @@ bool TestSolveMatchingProblem(const char* target) {
   return false;
 }
 
+struct ParallelTestUserData {
+  std::atomic<size_t> evaluation_count{0};
+  BitVector target_bits;
+};
+
+double ParallelTestObjective(Individual* individual, void* user_test_data) {
+  auto* test_data = static_cast<ParallelTestUserData*>(user_test_data);
+  test_data->evaluation_count++;
+  return static_cast<double>(
+      test_data->target_bits.HammingDistance(*individual));
+}
+
+struct TestRunResult {
+  std::vector<BitVector> chromosomes;
+  std::vector<double> scores;
+};
+
+// Builds and runs a GeneticAlgorithm which scores boolean genes against the
+// target bits of a ParallelTestUserData. Tests set only the knobs they're
+// about and leave the rest at the defaults below.
+class TestRun {
+ public:
+  using Callback = std::function<void(GeneticAlgorithm*)>;
+
+  // Score through |test_data| when given so the test can read the
+  // evaluation count and target bits afterwards.
+  explicit TestRun(ParallelTestUserData* test_data = nullptr)
+      : test_data_(test_data) {}
+
+  TestRun& Seed(uint64_t seed) {
+    seed_ = seed;
+    return *this;
+  }
+  // With a bit count of 0, a Configure callback must add the genes and set
+  // the fitness function.
+  TestRun& BitCount(size_t bit_count) {
+    bit_count_ = bit_count;
+    return *this;
+  }
+  TestRun& PopulationSize(size_t population_size) {
+    population_size_ = population_size;
+    return *this;
+  }
+  TestRun& Generations(size_t generations) {
+    generations_ = generations;
+    return *this;
+  }
+  TestRun& Threads(size_t thread_count) {
+    thread_count_ = thread_count;
+    return *this;
+  }
+  TestRun& Elites(size_t elite_count, size_t mutated_elite_count = 0) {
+    elite_count_ = elite_count;
+    mutated_elite_count_ = mutated_elite_count;
+    return *this;
+  }
+  // Called in order before the GeneticAlgorithm is initialized.
+  TestRun& Configure(Callback configure) {
+    configure_.push_back(std::move(configure));
+    return *this;
+  }
+  // Called in order after the last generation, before the population is
+  // collected.
+  TestRun& Finish(Callback finish) {
+    finish_.push_back(std::move(finish));
+    return *this;
+  }
+
+  // Return the final population in rank order.
+  TestRunResult Run() const {
+    ParallelTestUserData own_data;
+    ParallelTestUserData* test_data =
+        test_data_ != nullptr ? test_data_ : &own_data;
+    GeneticAlgorithm ga;
+    if (bit_count_ != 0) {
+      test_data->target_bits.SetBitCount(bit_count_);
+      ga.GetGenome().AddBooleanGenes(bit_count_);
+      ga.SetFitnessFunction(ParallelTestObjective);
+      ga.SetUserData(test_data);
+    }
+    ga.SetPopulationSize(population_size_);
+    ga.SetEliteCount(elite_count_);
+    ga.SetMutatedEliteCount(mutated_elite_count_);
+    ga.SetThreadCount(thread_count_);
+    ga.SetRandomSeed(seed_);
+    for (const auto& configure : configure_) {
+      configure(&ga);
+    }
+    ga.Initialize();
+    for (size_t generation = 0; generation < generations_; generation++) {
+      ga.Step();
+    }
+    for (const auto& finish : finish_) {
+      finish(&ga);
+    }
+
+    TestRunResult result;
+    const auto& population = ga.GetPopulation();
+    for (size_t i = 0; i < population.Size(); i++) {
+      result.chromosomes.emplace_back(population.GetIndividual(i));
+      result.scores.push_back(population.GetIndividual(i).GetScore());
+    }
+    return result;
+  }
+
+ private:
+  ParallelTestUserData* test_data_;
+  uint64_t seed_ = 1U;
+  size_t bit_count_ = 100U;
+  size_t population_size_ = 30U;
+  size_t generations_ = 5U;
+  size_t thread_count_ = 1U;
+  size_t elite_count_ = 0U;
+  size_t mutated_elite_count_ = 0U;
+  std::vector<Callback> configure_;
+  std::vector<Callback> finish_;
+};
+
+bool TestParallelEvaluation(size_t thread_count) {
+  GeneticAlgorithm ga;
+  Genome& genome = ga.GetGenome();
+  ParallelTestUserData test_data;
+
+  constexpr size_t test_bit_count = 300U;
+  constexpr size_t population_size = 250U;
+  constexpr size_t generations = 5U;
+  test_data.target_bits.SetBitCount(test_bit_count);
+  genome.AddBooleanGenes(test_bit_count);
+
+  ga.SetPopulationSize(population_size);
+  ga.SetFitnessFunction(ParallelTestObjective);
+  ga.SetUserData(&test_data);
+  ga.SetThreadCount(thread_count);
+  ga.SetEvaluationChunkSize(3);
+  // Use a selector which needs the whole population sorted.
+  ga.SetSelectorType(GeneticAlgorithm::SelectorType::RouletteWheel);
+  ga.Initialize();
+
+  for (size_t generation = 0; generation < generations; generation++) {
+    ga.Step();
+  }
+  AssertTrue(test_data.evaluation_count == population_size * generations,
+             "Every individual is evaluated exactly once per generation");
+
+  const auto& population = ga.GetPopulation();
+  for (size_t i = 0; i < population.Size(); i++) {
+    const auto& individual = population.GetIndividual(i);
+    AssertTrue(individual.GetScore() ==
+                   static_cast<double>(
+                       test_data.target_bits.HammingDistance(individual)),
+               "Parallel evaluation stores the score for each individual");
+    if (i > 0) {
+      AssertTrue(population.GetIndividual(i - 1).GetScore() <=
+                     individual.GetScore(),
+                 "Population is sorted after parallel evaluation");
+    }
+  }
+
+  return true;
+}
+
+bool TestBatchEvaluation(size_t thread_count) {
+  constexpr uint64_t seed = 41U;
+  constexpr size_t bit_count = 90U;
+  constexpr size_t population_size = 50U;
+  constexpr size_t generations = 5U;
+
+  GeneticAlgorithm ga;
+  BitVector target(bit_count);
+  ga.GetGenome().AddBooleanGenes(bit_count);
+  ga.SetPopulationSize(population_size);
+  ga.SetEliteCount(1);
+  ga.SetRandomSeed(seed);
+  ga.SetThreadCount(thread_count);
+
+  std::atomic<size_t> call_count{0};
+  std::atomic<size_t> scored_count{0};
+  std::atomic<bool> are_chromosomes_valid{true};
+  ga.SetBatchFitnessFunction([&](const panga::FitnessBatch& batch) {
+    call_count++;
+    scored_count += batch.count;
+    for (size_t i = 0; i < batch.count; i++) {
+      const auto& individual = batch.individuals[i];
+      // The raw chromosome holds the same bits as the Individual.
+      const auto* bytes = batch.chromosomes[i];
+      for (size_t bit = 0; bit < individual.GetBitCount(); bit++) {
+        const bool is_set =
+            (std::to_integer<unsigned>(bytes[bit / CHAR_BIT]) >>
+             (bit % CHAR_BIT)) &
+            1U;
+        if (is_set != individual.Get(bit)) {
+          are_chromosomes_valid = false;
+        }
+      }
+      batch.scores[i] = static_cast<double>(target.HammingDistance(individual));
+    }
+  });
+  ga.Initialize();
+
+  for (size_t generation = 0; generation < generations; generation++) {
+    ga.Step();
+  }
+
+  AssertTrue(are_chromosomes_valid, "Batches expose the chromosome bits");
+  AssertTrue(scored_count == population_size * generations,
+             "Each individual is scored once per generation");
+  if (thread_count == 1) {
+    AssertTrue(call_count == generations,
+               "Serial evaluation scores a generation in one call");
+  }
+
+  // Steady-state offspring are passed to the batch function one at a time.
+  ga.RunSteadyState(population_size);
+  AssertTrue(scored_count <= population_size * (generations + 1U),
+             "Steady-state offspring are scored at most once each");
+  const auto& population = ga.GetPopulation();
+  for (size_t i = 0; i < population.Size(); i++) {
+    const auto& individual = population.GetIndividual(i);
+    AssertTrue(individual.GetScore() ==
+                   static_cast<double>(target.HammingDistance(individual)),
+               "Batch scores are stored with their individuals");
+  }
+
+  return true;
+}
+
+bool TestAsyncEvaluation() {
+  constexpr size_t population_size = 40U;
+  constexpr size_t batch_size = 7U;
+  constexpr size_t max_in_flight = 3U;
+  constexpr size_t cache_capacity = 64U;
+
+  std::atomic<size_t> max_in_flight_seen{0};
+  const auto run = [&](bool use_async, ParallelTestUserData* test_data) {
+    // Score each batch on its own thread like a request to a remote service.
+    std::vector<std::thread> requests;
+    std::atomic<size_t> in_flight{0};
+    TestRun test_run(test_data);
+    test_run.Seed(47U)
+        .BitCount(70U)
+        .PopulationSize(population_size)
+        .Generations(6U)
+        .Elites(2)
+        .Configure([](GeneticAlgorithm* ga) {
+          // Cache hits leave gaps between the individuals which need a
+          // score.
+          ga->SetFitnessCacheCapacity(cache_capacity);
+        })
+        .Finish([&](GeneticAlgorithm* ga) {
+          ga->RunSteadyState(population_size);
+          for (auto& request : requests) {
+            request.join();
+          }
+        });
+    if (use_async) {
+      test_run.Configure([&](GeneticAlgorithm* ga) {
+        ga->SetEvaluationChunkSize(batch_size);
+        ga->SetMaxInFlightBatches(max_in_flight);
+        ga->SetAsyncFitnessFunction(
+            [&](panga::FitnessBatch batch, panga::FitnessCompletion done) {
+              const size_t count = ++in_flight;
+              if (count > max_in_flight_seen) {
+                max_in_flight_seen = count;
+              }
+              requests.emplace_back([&, batch, done]() {
+                for (size_t i = 0; i < batch.count; i++) {
+                  const auto& individual = batch.individuals[batch.indices[i]];
+                  assert(batch.chromosomes[i] == individual.GetBytes());
+                  batch.scores[i] = ParallelTestObjective(
+                      const_cast<Individual*>(&individual), test_data);
+                }
+                in_flight--;
+                done();
+              });
+            });
+      });
+    }
+    return test_run.Run();
+  };
+
+  ParallelTestUserData sync_data;
+  ParallelTestUserData async_data;
+  const auto sync = run(false, &sync_data);
+  const auto async = run(true, &async_data);
+
+  AssertTrue(sync.chromosomes.size() == async.chromosomes.size(),
+             "Both runs keep every individual");
+  for (size_t i = 0; i < sync.chromosomes.size(); i++) {
+    AssertTrue(sync.chromosomes[i].Equals(async.chromosomes[i]),
+               "Async evaluation doesn't change the result");
+    AssertTrue(async.scores[i] ==
+                   static_cast<double>(async_data.target_bits.HammingDistance(
+                       async.chromosomes[i])),
+               "Async scores are stored with their individuals");
+  }
+  AssertTrue(sync_data.evaluation_count == async_data.evaluation_count,
+             "Async evaluation scores the same individuals");
+  AssertTrue(max_in_flight_seen != 0 && max_in_flight_seen <= max_in_flight,
+             "No more batches than the limit are in flight");
+
+  return true;
+}
+
+bool TestSeededRunsAreReproducible(
+    GeneticAlgorithm::SelectorType selector_type) {
+  constexpr uint64_t seed = 12345U;
+  const auto run = [selector_type](uint64_t run_seed, size_t thread_count) {
+    return TestRun()
+        .Seed(run_seed)
+        .Threads(thread_count)
+        .Elites(2, 2)
+        .Configure([selector_type](GeneticAlgorithm* ga) {
+          ga->SetCrossoverType(GeneticAlgorithm::CrossoverType::TwoPoint);
+          ga->SetSelectorType(selector_type);
+          ga->SetAllowSameParentCouples(false);
+        })
+        .Run()
+        .chromosomes;
+  };
+  const auto serial = run(seed, 1);
+  const auto serial_again = run(seed, 1);
+  const auto parallel = run(seed, 4);
+  const auto other_seed = run(seed + 1U, 1);
+
+  AssertTrue(serial.size() == parallel.size(), "Populations have equal size");
+  bool is_different_seed_identical = true;
+  for (size_t i = 0; i < serial.size(); i++) {
+    AssertTrue(serial[i].Equals(serial_again[i]),
+               "Runs with the same seed produce the same population");
+    AssertTrue(serial[i].Equals(parallel[i]),
+               "Runs with the same seed produce the same population "
+               "regardless of thread count");
+    is_different_seed_identical &= serial[i].Equals(other_seed[i]);
+  }
+  AssertTrue(!is_different_seed_identical,
+             "Runs with different seeds produce different populations");
+
+  return true;
+}
+
+bool TestSteadyState(GeneticAlgorithm::SelectorType selector_type) {
+  constexpr size_t bit_count = 200U;
+  constexpr size_t population_size = 40U;
+  constexpr size_t evaluation_count = 3000U;
+
+  const auto run = [selector_type](size_t thread_count, bool* is_valid) {
+    ParallelTestUserData test_data;
+    return TestRun(&test_data)
+        .Seed(321U)
+        .BitCount(bit_count)
+        .PopulationSize(population_size)
+        .Generations(1)
+        .Threads(thread_count)
+        .Configure([selector_type](GeneticAlgorithm* ga) {
+          ga->SetMutationRate(1.0 / bit_count);
+          ga->SetSelectorType(selector_type);
+          ga->SetAllowSameParentCouples(false);
+        })
+        .Finish([&test_data, is_valid](GeneticAlgorithm* ga) {
+          const double initial_best_score =
+              ga->GetPopulation().GetMinimumScore();
+          ga->RunSteadyState(evaluation_count);
+
+          const auto& population = ga->GetPopulation();
+          *is_valid =
+              ga->GetCurrentGeneration() == 0 &&
+              ga->GetEvaluationCount() <= population_size + evaluation_count &&
+              test_data.evaluation_count == ga->GetEvaluationCount() &&
+              population.Size() == population_size &&
+              population.GetMinimumScore() < initial_best_score &&
+              population.GetMinimumScore() ==
+                  population.GetBestIndividual().GetScore();
+
+          double score_sum = 0.0;
+          for (size_t i = 0; i < population.Size(); i++) {
+            const auto& individual = population.GetIndividual(i);
+            *is_valid &= individual.GetScore() ==
+                         static_cast<double>(
+                             test_data.target_bits.HammingDistance(individual));
+            if (i > 0) {
+              *is_valid &= population.GetIndividual(i - 1).GetScore() <=
+                           individual.GetScore();
+            }
+            score_sum += individual.GetScore();
+          }
+          *is_valid &= std::fabs(score_sum / population_size -
+                                 population.GetAverageScore()) < 1e-9;
+        })
+        .Run()
+        .chromosomes;
+  };
+
+  bool is_valid = false;
+  const auto serial = run(1, &is_valid);
+  AssertTrue(is_valid,
+             "Steady-state offspring replace the worst individuals and keep "
+             "the population sorted and scored");
+  const auto serial_again = run(1, &is_valid);
+  AssertTrue(is_valid, "Serial steady-state run is valid");
+  for (size_t i = 0; i < serial.size(); i++) {
+    AssertTrue(serial[i].Equals(serial_again[i]),
+               "Serial steady-state runs with the same seed are identical");
+  }
+
+  run(4, &is_valid);
+  AssertTrue(is_valid,
+             "Parallel steady-state workers keep the population consistent");
+
+  return true;
+}
+
+// Hands every migrant sent by one island back to the next island which asks,
+// as if they came from another process.
+class LoopbackTransport : public panga::MigrationTransport {
+ public:
+  void Send(size_t /*island_index*/,
+            const std::vector<panga::Migrant>& migrants) override {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    send_count_++;
+    pending_.insert(pending_.end(), migrants.begin(), migrants.end());
+  }
+
+  void Receive(size_t /*island_index*/,
+               std::vector<panga::Migrant>* migrants) override {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& migrant : pending_) {
+      migrants->push_back(std::move(migrant));
+    }
+    pending_.clear();
+  }
+
+  size_t GetSendCount() {
+    const std::lock_guard<std::mutex> lock(mutex_);
+    return send_count_;
+  }
+
+ private:
+  std::mutex mutex_;
+  std::vector<panga::Migrant> pending_;
+  size_t send_count_ = 0;
+};
+
+// Hands each island one migrant whose chromosome is a bit short, as if it
+// came from a process running a different genome.
+class ShortMigrantTransport : public panga::MigrationTransport {
+ public:
+  explicit ShortMigrantTransport(size_t bit_count) : bit_count_(bit_count) {}
+
+  void Send(size_t /*island_index*/,
+            const std::vector<panga::Migrant>& /*migrants*/) override {}
+
+  void Receive(size_t /*island_index*/,
+               std::vector<panga::Migrant>* migrants) override {
+    panga::Migrant migrant;
+    migrant.chromosome.SetBitCount(bit_count_ - 1U);
+    migrants->push_back(std::move(migrant));
+  }
+
+ private:
+  size_t bit_count_;
+};
+
+// Hands each island the chromosome its fitness function is looking for with
+// a score no island would give it, as if the sender scored it differently.
+class ForgedScoreTransport : public panga::MigrationTransport {
+ public:
+  explicit ForgedScoreTransport(size_t bit_count) : bit_count_(bit_count) {}
+
+  void Send(size_t /*island_index*/,
+            const std::vector<panga::Migrant>& /*migrants*/) override {}
+
+  void Receive(size_t /*island_index*/,
+               std::vector<panga::Migrant>* migrants) override {
+    panga::Migrant migrant;
+    migrant.chromosome.SetBitCount(bit_count_);
+    migrant.score = -1.0;
+    migrants->push_back(std::move(migrant));
+  }
+
+ private:
+  size_t bit_count_;
+};
+
+void ConfigureIsland(GeneticAlgorithm* ga, ParallelTestUserData* test_data) {
+  constexpr size_t population_size = 30U;
+  ga->GetGenome().AddBooleanGenes(test_data->target_bits.GetBitCount());
+  ga->SetPopulationSize(population_size);
+  ga->SetEliteCount(1);
+  ga->SetFitnessFunction(ParallelTestObjective);
+  ga->SetUserData(test_data);
+}
+
+bool TestIslandModel(IslandModel::MigrationTopology topology) {
+  constexpr uint64_t seed = 77U;
+  constexpr size_t bit_count = 120U;
+  constexpr size_t island_count = 4U;
+  constexpr size_t generations = 12U;
+  constexpr size_t migration_interval = 3U;
+
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  IslandModel model(island_count);
+  for (size_t i = 0; i < island_count; i++) {
+    ConfigureIsland(&model.GetIsland(i), &test_data);
+  }
+  LoopbackTransport transport;
+  model.SetMigrationInterval(migration_interval);
+  model.SetMigrationTopology(topology);
+  model.SetMigrationTransport(&transport);
+  model.SetRandomSeed(seed);
+  model.Initialize();
+  model.Run(generations);
+
+  AssertTrue(transport.GetSendCount() ==
+                 island_count * (generations / migration_interval),
+             "Every island sends its migrants every interval");
+  AssertTrue(model.GetAcceptedMigrantCount() > 0,
+             "Migrants replace the worst individuals of other islands");
+  double best_score = model.GetIsland(0).GetPopulation().GetMinimumScore();
+  for (size_t i = 0; i < island_count; i++) {
+    const auto& island = model.GetIsland(i);
+    AssertTrue(island.GetCurrentGeneration() + 1U == generations,
+               "Every island runs every generation");
+    best_score = std::min(best_score, island.GetPopulation().GetMinimumScore());
+    const auto& population = island.GetPopulation();
+    for (size_t j = 0; j < population.Size(); j++) {
+      const auto& individual = population.GetIndividual(j);
+      AssertTrue(individual.GetScore() ==
+                     static_cast<double>(
+                         test_data.target_bits.HammingDistance(individual)),
+                 "Migrants arrive with the score of their chromosome");
+    }
+  }
+  AssertTrue(model.GetBestIndividual().GetScore() == best_score,
+             "The best individual comes from the best island");
+
+  return true;
+}
+
+bool TestShortMigrantsAreRejected() {
+  constexpr uint64_t seed = 79U;
+  constexpr size_t bit_count = 64U;
+  constexpr size_t island_count = 2U;
+  constexpr size_t generations = 7U;
+  constexpr size_t migration_interval = 3U;
+
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  IslandModel model(island_count);
+  for (size_t i = 0; i < island_count; i++) {
+    ConfigureIsland(&model.GetIsland(i), &test_data);
+  }
+  ShortMigrantTransport transport(bit_count);
+  model.SetMigrationInterval(migration_interval);
+  model.SetMigrationTransport(&transport);
+  model.SetRandomSeed(seed);
+  model.Initialize();
+  model.Run(generations);
+
+  AssertTrue(model.GetRejectedMigrantCount() ==
+                 island_count * (generations / migration_interval),
+             "Every migrant with the wrong number of bits is dropped");
+  for (size_t i = 0; i < island_count; i++) {
+    const auto& population = model.GetIsland(i).GetPopulation();
+    for (size_t j = 0; j < population.Size(); j++) {
+      AssertTrue(population.GetIndividual(j).GetBitCount() == bit_count,
+                 "Dropped migrants never join an island");
+    }
+  }
+
+  return true;
+}
+
+bool TestMigrantsAreRescored() {
+  constexpr uint64_t seed = 80U;
+  constexpr size_t bit_count = 64U;
+  constexpr size_t generations = 6U;
+  constexpr size_t migration_interval = 3U;
+
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  IslandModel model(1);
+  ConfigureIsland(&model.GetIsland(0), &test_data);
+  ForgedScoreTransport transport(bit_count);
+  model.SetMigrationInterval(migration_interval);
+  model.SetMigrationTransport(&transport);
+  model.SetRandomSeed(seed);
+  model.Initialize();
+  model.Run(generations);
+
+  AssertTrue(
+      model.GetAcceptedMigrantCount() == generations / migration_interval,
+      "Migrants which score well on the island are inserted");
+  const auto& population = model.GetIsland(0).GetPopulation();
+  for (size_t i = 0; i < population.Size(); i++) {
+    const auto& individual = population.GetIndividual(i);
+    AssertTrue(individual.GetScore() ==
+                   static_cast<double>(
+                       test_data.target_bits.HammingDistance(individual)),
+               "Migrants are scored by the island they arrive at");
+  }
+
+  return true;
+}
+
+bool TestIslandsWithoutMigration() {
+  constexpr uint64_t seed = 78U;
+  constexpr size_t bit_count = 90U;
+  constexpr size_t island_count = 3U;
+  constexpr size_t generations = 5U;
+
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  IslandModel model(island_count);
+  for (size_t i = 0; i < island_count; i++) {
+    ConfigureIsland(&model.GetIsland(i), &test_data);
+  }
+  model.SetMigrationInterval(0);
+  model.SetRandomSeed(seed);
+  model.Initialize();
+  model.Run(generations);
+  AssertTrue(model.GetAcceptedMigrantCount() == 0,
+             "Islands don't migrate with an interval of 0");
+
+  // Without migration, every island is the same as a standalone run seeded
+  // with the seed derived for it.
+  for (size_t i = 0; i < island_count; i++) {
+    GeneticAlgorithm ga;
+    ConfigureIsland(&ga, &test_data);
+    ga.SetRandomSeed(RandomWrapper::DeriveSeed(seed, i));
+    ga.Initialize();
+    for (size_t generation = 0; generation < generations; generation++) {
+      ga.Step();
+    }
+    const auto& expected = ga.GetPopulation();
+    const auto& actual = model.GetIsland(i).GetPopulation();
+    for (size_t j = 0; j < expected.Size(); j++) {
+      AssertTrue(expected.GetIndividual(j).Equals(actual.GetIndividual(j)),
+                 "Islands evolve independently between migrations");
+    }
+  }
+
+  return true;
+}
+
+bool TestThreadAffinity() {
+  constexpr uint64_t seed = 80U;
+  constexpr size_t bit_count = 90U;
+  constexpr size_t island_count = 2U;
+  constexpr size_t generations = 5U;
+  constexpr size_t worker_count = 3U;
+  constexpr size_t index_count = 10U;
+
+  AssertTrue((ThreadPool::ParseCpuList("0-3,8,10-11") ==
+              std::vector<size_t>{0, 1, 2, 3, 8, 10, 11}),
+             "Parse ranges and single CPUs");
+  AssertTrue(ThreadPool::ParseCpuList("3-1").empty(),
+             "Reject reversed ranges");
+  AssertTrue(ThreadPool::ParseCpuList("1,").empty(),
+             "Reject trailing separators");
+
+  // Pin the pool to wherever this thread is allowed to run so pinning
+  // succeeds on any machine.
+  const std::vector<size_t> cpus = ThreadPool::GetCurrentThreadAffinity();
+  ThreadPool pool(worker_count, cpus);
+  if (!cpus.empty()) {
+    AssertTrue(pool.GetWorkerCpu(1) == cpus[1 % cpus.size()],
+               "Pool threads are pinned in order");
+  }
+  AssertTrue(pool.GetWorkerCpu(0) == ThreadPool::NotPinned,
+             "The calling thread isn't pinned by the pool");
+
+  // Every worker gets its own slice and nobody steals.
+  std::vector<size_t> workers(index_count, worker_count);
+  std::atomic<size_t> call_count{0};
+  pool.ParallelForEachWorker(index_count, [&](size_t begin, size_t end) {
+    call_count++;
+    for (size_t i = begin; i < end; i++) {
+      workers[i] = ThreadPool::GetCurrentWorkerIndex();
+    }
+  });
+  AssertTrue(call_count == worker_count, "One call per worker");
+  const std::vector<size_t> expected_workers = {0, 0, 0, 0, 1, 1, 1, 2, 2, 2};
+  AssertTrue(workers == expected_workers, "Workers process their own slice");
+
+  // Pinned islands first touching their populations on their own threads
+  // evolve exactly like unpinned ones.
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  IslandModel model(island_count);
+  for (size_t i = 0; i < island_count; i++) {
+    ConfigureIsland(&model.GetIsland(i), &test_data);
+    model.SetIslandCpus(i, cpus);
+  }
+  model.GetIsland(1).SetThreadPool(&pool);
+  model.SetMigrationInterval(0);
+  model.SetRandomSeed(seed);
+  model.Initialize();
+  model.Run(generations);
+  AssertTrue(ThreadPool::GetCurrentThreadAffinity() == cpus,
+             "The calling thread gets its affinity back");
+
+  for (size_t i = 0; i < island_count; i++) {
+    GeneticAlgorithm ga;
+    ConfigureIsland(&ga, &test_data);
+    ga.SetRandomSeed(RandomWrapper::DeriveSeed(seed, i));
+    ga.Initialize();
+    for (size_t generation = 0; generation < generations; generation++) {
+      ga.Step();
+    }
+    const auto& expected = ga.GetPopulation();
+    const auto& actual = model.GetIsland(i).GetPopulation();
+    for (size_t j = 0; j < expected.Size(); j++) {
+      AssertTrue(expected.GetIndividual(j).Equals(actual.GetIndividual(j)),
+                 "Pinning doesn't change how islands evolve");
+    }
+  }
+
+  return true;
+}
+
+bool TestNestedParallelFor() {
+  constexpr uint64_t seed = 86U;
+  constexpr size_t bit_count = 90U;
+  constexpr size_t outer_worker_count = 4U;
+  constexpr size_t inner_thread_count = 2U;
+  constexpr size_t generations = 3U;
+  constexpr size_t screening_candidate_count = 3U;
+  constexpr size_t surrogate_archive_capacity = 32U;
+
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  const auto run = [&](GeneticAlgorithm* ga) {
+    ConfigureIsland(ga, &test_data);
+    ga->SetThreadCount(inner_thread_count);
+    ga->SetScreeningCandidateCount(screening_candidate_count);
+    ga->SetSurrogateArchiveCapacity(surrogate_archive_capacity);
+    ga->SetRandomSeed(seed);
+    ga->Initialize();
+    for (size_t generation = 0; generation < generations; generation++) {
+      ga->Step();
+    }
+  };
+  GeneticAlgorithm expected;
+  run(&expected);
+
+  // Each outer worker steps a GeneticAlgorithm with a smaller pool of its
+  // own. Those run serially so they must index their scratch from 0.
+  ThreadPool outer(outer_worker_count);
+  std::vector<GeneticAlgorithm> nested(outer_worker_count);
+  std::vector<size_t> workers(outer_worker_count);
+  std::vector<size_t> inner_workers(outer_worker_count);
+  outer.ParallelForEachWorker(
+      outer_worker_count, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+          outer.ParallelFor(1, 1, [&](size_t, size_t) {
+            inner_workers[i] = ThreadPool::GetCurrentWorkerIndex();
+          });
+          run(&nested[i]);
+          workers[i] = ThreadPool::GetCurrentWorkerIndex();
+        }
+      });
+
+  for (size_t i = 0; i < outer_worker_count; i++) {
+    AssertTrue(inner_workers[i] == 0, "Nested jobs run as worker 0");
+    AssertTrue(workers[i] == i, "The outer worker index is restored");
+    const auto& expected_population = expected.GetPopulation();
+    const auto& actual_population = nested[i].GetPopulation();
+    for (size_t j = 0; j < expected_population.Size(); j++) {
+      AssertTrue(expected_population.GetIndividual(j).Equals(
+                     actual_population.GetIndividual(j)),
+                 "Nested runs evolve like standalone runs");
+    }
+  }
+
+  return true;
+}
+
+bool TestStepStats() {
+  constexpr uint64_t seed = 79U;
+  constexpr size_t bit_count = 100U;
+  constexpr size_t generations = 4U;
+  constexpr size_t cache_capacity = 64U;
+
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  GeneticAlgorithm ga;
+  ConfigureIsland(&ga, &test_data);
+  ga.SetFitnessCacheCapacity(cache_capacity);
+  ga.SetRandomSeed(seed);
+  std::vector<StepStats> collected;
+  ga.SetStepStatsCallback(
+      [&collected](const StepStats& stats) { collected.push_back(stats); });
+  ga.Initialize();
+  for (size_t i = 0; i < generations; i++) {
+    ga.Step();
+  }
+
+  if constexpr (panga::IsInstrumentationEnabled) {
+    AssertTrue(collected.size() == generations,
+               "Every step reports its stats");
+    for (size_t i = 0; i < generations; i++) {
+      const auto& stats = collected[i];
+      AssertTrue(stats.generation == i, "Stats are reported in order");
+      AssertTrue(stats.evaluation_count + stats.fitness_cache_hit_count <=
+                     ga.GetPopulationSize(),
+                 "Only dirty individuals are looked up or scored");
+      const auto& evaluation = stats.GetPhase(StepPhase::Evaluation);
+      const auto& sort = stats.GetPhase(StepPhase::Sort);
+      AssertTrue(sort.start_nanoseconds >= evaluation.start_nanoseconds +
+                                               evaluation.duration_nanoseconds,
+                 "The sort follows the evaluation");
+      if (i != 0) {
+        AssertTrue(stats.random_draw_count != 0,
+                   "Creating offspring draws random values");
+      }
+    }
+    AssertTrue(collected[0].evaluation_count == ga.GetPopulationSize(),
+               "The whole initial population is scored");
+  } else {
+    AssertTrue(collected.empty(), "No stats without instrumentation");
+  }
+
+  // The trace writer works with any stats.
+  StepStats stats;
+  stats.generation = 3U;
+  stats.start_nanoseconds = 1500U;
+  stats.phases[static_cast<size_t>(StepPhase::Evaluation)] = {250U, 42U};
+  stats.evaluation_count = 7U;
+  std::stringstream trace;
+  {
+    panga::ChromeTraceWriter writer(&trace);
+    writer.Write(stats);
+  }
+  const std::string json = trace.str();
+  AssertTrue(json.rfind("{\"traceEvents\":[", 0) == 0,
+             "The trace is a trace event object");
+  const std::string trace_end = "]}";
+  AssertTrue(json.size() >= trace_end.size() &&
+                 json.compare(json.size() - trace_end.size(),
+                              trace_end.size(), trace_end) == 0,
+             "Destroying the writer closes the trace");
+  AssertTrue(json.find("{\"name\":\"Evaluation\",\"cat\":\"panga\","
+                       "\"ph\":\"X\",\"pid\":0,\"tid\":0,"
+                       "\"ts\":1.750,\"dur\":0.042,"
+                       "\"args\":{\"generation\":3}}") != std::string::npos,
+             "Phases are complete events in microseconds");
+  AssertTrue(json.find("\"evaluations\":7") != std::string::npos,
+             "Counters are counter events");
+
+  return true;
+}
+
+void ConfigureCheckpointedRun(GeneticAlgorithm* ga,
+                              ParallelTestUserData* test_data) {
+  constexpr uint64_t seed = 91U;
+  constexpr size_t population_size = 40U;
+  constexpr size_t screening_candidate_count = 3U;
+  // Smaller than the evaluation count so the archive replaces chromosomes.
+  constexpr size_t surrogate_archive_capacity = 64U;
+  Genome& genome = ga->GetGenome();
+  genome.AddGene(5);
+  genome.AddGene(11, true);
+  genome.AddBooleanGenes(70);
+  test_data->target_bits.SetBitCount(genome.BitsRequired());
+
+  ga->SetPopulationSize(population_size);
+  ga->SetEliteCount(2);
+  ga->SetMutatedEliteCount(1);
+  ga->SetMutationRate(0.01);
+  ga->SetCrossoverType(GeneticAlgorithm::CrossoverType::KPoint);
+  ga->SetSelectorType(GeneticAlgorithm::SelectorType::Tournament);
+  ga->SetScreeningCandidateCount(screening_candidate_count);
+  ga->SetSurrogateArchiveCapacity(surrogate_archive_capacity);
+  ga->SetFitnessFunction(ParallelTestObjective);
+  ga->SetUserData(test_data);
+  ga->SetRandomSeed(seed);
+}
+
+bool TestCheckpointRoundTrip() {
+  constexpr size_t generations = 4U;
+  const char* path = "panga_checkpoint_test.bin";
+
+  ParallelTestUserData test_data;
+  GeneticAlgorithm ga;
+  ConfigureCheckpointedRun(&ga, &test_data);
+  ga.Initialize();
+  for (size_t generation = 0; generation < generations; generation++) {
+    ga.Step();
+  }
+  std::stringstream checkpoint;
+  AssertTrue(ga.Save(&checkpoint), "Checkpoint is written to a stream");
+  AssertTrue(ga.Save(path), "Checkpoint is written to a file");
+  for (size_t generation = 0; generation < generations; generation++) {
+    ga.Step();
+  }
+
+  // Resume from the checkpoint with an empty genome and default settings.
+  GeneticAlgorithm resumed;
+  resumed.SetFitnessFunction(ParallelTestObjective);
+  resumed.SetUserData(&test_data);
+  AssertTrue(resumed.Load(path), "Checkpoint is read back from a file");
+  std::remove(path);
+  AssertTrue(resumed.GetGenome().BitsRequired() ==
+                 ga.GetGenome().BitsRequired(),
+             "The genome is rebuilt from the checkpoint");
+  AssertTrue(resumed.GetCurrentGeneration() + generations ==
+                 ga.GetCurrentGeneration(),
+             "The current generation is restored");
+  AssertTrue(resumed.GetEliteCount() == ga.GetEliteCount() &&
+                 resumed.GetMutationRate() == ga.GetMutationRate() &&
+                 resumed.GetSelectorType() == ga.GetSelectorType() &&
+                 resumed.GetScreeningCandidateCount() ==
+                     ga.GetScreeningCandidateCount(),
+             "Settings are restored");
+  AssertTrue(resumed.GetSurrogateArchive() != nullptr &&
+                 resumed.GetSurrogateArchive()->Size() ==
+                     resumed.GetSurrogateArchiveCapacity(),
+             "The surrogate archive is restored");
+  for (size_t generation = 0; generation < generations; generation++) {
+    resumed.Step();
+  }
+  AssertTrue(resumed.GetEvaluationCount() == ga.GetEvaluationCount(),
+             "The evaluation count is restored");
+  AssertTrue(
+      resumed.GetScreenedOffspringCount() == ga.GetScreenedOffspringCount(),
+      "The screened offspring count is restored");
+  const auto& expected = ga.GetPopulation();
+  const auto& actual = resumed.GetPopulation();
+  AssertTrue(expected.Size() == actual.Size(), "Population size is restored");
+  for (size_t i = 0; i < expected.Size(); i++) {
+    AssertTrue(expected.GetIndividual(i).Equals(actual.GetIndividual(i)) &&
+                   expected.GetIndividual(i).GetScore() ==
+                       actual.GetIndividual(i).GetScore(),
+               "A resumed run continues exactly like the original run");
+  }
+
+  // A genome which doesn't match the checkpoint is rejected.
+  GeneticAlgorithm mismatched;
+  mismatched.GetGenome().AddBooleanGenes(3);
+  AssertTrue(!mismatched.Load(&checkpoint),
+             "Checkpoints for a different genome are rejected");
+  std::stringstream garbage("not a checkpoint");
+  GeneticAlgorithm empty;
+  AssertTrue(!empty.Load(&garbage),
+             "Streams without a checkpoint are rejected");
+
+  // A truncated checkpoint leaves a running GeneticAlgorithm as it was.
+  const std::string bytes = checkpoint.str();
+  const size_t generation = ga.GetCurrentGeneration();
+  const size_t evaluation_count = ga.GetEvaluationCount();
+  std::vector<double> scores;
+  for (size_t i = 0; i < expected.Size(); i++) {
+    scores.push_back(expected.GetIndividual(i).GetScore());
+  }
+  for (const size_t length : {bytes.size() / 3, bytes.size() - 1}) {
+    std::stringstream truncated(bytes.substr(0, length));
+    AssertTrue(!ga.Load(&truncated), "Truncated checkpoints are rejected");
+    std::stringstream truncated_copy(bytes.substr(0, length));
+    AssertTrue(!empty.Load(&truncated_copy) &&
+                   empty.GetGenome().GetGeneCount() == 0,
+               "A failed load leaves an empty genome empty");
+  }
+  AssertTrue(ga.GetCurrentGeneration() == generation &&
+                 ga.GetEvaluationCount() == evaluation_count &&
+                 ga.GetPopulation().Size() == scores.size(),
+             "A failed load leaves the settings untouched");
+  for (size_t i = 0; i < scores.size(); i++) {
+    AssertTrue(ga.GetPopulation().GetIndividual(i).GetScore() == scores[i],
+               "A failed load leaves the population untouched");
+  }
+  ga.Step();
+  AssertTrue(ga.GetCurrentGeneration() == generation + 1 &&
+                 ga.GetPopulation().Size() == scores.size(),
+             "A failed load leaves a GeneticAlgorithm which can still Step");
+
+  return true;
+}
+
+bool TestCheckpointValidation() {
+  using SelectorType = GeneticAlgorithm::SelectorType;
+  for (const uint8_t stored : {uint8_t{0}, uint8_t{7}}) {
+    std::stringstream stream;
+    WriteBinary(&stream, stored);
+    SelectorType selector_type = SelectorType::Rank;
+    AssertTrue(!ReadEnum(&stream, SelectorType::Rank,
+                         SelectorType::StochasticUniversalSampling,
+                         &selector_type),
+               "Enumerations outside their range are rejected");
+  }
+  std::stringstream in_range;
+  WriteEnum(&in_range, SelectorType::Tournament);
+  SelectorType selector_type = SelectorType::Rank;
+  AssertTrue(ReadEnum(&in_range, SelectorType::Rank,
+                      SelectorType::StochasticUniversalSampling,
+                      &selector_type) &&
+                 selector_type == SelectorType::Tournament,
+             "Enumerations inside their range are read");
+
+  // Sizes are checked before any storage is allocated for them.
+  constexpr size_t count = 8U;
+  Genome genome;
+  genome.AddBooleanGenes(21U);
+  Population population(genome);
+  population.Resize(count, nullptr);
+  std::stringstream saved;
+  population.Save(&saved);
+  const std::string bytes = saved.str();
+
+  Population loaded(genome);
+  std::stringstream too_many(bytes);
+  AssertTrue(!loaded.Load(&too_many, count - 1U),
+             "Populations larger than the maximum size are rejected");
+  std::string huge_bytes = bytes;
+  const uint64_t huge_size = std::numeric_limits<uint64_t>::max() / 2U;
+  std::memcpy(huge_bytes.data(), &huge_size, sizeof(huge_size));
+  std::stringstream huge(huge_bytes);
+  AssertTrue(!loaded.Load(&huge, std::numeric_limits<size_t>::max()),
+             "Populations larger than the stream are rejected");
+  std::stringstream truncated(bytes.substr(0, bytes.size() / 2U));
+  AssertTrue(!loaded.Load(&truncated, count),
+             "Populations cut short by the stream are rejected");
+  std::stringstream whole(bytes);
+  AssertTrue(loaded.Load(&whole, count) && loaded.Size() == count,
+             "Populations within the maximum size are read");
+
+  // Gene geometry is checked before the genes are accepted.
+  Genome gene_genome;
+  gene_genome.AddGene(8U);
+  gene_genome.AddGene(8U);
+  std::stringstream saved_genes;
+  gene_genome.Save(&saved_genes);
+  const std::string gene_bytes = saved_genes.str();
+  const auto load_patched = [&gene_bytes](size_t field, uint64_t value) {
+    std::string patched = gene_bytes;
+    std::memcpy(patched.data() + field * sizeof(value), &value, sizeof(value));
+    std::stringstream stream(patched);
+    Genome patched_genome;
+    return patched_genome.Load(&stream);
+  };
+  // Fields are the gene count, each gene's start bit index and bit width,
+  // the first boolean gene bit index and the boolean gene count.
+  AssertTrue(!load_patched(1U, uint64_t{1} << 20U),
+             "Genes starting past the next gene are rejected");
+  AssertTrue(!load_patched(3U, 4U), "Overlapping genes are rejected");
+  AssertTrue(!load_patched(3U, uint64_t{1} << 20U),
+             "Genes past the first boolean gene are rejected");
+  AssertTrue(!load_patched(2U, 0U), "Empty genes are rejected");
+  AssertTrue(!load_patched(4U, 65U), "Genes wider than a word are rejected");
+  AssertTrue(!load_patched(5U, 64U),
+             "Boolean genes not following the last gene are rejected");
+  AssertTrue(!load_patched(6U, std::numeric_limits<uint64_t>::max()),
+             "Boolean gene counts overflowing the bit count are rejected");
+  // The byte-wide value gene type follows, then the first value gene index
+  // and the value gene count.
+  std::string value_bytes = gene_bytes;
+  const size_t value_type_offset = 7U * sizeof(uint64_t);
+  value_bytes[value_type_offset] =
+      static_cast<char>(panga::ValueGeneType::Int64);
+  const uint64_t value_range[] = {1U, std::numeric_limits<uint64_t>::max()};
+  std::memcpy(value_bytes.data() + value_type_offset + 1U, value_range,
+              sizeof(value_range));
+  std::stringstream wrapped_values(value_bytes);
+  Genome wrapped_genome;
+  AssertTrue(!wrapped_genome.Load(&wrapped_values),
+             "Value gene ranges wrapping past the genes are rejected");
+  std::stringstream whole_genes(gene_bytes);
+  Genome whole_genome;
+  AssertTrue(whole_genome.Load(&whole_genes) &&
+                 whole_genome.BitsRequired() == 16U,
+             "Genomes with sound gene geometry are read");
+
+  return true;
+}
+
+bool TestInitialPopulationFromRows() {
+  constexpr size_t bit_count = 21U;
+  constexpr size_t row_stride = 5U;
+  constexpr size_t count = 4U;
+
+  std::vector<std::byte> rows(row_stride * count);
+  for (size_t i = 0; i < rows.size(); i++) {
+    rows[i] = static_cast<std::byte>(i * 37U + 11U);
+  }
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  population.Initialize(rows.data(), row_stride, count);
+  AssertTrue(population.Size() == count, "Every row becomes an individual");
+  for (size_t i = 0; i < count; i++) {
+    for (size_t bit = 0; bit < bit_count; bit++) {
+      const bool expected =
+          ((std::to_integer<unsigned>(rows[i * row_stride + bit / CHAR_BIT]) >>
+            (bit % CHAR_BIT)) &
+           1U) != 0;
+      AssertTrue(population.GetIndividualWritable(i).Get(bit) == expected,
+                 "Rows are copied into the population storage");
+    }
+  }
+
+  return true;
+}
+
+bool TestGeneratedInitialPopulation() {
+  constexpr size_t bit_count = 37U;
+  constexpr size_t count = 6U;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  population.Initialize(count, [](size_t index, Chromosome* chromosome) {
+    chromosome->Set(index * 5U % bit_count);
+  });
+  AssertTrue(population.Size() == count,
+             "Every generated chromosome becomes an individual");
+  for (size_t i = 0; i < count; i++) {
+    const auto& individual = population.GetIndividualWritable(i);
+    const size_t bit = individual.FindNextSetBit(0);
+    AssertTrue(bit == i * 5U % bit_count &&
+                   individual.FindNextSetBit(bit + 1U) == bit_count,
+               "Generated chromosomes are written into the population");
+  }
+
+  Population scratch(genome);
+  scratch.Resize(count, nullptr);
+  AssertTrue(scratch.Size() == count, "Resizing without randomizing adds");
+  for (size_t i = 0; i < count; i++) {
+    AssertTrue(scratch.GetIndividualWritable(i).FindNextSetBit(0) == bit_count,
+               "Individuals which aren't randomized start empty");
+  }
+
+  return true;
+}
+
+bool TestRandomWrapper() {
+  constexpr uint64_t seed = 42U;
+  RandomWrapper random(seed);
+  RandomWrapper same_seed(seed);
+  AssertTrue(random.RandomWord() == same_seed.RandomWord(),
+             "RandomWrappers with the same seed produce the same values");
+
+  constexpr size_t draw_count = 1000U;
+  constexpr int min = -3;
+  constexpr int max = 3;
+  bool seen[max - min + 1] = {};
+  for (size_t i = 0; i < draw_count; i++) {
+    const int value = random.RandomInteger<int>(min, max);
+    AssertTrue(value >= min && value <= max,
+               "RandomInteger stays within [min, max]");
+    seen[value - min] = true;
+  }
+  for (const bool value_seen : seen) {
+    AssertTrue(value_seen, "RandomInteger produces every value in range");
+  }
+
+  for (size_t i = 0; i < draw_count; i++) {
+    const double value = random.RandomFloat(1.0, 2.0);
+    AssertTrue(value >= 1.0 && value < 2.0,
+               "RandomFloat stays within [min, max)");
+    AssertTrue(!random.CoinFlip(0.0), "CoinFlip(0) is never true");
+    AssertTrue(random.CoinFlip(1.0), "CoinFlip(1) is always true");
+  }
+
+  constexpr size_t buffer_size = 13U;
+  std::byte first[buffer_size] = {};
+  std::byte second[buffer_size] = {};
+  random.SetSeed(seed);
+  random.FillBytes(first, buffer_size);
+  random.SetSeed(seed);
+  random.FillBytes(second, buffer_size);
+  AssertTrue(std::memcmp(first, second, buffer_size) == 0,
+             "SetSeed restarts the sequence of random values");
+
+  return true;
+}
+
+bool TestPopulationDiversity() {
+  constexpr uint64_t seed = 99U;
+  constexpr size_t bit_count = 150U;
+  constexpr size_t population_size = 40U;
+  constexpr size_t sample_size = 30U;
+  constexpr double epsilon = 1e-12;
+  constexpr double sample_tolerance = 0.05;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(population_size, &random);
+
+  // Compare against the average Hamming distance over every pair.
+  size_t distance = 0;
+  for (size_t i = 0; i < population_size; i++) {
+    for (size_t j = i + 1U; j < population_size; j++) {
+      distance += population.GetIndividualWritable(i).HammingDistance(
+          population.GetIndividualWritable(j));
+    }
+  }
+  const double pair_count = population_size * (population_size - 1U) / 2.0;
+  const double expected = static_cast<double>(distance) / pair_count / bit_count;
+
+  const double diversity = population.GetPopulationDiversity();
+  AssertTrue(std::abs(diversity - expected) < epsilon,
+             "Population diversity equals the average pairwise distance");
+  AssertTrue(std::abs(population.EstimatePopulationDiversity(
+                          population_size, &random) -
+                      expected) < epsilon,
+             "Sampling the whole population gives the exact diversity");
+  AssertTrue(std::abs(population.EstimatePopulationDiversity(sample_size,
+                                                             &random) -
+                      expected) < sample_tolerance,
+             "Sampled diversity is close to the exact diversity");
+
+  return true;
+}
+
+double CountSetBitsObjective(Individual* individual, void* /*user_data*/) {
+  size_t count = 0;
+  for (size_t i = 0; i < individual->GetBitCount(); i++) {
+    count += individual->Get(i) ? 1U : 0U;
+  }
+  return static_cast<double>(count);
+}
+
+bool TestSelectorsHonorExclusion() {
+  constexpr uint64_t seed = 5U;
+  constexpr size_t bit_count = 32U;
+  constexpr size_t population_size = 6U;
+  constexpr size_t tournament_size = 3U;
+  constexpr size_t draw_count = 2000U;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(population_size, &random);
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  population.InitializePartialSums();
+  population.InitializeAliasTable();
+
+  // Exclude every rank in turn, including the best individual whose roulette
+  // slice is the widest.
+  for (size_t rank = 0; rank < population_size; rank++) {
+    const Individual* excluded = &population.GetIndividual(rank);
+    for (size_t i = 0; i < draw_count; i++) {
+      AssertTrue(&population.UniformSelect(&random, excluded) != excluded,
+                 "UniformSelect never picks the excluded individual");
+      AssertTrue(
+          &population.RouletteWheelSelect(&random, excluded) != excluded,
+          "RouletteWheelSelect never picks the excluded individual");
+      AssertTrue(&population.AliasSelect(&random, excluded) != excluded,
+                 "AliasSelect never picks the excluded individual");
+      AssertTrue(&population.TournamentSelect(tournament_size, &random,
+                                              excluded) != excluded,
+                 "TournamentSelect never picks the excluded individual");
+    }
+    AssertTrue(&population.RankSelect(excluded) != excluded,
+               "RankSelect never picks the excluded individual");
+  }
+
+  return true;
+}
+
+bool TestFitnessProportionalSelectors() {
+  constexpr uint64_t seed = 8U;
+  constexpr size_t bit_count = 32U;
+  constexpr size_t population_size = 10U;
+  constexpr size_t draw_count = 100000U;
+  constexpr double tolerance = 0.01;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(population_size, &random);
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  population.InitializePartialSums();
+  population.InitializeAliasTable();
+
+  std::vector<size_t> alias_counts(population_size);
+  for (size_t i = 0; i < draw_count; i++) {
+    const auto& selected = population.AliasSelect(&random);
+    alias_counts[population.GetStorageIndex(selected)]++;
+  }
+
+  std::vector<const Individual*> sampled;
+  population.StochasticUniversalSelect(draw_count, &random, &sampled);
+  AssertTrue(sampled.size() == draw_count, "Every requested parent is sampled");
+  std::vector<size_t> sampled_counts(population_size);
+  for (const auto* individual : sampled) {
+    sampled_counts[population.GetStorageIndex(*individual)]++;
+  }
+
+  for (size_t i = 0; i < population_size; i++) {
+    const auto& individual = population.GetIndividual(i);
+    const size_t index = population.GetStorageIndex(individual);
+    const double expected = individual.GetFitness() * draw_count;
+    AssertTrue(std::fabs(static_cast<double>(alias_counts[index]) -
+                         expected) < draw_count * tolerance,
+               "AliasSelect picks in proportion to fitness");
+    AssertTrue(std::fabs(static_cast<double>(sampled_counts[index]) -
+                         expected) <= 1.0 + tolerance,
+               "StochasticUniversalSelect stays within one of the expected "
+               "count");
+  }
+
+  return true;
+}
+
+bool TestSteadyStatePopulation() {
+  constexpr uint64_t seed = 29U;
+  constexpr size_t bit_count = 32U;
+  constexpr size_t population_size = 13U;
+  constexpr size_t draw_count = 100000U;
+  constexpr size_t replacement_count = 300U;
+  constexpr double tolerance = 0.01;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(population_size, &random);
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  std::vector<double> fitnesses(population_size);
+  for (size_t i = 0; i < population_size; i++) {
+    const auto& individual = population.GetIndividual(i);
+    fitnesses[population.GetStorageIndex(individual)] =
+        individual.GetFitness();
+  }
+
+  // The score tree selects in proportion to the same fitness values.
+  population.BeginSteadyState();
+  std::vector<size_t> roulette_counts(population_size);
+  std::vector<size_t> alias_counts(population_size);
+  for (size_t i = 0; i < draw_count; i++) {
+    roulette_counts[population.GetStorageIndex(
+        population.RouletteWheelSelect(&random))]++;
+    alias_counts[population.GetStorageIndex(
+        population.AliasSelect(&random))]++;
+  }
+  for (size_t i = 0; i < population_size; i++) {
+    const double expected = fitnesses[i] * draw_count;
+    AssertTrue(std::fabs(static_cast<double>(roulette_counts[i]) - expected) <
+                       draw_count * tolerance &&
+                   std::fabs(static_cast<double>(alias_counts[i]) -
+                             expected) < draw_count * tolerance,
+               "Steady-state selectors pick in proportion to fitness");
+  }
+
+  // Every replacement takes the place of the worst individual and the
+  // selectors follow along.
+  Individual candidate(genome);
+  std::vector<double> scores(population_size);
+  for (size_t i = 0; i < replacement_count; i++) {
+    candidate.Randomize(&random);
+    candidate.SetScore(CountSetBitsObjective(&candidate, nullptr));
+    for (size_t j = 0; j < population_size; j++) {
+      scores[j] = population.GetIndividualWritable(j).GetScore();
+    }
+    const double worst = *std::max_element(scores.begin(), scores.end());
+    AssertTrue(population.ReplaceWorst(candidate) ==
+                   (candidate.GetScore() < worst),
+               "Only offspring better than the worst individual are inserted");
+    for (size_t j = 0; j < population_size; j++) {
+      scores[j] = population.GetIndividualWritable(j).GetScore();
+    }
+    std::sort(scores.begin(), scores.end());
+    const auto& best = population.RankSelect();
+    AssertTrue(best.GetScore() == scores[0] &&
+                   population.RankSelect(&best).GetScore() == scores[1],
+               "RankSelect follows the two best individuals");
+    AssertTrue(&population.RouletteWheelSelect(&random, &best) != &best &&
+                   &population.AliasSelect(&random, &best) != &best,
+               "Excluded individuals are never selected");
+    AssertTrue(population.GetMinimumScore() == scores[0] &&
+                   population.GetMaximumScore() == scores.back(),
+               "Statistics include every replacement");
+  }
+
+  population.EndSteadyState();
+  double fitness_sum = 0.0;
+  for (size_t i = 0; i < population_size; i++) {
+    AssertTrue(population.GetIndividual(i).GetScore() == scores[i],
+               "The population is sorted once steady-state mode ends");
+    fitness_sum += population.GetIndividual(i).GetFitness();
+  }
+  AssertTrue(std::fabs(fitness_sum - 1.0) < 1e-9,
+             "Fitness values are updated once steady-state mode ends");
+
+  return true;
+}
+
+bool TestPartialSort() {
+  constexpr uint64_t seed = 23U;
+  constexpr size_t bit_count = 64U;
+  constexpr size_t population_size = 50U;
+  constexpr size_t ranked_count = 5U;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(population_size, &random);
+  population.Evaluate(CountSetBitsObjective, nullptr);
+
+  std::vector<double> sorted_scores;
+  for (size_t i = 0; i < population_size; i++) {
+    sorted_scores.push_back(population.GetIndividual(i).GetScore());
+  }
+  AssertTrue(std::is_sorted(sorted_scores.begin(), sorted_scores.end()),
+             "A full sort orders every individual");
+  const double fitness = population.GetIndividual(ranked_count).GetFitness();
+
+  population.SetRankedCount(ranked_count);
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  for (size_t i = 0; i < ranked_count; i++) {
+    AssertTrue(population.GetIndividual(i).GetScore() == sorted_scores[i],
+               "The ranked individuals are in order");
+  }
+  AssertTrue(population.GetIndividual(population_size - 1U).GetScore() ==
+                 sorted_scores.back(),
+             "The worst individual is last");
+  AssertTrue(population.GetMinimumScore() == sorted_scores.front(),
+             "The best individual is first");
+  for (size_t i = ranked_count; i < population_size; i++) {
+    AssertTrue(population.GetIndividual(i).GetScore() >=
+                   sorted_scores[ranked_count - 1U],
+               "Unranked individuals are no better than the ranked ones");
+  }
+
+  // Fitness only depends on the best and worst scores so it doesn't change.
+  double fitness_sum = 0.0;
+  for (size_t i = 0; i < population_size; i++) {
+    const auto& individual = population.GetIndividual(i);
+    fitness_sum += individual.GetFitness();
+    if (individual.GetScore() == sorted_scores[ranked_count]) {
+      AssertTrue(individual.GetFitness() == fitness,
+                 "Partial sorting doesn't change fitness values");
+    }
+  }
+  AssertTrue(std::fabs(fitness_sum - 1.0) < 1e-9, "Fitness values sum to 1");
+
+  // Asking for more of the best individuals than are ranked still returns
+  // them in order.
+  std::vector<const Individual*> best;
+  population.GetBestIndividuals(ranked_count * 2U, &best);
+  AssertTrue(best.size() == ranked_count * 2U,
+             "The requested number of best individuals is returned");
+  for (size_t i = 0; i < best.size(); i++) {
+    AssertTrue(best[i]->GetScore() == sorted_scores[i],
+               "Best individuals are returned in rank order");
+  }
+
+  // Replacing the worst individual sorts the rest of the population first.
+  Individual replacement(genome);
+  replacement.SetScore(sorted_scores[ranked_count]);
+  replacement.SetDirty(false);
+  AssertTrue(population.ReplaceWorst(replacement),
+             "A better individual replaces the worst one");
+  AssertTrue(!population.ReplaceWorst(population.GetIndividual(
+                 population_size - 1U)),
+             "An individual no better than the worst one is rejected");
+  for (size_t i = 1; i < population_size; i++) {
+    AssertTrue(population.GetIndividual(i - 1U).GetScore() <=
+                   population.GetIndividual(i).GetScore(),
+               "The population stays sorted after replacing the worst");
+  }
+  AssertTrue(population.GetMaximumScore() ==
+                 population.GetIndividual(population_size - 1U).GetScore(),
+             "Statistics include the replacement");
+
+  return true;
+}
+
+bool TestPopulationStats() {
+  constexpr uint64_t seed = 31U;
+  constexpr size_t bit_count = 100U;
+  constexpr size_t population_size = 30U;
+  constexpr size_t shrunk_size = 10U;
+  constexpr double epsilon = 1e-9;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(population_size, &random);
+  const double diversity = population.GetPopulationDiversity();
+  population.Evaluate(CountSetBitsObjective, nullptr);
+
+  const auto check_stats = [&](size_t size) {
+    // Read every statistic before touching the individuals since getting
+    // them to write drops the cached statistics.
+    const auto stats = population.GetStats();
+    const double average_score = population.GetAverageScore();
+    const double standard_deviation = population.GetScoreStandardDeviation();
+    const double minimum_score = population.GetMinimumScore();
+    const double maximum_score = population.GetMaximumScore();
+    const double population_diversity = population.GetPopulationDiversity();
+
+    double sum = 0.0;
+    double minimum = population.GetIndividualWritable(0).GetScore();
+    double maximum = minimum;
+    for (size_t i = 0; i < size; i++) {
+      const double score = population.GetIndividualWritable(i).GetScore();
+      sum += score;
+      minimum = std::min(minimum, score);
+      maximum = std::max(maximum, score);
+    }
+    const double mean = sum / size;
+    double squared_deviations = 0.0;
+    for (size_t i = 0; i < size; i++) {
+      const double deviation =
+          population.GetIndividualWritable(i).GetScore() - mean;
+      squared_deviations += deviation * deviation;
+    }
+    const double deviation = std::sqrt(squared_deviations / (size - 1U));
+
+    AssertTrue(std::fabs(stats.average_score - mean) < epsilon &&
+                   std::fabs(average_score - mean) < epsilon,
+               "Average score");
+    AssertTrue(std::fabs(stats.score_standard_deviation - deviation) <
+                       epsilon &&
+                   std::fabs(standard_deviation - deviation) < epsilon,
+               "Score standard deviation");
+    AssertTrue(stats.minimum_score == minimum && minimum_score == minimum,
+               "Minimum score");
+    AssertTrue(stats.maximum_score == maximum && maximum_score == maximum,
+               "Maximum score");
+    AssertTrue(stats.diversity == population_diversity &&
+                   std::fabs(population_diversity -
+                             population.GetPopulationDiversity()) < epsilon,
+               "Diversity");
+    return true;
+  };
+
+  AssertTrue(check_stats(population_size), "Statistics after Evaluate");
+  AssertTrue(std::fabs(population.GetPopulationDiversity() - diversity) <
+                 epsilon,
+             "Cached diversity matches the diversity before Evaluate");
+
+  // Shrinking the population must not leave stale statistics behind.
+  population.Resize(shrunk_size, &random);
+  AssertTrue(check_stats(shrunk_size), "Statistics after Resize");
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  AssertTrue(check_stats(shrunk_size), "Statistics after another Evaluate");
+
+  // Every way of changing the population drops the cached statistics.
+  Individual replacement(genome);
+  replacement.SetScore(-100.0);
+  population.Replace(0, replacement);
+  AssertTrue(check_stats(shrunk_size), "Statistics after Replace");
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  population.GetStats();
+  population.GetIndividualWritable(1).SetScore(1000.0);
+  AssertTrue(check_stats(shrunk_size),
+             "Statistics after writing an individual");
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  population.GetStats();
+  std::fill_n(population.GetChromosomeStorage(2),
+              BitVector::BytesRequired(bit_count), std::byte{0xff});
+  AssertTrue(check_stats(shrunk_size),
+             "Statistics after writing chromosome storage");
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  population.Sort();
+  replacement.SetScore(-200.0);
+  AssertTrue(population.ReplaceWorst(replacement),
+             "A better individual replaces the worst one");
+  AssertTrue(check_stats(shrunk_size), "Statistics after ReplaceWorst");
+
+  return true;
+}
+
+bool TestPopulationStorage() {
+  constexpr uint64_t seed = 17U;
+  constexpr size_t bit_count = 100U;
+  constexpr size_t initial_size = 3U;
+  constexpr size_t grown_size = 50U;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Population population(genome);
+  RandomWrapper random(seed);
+  population.Resize(initial_size, &random);
+  population.Evaluate(CountSetBitsObjective, nullptr);
+
+  // Remember the individuals and their scores before the storage grows.
+  std::vector<BitVector> before;
+  std::vector<double> scores;
+  for (size_t i = 0; i < initial_size; i++) {
+    const auto& individual = population.GetIndividualWritable(i);
+    AssertTrue(individual.HasExternalStorage(),
+               "Population members are views into the population storage");
+    before.push_back(individual);
+    scores.push_back(individual.GetScore());
+  }
+
+  population.Resize(grown_size, &random);
+  AssertTrue(population.GetCapacity() >= grown_size,
+             "Population storage grew to hold every individual");
+  for (size_t i = 0; i < initial_size; i++) {
+    const auto& individual = population.GetIndividualWritable(i);
+    AssertTrue(individual.Equals(before[i]),
+               "Growing the population keeps existing chromosomes");
+    AssertTrue(individual.GetScore() == scores[i],
+               "Growing the population keeps existing scores");
+  }
+
+  // Copying between views copies the bits and scores but keeps the storage.
+  population.Evaluate(CountSetBitsObjective, nullptr);
+  const auto& best = population.GetBestIndividual();
+  auto& target = population.GetIndividualWritable(grown_size - 1U);
+  if (&target != &best) {
+    target = best;
+    AssertTrue(target.Equals(best), "Replacing a view copies the chromosome");
+    AssertTrue(target.GetScore() == best.GetScore(),
+               "Replacing a view copies the score");
+    AssertTrue(target.HasExternalStorage(),
+               "Replacing a view keeps the population storage");
+  }
+
+  // A standalone copy owns its bits again.
+  const Individual copy(genome, best);
+  AssertTrue(!copy.HasExternalStorage() && copy.Equals(best),
+             "Individuals copied out of a population own their bits");
+
+  // GeneticAlgorithm constructs its populations before any genes are added.
+  Genome late_genome;
+  Population late_population(late_genome);
+  late_genome.AddBooleanGenes(bit_count);
+  late_population.Resize(initial_size, &random);
+  for (size_t i = 0; i < initial_size; i++) {
+    const auto& individual = late_population.GetIndividualWritable(i);
+    AssertTrue(individual.HasExternalStorage() &&
+                   individual.GetBytes() ==
+                       late_population.GetChromosomeStorage(i),
+               "Genes added after construction still use the storage");
+  }
+
+  return true;
+}
+
+bool TestPopulationSwap() {
+  constexpr uint64_t seed = 23U;
+  constexpr size_t bit_count = 70U;
+  constexpr size_t population_size = 4U;
+  constexpr size_t grown_size = 40U;
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  RandomWrapper random(seed);
+  Population left(genome);
+  Population right(genome);
+  left.Resize(population_size, &random);
+  right.Resize(population_size, &random);
+
+  const BitVector left_first(left.GetIndividualWritable(0));
+  const BitVector right_last(right.GetIndividualWritable(population_size - 1U));
+  left.Swap(0, &right, population_size - 1U);
+  AssertTrue(left.GetIndividualWritable(0).Equals(right_last) &&
+                 right.GetIndividualWritable(population_size - 1U)
+                     .Equals(left_first),
+             "Swap exchanges individuals between populations");
+
+  // Growing gives the traded storage back without changing any individual.
+  left.Resize(grown_size, &random);
+  AssertTrue(left.GetIndividualWritable(0).Equals(right_last) &&
+                 right.GetIndividualWritable(population_size - 1U)
+                     .Equals(left_first),
+             "Restoring storage keeps the individuals");
+
+  // Shrinking drops the individuals past the new size.
+  left.Resize(population_size, &random);
+  AssertTrue(left.Size() == population_size, "Populations can shrink");
+
+  return true;
+}
+
+bool TestClonesShareStorage() {
+  constexpr uint64_t seed = 31U;
+  constexpr size_t bit_count = 120U;
+  constexpr size_t population_size = 30U;
+  constexpr size_t generations = 8U;
+
+  GeneticAlgorithm ga;
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  ga.GetGenome().AddBooleanGenes(bit_count);
+  ga.SetPopulationSize(population_size);
+  ga.SetFitnessFunction(ParallelTestObjective);
+  ga.SetUserData(&test_data);
+  ga.SetEliteCount(3);
+  ga.SetCrossoverRate(0.0);
+  ga.SetMutationRate(0.0);
+  ga.SetRandomSeed(seed);
+  ga.Initialize();
+  ga.Step();
+
+  // Without crossover or mutation, every generation is made of clones of
+  // the initial population.
+  std::vector<BitVector> initial;
+  const auto& initial_population = ga.GetPopulation();
+  for (size_t i = 0; i < initial_population.Size(); i++) {
+    initial.emplace_back(initial_population.GetIndividual(i));
+  }
+  const double best_score = initial_population.GetMinimumScore();
+  AssertTrue(initial_population.GetBestIndividual().HasExternalStorage(),
+             "Individuals live in the population storage");
+
+  for (size_t generation = 0; generation < generations; generation++) {
+    ga.Step();
+    const auto& population = ga.GetPopulation();
+    AssertTrue(population.GetMinimumScore() == best_score,
+               "Elites survive every generation unchanged");
+    for (size_t i = 0; i < population.Size(); i++) {
+      const auto& individual = population.GetIndividual(i);
+      AssertTrue(std::any_of(initial.cbegin(), initial.cend(),
+                             [&](const BitVector& original) {
+                               return original.Equals(individual);
+                             }),
+                 "Clones are copies of an initial individual");
+    }
+  }
+
+  return true;
+}
+
+bool TestFitnessCache() {
+  constexpr size_t capacity = 2U;
+  constexpr size_t bit_count = 20U;
+  constexpr double first_score = 1.5;
+  constexpr double second_score = 2.5;
+  constexpr double third_score = 3.5;
+
+  panga::FitnessCache cache(capacity);
+  BitVector first(bit_count);
+  BitVector second(bit_count);
+  BitVector third(bit_count);
+  second.Set(1);
+  third.Set(2);
+  AssertTrue(first.Hash() != second.Hash(), "Different bits hash differently");
+
+  double score = 0.0;
+  AssertTrue(!cache.Find(first, first.Hash(), &score), "Empty cache misses");
+  cache.Insert(first, first.Hash(), first_score);
+  cache.Insert(second, second.Hash(), second_score);
+  AssertTrue(cache.Find(first, first.Hash(), &score) && score == first_score,
+             "Cached chromosomes are found");
+
+  // A matching hash alone isn't enough.
+  AssertTrue(!cache.Find(third, first.Hash(), &score),
+             "Hash collisions are detected");
+
+  // |first| was just used so the clock hand evicts |second|.
+  cache.Insert(third, third.Hash(), third_score);
+  AssertTrue(cache.Size() == capacity, "The cache stays bounded");
+  AssertTrue(!cache.Find(second, second.Hash(), &score),
+             "The least recently used entry is evicted");
+  AssertTrue(cache.Find(first, first.Hash(), &score) && score == first_score,
+             "Recently used entries survive eviction");
+  AssertTrue(cache.Find(third, third.Hash(), &score) && score == third_score,
+             "New entries are found");
+  AssertTrue(cache.GetHitCount() == 3U && cache.GetMissCount() == 3U,
+             "Hits and misses are counted");
+
+  return true;
+}
+
+bool TestCachedEvaluation() {
+  constexpr size_t cache_capacity = 1000U;
+
+  const auto run = [](size_t capacity, size_t* evaluation_count) {
+    ParallelTestUserData test_data;
+    const auto chromosomes =
+        TestRun(&test_data)
+            .Seed(77U)
+            .BitCount(40U)
+            .PopulationSize(40U)
+            .Generations(12U)
+            .Elites(2, 2)
+            .Configure([capacity](GeneticAlgorithm* ga) {
+              ga->SetCrossoverRate(0.5);
+              ga->SetFitnessCacheCapacity(capacity);
+            })
+            .Run()
+            .chromosomes;
+    *evaluation_count = test_data.evaluation_count;
+    return chromosomes;
+  };
+
+  size_t uncached_evaluations = 0;
+  size_t cached_evaluations = 0;
+  const auto uncached = run(0, &uncached_evaluations);
+  const auto cached = run(cache_capacity, &cached_evaluations);
+
+  for (size_t i = 0; i < uncached.size(); i++) {
+    AssertTrue(uncached[i].Equals(cached[i]),
+               "The fitness cache doesn't change the result");
+  }
+  AssertTrue(cached_evaluations < uncached_evaluations,
+             "The fitness cache skips evaluations");
+
+  return true;
+}
+
+// Each gene with a bit width adds its value times its position in the genome
+// to the score and each set boolean gene adds one.
+constexpr size_t DeltaTestGeneCount = 12U;
+constexpr size_t DeltaTestGeneWidth = 6U;
+constexpr size_t DeltaTestBooleanGeneCount = 40U;
+
+struct DeltaTestUserData {
+  std::atomic<size_t> full_evaluations{0};
+  std::atomic<size_t> delta_evaluations{0};
+};
+
+double GeneContribution(const Genome& genome, size_t gene_index,
+                        uint64_t value) {
+  const double weight = gene_index < genome.GetFirstBooleanGeneIndex()
+                            ? static_cast<double>(gene_index + 1U)
+                            : 1.0;
+  return weight * static_cast<double>(value);
+}
+
+uint64_t ReadRawGene(const Individual& individual, size_t gene_index) {
+  const auto& genome = individual.GetGenome();
+  return individual.GetInt<uint64_t>(genome.GetGeneStartBitIndex(gene_index),
+                                     genome.GetGeneBitWitdh(gene_index));
+}
+
+double AdditiveObjective(Individual* individual, void* user_data) {
+  static_cast<DeltaTestUserData*>(user_data)->full_evaluations++;
+  const auto& genome = individual->GetGenome();
+  double score = 0.0;
+  for (size_t i = 0; i < genome.GetGeneCount(); i++) {
+    score += GeneContribution(genome, i, ReadRawGene(*individual, i));
+  }
+  return score;
+}
+
+double AdditiveDeltaObjective(Individual* individual,
+                              const panga::GeneDelta& delta,
+                              void* user_data) {
+  static_cast<DeltaTestUserData*>(user_data)->delta_evaluations++;
+  const auto& genome = individual->GetGenome();
+  double score = delta.parent_score;
+  for (size_t i = 0; i < delta.changed_gene_count; i++) {
+    const size_t gene_index = delta.changed_genes[i];
+    score += GeneContribution(genome, gene_index,
+                              ReadRawGene(*individual, gene_index)) -
+             GeneContribution(genome, gene_index,
+                              delta.parent_gene_values[i]);
+  }
+  return score;
+}
+
+// A run which scores the genes of the delta test genome with
+// AdditiveObjective through |test_data|.
+TestRun DeltaTestRun(size_t thread_count, DeltaTestUserData* test_data) {
+  TestRun run;
+  run.Seed(91U)
+      .BitCount(0)
+      .PopulationSize(40U)
+      .Generations(15U)
+      .Threads(thread_count)
+      .Elites(2, 2)
+      .Configure([test_data](GeneticAlgorithm* ga) {
+        for (size_t i = 0; i < DeltaTestGeneCount; i++) {
+          ga->GetGenome().AddGene(DeltaTestGeneWidth, i % 4U == 0);
+        }
+        ga->GetGenome().AddBooleanGenes(DeltaTestBooleanGeneCount);
+        ga->SetCrossoverRate(0.6);
+        ga->SetCrossoverType(GeneticAlgorithm::CrossoverType::OnePoint);
+        ga->SetMutationRate(0.01);
+        ga->SetFitnessFunction(AdditiveObjective);
+        ga->SetUserData(test_data);
+      });
+  return run;
+}
+
+void UseDeltaFitness(GeneticAlgorithm* ga) {
+  ga->SetDeltaFitnessFunction(AdditiveDeltaObjective);
+}
+
+void UsePipelinedEvaluation(GeneticAlgorithm* ga) {
+  ga->SetPipelinedEvaluation(true);
+}
+
+bool TestChangedGenes() {
+  constexpr size_t first_width = 5U;
+  constexpr size_t aligned_width = 8U;
+  constexpr size_t wide_width = 70U;
+  constexpr size_t boolean_gene_count = 9U;
+
+  Genome genome;
+  genome.AddGene(first_width);
+  // Starts at bit 8 after three padding bits.
+  genome.AddGene(aligned_width, true);
+  genome.AddGene(wide_width);
+  genome.AddBooleanGenes(boolean_gene_count);
+  genome.Freeze();
+  const size_t padding_bit = first_width + 1U;
+  const size_t first_boolean_bit = genome.GetFirstBooleanGeneBitIndex();
+
+  AssertTrue(genome.GetGeneIndexForBit(0) == 0, "Bit in the first gene");
+  AssertTrue(genome.GetGeneIndexForBit(padding_bit) == genome.GetGeneCount(),
+             "Padding bits belong to no gene");
+  AssertTrue(genome.GetGeneIndexForBit(first_boolean_bit - 1U) == 2U,
+             "Last bit of the wide gene");
+  AssertTrue(genome.GetGeneIndexForBit(first_boolean_bit + 3U) == 6U,
+             "Each boolean gene holds one bit");
+
+  Chromosome left(genome);
+  Chromosome right(genome);
+  RandomWrapper random(92U);
+  left.Randomize(&random);
+  static_cast<BitVector&>(right) = left;
+  std::vector<size_t> changed;
+  left.FindChangedGenes(right, &changed);
+  AssertTrue(changed.empty(), "Equal chromosomes have no changed genes");
+
+  // Two bits in the wide gene, one of them past the first word.
+  right.Flip(padding_bit);
+  right.Flip(genome.GetGeneStartBitIndex(2) + 1U);
+  right.Flip(genome.GetGeneStartBitIndex(2) + 65U);
+  right.Flip(first_boolean_bit);
+  right.Flip(first_boolean_bit + boolean_gene_count - 1U);
+  left.FindChangedGenes(right, &changed);
+  const std::vector<size_t> expected = {2U, 3U, 3U + boolean_gene_count - 1U};
+  AssertTrue(changed == expected, "Each changed gene is listed once");
+
+  Chromosome flipped(genome);
+  flipped.Set(2);
+  flipped.Set(first_boolean_bit + 1U);
+  std::vector<size_t> flipped_genes;
+  flipped.FindGenesWithSetBits(&flipped_genes);
+  AssertTrue((flipped_genes == std::vector<size_t>{0U, 4U}),
+             "Genes with set bits");
+  left.FlipBits(flipped);
+  AssertTrue(left.Get(2) != right.Get(2), "FlipBits flips the masked bits");
+  AssertTrue(left.HammingDistance(right) == 7U, "Only masked bits flip");
+
+  return true;
+}
+
+bool TestDeltaEvaluation(size_t thread_count) {
+  DeltaTestUserData full_data;
+  DeltaTestUserData delta_data;
+  const auto full = DeltaTestRun(thread_count, &full_data).Run();
+  const auto delta =
+      DeltaTestRun(thread_count, &delta_data).Configure(UseDeltaFitness).Run();
+
+  for (size_t i = 0; i < full.chromosomes.size(); i++) {
+    AssertTrue(full.chromosomes[i].Equals(delta.chromosomes[i]),
+               "Delta evaluation doesn't change the result");
+    AssertTrue(full.scores[i] == delta.scores[i],
+               "Delta scores match full scores");
+  }
+  AssertTrue(full_data.delta_evaluations == 0,
+             "The delta function is only used once set");
+  AssertTrue(delta_data.delta_evaluations != 0,
+             "Offspring are scored by the delta function");
+  AssertTrue(delta_data.full_evaluations < full_data.full_evaluations,
+             "Delta evaluation replaces full evaluations");
+
+  return true;
+}
+
+class CountingReproductionBackend : public panga::CpuReproductionBackend {
+ public:
+  using CpuReproductionBackend::CpuReproductionBackend;
+
+  void CreateOffspring(const panga::OffspringBatch& batch) override {
+    offspring_count_ += batch.count;
+    CpuReproductionBackend::CreateOffspring(batch);
+  }
+
+  size_t GetOffspringCount() const { return offspring_count_; }
+
+ private:
+  size_t offspring_count_ = 0;
+};
+
+bool TestReproductionBackend() {
+  constexpr size_t bit_count = 150U;
+  constexpr size_t word_count = 3U;
+  constexpr size_t bits_per_word = 64U;
+  constexpr size_t thread_count = 4U;
+
+  // Cross over all-ones and all-zeros with a single cut and no mutation.
+  std::vector<uint64_t> ones(word_count, ~uint64_t{0});
+  ones.back() = (uint64_t{1} << (bit_count % bits_per_word)) - 1U;
+  std::vector<uint64_t> zeros(word_count, 0);
+  std::vector<uint64_t> child(word_count, 0);
+  const auto* first_parent = reinterpret_cast<const std::byte*>(ones.data());
+  const auto* second_parent = reinterpret_cast<const std::byte*>(zeros.data());
+  auto* offspring = reinterpret_cast<std::byte*>(child.data());
+  constexpr uint64_t batch_seed = 82U;
+  panga::OffspringBatch batch;
+  batch.first_parents = &first_parent;
+  batch.second_parents = &second_parent;
+  batch.offspring = &offspring;
+  batch.seeds = &batch_seed;
+  batch.count = 1;
+  batch.bit_count = bit_count;
+  batch.crossover_point_count = 1;
+  panga::CpuReproductionBackend backend;
+  backend.CreateOffspring(batch);
+  size_t transitions = 0;
+  for (size_t bit = 1; bit < bit_count; bit++) {
+    const auto get_bit = [&child](size_t index) {
+      return (child[index / bits_per_word] >> (index % bits_per_word)) & 1U;
+    };
+    if (get_bit(bit) != get_bit(bit - 1U)) {
+      transitions++;
+      AssertTrue(get_bit(bit) == 0, "One-point offspring start as parent 1");
+    }
+  }
+  AssertTrue(transitions <= 1, "One cut switches parents at most once");
+
+  // Flipping every bit never touches the padding.
+  batch.first_parents = &second_parent;
+  batch.crossover_point_count = 0;
+  batch.mutation_rate = 1.0;
+  backend.CreateOffspring(batch);
+  AssertTrue(child == ones, "Offspring only flip bits in the chromosome");
+
+  // Builds with a backend are identical no matter how the work is split and
+  // calculate the same diversity as the population does.
+  using CrossoverType = GeneticAlgorithm::CrossoverType;
+  for (const auto crossover_type :
+       {CrossoverType::Uniform, CrossoverType::TwoPoint}) {
+    const auto run = [crossover_type](size_t run_thread_count,
+                                      CountingReproductionBackend* backend,
+                                      bool* is_diversity_equal) {
+      return TestRun()
+          .Threads(run_thread_count)
+          .Configure([crossover_type, backend](GeneticAlgorithm* ga) {
+            ga->SetCrossoverType(crossover_type);
+            ga->SetMutatorType(GeneticAlgorithm::MutatorType::MaskFlip);
+            ga->SetReproductionBackend(backend);
+          })
+          .Finish([is_diversity_equal](GeneticAlgorithm* ga) {
+            const double diversity =
+                ga->GetPopulation().GetPopulationDiversity();
+            ga->SetReproductionBackend(nullptr);
+            *is_diversity_equal =
+                diversity == ga->GetPopulation().GetPopulationDiversity();
+          })
+          .Run()
+          .chromosomes;
+    };
+
+    CountingReproductionBackend serial_backend;
+    bool is_diversity_equal = false;
+    const auto serial = run(1, &serial_backend, &is_diversity_equal);
+    AssertTrue(serial_backend.GetOffspringCount() != 0,
+               "Offspring are built by the backend");
+    AssertTrue(is_diversity_equal,
+               "Backend diversity matches the population diversity");
+
+    ThreadPool pool(thread_count);
+    CountingReproductionBackend parallel_backend(&pool);
+    const auto parallel =
+        run(thread_count, &parallel_backend, &is_diversity_equal);
+    AssertTrue(serial_backend.GetOffspringCount() ==
+                   parallel_backend.GetOffspringCount(),
+               "Thread count doesn't change which offspring are built");
+    for (size_t i = 0; i < serial.size(); i++) {
+      AssertTrue(serial[i].Equals(parallel[i]),
+                 "Thread count doesn't change backend offspring");
+    }
+  }
+
+  return true;
+}
+
+bool TestCombinedReproductionModes() {
+  constexpr size_t thread_count = 4U;
+  constexpr size_t candidate_count = 3U;
+  constexpr size_t archive_capacity = 128U;
+
+  struct Counts {
+    size_t backend_offspring_count = 0;
+    size_t screened_offspring_count = 0;
+    size_t evaluation_count = 0;
+  };
+  const auto run = [](size_t run_thread_count, bool pipelined,
+                      Counts* counts) {
+    ParallelTestUserData test_data;
+    ThreadPool pool(run_thread_count);
+    CountingReproductionBackend backend(&pool);
+    const auto result =
+        TestRun(&test_data)
+            .Threads(run_thread_count)
+            .Elites(1, 2)
+            .Configure([&backend, pipelined](GeneticAlgorithm* ga) {
+              ga->SetCrossoverRate(0.7);
+              ga->SetMutatorType(GeneticAlgorithm::MutatorType::MaskFlip);
+              ga->SetReproductionBackend(&backend);
+              ga->SetScreeningCandidateCount(candidate_count);
+              ga->SetSurrogateArchiveCapacity(archive_capacity);
+              ga->SetPipelinedEvaluation(pipelined);
+            })
+            .Finish([counts](GeneticAlgorithm* ga) {
+              counts->screened_offspring_count =
+                  ga->GetScreenedOffspringCount();
+            })
+            .Run();
+    counts->backend_offspring_count = backend.GetOffspringCount();
+    counts->evaluation_count = test_data.evaluation_count;
+    return result;
+  };
+
+  // Screening steps aside for the backend and pipelining scores the backend
+  // offspring early, without changing any result.
+  Counts serial_counts;
+  const auto serial = run(1, false, &serial_counts);
+  AssertTrue(serial_counts.backend_offspring_count != 0,
+             "Offspring are built by the backend");
+  AssertTrue(serial_counts.screened_offspring_count == 0,
+             "Backend offspring aren't screened");
+  for (const bool pipelined : {false, true}) {
+    Counts counts;
+    const auto combined = run(thread_count, pipelined, &counts);
+    AssertTrue(counts.backend_offspring_count ==
+                   serial_counts.backend_offspring_count,
+               "Every mode builds the same backend offspring");
+    AssertTrue(counts.evaluation_count == serial_counts.evaluation_count,
+               "Individuals scored early aren't scored again");
+    for (size_t i = 0; i < serial.chromosomes.size(); i++) {
+      AssertTrue(serial.chromosomes[i].Equals(combined.chromosomes[i]) &&
+                     serial.scores[i] == combined.scores[i],
+                 "Backend, screening and pipelining together don't change "
+                 "the result");
+    }
+  }
+
+  return true;
+}
+
+double ExactSurrogate(const Individual* individual, void* user_test_data) {
+  const auto* test_data = static_cast<ParallelTestUserData*>(user_test_data);
+  return static_cast<double>(
+      test_data->target_bits.HammingDistance(*individual));
+}
+
+bool TestOffspringScreening() {
+  constexpr size_t bit_count = 8U;
+  constexpr size_t candidate_count = 4U;
+  constexpr size_t archive_capacity = 256U;
+  constexpr size_t thread_count = 4U;
+
+  // The archive finds the nearest chromosome and forgets the oldest one.
+  panga::NearestNeighborSurrogate archive(2);
+  BitVector chromosome(bit_count);
+  chromosome.FromStringHex("0f", 2);
+  archive.Add(chromosome, 1.0);
+  chromosome.FromStringHex("ff", 2);
+  archive.Add(chromosome, 2.0);
+  double estimate = 0.0;
+  chromosome.FromStringHex("7f", 2);
+  AssertTrue(archive.Estimate(chromosome, &estimate) && estimate == 2.0,
+             "Estimate with the nearest archived chromosome");
+  chromosome.FromStringHex("00", 2);
+  archive.Add(chromosome, 3.0);
+  chromosome.FromStringHex("03", 2);
+  AssertTrue(archive.Estimate(chromosome, &estimate) && estimate == 3.0,
+             "Estimate with the nearest archived chromosome");
+  chromosome.FromStringHex("07", 2);
+  AssertTrue(archive.Estimate(chromosome, &estimate) && estimate == 3.0,
+             "The oldest chromosome is replaced once the archive is full");
+  archive.Clear();
+  AssertTrue(!archive.Estimate(chromosome, &estimate),
+             "An empty archive has no estimate");
+
+  struct ScreeningStats {
+    ParallelTestUserData test_data;
+    size_t screened_offspring_count = 0;
+  };
+  // Every run shares the seed and sizes so only the screening knobs differ.
+  const auto screening_run = [](size_t run_thread_count,
+                                size_t run_candidate_count,
+                                ScreeningStats* stats) {
+    TestRun run(&stats->test_data);
+    run.Seed(83U)
+        .BitCount(120U)
+        .Generations(10U)
+        .Threads(run_thread_count)
+        .Elites(1)
+        .Configure([run_candidate_count](GeneticAlgorithm* ga) {
+          ga->SetScreeningCandidateCount(run_candidate_count);
+        })
+        .Finish([stats](GeneticAlgorithm* ga) {
+          stats->screened_offspring_count = ga->GetScreenedOffspringCount();
+        });
+    return run;
+  };
+  const auto use_archive = [](GeneticAlgorithm* ga) {
+    ga->SetSurrogateArchiveCapacity(archive_capacity);
+  };
+  const auto use_exact_surrogate = [](GeneticAlgorithm* ga) {
+    ga->SetSurrogateFunction(ExactSurrogate);
+  };
+  // Every offspring clones a parent sampled by stochastic universal sampling
+  // so screening can only help by selecting other parents.
+  const auto use_sampled_clones = [](GeneticAlgorithm* ga) {
+    ga->SetSelectorType(
+        GeneticAlgorithm::SelectorType::StochasticUniversalSampling);
+    ga->SetCrossoverRate(0.0);
+  };
+  const auto average = [](const TestRunResult& result) {
+    double sum = 0.0;
+    for (const double score : result.scores) {
+      sum += score;
+    }
+    return sum / static_cast<double>(result.scores.size());
+  };
+
+  ScreeningStats unscreened_stats;
+  const auto unscreened =
+      screening_run(1, 1, &unscreened_stats).Configure(use_archive).Run();
+  AssertTrue(unscreened_stats.screened_offspring_count == 0,
+             "A single candidate screens nothing");
+
+  ScreeningStats serial_stats;
+  const auto serial = screening_run(1, candidate_count, &serial_stats)
+                          .Configure(use_archive)
+                          .Run();
+  ScreeningStats parallel_stats;
+  const auto parallel =
+      screening_run(thread_count, candidate_count, &parallel_stats)
+          .Configure(use_archive)
+          .Run();
+  AssertTrue(serial_stats.screened_offspring_count != 0,
+             "Screening discards candidates");
+  AssertTrue(serial_stats.test_data.evaluation_count ==
+                 unscreened_stats.test_data.evaluation_count,
+             "Only the kept offspring are evaluated");
+  AssertTrue(serial_stats.screened_offspring_count ==
+                 parallel_stats.screened_offspring_count,
+             "Thread count doesn't change screening");
+  for (size_t i = 0; i < serial.chromosomes.size(); i++) {
+    AssertTrue(serial.chromosomes[i].Equals(parallel.chromosomes[i]),
+               "Thread count doesn't change screened offspring");
+  }
+
+  // With a surrogate which knows the true score, screening picks better
+  // offspring for the same number of evaluations.
+  ScreeningStats exact_stats;
+  const auto exact = screening_run(1, candidate_count, &exact_stats)
+                         .Configure(use_exact_surrogate)
+                         .Run();
+  AssertTrue(exact_stats.test_data.evaluation_count ==
+                 unscreened_stats.test_data.evaluation_count,
+             "The surrogate function isn't counted as an evaluation");
+  AssertTrue(exact.scores.front() < unscreened.scores.front(),
+             "Screening with an exact surrogate finds better offspring");
+
+  ScreeningStats sampled_stats;
+  const auto sampled = screening_run(1, 1, &sampled_stats)
+                           .Configure(use_exact_surrogate)
+                           .Configure(use_sampled_clones)
+                           .Run();
+  ScreeningStats sampled_screened_stats;
+  const auto sampled_screened =
+      screening_run(1, candidate_count, &sampled_screened_stats)
+          .Configure(use_exact_surrogate)
+          .Configure(use_sampled_clones)
+          .Run();
+  AssertTrue(average(sampled_screened) < average(sampled),
+             "Screening candidates select their own parents");
+
+  return true;
+}
+
+bool TestSurrogateArchiveFeeding(size_t thread_count) {
+  constexpr uint64_t seed = 89U;
+  constexpr size_t bit_count = 120U;
+  constexpr size_t generations = 5U;
+  constexpr size_t steady_state_evaluations = 60U;
+  constexpr size_t archive_capacity = 4096U;
+  constexpr size_t fitness_cache_capacity = 4096U;
+
+  // Every chromosome the fitness function scores is archived - fitness
+  // cache hits are not.
+  ParallelTestUserData test_data;
+  test_data.target_bits.SetBitCount(bit_count);
+  GeneticAlgorithm ga;
+  ConfigureIsland(&ga, &test_data);
+  ga.SetThreadCount(thread_count);
+  ga.SetSurrogateArchiveCapacity(archive_capacity);
+  ga.SetFitnessCacheCapacity(fitness_cache_capacity);
+  ga.SetRandomSeed(seed);
+  ga.Initialize();
+  for (size_t generation = 0; generation < generations; generation++) {
+    ga.Step();
+  }
+  AssertTrue(ga.GetSurrogateArchive()->Size() == test_data.evaluation_count,
+             "Step archives exactly the evaluated offspring");
+
+  ga.RunSteadyState(steady_state_evaluations);
+  AssertTrue(ga.GetSurrogateArchive()->Size() == test_data.evaluation_count,
+             "Steady-state offspring are archived");
+
+  Individual immigrant(ga.GetGenome());
+  RandomWrapper random(seed);
+  immigrant.Randomize(&random);
+  immigrant.SetDirty(true);
+  ga.ReplaceWorstIndividual(&immigrant);
+  AssertTrue(ga.GetSurrogateArchive()->Size() == test_data.evaluation_count,
+             "Rescored immigrants are archived");
+
+  return true;
+}
+
+bool TestPipelinedEvaluation(size_t thread_count) {
+  DeltaTestUserData full_data;
+  const auto full = DeltaTestRun(thread_count, &full_data).Run();
+
+  for (const bool use_delta : {false, true}) {
+    DeltaTestUserData pipelined_data;
+    auto run = DeltaTestRun(thread_count, &pipelined_data);
+    run.Configure(UsePipelinedEvaluation);
+    if (use_delta) {
+      run.Configure(UseDeltaFitness);
+    }
+    const auto pipelined = run.Run();
+    for (size_t i = 0; i < full.chromosomes.size(); i++) {
+      AssertTrue(full.chromosomes[i].Equals(pipelined.chromosomes[i]),
+                 "Pipelined evaluation doesn't change the result");
+      AssertTrue(full.scores[i] == pipelined.scores[i],
+                 "Pipelined scores match scores from Evaluate");
+    }
+    AssertTrue(
+        pipelined_data.full_evaluations + pipelined_data.delta_evaluations ==
+            full_data.full_evaluations,
+        "Individuals scored early aren't scored again");
+  }
+
+  return true;
+}
+
+using MutatorFunction = size_t (*)(Chromosome*, double, RandomWrapper*);
+
+bool TestBernoulliMutator(MutatorFunction mutator) {
+  // Not a multiple of the word size so the padding bits get exercised.
+  constexpr size_t bit_count = 1000U;
+  constexpr uint64_t seed = 99U;
+  constexpr size_t trials = 200U;
+  // Allowed distance from the expected flip count in standard deviations.
+  constexpr double tolerance = 5.0;
+  constexpr double rates[] = {0.002, 0.05, 0.3, 0.75};
+
+  Genome genome;
+  genome.AddBooleanGenes(bit_count);
+  Chromosome chromosome(genome);
+  RandomWrapper random(seed);
+
+  for (const double rate : rates) {
+    size_t total_flips = 0;
+    for (size_t trial = 0; trial < trials; trial++) {
+      chromosome.Clear();
+      const size_t flips = mutator(&chromosome, rate, &random);
+      size_t set_bits = 0;
+      for (size_t i = 0; i < bit_count; i++) {
+        set_bits += chromosome.Get(i) ? 1U : 0U;
+      }
+      AssertTrue(set_bits == flips, "Every reported flip is a distinct bit");
+      total_flips += flips;
+    }
+    // The flip count is binomial over every bit of every trial.
+    const double draws = static_cast<double>(bit_count * trials);
+    const double expected = rate * draws;
+    const double deviation = std::sqrt(draws * rate * (1.0 - rate));
+    AssertTrue(std::fabs(static_cast<double>(total_flips) - expected) <
+                   deviation * tolerance,
+               "Bits flip at the requested rate");
+  }
+
+  chromosome.Clear();
+  AssertTrue(mutator(&chromosome, 0.0, &random) == 0,
+             "A zero rate flips nothing");
+  AssertTrue(mutator(&chromosome, 1.0, &random) == bit_count,
+             "A rate of one flips every bit");
+  for (size_t i = 0; i < bit_count; i++) {
+    AssertTrue(chromosome.Get(i), "A rate of one flips every bit");
+  }
+
+  return true;
+}
+
+bool TestGeneLayoutDecoding() {
+  constexpr uint64_t seed = 57U;
+  constexpr size_t gene_widths[] = {3, 17, 57, 64, 9, 31, 58, 5};
+  constexpr size_t aligned_gene = 4U;
+  constexpr size_t boolean_gene_count = 11U;
+  constexpr size_t fixed_width_gene = 1U;
+  constexpr size_t fixed_width = 17U;
+  constexpr size_t trials = 50U;
+  constexpr double min = -2.5;
+  constexpr double max = 7.0;
+  constexpr uint64_t integer_max = 1000U;
+  constexpr double epsilon = 1e-12;
+  constexpr size_t gene_count = std::size(gene_widths);
+
+  Genome genome;
+  Genome frozen_genome;
+  for (size_t i = 0; i < gene_count; i++) {
+    genome.AddGene(gene_widths[i], i == aligned_gene);
+    frozen_genome.AddGene(gene_widths[i], i == aligned_gene);
+  }
+  genome.AddBooleanGenes(boolean_gene_count);
+  frozen_genome.AddBooleanGenes(boolean_gene_count);
+  frozen_genome.Freeze();
+  AssertTrue(frozen_genome.IsFrozen() && !genome.IsFrozen(), "Freeze");
+
+  const size_t first_boolean = genome.GetFirstBooleanGeneIndex();
+  for (size_t i = 0; i < boolean_gene_count; i++) {
+    AssertTrue(genome.GetGeneStartBitIndex(first_boolean + i) ==
+                   genome.GetFirstBooleanGeneBitIndex() + i,
+               "Boolean genes are laid out in order");
+  }
+
+  Chromosome chromosome(genome);
+  Chromosome frozen(frozen_genome);
+  RandomWrapper random(seed);
+  uint64_t integers[gene_count];
+  double floats[gene_count];
+  for (size_t trial = 0; trial < trials; trial++) {
+    chromosome.Randomize(&random);
+    static_cast<BitVector&>(frozen) = chromosome;
+    frozen.DecodeAllIntegerGenes(integers);
+    frozen.DecodeAllFloatGenes(floats, min, max);
+
+    for (size_t i = 0; i < gene_count; i++) {
+      const auto expected =
+          chromosome.DecodeIntegerGene(i, uint64_t{0}, integer_max);
+      AssertTrue(
+          frozen.DecodeIntegerGene(i, uint64_t{0}, integer_max) == expected,
+          "Decoding through the layout gives the same integer");
+      const auto raw = chromosome.DecodeIntegerGene<uint64_t, false>(i);
+      AssertTrue((frozen.DecodeIntegerGene<uint64_t, false>(i) == raw),
+                 "Decoding through the layout gives the same raw bits");
+      const double expected_float = chromosome.DecodeFloatGene(i, min, max);
+      AssertTrue(std::fabs(frozen.DecodeFloatGene(i, min, max) -
+                           expected_float) < epsilon,
+                 "Decoding through the layout gives the same float");
+      AssertTrue(std::fabs(floats[i] - expected_float) < epsilon,
+                 "DecodeAllFloatGenes gives the same float");
+      AssertTrue(Chromosome::EncodeGray(integers[i]) == raw,
+                 "DecodeAllIntegerGenes gives the decoded gray value");
+    }
+    AssertTrue(
+        frozen.DecodeIntegerGeneOfWidth<fixed_width>(fixed_width_gene) ==
+            frozen.DecodeIntegerGene(fixed_width_gene),
+        "A compile-time width decodes the same integer");
+    AssertTrue(
+        frozen.DecodeFloatGeneOfWidth<fixed_width>(fixed_width_gene, min,
+                                                   max) ==
+            floats[fixed_width_gene],
+        "A compile-time width decodes the same float");
+  }
+
+  return true;
+}
+
+// One gene inside the first word, one straddling both words, one inside the
+// second word and then boolean genes.
+using FixedLayout = FixedGenome<5, 10, 60, 7>;
+using FixedLayoutChromosome = FixedChromosome<FixedLayout>;
+
+static_assert(FixedLayout::BitsRequired == 82U);
+static_assert(FixedLayout::GetGeneStartBitIndex(2) == 70U);
+static_assert(FixedLayout::GetGeneStartBitIndex(4) == 78U);
+static_assert(FixedLayoutChromosome::WordCount == 2U);
+static_assert(std::is_trivially_copyable_v<FixedLayoutChromosome>);
+static_assert(sizeof(FixedLayoutChromosome) == 2U * sizeof(uint64_t));
+
+constexpr FixedLayoutChromosome MakeFixedChromosome(uint64_t straddling_value) {
+  FixedLayoutChromosome chromosome;
+  chromosome.EncodeIntegerGene<1>(straddling_value);
+  chromosome.Set(FixedLayout::GetGeneStartBitIndex(3));
+  return chromosome;
+}
+
+static_assert(MakeFixedChromosome(123456789U).DecodeIntegerGene<1>() ==
+              123456789U);
+static_assert(MakeFixedChromosome(1U).DecodeIntegerGene<0>() == 0U);
+static_assert(MakeFixedChromosome(1U).DecodeBooleanGene<3>());
+static_assert(!MakeFixedChromosome(1U).DecodeBooleanGene<4>());
+
+bool TestFixedChromosome() {
+  constexpr uint64_t seed = 61U;
+  constexpr size_t trials = 50U;
+  constexpr double min = -2.5;
+  constexpr double max = 7.0;
+  constexpr uint64_t integer_max = 1000U;
+  constexpr double epsilon = 1e-12;
+
+  Genome genome;
+  FixedLayout::AddGenesTo(&genome);
+  AssertTrue(FixedLayout::Matches(genome), "Added genes match the layout");
+  Genome other_genome;
+  other_genome.AddGene(10, true);
+  other_genome.AddGene(60);
+  other_genome.AddGene(7);
+  other_genome.AddBooleanGenes(5);
+  AssertTrue(!FixedLayout::Matches(other_genome),
+             "A byte aligned gene doesn't match the layout");
+
+  Chromosome chromosome(genome);
+  Chromosome stored(genome);
+  RandomWrapper random(seed);
+  for (size_t trial = 0; trial < trials; trial++) {
+    chromosome.Randomize(&random);
+    const FixedLayoutChromosome fixed(chromosome);
+
+    AssertTrue(fixed.DecodeIntegerGene<0>(uint64_t{0}, integer_max) ==
+                   chromosome.DecodeIntegerGene(0, uint64_t{0}, integer_max),
+               "Fixed decode gives the same clamped integer");
+    AssertTrue(fixed.DecodeIntegerGene<1>() ==
+                   chromosome.DecodeIntegerGene(1),
+               "Fixed decode gives the same integer across words");
+    AssertTrue((fixed.DecodeIntegerGene<2, uint64_t, false>() ==
+                chromosome.DecodeIntegerGene<uint64_t, false>(2)),
+               "Fixed decode gives the same raw bits");
+    const double floats[] = {fixed.DecodeFloatGene<0>(min, max),
+                             fixed.DecodeFloatGene<1>(min, max),
+                             fixed.DecodeFloatGene<2>(min, max)};
+    for (size_t i = 0; i < FixedLayout::FirstBooleanGeneIndex; i++) {
+      AssertTrue(
+          std::fabs(chromosome.DecodeFloatGene(i, min, max) - floats[i]) <
+              epsilon,
+          "Fixed decode gives the same float");
+    }
+    AssertTrue(fixed.DecodeBooleanGene<5>() ==
+                   chromosome.Get(FixedLayout::GetGeneStartBitIndex(5)),
+               "Fixed decode gives the same boolean");
+    for (size_t i = 0; i < FixedLayout::BitsRequired; i++) {
+      AssertTrue(fixed.Get(i) == chromosome.Get(i), "Every bit is loaded");
+    }
+
+    FixedLayoutChromosome copy = fixed;
+    AssertTrue(copy == fixed && copy.HammingDistance(fixed) == 0,
+               "Copies are equal");
+    copy.EncodeIntegerGene<1>(trial);
+    copy.Flip(FixedLayout::BitsRequired - 1U);
+    copy.Store(&stored);
+    AssertTrue(FixedLayoutChromosome(stored) == copy,
+               "Stored bits load back the same chromosome");
+    AssertTrue(stored.DecodeIntegerGene(1) == trial,
+               "Encoded gene decodes through the runtime genome");
+    AssertTrue(
+        copy.HammingDistance(fixed) == stored.HammingDistance(chromosome),
+        "Hamming distance matches the runtime chromosomes");
+  }
+
+  return true;
+}
+
 bool TestCrossoverGenes(size_t gene_count, size_t gene_width) {
   Genome genome;
   for (size_t i = 0; i < gene_count; i++) {
@@ -182,6 +2774,337 @@ bool TestCrossoverGenes(size_t gene_count, size_t gene_width) {
   return true;
 }
 
+// Count the runs of equal bits in |bits|.
+size_t CountBitRuns(const BitVector& bits) {
+  size_t runs = bits.GetBitCount() == 0 ? 0 : 1U;
+  for (size_t i = 1; i < bits.GetBitCount(); i++) {
+    runs += bits.Get(i) != bits.Get(i - 1U) ? 1U : 0U;
+  }
+  return runs;
+}
+
+bool TestMaskedCrossover() {
+  constexpr uint64_t seed = 73U;
+  constexpr size_t gene_widths[] = {5, 13, 64, 7, 30, 70, 1};
+  constexpr size_t boolean_gene_count = 150U;
+  constexpr size_t k = 5U;
+  constexpr size_t trials = 200U;
+  constexpr double boolean_tolerance = 0.1;
+
+  Genome genome;
+  for (const size_t width : gene_widths) {
+    genome.AddGene(width);
+  }
+  genome.AddBooleanGenes(boolean_gene_count);
+  const size_t bit_count = genome.BitsRequired();
+
+  // Parent1 is all ones and parent2 is all zeros so every set bit of the
+  // offspring came from parent1.
+  Individual ones(genome);
+  Individual zeros(genome);
+  Individual offspring(genome);
+  for (size_t i = 0; i < bit_count; i++) {
+    ones.Set(i);
+  }
+  RandomWrapper random(seed);
+
+  const size_t first_boolean = genome.GetFirstBooleanGeneIndex();
+  const auto genes_are_whole = [&]() {
+    for (size_t gene = 0; gene < first_boolean; gene++) {
+      const size_t begin = genome.GetGeneStartBitIndex(gene);
+      for (size_t i = 1; i < genome.GetGeneBitWitdh(gene); i++) {
+        if (offspring.Get(begin + i) != offspring.Get(begin)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  size_t boolean_ones = 0;
+  for (size_t trial = 0; trial < trials; trial++) {
+    Individual::KPointCrossover(k, ones, zeros, &offspring, &random, true);
+    AssertTrue(CountBitRuns(offspring) <= k + 1U,
+               "K-point crossover copies at most k + 1 chunks");
+    AssertTrue(offspring.Get(0), "The first chunk comes from parent1");
+
+    Individual::KPointCrossover(k, ones, zeros, &offspring, &random, false);
+    AssertTrue(CountBitRuns(offspring) <= k + 1U,
+               "K-point crossover by gene copies at most k + 1 chunks");
+    AssertTrue(genes_are_whole(), "K-point crossover only cuts between genes");
+
+    Individual::UniformCrossover(ones, zeros, &offspring, &random, false);
+    AssertTrue(genes_are_whole(), "Uniform crossover keeps genes whole");
+    for (size_t gene = 0; gene < boolean_gene_count; gene++) {
+      boolean_ones += offspring.DecodeBooleanGene(first_boolean + gene);
+    }
+  }
+  const double boolean_share =
+      static_cast<double>(boolean_ones) / (boolean_gene_count * trials);
+  AssertTrue(std::fabs(boolean_share - 0.5) < boolean_tolerance,
+             "Boolean genes come from either parent evenly");
+
+  return true;
+}
+
+template <typename ValueType>
+bool ValueGenesInRange(const Chromosome& chromosome) {
+  const auto& genome = chromosome.GetGenome();
+  const ValueType* values = chromosome.GetValueGenes<ValueType>();
+  for (size_t i = 0; i < genome.GetValueGeneCount(); i++) {
+    // Written so NaN values are out of range as well.
+    if (!(values[i] >= genome.GetValueGeneMin() &&
+          values[i] <= genome.GetValueGeneMax())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool TestValueGenes() {
+  constexpr uint64_t seed = 29U;
+  constexpr size_t leading_gene_width = 3U;
+  constexpr size_t value_gene_count = 12U;
+  constexpr size_t boolean_gene_count = 5U;
+  constexpr double min = -2.0;
+  constexpr double max = 3.0;
+  constexpr size_t trials = 50U;
+
+  Genome genome;
+  genome.AddGene(leading_gene_width);
+  const size_t first_value =
+      genome.AddValueGenes<double>(value_gene_count / 2U, min, max);
+  genome.AddValueGenes<double>(value_gene_count / 2U, min, max);
+  genome.AddBooleanGenes(boolean_gene_count);
+  genome.Freeze();
+  AssertTrue(first_value == 1U && genome.GetFirstValueGeneIndex() == 1U &&
+                 genome.GetValueGeneCount() == value_gene_count,
+             "Value genes are added as one run");
+  AssertTrue(genome.GetValueGeneByteOffset() == sizeof(double),
+             "Value genes are aligned to the size of their values");
+  AssertTrue(genome.GetFirstBooleanGeneBitIndex() ==
+                 (value_gene_count + 1U) * sizeof(double) * CHAR_BIT,
+             "Boolean genes follow the value genes");
+
+  RandomWrapper random(seed);
+  Chromosome parent1(genome);
+  Chromosome parent2(genome);
+  Chromosome offspring(genome);
+  parent1.Randomize(&random);
+  parent2.Randomize(&random);
+  AssertTrue(ValueGenesInRange<double>(parent1) &&
+                 ValueGenesInRange<double>(parent2),
+             "Random values are inside the range");
+
+  for (size_t trial = 0; trial < trials; trial++) {
+    Chromosome::BlendCrossover(Chromosome::DefaultBlendAlpha, parent1,
+                               parent2, &offspring, &random);
+    AssertTrue(ValueGenesInRange<double>(offspring),
+               "Blend crossover stays inside the range");
+    Chromosome::SimulatedBinaryCrossover(
+        Chromosome::DefaultCrossoverDistributionIndex, parent1, parent2,
+        &offspring, &random);
+    AssertTrue(ValueGenesInRange<double>(offspring),
+               "Simulated binary crossover stays inside the range");
+    AssertTrue(Chromosome::GaussianMutator(&offspring, 1.0, &random) != 0 &&
+                   ValueGenesInRange<double>(offspring),
+               "Gaussian mutation stays inside the range");
+    AssertTrue(Chromosome::PolynomialMutator(&offspring, 1.0, &random) != 0 &&
+                   ValueGenesInRange<double>(offspring),
+               "Polynomial mutation stays inside the range");
+  }
+
+  // Crossing a chromosome with itself keeps its values.
+  Chromosome::SimulatedBinaryCrossover(
+      Chromosome::DefaultCrossoverDistributionIndex, parent1, parent1,
+      &offspring, &random);
+  AssertTrue(offspring.Equals(parent1),
+             "Identical parents have identical offspring");
+  AssertTrue(Chromosome::GaussianMutator(&offspring, 0.0, &random) == 0,
+             "Nothing mutates at a zero rate");
+
+  Genome integer_genome;
+  integer_genome.AddValueGenes<int32_t>(value_gene_count, -4, 4);
+  Chromosome integers(integer_genome);
+  for (size_t trial = 0; trial < trials; trial++) {
+    integers.Randomize(&random);
+    Chromosome::PolynomialMutator(&integers, 1.0, &random);
+    AssertTrue(ValueGenesInRange<int32_t>(integers),
+               "Integer values stay inside the range");
+  }
+
+  return true;
+}
+
+struct MixedGenesUserData {
+  std::atomic<bool> are_values_in_range{true};
+};
+
+double MixedGenesObjective(Individual* individual, void* user_data) {
+  if (!ValueGenesInRange<float>(*individual)) {
+    static_cast<MixedGenesUserData*>(user_data)->are_values_in_range = false;
+  }
+  const auto& genome = individual->GetGenome();
+  const float* values = individual->GetValueGenes<float>();
+  double score = 0.0;
+  for (size_t i = 0; i < genome.GetValueGeneCount(); i++) {
+    score += std::fabs(values[i] - 1.0F);
+  }
+  for (size_t i = genome.GetFirstBooleanGeneIndex(); i < genome.GetGeneCount();
+       i++) {
+    score += individual->DecodeBooleanGene(i) ? 0.0 : 1.0;
+  }
+  return score;
+}
+
+bool TestBitOperatorsOnValueGenes() {
+  constexpr uint64_t seed = 37U;
+  constexpr size_t leading_gene_width = 5U;
+  constexpr size_t value_gene_count = 7U;
+  constexpr size_t boolean_gene_count = 40U;
+  constexpr float min = -4.0F;
+  constexpr float max = 4.0F;
+  constexpr size_t population_size = 30U;
+  constexpr size_t generations = 20U;
+  constexpr double mutation_rate = 0.2;
+
+  using CrossoverType = GeneticAlgorithm::CrossoverType;
+  using MutatorType = GeneticAlgorithm::MutatorType;
+  for (const auto crossover_type :
+       {CrossoverType::OnePoint, CrossoverType::Uniform}) {
+    for (const auto mutator_type :
+         {MutatorType::Flip, MutatorType::GeometricFlip, MutatorType::MaskFlip,
+          MutatorType::Gaussian}) {
+      MixedGenesUserData test_data;
+      GeneticAlgorithm ga;
+      ga.GetGenome().AddGene(leading_gene_width);
+      ga.GetGenome().AddValueGenes<float>(value_gene_count, min, max);
+      ga.GetGenome().AddBooleanGenes(boolean_gene_count);
+      ga.SetPopulationSize(population_size);
+      ga.SetCrossoverType(crossover_type);
+      ga.SetMutatorType(mutator_type);
+      ga.SetMutationRate(mutation_rate);
+      ga.SetFitnessFunction(MixedGenesObjective);
+      ga.SetUserData(&test_data);
+      ga.SetRandomSeed(seed);
+      ga.Initialize();
+      for (size_t i = 0; i < generations; i++) {
+        ga.Step();
+      }
+      AssertTrue(test_data.are_values_in_range,
+                 "Bit operators keep every value gene finite and in range");
+    }
+  }
+
+  // Value mutators flip the bits of every other gene.
+  Genome genome;
+  genome.AddGene(leading_gene_width);
+  genome.AddValueGenes<float>(value_gene_count, min, max);
+  genome.AddBooleanGenes(boolean_gene_count);
+  RandomWrapper random(seed);
+  Chromosome mutated(genome);
+  mutated.Randomize(&random);
+  std::vector<bool> original;
+  for (size_t i = genome.GetFirstBooleanGeneIndex(); i < genome.GetGeneCount();
+       i++) {
+    original.push_back(mutated.DecodeBooleanGene(i));
+  }
+  Chromosome::GaussianMutator(&mutated, mutation_rate, &random);
+  bool is_boolean_gene_changed = false;
+  for (size_t i = 0; i < original.size(); i++) {
+    is_boolean_gene_changed |=
+        mutated.DecodeBooleanGene(genome.GetFirstBooleanGeneIndex() + i) !=
+        original[i];
+  }
+  AssertTrue(is_boolean_gene_changed && ValueGenesInRange<float>(mutated),
+             "Gaussian mutation flips the bits of other genes");
+
+  return true;
+}
+
+struct ValueTestUserData {
+  std::atomic<size_t> delta_evaluations{0};
+};
+
+constexpr int32_t ValueTestTarget = 3;
+
+int64_t ValueGeneError(int32_t value) {
+  const int64_t difference = value - ValueTestTarget;
+  return difference * difference;
+}
+
+double SphereObjective(Individual* individual, void* /*user_data*/) {
+  const auto& genome = individual->GetGenome();
+  const int32_t* values = individual->GetValueGenes<int32_t>();
+  int64_t score = 0;
+  for (size_t i = 0; i < genome.GetValueGeneCount(); i++) {
+    score += ValueGeneError(values[i]);
+  }
+  return static_cast<double>(score);
+}
+
+double SphereDeltaObjective(Individual* individual,
+                            const panga::GeneDelta& delta, void* user_data) {
+  static_cast<ValueTestUserData*>(user_data)->delta_evaluations++;
+  const size_t first_value = individual->GetGenome().GetFirstValueGeneIndex();
+  const int32_t* values = individual->GetValueGenes<int32_t>();
+  double score = delta.parent_score;
+  for (size_t i = 0; i < delta.changed_gene_count; i++) {
+    // Gene values are the raw bits of the value.
+    const auto parent_bits =
+        static_cast<uint32_t>(delta.parent_gene_values[i]);
+    const size_t value_index = delta.changed_genes[i] - first_value;
+    score += static_cast<double>(
+        ValueGeneError(values[value_index]) -
+        ValueGeneError(static_cast<int32_t>(parent_bits)));
+  }
+  return score;
+}
+
+bool TestSolveValueProblem(GeneticAlgorithm::CrossoverType crossover_type,
+                           GeneticAlgorithm::MutatorType mutator_type) {
+  constexpr uint64_t seed = 13U;
+  constexpr size_t value_gene_count = 16U;
+  constexpr int32_t min = -10;
+  constexpr int32_t max = 10;
+  constexpr size_t population_size = 60U;
+  constexpr size_t max_generation = 500U;
+  constexpr double mutation_rate = 0.1;
+
+  std::vector<BitVector> results;
+  for (const bool use_delta : {false, true}) {
+    ValueTestUserData test_data;
+    GeneticAlgorithm ga;
+    ga.GetGenome().AddValueGenes<int32_t>(value_gene_count, min, max);
+    ga.SetPopulationSize(population_size);
+    ga.SetEliteCount(2);
+    ga.SetMutatedEliteCount(2);
+    ga.SetCrossoverType(crossover_type);
+    ga.SetMutatorType(mutator_type);
+    ga.SetMutationRate(mutation_rate);
+    ga.SetFitnessFunction(SphereObjective);
+    if (use_delta) {
+      ga.SetDeltaFitnessFunction(SphereDeltaObjective);
+    }
+    ga.SetUserData(&test_data);
+    ga.SetRandomSeed(seed);
+    ga.Initialize();
+    do {
+      ga.Step();
+    } while (ga.GetCurrentGeneration() < max_generation &&
+             ga.GetPopulation().GetMinimumScore() != 0.0);
+    AssertTrue(ga.GetPopulation().GetMinimumScore() == 0.0,
+               "Value genes reach the target");
+    AssertTrue(use_delta == (test_data.delta_evaluations != 0),
+               "Value genes are scored by the delta function");
+    results.emplace_back(ga.GetPopulation().GetIndividual(0));
+  }
+  AssertTrue(results[0].Equals(results[1]),
+             "Delta evaluation of value genes doesn't change the result");
+
+  return true;
+}
+
 bool TestBitVectorToString(BitVector* bv, const char* expectedBinString,
                            const char* expectedHexString) {
   constexpr size_t buf_size = 2000;
@@ -266,19 +3189,164 @@ bool BitVectorSanityTests() {
   return true;
 }
 
+bool TestBitVectorKernels() {
+  constexpr uint64_t seed = 7U;
+  constexpr size_t bit_count = 517U;
+  constexpr size_t iterations = 200U;
+  RandomWrapper random(seed);
+
+  BitVector left(bit_count);
+  BitVector right(bit_count);
+  BitVector mask(bit_count);
+  for (size_t i = 0; i < bit_count; i++) {
+    if (random.CoinFlip(0.5)) {
+      left.Set(i);
+    }
+    if (random.CoinFlip(0.5)) {
+      right.Set(i);
+    }
+    if (random.CoinFlip(0.5)) {
+      mask.Set(i);
+    }
+  }
+
+  size_t expected_distance = 0;
+  for (size_t i = 0; i < bit_count; i++) {
+    expected_distance += left.Get(i) != right.Get(i) ? 1U : 0U;
+  }
+  AssertTrue(left.HammingDistance(right) == expected_distance,
+             "HammingDistance counts every differing bit");
+
+  BitVector blended;
+  blended.Blend(mask, left, right);
+  for (size_t i = 0; i < bit_count; i++) {
+    AssertTrue(blended.Get(i) == (mask.Get(i) ? left.Get(i) : right.Get(i)),
+               "Blend takes each bit from the parent chosen by the mask");
+  }
+
+  // Copy random ranges of bits at arbitrary offsets and make sure only the
+  // destination range changes.
+  for (size_t iteration = 0; iteration < iterations; iteration++) {
+    const auto source_offset = random.RandomInteger<size_t>(0, bit_count - 1U);
+    const auto destination_offset =
+        random.RandomInteger<size_t>(0, bit_count - 1U);
+    const auto bits_to_copy = random.RandomInteger<size_t>(
+        0, bit_count - std::max(source_offset, destination_offset));
+
+    BitVector destination(right);
+    left.SubVector(&destination, destination_offset, source_offset,
+                   bits_to_copy);
+    for (size_t i = 0; i < bit_count; i++) {
+      const bool in_range =
+          i >= destination_offset && i < destination_offset + bits_to_copy;
+      const bool expected =
+          in_range ? left.Get(source_offset + i - destination_offset)
+                   : right.Get(i);
+      AssertTrue(destination.Get(i) == expected,
+                 "SubVector copies exactly the requested range of bits");
+    }
+  }
+
+  BitVector copy(left);
+  AssertTrue(copy.Equals(left), "Copied BitVector is equal");
+  copy.Flip(bit_count - 1U);
+  AssertTrue(!copy.Equals(left), "Flipping the last bit breaks equality");
+  AssertTrue(copy.Equals(left, bit_count - 1U),
+             "Equality can be limited to a prefix of the bits");
+
+  return true;
+}
+
 int DoTests(int argc, const char** argv) {
   const char* target = nullptr;
   if (argc > 1) {
     target = argv[1];
   }
   ReturnErrorIfFalse(TestSolveMatchingProblem(target));
+  ReturnErrorIfFalse(TestSolveMatchingProblem(
+      target, GeneticAlgorithm::MutatorType::GeometricFlip));
+  ReturnErrorIfFalse(TestSolveMatchingProblem(
+      target, GeneticAlgorithm::MutatorType::MaskFlip));
+
+  ReturnErrorIfFalse(TestRandomWrapper());
+
+  ReturnErrorIfFalse(TestParallelEvaluation(1));
+  ReturnErrorIfFalse(TestParallelEvaluation(4));
+  ReturnErrorIfFalse(TestSeededRunsAreReproducible(
+      GeneticAlgorithm::SelectorType::RouletteWheel));
+  ReturnErrorIfFalse(
+      TestSeededRunsAreReproducible(GeneticAlgorithm::SelectorType::Alias));
+  ReturnErrorIfFalse(TestSeededRunsAreReproducible(
+      GeneticAlgorithm::SelectorType::StochasticUniversalSampling));
+  ReturnErrorIfFalse(
+      TestSteadyState(GeneticAlgorithm::SelectorType::Tournament));
+  ReturnErrorIfFalse(
+      TestSteadyState(GeneticAlgorithm::SelectorType::RouletteWheel));
+  ReturnErrorIfFalse(TestSteadyState(
+      GeneticAlgorithm::SelectorType::StochasticUniversalSampling));
+  ReturnErrorIfFalse(TestIslandModel(IslandModel::MigrationTopology::Ring));
+  ReturnErrorIfFalse(
+      TestIslandModel(IslandModel::MigrationTopology::FullyConnected));
+  ReturnErrorIfFalse(TestIslandModel(IslandModel::MigrationTopology::Random));
+  ReturnErrorIfFalse(TestShortMigrantsAreRejected());
+  ReturnErrorIfFalse(TestMigrantsAreRescored());
+  ReturnErrorIfFalse(TestIslandsWithoutMigration());
+  ReturnErrorIfFalse(TestThreadAffinity());
+  ReturnErrorIfFalse(TestNestedParallelFor());
+  ReturnErrorIfFalse(TestStepStats());
+  ReturnErrorIfFalse(TestCheckpointRoundTrip());
+  ReturnErrorIfFalse(TestCheckpointValidation());
+  ReturnErrorIfFalse(TestInitialPopulationFromRows());
+  ReturnErrorIfFalse(TestGeneratedInitialPopulation());
+  ReturnErrorIfFalse(TestBatchEvaluation(1));
+  ReturnErrorIfFalse(TestBatchEvaluation(4));
+  ReturnErrorIfFalse(TestAsyncEvaluation());
+
+  ReturnErrorIfFalse(TestPopulationDiversity());
+  ReturnErrorIfFalse(TestSelectorsHonorExclusion());
+  ReturnErrorIfFalse(TestFitnessProportionalSelectors());
+  ReturnErrorIfFalse(TestSteadyStatePopulation());
+  ReturnErrorIfFalse(TestPartialSort());
+  ReturnErrorIfFalse(TestPopulationStats());
+  ReturnErrorIfFalse(TestPopulationStorage());
+  ReturnErrorIfFalse(TestPopulationSwap());
+  ReturnErrorIfFalse(TestClonesShareStorage());
+  ReturnErrorIfFalse(TestFitnessCache());
+  ReturnErrorIfFalse(TestCachedEvaluation());
+  ReturnErrorIfFalse(TestChangedGenes());
+  ReturnErrorIfFalse(TestDeltaEvaluation(1));
+  ReturnErrorIfFalse(TestDeltaEvaluation(4));
+  ReturnErrorIfFalse(TestPipelinedEvaluation(1));
+  ReturnErrorIfFalse(TestPipelinedEvaluation(4));
+  ReturnErrorIfFalse(TestReproductionBackend());
+  ReturnErrorIfFalse(TestOffspringScreening());
+  ReturnErrorIfFalse(TestCombinedReproductionModes());
+  ReturnErrorIfFalse(TestSurrogateArchiveFeeding(1));
+  ReturnErrorIfFalse(TestSurrogateArchiveFeeding(4));
+
+  ReturnErrorIfFalse(TestBernoulliMutator(Chromosome::GeometricFlipMutator));
+  ReturnErrorIfFalse(TestBernoulliMutator(Chromosome::MaskFlipMutator));
+
+  ReturnErrorIfFalse(TestGeneLayoutDecoding());
+  ReturnErrorIfFalse(TestFixedChromosome());
 
   ReturnErrorIfFalse(TestCrossoverGenes(10, 1));
   ReturnErrorIfFalse(TestCrossoverGenes(10, 7));
   ReturnErrorIfFalse(TestCrossoverGenes(10, 8));
   ReturnErrorIfFalse(TestCrossoverGenes(10, 9));
+  ReturnErrorIfFalse(TestMaskedCrossover());
+
+  ReturnErrorIfFalse(TestValueGenes());
+  ReturnErrorIfFalse(TestBitOperatorsOnValueGenes());
+  ReturnErrorIfFalse(
+      TestSolveValueProblem(GeneticAlgorithm::CrossoverType::Blend,
+                            GeneticAlgorithm::MutatorType::Gaussian));
+  ReturnErrorIfFalse(
+      TestSolveValueProblem(GeneticAlgorithm::CrossoverType::SimulatedBinary,
+                            GeneticAlgorithm::MutatorType::Polynomial));
 
   ReturnErrorIfFalse(BitVectorSanityTests());
+  ReturnErrorIfFalse(TestBitVectorKernels());
 
   std::cout << "All tests passed!" << std::endl;
 